@@ -0,0 +1,269 @@
+;;; package-cache.el --- load libraries with their functions read on demand  -*- lexical-binding: t -*-
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; Keywords: lisp, internal
+;; Package: emacs
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Loading a byte-compiled library reads the code of every function it
+;; defines, although a session typically calls only a few of them.
+;; The package cache keeps a rewritten copy of selected libraries, in
+;; which each top-level `defalias' of a byte-compiled function or macro
+;; is replaced by an autoload.  The code of the function is kept in the
+;; same file, in the format of dynamic docstrings, and the autoload
+;; records where, so that `autoload-do-load' reads just that code the
+;; first time the function is called, without loading anything else.
+;; All other top-level forms are copied unchanged, so loading the
+;; rewritten library has the same effects as loading the original one.
+;; This saves the memory taken by the code of the functions that are
+;; never called; loading takes about as long as before.
+;;
+;; To use it, customize `package-cache-libraries', and call
+;; `package-cache-activate' in your init file once the libraries can be
+;; found in `load-path', for instance after `package-initialize'.
+
+;;; Code:
+
+(defgroup package-cache nil
+  "Load selected libraries with their functions read on demand."
+  :group 'package
+  :version "24.4")
+
+(defcustom package-cache-libraries nil
+  "Libraries to load from the package cache.
+Each element is the name of a byte-compiled library, as for
+`load-library'.  See `package-cache-activate'."
+  :type '(repeat string))
+
+(defcustom package-cache-directory (locate-user-emacs-file "package-cache/")
+  "Directory where the package cache keeps its copies of libraries."
+  :type 'directory)
+
+(defconst package-cache--format 2
+  "Version of the format of the files in the package cache.")
+
+(defvar package-cache--loaded nil
+  "The library of the cached copy being loaded, and its lazy functions.
+The last form of a cached copy sets this to (SOURCE . NAMES), where
+SOURCE is the file of the library and NAMES are the functions that
+the copy defines as autoloads.  See `package-cache--after-load'.")
+
+(defun package-cache--file (source)
+  "Return the name of the cached copy of the library file SOURCE."
+  (expand-file-name (file-name-nondirectory source) package-cache-directory))
+
+(defun package-cache--header (source)
+  "Return the line that identifies a cached copy of SOURCE."
+  (format ";;; package-cache %d %s\n" package-cache--format source))
+
+(defun package-cache--up-to-date-p (source cache)
+  "Return non-nil if CACHE is an up-to-date copy of SOURCE."
+  (and (file-exists-p cache)
+       (not (file-newer-than-file-p source cache))
+       (with-temp-buffer
+         (let ((coding-system-for-read 'utf-8-emacs-unix))
+           (insert-file-contents cache nil 0 4096))
+         (search-forward (package-cache--header source) nil t))))
+
+(defun package-cache--lazy-definition (form)
+  "If FORM defines a byte-compiled function, return (NAME DEF . ARGS).
+NAME is the function's name and DEF its definition, a byte-code
+object or a macro whose expander is one.  ARGS are the remaining
+arguments of `defalias', which must be constant.  Otherwise, return nil."
+  (pcase form
+    (`(defalias ',(and name (pred symbolp)) ,def . ,args)
+     (let ((fun (pcase def
+                  ((pred byte-code-function-p) def)
+                  (`(function ,(and f (pred byte-code-function-p))) f)
+                  (`(quote (macro . ,(and f (pred byte-code-function-p))))
+                   (cons 'macro f))
+                  (`(cons 'macro ,(and f (pred byte-code-function-p)))
+                   (cons 'macro f)))))
+       (and fun
+            (or (null args) (and (stringp (car args)) (null (cdr args))))
+            (cons name (cons fun args)))))))
+
+(defun package-cache--print (object)
+  "Return the printed representation of OBJECT, or nil.
+Return nil if reading it back would not give an object that prints the
+same way."
+  (let ((text (prin1-to-string object)))
+    (and (condition-case nil
+             (equal (prin1-to-string (car (read-from-string text))) text)
+           (invalid-read-syntax nil))
+         text)))
+
+(defun package-cache--insert (buffer &rest strings)
+  "Insert STRINGS into the unibyte BUFFER, encoded as in byte-compiled files."
+  (with-current-buffer buffer
+    (dolist (string strings)
+      (insert (encode-coding-string string 'utf-8-emacs-unix)))))
+
+(defun package-cache--insert-definition (buffer text)
+  "Insert TEXT into BUFFER as a dynamic docstring; return its position.
+The value is the byte offset of TEXT in the file written from BUFFER,
+as `autoload-do-load' expects it."
+  (let ((data (replace-regexp-in-string
+               "[\001\000\037]"
+               (lambda (c)
+                 (cond ((equal c "\001") "\001\001")
+                       ((equal c "\000") "\0010")
+                       (t "\001_")))
+               (encode-coding-string text 'utf-8-emacs-unix) t t)))
+    (with-current-buffer buffer
+      ;; The count covers the space, DATA and the final ^_.
+      (insert (format "\n#@%d " (+ (length data) 2)))
+      (prog1 (1- (point))
+        (insert data "\037")))))
+
+(defun package-cache--write (source cache)
+  "Write CACHE, a copy of the byte-compiled file SOURCE.
+Each function that SOURCE defines with a top-level `defalias' of a
+byte-code object is defined in CACHE as an autoload whose definition
+is read from CACHE when it is first called."
+  (let ((library (file-name-sans-extension (file-name-nondirectory source)))
+        (out (generate-new-buffer " *package-cache*"))
+        (print-escape-newlines t)
+        (print-length nil)
+        (print-level nil)
+        (print-quoted t)
+        (print-gensym t)
+        (print-circle t))
+    (unwind-protect
+        (with-temp-buffer
+          (let ((coding-system-for-read 'utf-8-emacs-unix))
+            (insert-file-contents source))
+          (unless (looking-at ";ELC")
+            (error "`%s' is not a byte-compiled file" source))
+          (with-current-buffer out
+            (set-buffer-multibyte nil))
+          ;; Copy the header, then make `#$' in the copied forms and
+          ;; `load-file-name' in their code refer to SOURCE.
+          (forward-line 1)
+          (while (looking-at ";")
+            (forward-line 1))
+          (package-cache--insert
+           out (buffer-substring-no-properties (point-min) (point))
+           (package-cache--header source)
+           (prin1-to-string `(setq load-file-name ,source)))
+          (let ((load-file-name source)
+                (beg (point))
+                (names nil)
+                form)
+            (while (setq form (condition-case nil
+                                  (list (read (current-buffer)))
+                                (end-of-file nil)))
+              (let* ((lazy (package-cache--lazy-definition (car form)))
+                     (text (and lazy (package-cache--print (nth 1 lazy)))))
+                (if (not text)
+                    (package-cache--insert
+                     out (buffer-substring-no-properties beg (point)))
+                  (let* ((fun (nth 1 lazy))
+                         (code (if (eq (car-safe fun) 'macro) (cdr fun) fun))
+                         (pos (package-cache--insert-definition out text))
+                         (print-circle nil))
+                    (push (car lazy) names)
+                    (package-cache--insert
+                     out "\n"
+                     (prin1-to-string
+                      `(defalias ',(car lazy)
+                         '(autoload ,library
+                                    ,(and (> (length code) 4) (aref code 4))
+                                    ,(and (commandp fun) t)
+                                    ,(and (eq (car-safe fun) 'macro) 'macro)
+                                    (,cache . ,pos))
+                         ,@(nthcdr 2 lazy))))))
+                (setq beg (point))))
+            ;; Let `package-cache--after-load' record the definitions
+            ;; in `load-history' under SOURCE.
+            (package-cache--insert
+             out "\n"
+             (let ((print-circle nil))
+               (prin1-to-string
+                `(setq package-cache--loaded '(,source . ,names))))
+             "\n"))
+          (with-current-buffer out
+            (let ((coding-system-for-write 'no-conversion))
+              (write-region nil nil cache nil 'silent))))
+      (kill-buffer out))))
+
+(defun package-cache--after-load (file)
+  "Record the definitions of FILE in `load-history' under its library.
+Do this if FILE is a cached copy that was just loaded, so that
+`load-history' ends up as if the library itself had been loaded, with
+the functions of the copy recorded as functions and not autoloads."
+  (let ((loaded package-cache--loaded)
+        (entry (assoc file load-history)))
+    (setq package-cache--loaded nil)
+    (when (and loaded entry)
+      (setq load-history
+            (cons (cons (car loaded)
+                        (mapcar (lambda (elt)
+                                  (if (and (eq (car-safe elt) 'autoload)
+                                           (memq (cdr elt) (cdr loaded)))
+                                      (cons 'defun (cdr elt))
+                                    elt))
+                                (cdr entry)))
+                  (delq entry (delq (assoc (car loaded) load-history)
+                                    load-history)))))))
+
+;;;###autoload
+(defun package-cache-activate ()
+  "Load the libraries in `package-cache-libraries' from the package cache.
+Rewrite the cached copy of each library that has none yet, or whose
+copy is older than the library, and put `package-cache-directory' at
+the front of `load-path', so that loading one of these libraries,
+including through an autoload, loads its cached copy instead.  A
+cached copy defines the library's byte-compiled functions as
+autoloads whose code is read from the copy when they are first
+called; otherwise, loading it has the same effects as loading the
+library itself.
+
+Libraries that are already loaded are not affected until they are
+loaded again."
+  (interactive)
+  (let ((dir (file-name-as-directory
+              (expand-file-name package-cache-directory)))
+        (keep nil))
+    (setq load-path (delete dir load-path))
+    (make-directory dir t)
+    (dolist (library package-cache-libraries)
+      (let ((source (locate-library library)))
+        (if (not (and source (string-match "\\.elc\\'" source)))
+            (message "Library `%s' is not byte-compiled; not cached" library)
+          (let ((cache (package-cache--file source)))
+            (push cache keep)
+            (unless (package-cache--up-to-date-p source cache)
+              (condition-case err
+                  (package-cache--write source cache)
+                (error
+                 (setq keep (delete cache keep))
+                 (message "Could not cache library `%s': %s"
+                          library (error-message-string err)))))))))
+    ;; Files left over from other libraries would shadow them.
+    (dolist (file (directory-files dir t "\\.elc\\'"))
+      (unless (member file keep)
+        (delete-file file)))
+    (add-hook 'after-load-functions #'package-cache--after-load)
+    (push dir load-path)))
+
+(provide 'package-cache)
+
+;;; package-cache.el ends here
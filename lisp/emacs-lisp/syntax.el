@@ -352,30 +352,31 @@ itself at the outermost level), return nil."
    (t nil)))
 
 (defvar syntax-ppss-max-span 20000
-  "Threshold below which cache info is deemed unnecessary.
-We try to make sure that cache entries are at least this far apart
-from each other, to avoid keeping too much useless info.")
+  "Threshold below which checkpoints are deemed unnecessary.
+When the last position `syntax-ppss' was called for, or the one
+`syntax-begin-function' finds, is closer than this to the position
+asked for, and closer than the last checkpoint, the state is
+computed from there rather than from the checkpoints.")
 
 (defvar syntax-begin-function nil
   "Function to move back outside of any comment/string/paren.
 This function should move the cursor back to some syntactically safe
 point (where the PPSS is equivalent to nil).")
 
-(defvar syntax-ppss-cache nil
-  "List of (POS . PPSS) pairs, in decreasing POS order.")
-(make-variable-buffer-local 'syntax-ppss-cache)
 (defvar syntax-ppss-last nil
   "Cache of (LAST-POS . LAST-PPSS).")
 (make-variable-buffer-local 'syntax-ppss-last)
 
 (defalias 'syntax-ppss-after-change-function 'syntax-ppss-flush-cache)
-(defun syntax-ppss-flush-cache (beg &rest ignored)
-  "Flush the cache of `syntax-ppss' starting at position BEG."
+(defun syntax-ppss-flush-cache (beg &optional end &rest ignored)
+  "Flush the cache of `syntax-ppss' starting at position BEG.
+If END is non-nil, only the text between BEG and END has changed, so
+the checkpoints after END are kept until a scan checks them again."
   ;; Set syntax-propertize to refontify anything past beg.
   (setq syntax-propertize--done (min beg syntax-propertize--done))
-  ;; Flush invalid cache entries.
-  (while (and syntax-ppss-cache (> (caar syntax-ppss-cache) beg))
-    (setq syntax-ppss-cache (cdr syntax-ppss-cache)))
+  ;; Flush invalid checkpoints.  Changes to the text do that by
+  ;; themselves, but not changes to `syntax-table' properties.
+  (syntax-ppss-flush-checkpoints beg (and (integerp end) end))
   ;; Throw away `last' value if made invalid.
   (when (< beg (or (car syntax-ppss-last) 0))
     ;; If syntax-begin-function jumped to BEG, then the old state at BEG can
@@ -450,32 +451,25 @@ running the hook."
 	    (cl-incf (car (aref syntax-ppss-stats 1)))
 	    (cl-incf (cdr (aref syntax-ppss-stats 1)) (- pos pt-min))
 	    (setq ppss (parse-partial-sexp pt-min pos)))
-	   ;; The OLD-* data can't be used.  Consult the cache.
+	   ;; The OLD-* data can't be used.  Consult the checkpoints.
 	   (t
-	    (let ((cache-pred nil)
-		  (cache syntax-ppss-cache)
-		  (pt-min (point-min))
-		  ;; I differentiate between PT-MIN and PT-BEST because
-		  ;; I feel like it might be important to ensure that the
-		  ;; cache is only filled with 100% sure data (whereas
-		  ;; syntax-begin-function might return incorrect data).
-		  ;; Maybe that's just stupid.
-		  (pt-best (point-min))
-		  (ppss-best nil))
-	      ;; look for a usable cache entry.
-	      (while (and cache (< pos (caar cache)))
-		(setq cache-pred cache)
-		(setq cache (cdr cache)))
-	      (if cache (setq pt-min (caar cache) ppss (cdar cache)))
+	    (let* ((checkpoint (syntax-ppss-checkpoint pos))
+		   ;; I differentiate between PT-MIN and PT-BEST because
+		   ;; I feel like it might be important to ensure that the
+		   ;; checkpoints are only computed from 100% sure data
+		   ;; (whereas syntax-begin-function might return
+		   ;; incorrect data).  Maybe that's just stupid.
+		   (pt-min (if checkpoint (car checkpoint) (point-min)))
+		   (pt-best pt-min)
+		   (ppss-best (cdr checkpoint)))
 
 	      ;; Setup the before-change function if necessary.
-	      (unless (or syntax-ppss-cache syntax-ppss-last)
+	      (unless syntax-ppss-last
 		(add-hook 'before-change-functions
 			  'syntax-ppss-flush-cache t t))
 
-	      ;; Use the best of OLD-POS and CACHE.
-	      (if (or (not old-pos) (< old-pos pt-min))
-		  (setq pt-best pt-min ppss-best ppss)
+	      ;; Use the best of OLD-POS and the checkpoint.
+	      (when (and old-pos (>= old-pos pt-min))
 		(cl-incf (car (aref syntax-ppss-stats 4)))
 		(cl-incf (cdr (aref syntax-ppss-stats 4)) (- pos old-pos))
 		(setq pt-best old-pos ppss-best old-ppss))
@@ -483,10 +477,11 @@ running the hook."
 	      ;; Use the `syntax-begin-function' if available.
 	      ;; We could try using that function earlier, but:
 	      ;; - The result might not be 100% reliable, so it's better to use
-	      ;;   the cache if available.
+	      ;;   the checkpoints if available.
 	      ;; - The function might be slow.
 	      ;; - If this function almost always finds a safe nearby spot,
-	      ;;   the cache won't be populated, so consulting it is cheap.
+	      ;;   the checkpoints won't be computed, so consulting them
+	      ;;   is cheap.
 	      (when (and (not syntax-begin-function)
 			 (boundp 'font-lock-beginning-of-syntax-function)
 			 font-lock-beginning-of-syntax-function)
@@ -506,50 +501,20 @@ running the hook."
 		(cl-incf (cdr (aref syntax-ppss-stats 5)) (- pos (point)))
 		(setq pt-best (point) ppss-best nil))
 
-	      (cond
-	       ;; Quick case when we found a nearby pos.
-	       ((< (- pos pt-best) syntax-ppss-max-span)
-		(cl-incf (car (aref syntax-ppss-stats 2)))
-		(cl-incf (cdr (aref syntax-ppss-stats 2)) (- pos pt-best))
-		(setq ppss (parse-partial-sexp pt-best pos nil nil ppss-best)))
-	       ;; Slow case: compute the state from some known position and
-	       ;; populate the cache so we won't need to do it again soon.
-	       (t
+	      (if (and (> pt-best pt-min)
+		       (< (- pos pt-best) syntax-ppss-max-span))
+		  ;; Quick case when we found a nearby pos.
+		  (progn
+		    (cl-incf (car (aref syntax-ppss-stats 2)))
+		    (cl-incf (cdr (aref syntax-ppss-stats 2)) (- pos pt-best))
+		    (setq ppss (parse-partial-sexp pt-best pos nil nil
+						   ppss-best)))
+		;; Otherwise, compute the state from the checkpoint, which
+		;; adds checkpoints on the way if needed, so we won't need
+		;; to scan that text again soon.
 		(cl-incf (car (aref syntax-ppss-stats 3)))
 		(cl-incf (cdr (aref syntax-ppss-stats 3)) (- pos pt-min))
-
-		;; If `pt-min' is too far, add a few intermediate entries.
-		(while (> (- pos pt-min) (* 2 syntax-ppss-max-span))
-		  (setq ppss (parse-partial-sexp
-			      pt-min (setq pt-min (/ (+ pt-min pos) 2))
-			      nil nil ppss))
-                  (push (cons pt-min ppss)
-                        (if cache-pred (cdr cache-pred) syntax-ppss-cache)))
-
-		;; Compute the actual return value.
-		(setq ppss (parse-partial-sexp pt-min pos nil nil ppss))
-
-		;; Debugging check.
-		;; (let ((real-ppss (parse-partial-sexp (point-min) pos)))
-		;;   (setcar (last ppss 4) 0)
-		;;   (setcar (last real-ppss 4) 0)
-		;;   (setcar (last ppss 8) nil)
-		;;   (setcar (last real-ppss 8) nil)
-		;;   (unless (equal ppss real-ppss)
-		;;     (message "!!Syntax: %s != %s" ppss real-ppss)
-		;;     (setq ppss real-ppss)))
-
-		;; Store it in the cache.
-		(let ((pair (cons pos ppss)))
-		  (if cache-pred
-		      (if (> (- (caar cache-pred) pos) syntax-ppss-max-span)
-			  (push pair (cdr cache-pred))
-			(setcar cache-pred pair))
-		    (if (or (null syntax-ppss-cache)
-			    (> (- (caar syntax-ppss-cache) pos)
-			       syntax-ppss-max-span))
-			(push pair syntax-ppss-cache)
-		      (setcar syntax-ppss-cache pair)))))))))
+		(setq ppss (syntax-ppss-scan pos))))))
 
 	  (setq syntax-ppss-last (cons pos ppss))
 	  ppss)
@@ -564,10 +529,13 @@ running the hook."
 
 (defun syntax-ppss-debug ()
   (let ((pt nil)
-	(min-diffs nil))
-    (dolist (x (append syntax-ppss-cache (list (cons (point-min) nil))))
-      (when pt (push (- pt (car x)) min-diffs))
-      (setq pt (car x)))
+	(min-diffs nil)
+	(checkpoint (syntax-ppss-checkpoint (point-max))))
+    (while checkpoint
+      (when pt (push (- pt (car checkpoint)) min-diffs))
+      (setq pt (car checkpoint))
+      (setq checkpoint (syntax-ppss-checkpoint (1- pt))))
+    (when pt (push (- pt (point-min)) min-diffs))
     min-diffs))
 
 ;; XEmacs compatibility functions
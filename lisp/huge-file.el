@@ -0,0 +1,269 @@
+;;; huge-file.el --- view files too large to visit, a chunk at a time  -*- lexical-binding: t -*-
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; Keywords: files, data
+;; Package: emacs
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Visiting a file reads and decodes all of it before showing anything,
+;; so a log of several gigabytes takes as much memory, and a long wait.
+;; `huge-file-find' instead shows the file in a read-only buffer one
+;; chunk of about `huge-file-chunk-size' bytes at a time.  Only the
+;; chunk shown is read and decoded, so the first screenful appears at
+;; once, whatever the size of the file, and redisplay, motion and
+;; searches within the chunk work as in any other buffer.
+;;
+;; Chunks begin and end at line boundaries, except in lines longer than
+;; a chunk, so that they can be decoded on their own.  In the buffer,
+;; `]' and `[' show the next and the previous chunk, `{' and `}' the
+;; first and the last, `%' and `j' the chunk at a percentage of the
+;; file or at a byte offset, and `s' and `r' search forward and
+;; backward through the chunks for a regexp.  `g' shows the current
+;; chunk again, for instance when the file grows.
+
+;;; Code:
+
+(defgroup huge-file nil
+  "Viewing huge files a chunk at a time."
+  :group 'files
+  :version "24.4")
+
+(defcustom huge-file-chunk-size 1000000
+  "Number of bytes of a huge file that `huge-file-mode' shows at a time.
+Chunks are shortened or lengthened to end at a line boundary."
+  :type 'integer
+  :version "24.4")
+
+(defvar-local huge-file-name nil
+  "Name of the file shown in the current `huge-file-mode' buffer.")
+
+(defvar-local huge-file-size nil
+  "Size in bytes of the file shown in the current buffer.")
+
+(defvar-local huge-file-start nil
+  "Byte offset in the file of the start of the chunk shown.")
+
+(defvar-local huge-file-end nil
+  "Byte offset in the file of the end of the chunk shown.")
+
+(defun huge-file--line-start (pos)
+  "Return the byte offset of the start of the line at byte POS.
+Look for it in the `huge-file-chunk-size' bytes before POS, and
+return POS if none of them is a newline."
+  (if (or (<= pos 0) (>= pos huge-file-size))
+      (max 0 (min pos huge-file-size))
+    (let ((file huge-file-name)
+          (from (max 0 (- pos huge-file-chunk-size))))
+      (with-temp-buffer
+        (set-buffer-multibyte nil)
+        (insert-file-contents-literally file nil from pos)
+        (goto-char (point-max))
+        (if (search-backward "\n" nil t)
+            ;; The newline is at byte FROM + (point) - 1 of the file.
+            (+ from (point))
+          pos)))))
+
+(defun huge-file--show (start &optional end)
+  "Show the chunk of the file from byte START to byte END.
+START should be the start of a line.  END defaults to the start of
+the line about `huge-file-chunk-size' bytes after START."
+  (unless end
+    (setq end (min huge-file-size (+ start huge-file-chunk-size)))
+    (let ((line (huge-file--line-start end)))
+      (when (> line start)
+        (setq end line))))
+  (let ((inhibit-read-only t))
+    (erase-buffer)
+    (insert-file-contents huge-file-name nil start end)
+    (set-buffer-modified-p nil))
+  (setq huge-file-start start
+        huge-file-end end)
+  (goto-char (point-min)))
+
+(defun huge-file--previous-start ()
+  "Return the byte offset where the chunk before the current one starts."
+  (let ((pos (max 0 (- huge-file-start huge-file-chunk-size))))
+    (min pos (huge-file--line-start pos))))
+
+(defun huge-file--update-size ()
+  "Update `huge-file-size' from the file."
+  (setq huge-file-size
+        (or (nth 7 (file-attributes huge-file-name))
+            (error "Cannot read file %s" huge-file-name))))
+
+(defun huge-file-next-chunk ()
+  "Show the chunk of the file after the current one."
+  (interactive)
+  (if (>= huge-file-end huge-file-size)
+      (user-error "End of file")
+    (huge-file--show huge-file-end)))
+
+(defun huge-file-previous-chunk ()
+  "Show the chunk of the file before the current one.
+Leave point at its end."
+  (interactive)
+  (if (<= huge-file-start 0)
+      (user-error "Beginning of file")
+    (huge-file--show (huge-file--previous-start) huge-file-start)
+    (goto-char (point-max))))
+
+(defun huge-file-first-chunk ()
+  "Show the chunk at the beginning of the file."
+  (interactive)
+  (huge-file--show 0))
+
+(defun huge-file-last-chunk ()
+  "Show the chunk at the end of the file, and leave point at its end."
+  (interactive)
+  (huge-file--update-size)
+  (huge-file--show (huge-file--line-start
+                    (max 0 (- huge-file-size huge-file-chunk-size)))
+                   huge-file-size)
+  (goto-char (point-max)))
+
+(defun huge-file-goto-byte (offset)
+  "Show the chunk that starts with the line at byte OFFSET of the file.
+Interactively, OFFSET is the numeric prefix argument, or is read in
+the minibuffer."
+  (interactive (list (if current-prefix-arg
+                         (prefix-numeric-value current-prefix-arg)
+                       (read-number "Go to byte offset: "))))
+  (huge-file--show (huge-file--line-start
+                    (max 0 (min offset huge-file-size)))))
+
+(defun huge-file-goto-percent (percent)
+  "Show the chunk that starts with the line PERCENT into the file.
+Interactively, PERCENT is the numeric prefix argument, or is read in
+the minibuffer."
+  (interactive (list (if current-prefix-arg
+                         (prefix-numeric-value current-prefix-arg)
+                       (read-number "Go to percentage: "))))
+  (huge-file-goto-byte (floor (* huge-file-size (/ percent 100.0)))))
+
+(defun huge-file--search (regexp forward)
+  "Search for REGEXP from point through the chunks of the file.
+FORWARD non-nil means search forward, nil means backward.  Return
+point, in the chunk that has the match, or signal an error and show
+the chunk where the search began."
+  (let ((start huge-file-start)
+        (end huge-file-end)
+        (pos (point))
+        (found nil))
+    (unwind-protect
+        (while (not (setq found (if forward
+                                    (re-search-forward regexp nil t)
+                                  (re-search-backward regexp nil t))))
+          (cond
+           ((and forward (< huge-file-end huge-file-size))
+            (huge-file--show huge-file-end))
+           ((and (not forward) (> huge-file-start 0))
+            (huge-file--show (huge-file--previous-start) huge-file-start)
+            (goto-char (point-max)))
+           (t (signal 'search-failed (list regexp)))))
+      (unless found
+        (unless (and (= start huge-file-start) (= end huge-file-end))
+          (huge-file--show start end))
+        (goto-char pos)))
+    (point)))
+
+(defun huge-file-search-forward (regexp)
+  "Search forward from point for REGEXP, through the following chunks.
+Matches that span two chunks are not found.  Leave point at the end
+of the match, in the chunk that contains it."
+  (interactive (list (read-regexp "Search forward in file (regexp)")))
+  (huge-file--search regexp t))
+
+(defun huge-file-search-backward (regexp)
+  "Search backward from point for REGEXP, through the previous chunks.
+Matches that span two chunks are not found.  Leave point at the start
+of the match, in the chunk that contains it."
+  (interactive (list (read-regexp "Search backward in file (regexp)")))
+  (huge-file--search regexp nil))
+
+(defun huge-file-revert (&rest _)
+  "Show the current chunk again, as the file now is."
+  (let ((pos (point))
+        (last (>= huge-file-end huge-file-size)))
+    (huge-file--update-size)
+    ;; The last chunk takes in what was appended to the file.
+    (huge-file--show (min huge-file-start huge-file-size)
+                     (unless last (min huge-file-end huge-file-size)))
+    (goto-char pos)))
+
+(defun huge-file--mode-line ()
+  "Return the part of the mode line that shows where the chunk is."
+  (format " %d%%" (if (> huge-file-size 0)
+                      (/ (* 100 huge-file-end) huge-file-size)
+                    100)))
+
+(defvar huge-file-mode-map
+  (let ((map (make-sparse-keymap)))
+    (set-keymap-parent map special-mode-map)
+    (define-key map "]" 'huge-file-next-chunk)
+    (define-key map "[" 'huge-file-previous-chunk)
+    (define-key map "{" 'huge-file-first-chunk)
+    (define-key map "}" 'huge-file-last-chunk)
+    (define-key map "%" 'huge-file-goto-percent)
+    (define-key map "j" 'huge-file-goto-byte)
+    (define-key map "s" 'huge-file-search-forward)
+    (define-key map "r" 'huge-file-search-backward)
+    map)
+  "Keymap for `huge-file-mode'.")
+
+(define-derived-mode huge-file-mode special-mode
+  '("Huge" (:eval (huge-file--mode-line)))
+  "Major mode for viewing a huge file a chunk at a time.
+The buffer shows the part of the file `huge-file-name' from byte
+`huge-file-start' to byte `huge-file-end', read and decoded on its
+own.  Use `huge-file-find' to view a file in this mode.
+
+\\{huge-file-mode-map}"
+  (setq buffer-undo-list t)
+  (setq-local revert-buffer-function #'huge-file-revert))
+
+;;;###autoload
+(defun huge-file-find (file)
+  "View FILE one chunk at a time, in a read-only buffer.
+Only the chunk shown is read into memory, so this is fit for files
+too large to visit.  See `huge-file-mode' for the commands that show
+other chunks."
+  (interactive "fView huge file: ")
+  (setq file (expand-file-name file))
+  (let ((buffer (catch 'found
+                  (dolist (buffer (buffer-list))
+                    (with-current-buffer buffer
+                      (when (and (derived-mode-p 'huge-file-mode)
+                                 (equal huge-file-name file))
+                        (throw 'found buffer)))))))
+    (unless buffer
+      (setq buffer (generate-new-buffer (file-name-nondirectory file)))
+      (with-current-buffer buffer
+        (setq default-directory (file-name-directory file))
+        (huge-file-mode)
+        (setq huge-file-name file)
+        (huge-file--update-size)
+        (huge-file--show 0)))
+    (if (called-interactively-p 'interactive)
+        (switch-to-buffer buffer)
+      buffer)))
+
+(provide 'huge-file)
+
+;;; huge-file.el ends here
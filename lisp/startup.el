@@ -616,7 +616,7 @@ It is the default value of the variable `top-level'."
     (setq default-directory (abbreviate-file-name default-directory))
     (let ((old-face-font-rescale-alist face-font-rescale-alist))
       (unwind-protect
-	  (command-line)
+	  (startup-trace-call "command-line" #'command-line)
 	;; Do this again, in case .emacs defined more abbreviations.
 	(setq default-directory (abbreviate-file-name default-directory))
 	;; Specify the file for recording all the auto save files of this session.
@@ -703,6 +703,44 @@ It is the default value of the variable `top-level'."
       (when display
         (delete display process-environment)))))
 
+(defun startup-trace-report (&optional string)
+  "Display the startup trace as a tree.
+Each line shows the elapsed real time and CPU time in milliseconds,
+the number of garbage collections and the amount of Lisp data
+allocated for one phase of startup or one loaded file, with the
+entries that ran within it indented below it.  See `startup-trace'.
+
+In batch mode, print the report to standard output.  If STRING is
+non-nil, return the report as a string instead of displaying it."
+  (interactive)
+  (let ((trace (startup-trace)))
+    (unless trace
+      (error "No startup trace; set EMACS_STARTUP_TRACE before starting Emacs"))
+    (with-temp-buffer
+      (insert "   Wall ms    CPU ms  GCs   Alloc  Name\n")
+      (let ((stack (list trace))
+	    (depth 0))
+	(while stack
+	  (if (null (car stack))
+	      (setq stack (cdr stack)
+		    depth (1- depth))
+	    (let ((node (pop (car stack))))
+	      (insert (format "%10.1f %9.1f %4d %7s  %s%s\n"
+			      (* 1000 (nth 1 node)) (* 1000 (nth 2 node))
+			      (nth 3 node)
+			      (file-size-human-readable (nth 4 node))
+			      (make-string (* 2 depth) ?\s)
+			      (car node)))
+	      (when (nthcdr 5 node)
+		(push (nthcdr 5 node) stack)
+		(setq depth (1+ depth)))))))
+      (cond
+       (string (buffer-string))
+       (noninteractive (princ (buffer-string)) nil)
+       (t (let ((report (buffer-string)))
+	    (with-help-window "*Startup Trace*"
+	      (princ report))))))))
+
 ;; Precompute the keyboard equivalents in the menu bar items.
 ;; Command-line options supported by tty's:
 (defconst tty-long-option-alist
@@ -970,7 +1008,8 @@ please check its value")
 		 (error "Unsupported window system `%s'" initial-window-system))
 	     command-line-args))
       ;; Initialize the window system. (Open connection, etc.)
-      (funcall
+      (startup-trace-call
+       "window system"
        (or (cdr (assq initial-window-system window-system-initialization-alist))
 	   (error "Unsupported window system `%s'" initial-window-system)))
       (put initial-window-system 'window-system-initialized t))
@@ -1001,7 +1040,7 @@ please check its value")
 	(setq menu-bar-mode nil
 	      tool-bar-mode nil
 	      no-blinking-cursor t))
-    (frame-initialize))
+    (startup-trace-call "initial frame" #'frame-initialize))
 
   (when (fboundp 'x-create-frame)
     ;; Set up the tool-bar (even in tty frames, since Emacs might open a
@@ -1271,10 +1310,11 @@ the `--debug-init' option to view a complete error backtrace."
                                 (package--description-file subdir)
                                 subdir))))
 		   (throw 'package-dir-found t)))))))
-       (package-initialize))
+       (startup-trace-call "package-initialize" #'package-initialize))
 
   (setq after-init-time (current-time))
-  (run-hooks 'after-init-hook)
+  (startup-trace-call "after-init-hook"
+		      (lambda () (run-hooks 'after-init-hook)))
 
   ;; If *scratch* exists and init file didn't change its mode, initialize it.
   (if (get-buffer "*scratch*")
@@ -1296,7 +1336,8 @@ the `--debug-init' option to view a complete error backtrace."
 	      (substitute-command-keys "Memory exhausted--use \\[save-some-buffers] then exit and restart Emacs")))
 
   ;; Process the remaining args.
-  (command-line-1 (cdr command-line-args))
+  (startup-trace-call "command-line-1"
+		      (lambda () (command-line-1 (cdr command-line-args))))
 
   ;; This is a problem because, e.g. if emacs.d/gnus.el exists,
   ;; trying to load gnus could load the wrong file.
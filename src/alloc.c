@@ -1840,9 +1840,6 @@ sweep_strings (void)
 		  /* String is live; unmark it and its intervals.  */
 		  UNMARK_STRING (s);
 
-		  /* Do not use string_(set|get)_intervals here.  */
-		  s->intervals = balance_intervals (s->intervals);
-
 		  ++total_strings;
 		  total_string_bytes += STRING_BYTES (s);
 		}
@@ -3571,18 +3568,22 @@ free_save_value (Lisp_Object save)
   free_misc (save);
 }
 
-/* Return a Lisp_Misc_Overlay object with specified START, END and PLIST.  */
+/* Return a Lisp_Misc_Overlay object with specified PLIST, in no
+   buffer.  FRONT_ADVANCE and REAR_ADVANCE say whether its start and
+   end move past text inserted at them.  */
 
 Lisp_Object
-build_overlay (Lisp_Object start, Lisp_Object end, Lisp_Object plist)
+build_overlay (bool front_advance, bool rear_advance, Lisp_Object plist)
 {
   register Lisp_Object overlay;
+  struct Lisp_Overlay *ov;
 
   overlay = allocate_misc (Lisp_Misc_Overlay);
-  OVERLAY_START (overlay) = start;
-  OVERLAY_END (overlay) = end;
+  ov = XOVERLAY (overlay);
+  ov->buffer = NULL;
+  ov->interval = xmalloc (sizeof *ov->interval);
+  itree_node_init (ov->interval, front_advance, rear_advance, overlay);
   set_overlay_plist (overlay, plist);
-  XOVERLAY (overlay)->next = NULL;
   return overlay;
 }
 
@@ -3596,9 +3597,7 @@ DEFUN ("make-marker", Fmake_marker, Smake_marker, 0, 0, 0,
   val = allocate_misc (Lisp_Misc_Marker);
   p = XMARKER (val);
   p->buffer = 0;
-  p->bytepos = 0;
-  p->charpos = 0;
-  p->next = NULL;
+  p->node = NULL;
   p->insertion_type = 0;
   p->need_adjustment = 0;
   return val;
@@ -3616,18 +3615,13 @@ build_marker (struct buffer *buf, ptrdiff_t charpos, ptrdiff_t bytepos)
   /* No dead buffers here.  */
   eassert (BUFFER_LIVE_P (buf));
 
-  /* Every character is at least one byte.  */
-  eassert (charpos <= bytepos);
-
   obj = allocate_misc (Lisp_Misc_Marker);
   m = XMARKER (obj);
-  m->buffer = buf;
-  m->charpos = charpos;
-  m->bytepos = bytepos;
+  m->buffer = NULL;
+  m->node = NULL;
   m->insertion_type = 0;
   m->need_adjustment = 0;
-  m->next = BUF_MARKERS (buf);
-  BUF_MARKERS (buf) = m;
+  attach_marker (m, buf, charpos, bytepos);
   return obj;
 }
 
@@ -5535,6 +5529,9 @@ See Info node `(elisp)Garbage Collection'.  */)
   mark_specpdl ();
   mark_terminals ();
   mark_kboards ();
+  mark_print_stack ();
+  mark_data_frames ();
+  mark_regexp_cache ();
 
 #ifdef USE_GTK
   xg_mark_data ();
@@ -5576,11 +5573,15 @@ See Info node `(elisp)Garbage Collection'.  */)
 
   FOR_EACH_BUFFER (nextb)
     {
+      /* Set the field directly, since bset_undo_list would discard
+	 the undo journal.  */
       if (!EQ (BVAR (nextb, undo_list), Qt))
-	bset_undo_list (nextb, compact_undo_list (BVAR (nextb, undo_list)));
+	nextb->INTERNAL_FIELD (undo_list)
+	  = compact_undo_list (BVAR (nextb, undo_list));
       /* Now that we have stripped the elements that need not be
 	 in the undo_list any more, we can finally mark the list.  */
       mark_object (BVAR (nextb, undo_list));
+      mark_undo_journal (nextb);
     }
 
   gc_sweep ();
@@ -5813,17 +5814,24 @@ mark_char_table (struct Lisp_Vector *ptr)
     }
 }
 
-/* Mark the chain of overlays starting at PTR.  */
+/* Mark the overlay PTR.  */
 
 static void
 mark_overlay (struct Lisp_Overlay *ptr)
 {
-  for (; ptr && !ptr->gcmarkbit; ptr = ptr->next)
+  ptr->gcmarkbit = 1;
+  mark_object (ptr->plist);
+}
+
+/* Mark the overlays in the overlay tree rooted at NODE.  */
+
+static void
+mark_overlays (struct itree_node *node)
+{
+  for (; node; node = node->right)
     {
-      ptr->gcmarkbit = 1;
-      mark_object (ptr->start);
-      mark_object (ptr->end);
-      mark_object (ptr->plist);
+      mark_object (node->data);
+      mark_overlays (node->left);
     }
 }
 
@@ -5843,8 +5851,9 @@ mark_buffer (struct buffer *buffer)
      a special way just before the sweep phase, and after stripping
      some of its elements that are not needed any more.  */
 
-  mark_overlay (buffer->overlays_before);
-  mark_overlay (buffer->overlays_after);
+  mark_overlays (buffer->overlays.root);
+
+  mark_ppss_cache (buffer);
 
   /* If this is an indirect buffer, mark its base buffer.  */
   if (buffer->base_buffer && !VECTOR_MARKED_P (buffer->base_buffer))
@@ -6544,7 +6553,7 @@ gc_sweep (void)
 	    if (!sym->s.gcmarkbit && !pure_p)
 	      {
 		if (sym->s.redirect == SYMBOL_LOCALIZED)
-		  xfree (SYMBOL_BLV (&sym->s));
+		  free_blv (SYMBOL_BLV (&sym->s));
 		sym->s.next = symbol_free_list;
 		symbol_free_list = &sym->s;
 #if GC_MARK_STACK
@@ -6603,6 +6612,8 @@ gc_sweep (void)
 	      {
 		if (mblk->markers[i].m.u_any.type == Lisp_Misc_Marker)
 		  unchain_marker (&mblk->markers[i].m.u_marker);
+		else if (mblk->markers[i].m.u_any.type == Lisp_Misc_Overlay)
+		  xfree (mblk->markers[i].m.u_overlay.interval);
 		/* Set the type of the freed object to Lisp_Misc_Free.
 		   We could leave the type alone, since nobody checks it,
 		   but this might catch bugs faster.  */
@@ -6653,8 +6664,6 @@ gc_sweep (void)
       else
 	{
 	  VECTOR_UNMARK (buffer);
-	  /* Do not use buffer_(set|get)_intervals here.  */
-	  buffer->text->intervals = balance_intervals (buffer->text->intervals);
 	  total_buffers++;
 	  bprev = &buffer->next;
 	}
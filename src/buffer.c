@@ -144,7 +144,7 @@ Lisp_Object Qinsert_behind_hooks;
 
 static void alloc_buffer_text (struct buffer *, ptrdiff_t);
 static void free_buffer_text (struct buffer *b);
-static struct Lisp_Overlay * copy_overlays (struct buffer *, struct Lisp_Overlay *);
+static void copy_overlays (struct buffer *, struct buffer *);
 static void modify_overlay (struct buffer *, ptrdiff_t, ptrdiff_t);
 static Lisp_Object buffer_lisp_local_variables (struct buffer *, bool);
 
@@ -568,6 +568,8 @@ even if it is dead.  The return value is never nil.  */)
   BUF_SAVE_MODIFF (b) = 1;
   BUF_COMPACT (b) = 1;
   set_buffer_intervals (b, NULL);
+  b->text->pos_index = NULL;
+  b->text->newline_index = NULL;
   BUF_UNCHANGED_MODIFIED (b) = 1;
   BUF_OVERLAY_UNCHANGED_MODIFIED (b) = 1;
   BUF_END_UNCHANGED (b) = 0;
@@ -579,6 +581,13 @@ even if it is dead.  The return value is never nil.  */)
   b->newline_cache = 0;
   b->width_run_cache = 0;
   b->bidi_paragraph_cache = 0;
+  b->ppss_cache = 0;
+  b->undo_journal = NULL;
+  b->local_var_cells = NULL;
+  b->local_var_cells_size = 0;
+  b->local_fwd_cells = NULL;
+  b->local_fwd_cells_count = b->local_fwd_cells_size = 0;
+  b->local_var_cells_valid = 0;
   bset_width_table (b, Qnil);
   b->prevent_redisplay_optimizations_p = 1;
 
@@ -598,7 +607,7 @@ even if it is dead.  The return value is never nil.  */)
   reset_buffer_local_variables (b, 1);
 
   bset_mark (b, Fmake_marker ());
-  BUF_MARKERS (b) = NULL;
+  itree_init (BUF_MARKERS (b));
 
   /* Put this in the alist of all live buffers.  */
   XSETBUFFER (buffer, b);
@@ -611,51 +620,46 @@ even if it is dead.  The return value is never nil.  */)
 }
 
 
-/* Return a list of overlays which is a copy of the overlay list
-   LIST, but for buffer B.  */
+/* Put the overlay OV into the overlay tree of buffer B, from BEGIN
+   to END.  OV must not be in a buffer already.  */
 
-static struct Lisp_Overlay *
-copy_overlays (struct buffer *b, struct Lisp_Overlay *list)
+static void
+add_buffer_overlay (struct buffer *b, struct Lisp_Overlay *ov,
+		    ptrdiff_t begin, ptrdiff_t end)
 {
-  struct Lisp_Overlay *result = NULL, *tail = NULL;
-
-  for (; list; list = list->next)
-    {
-      Lisp_Object overlay, start, end;
-      struct Lisp_Marker *m;
-
-      eassert (MARKERP (list->start));
-      m = XMARKER (list->start);
-      start = build_marker (b, m->charpos, m->bytepos);
-      XMARKER (start)->insertion_type = m->insertion_type;
-
-      eassert (MARKERP (list->end));
-      m = XMARKER (list->end);
-      end = build_marker (b, m->charpos, m->bytepos);
-      XMARKER (end)->insertion_type = m->insertion_type;
-
-      overlay = build_overlay (start, end, Fcopy_sequence (list->plist));
-      if (tail)
-	tail = tail->next = XOVERLAY (overlay);
-      else
-	result = tail = XOVERLAY (overlay);
-    }
-
-  return result;
+  eassert (! ov->buffer);
+  ov->buffer = b;
+  itree_insert (&b->overlays, ov->interval, begin, end);
 }
 
-/* Set an appropriate overlay of B.  */
+/* Take the overlay OV out of the overlay tree of buffer B.  */
 
 static void
-set_buffer_overlays_before (struct buffer *b, struct Lisp_Overlay *o)
+remove_buffer_overlay (struct buffer *b, struct Lisp_Overlay *ov)
 {
-  b->overlays_before = o;
+  eassert (ov->buffer == b);
+  itree_remove (&b->overlays, ov->interval);
+  ov->buffer = NULL;
 }
 
+/* Give buffer TO a copy of each overlay of buffer FROM.  */
+
 static void
-set_buffer_overlays_after (struct buffer *b, struct Lisp_Overlay *o)
+copy_overlays (struct buffer *from, struct buffer *to)
 {
-  b->overlays_after = o;
+  struct itree_iterator iter;
+  struct itree_node *node;
+
+  eassert (! to->overlays.root);
+  for (node = itree_iterator_start (&iter, &from->overlays,
+				    PTRDIFF_MIN, PTRDIFF_MAX);
+       node; node = itree_iterator_next (&iter))
+    {
+      Lisp_Object overlay
+	= build_overlay (node->front_advance, node->rear_advance,
+			 Fcopy_sequence (OVERLAY_PLIST (node->data)));
+      add_buffer_overlay (to, XOVERLAY (overlay), node->begin, node->end);
+    }
 }
 
 /* Clone per-buffer values of buffer FROM.
@@ -683,7 +687,7 @@ clone_per_buffer_values (struct buffer *from, struct buffer *to)
 	{
 	  struct Lisp_Marker *m = XMARKER (obj);
 
-	  obj = build_marker (to, m->charpos, m->bytepos);
+	  obj = build_marker (to, marker_charpos (m), marker_bytepos (m));
 	  XMARKER (obj)->insertion_type = m->insertion_type;
 	}
 
@@ -692,8 +696,7 @@ clone_per_buffer_values (struct buffer *from, struct buffer *to)
 
   memcpy (to->local_flags, from->local_flags, sizeof to->local_flags);
 
-  set_buffer_overlays_before (to, copy_overlays (to, from->overlays_before));
-  set_buffer_overlays_after (to, copy_overlays (to, from->overlays_after));
+  copy_overlays (from, to);
 
   /* Get (a copy of) the alist of Lisp-level local variables of FROM
      and install that in TO.  */
@@ -803,6 +806,13 @@ CLONE nil means the indirect buffer's state is reset to default values.  */)
   b->newline_cache = 0;
   b->width_run_cache = 0;
   b->bidi_paragraph_cache = 0;
+  b->ppss_cache = 0;
+  b->undo_journal = NULL;
+  b->local_var_cells = NULL;
+  b->local_var_cells_size = 0;
+  b->local_fwd_cells = NULL;
+  b->local_fwd_cells_count = b->local_fwd_cells_size = 0;
+  b->local_var_cells_valid = 0;
   bset_width_table (b, Qnil);
 
   name = Fcopy_sequence (name);
@@ -880,39 +890,21 @@ CLONE nil means the indirect buffer's state is reset to default values.  */)
 static void
 drop_overlay (struct buffer *b, struct Lisp_Overlay *ov)
 {
-  eassert (b == XBUFFER (Fmarker_buffer (ov->start)));
-  modify_overlay (b, marker_position (ov->start),
-		  marker_position (ov->end));
-  unchain_marker (XMARKER (ov->start));
-  unchain_marker (XMARKER (ov->end));
-
+  eassert (b == ov->buffer);
+  modify_overlay (b, itree_node_begin (&b->overlays, ov->interval),
+		  itree_node_end (&b->overlays, ov->interval));
+  remove_buffer_overlay (b, ov);
 }
 
-/* Delete all overlays of B and reset it's overlay lists.  */
+/* Delete all overlays of B and empty its overlay tree.  */
 
 void
 delete_all_overlays (struct buffer *b)
 {
-  struct Lisp_Overlay *ov, *next;
+  struct itree_node *node;
 
-  /* FIXME: Since each drop_overlay will scan BUF_MARKERS to unlink its
-     markers, we have an unneeded O(N^2) behavior here.  */
-  for (ov = b->overlays_before; ov; ov = next)
-    {
-      drop_overlay (b, ov);
-      next = ov->next;
-      ov->next = NULL;
-    }
-
-  for (ov = b->overlays_after; ov; ov = next)
-    {
-      drop_overlay (b, ov);
-      next = ov->next;
-      ov->next = NULL;
-    }
-
-  set_buffer_overlays_before (b, NULL);
-  set_buffer_overlays_after (b, NULL);
+  while ((node = b->overlays.root))
+    drop_overlay (b, XOVERLAY (node->data));
 }
 
 /* Reinitialize everything about a buffer except its name and contents
@@ -940,9 +932,7 @@ reset_buffer (register struct buffer *b)
   b->auto_save_failure_time = 0;
   bset_auto_save_file_name (b, Qnil);
   bset_read_only (b, Qnil);
-  set_buffer_overlays_before (b, NULL);
-  set_buffer_overlays_after (b, NULL);
-  b->overlay_center = BEG;
+  itree_init (&b->overlays);
   bset_mark_active (b, Qnil);
   bset_point_before_scroll (b, Qnil);
   bset_file_format (b, Qnil);
@@ -1032,6 +1022,8 @@ reset_buffer_local_variables (struct buffer *b, bool permanent_too)
 	  bset_local_var_alist (b, XCDR (tmp));
 	else
 	  XSETCDR (last, XCDR (tmp));
+      /* The bindings deleted in place are still in the table.  */
+      b->local_var_cells_valid = 0;
     }
 
   for (i = 0; i < last_per_buffer_idx; ++i)
@@ -1195,7 +1187,7 @@ buffer_local_value_1 (Lisp_Object variable, Lisp_Object buffer)
       { /* Look in local_var_alist.  */
 	struct Lisp_Buffer_Local_Value *blv = SYMBOL_BLV (sym);
 	XSETSYMBOL (variable, sym); /* Update In case of aliasing.  */
-	result = Fassoc (variable, BVAR (buf, local_var_alist));
+	result = buffer_local_binding (buf, blv);
 	if (!NILP (result))
 	  {
 	    if (blv->fwd)
@@ -1702,7 +1694,6 @@ cleaning up all windows currently displaying the buffer to be killed. */)
   Lisp_Object buffer;
   register struct buffer *b;
   register Lisp_Object tem;
-  register struct Lisp_Marker *m;
   struct gcpro gcpro1;
 
   if (NILP (buffer_or_name))
@@ -1872,17 +1863,7 @@ cleaning up all windows currently displaying the buffer to be killed. */)
       /* Unchain all markers that belong to this indirect buffer.
 	 Don't unchain the markers that belong to the base buffer
 	 or its other indirect buffers.  */
-      struct Lisp_Marker **mp = &BUF_MARKERS (b);
-      while ((m = *mp))
-	{
-	  if (m->buffer == b)
-	    {
-	      m->buffer = NULL;
-	      *mp = m->next;
-	    }
-	  else
-	    mp = &m->next;
-	}
+      unchain_buffer_markers (b);
       /* Intervals should be owned by the base buffer (Bug#16502).  */
       i = buffer_intervals (b);
       if (i)
@@ -1896,22 +1877,15 @@ cleaning up all windows currently displaying the buffer to be killed. */)
     {
       /* Unchain all markers of this buffer and its indirect buffers.
 	 and leave them pointing nowhere.  */
-      for (m = BUF_MARKERS (b); m; )
-	{
-	  struct Lisp_Marker *next = m->next;
-	  m->buffer = 0;
-	  m->next = NULL;
-	  m = next;
-	}
-      BUF_MARKERS (b) = NULL;
+      while (BUF_MARKERS (b)->root)
+	unchain_marker (XMARKER (BUF_MARKERS (b)->root->data));
       set_buffer_intervals (b, NULL);
 
       /* Perhaps we should explicitly free the interval tree here...  */
     }
-  /* Since we've unlinked the markers, the overlays can't be here any more
-     either.  */
-  b->overlays_before = NULL;
-  b->overlays_after = NULL;
+  /* The overlays go with the text, even if the buffer is going to be
+     reused.  */
+  delete_all_overlays (b);
 
   /* Reset the local variables, so that this buffer's local values
      won't be protected from GC.  They would be protected
@@ -1955,6 +1929,13 @@ cleaning up all windows currently displaying the buffer to be killed. */)
       free_region_cache (b->bidi_paragraph_cache);
       b->bidi_paragraph_cache = 0;
     }
+  free_ppss_cache (b);
+  xfree (b->local_var_cells);
+  b->local_var_cells = NULL;
+  b->local_var_cells_size = 0;
+  xfree (b->local_fwd_cells);
+  b->local_fwd_cells = NULL;
+  b->local_fwd_cells_count = b->local_fwd_cells_size = 0;
   bset_width_table (b, Qnil);
   unblock_input ();
   bset_undo_list (b, Qnil);
@@ -2105,7 +2086,6 @@ void
 set_buffer_internal_1 (register struct buffer *b)
 {
   register struct buffer *old_buf;
-  register Lisp_Object tail;
 
 #ifdef USE_MMAP_FOR_BUFFERS
   if (b->text->beg == NULL)
@@ -2126,7 +2106,7 @@ set_buffer_internal_1 (register struct buffer *b)
       /* Put the undo list back in the base buffer, so that it appears
 	 that an indirect buffer shares the undo list of its base.  */
       if (old_buf->base_buffer)
-	bset_undo_list (old_buf->base_buffer, BVAR (old_buf, undo_list));
+	bset_undo_list (old_buf->base_buffer, buffer_undo_list (old_buf));
 
       /* If the old current buffer has markers to record PT, BEGV and ZV
 	 when it is not current, update them now.  */
@@ -2136,20 +2116,22 @@ set_buffer_internal_1 (register struct buffer *b)
   /* Get the undo list from the base buffer, so that it appears
      that an indirect buffer shares the undo list of its base.  */
   if (b->base_buffer)
-    bset_undo_list (b, BVAR (b->base_buffer, undo_list));
+    bset_undo_list (b, buffer_undo_list (b->base_buffer));
 
   /* If the new current buffer has markers to record PT, BEGV and ZV
      when it is not current, fetch them now.  */
   fetch_buffer_markers (b);
 
-  /* Look down buffer's list of local Lisp variables
-     to find and update any that forward into C variables.  */
+  /* Find and update the buffer's local Lisp variables that forward
+     into C variables.  */
 
   do
     {
-      for (tail = BVAR (b, local_var_alist); CONSP (tail); tail = XCDR (tail))
+      ptrdiff_t i;
+
+      for (i = 0; i < buffer_local_fwd_bindings (b); i++)
 	{
-	  Lisp_Object var = XCAR (XCAR (tail));
+	  Lisp_Object var = XCAR (b->local_fwd_cells[i]);
 	  struct Lisp_Symbol *sym = XSYMBOL (var);
 	  if (sym->redirect == SYMBOL_LOCALIZED /* Just to be sure.  */
 	      && SYMBOL_BLV (sym)->fwd)
@@ -2300,6 +2282,52 @@ advance_to_char_boundary (ptrdiff_t byte_pos)
   return byte_pos;
 }
 
+/* Convert the positions in TREE, the overlays or the markers of a
+   buffer that shares the text of the current buffer, between
+   characters and bytes: to bytes if MULTIBYTE is false, which must be
+   done while the text is still multibyte, and back to characters if
+   it is true, which must wait until the text is multibyte.  */
+
+static void
+set_positions_multibyte (struct itree_tree *tree, bool multibyte)
+{
+  struct itree_iterator iter;
+  struct itree_node *node, **nodes;
+  ptrdiff_t i, n = tree->size;
+  USE_SAFE_ALLOCA;
+
+  if (! n)
+    return;
+
+  /* Changing the positions changes the tree, so collect the nodes
+     first.  */
+  SAFE_NALLOCA (nodes, 1, n);
+  for (i = 0, node = itree_iterator_start (&iter, tree,
+					   PTRDIFF_MIN, PTRDIFF_MAX);
+       node; node = itree_iterator_next (&iter))
+    nodes[i++] = node;
+  eassert (i == n);
+
+  for (i = 0; i < n; i++)
+    {
+      ptrdiff_t begin = nodes[i]->begin, end = nodes[i]->end;
+
+      if (multibyte)
+	{
+	  begin = BYTE_TO_CHAR (advance_to_char_boundary (begin));
+	  end = BYTE_TO_CHAR (advance_to_char_boundary (end));
+	}
+      else
+	{
+	  begin = CHAR_TO_BYTE (begin);
+	  end = CHAR_TO_BYTE (end);
+	}
+      itree_node_set_region (tree, nodes[i], begin, end);
+    }
+
+  SAFE_FREE ();
+}
+
 DEFUN ("buffer-swap-text", Fbuffer_swap_text, Sbuffer_swap_text,
        1, 1, 0,
        doc: /* Swap the text between current buffer and BUFFER.  */)
@@ -2366,11 +2394,14 @@ DEFUN ("buffer-swap-text", Fbuffer_swap_text, Sbuffer_swap_text,
   swapfield (newline_cache, struct region_cache *);
   swapfield (width_run_cache, struct region_cache *);
   swapfield (bidi_paragraph_cache, struct region_cache *);
+  swapfield (ppss_cache, struct ppss_cache *);
   current_buffer->prevent_redisplay_optimizations_p = 1;
   other_buffer->prevent_redisplay_optimizations_p = 1;
-  swapfield (overlays_before, struct Lisp_Overlay *);
-  swapfield (overlays_after, struct Lisp_Overlay *);
-  swapfield (overlay_center, ptrdiff_t);
+  swapfield (overlays, struct itree_tree);
+  /* Put the changes in the undo journals in the lists first, since
+     bset_undo_list discards them.  */
+  buffer_undo_list (current_buffer);
+  buffer_undo_list (other_buffer);
   swapfield_ (undo_list, Lisp_Object);
   swapfield_ (mark, Lisp_Object);
   swapfield_ (enable_multibyte_characters, Lisp_Object);
@@ -2392,21 +2423,38 @@ DEFUN ("buffer-swap-text", Fbuffer_swap_text, Sbuffer_swap_text,
   other_buffer->text->beg_unchanged = other_buffer->text->gpt;
   other_buffer->text->end_unchanged = other_buffer->text->gpt;
   {
-    struct Lisp_Marker *m;
-    for (m = BUF_MARKERS (current_buffer); m; m = m->next)
-      if (m->buffer == other_buffer)
-	m->buffer = current_buffer;
-      else
-	/* Since there's no indirect buffer in sight, markers on
-	   BUF_MARKERS(buf) should either be for `buf' or dead.  */
-	eassert (!m->buffer);
-    for (m = BUF_MARKERS (other_buffer); m; m = m->next)
-      if (m->buffer == current_buffer)
-	m->buffer = other_buffer;
-      else
-	/* Since there's no indirect buffer in sight, markers on
-	   BUF_MARKERS(buf) should either be for `buf' or dead.  */
-	eassert (!m->buffer);
+    struct itree_iterator iter;
+    struct itree_node *node;
+
+    /* Since there's no indirect buffer in sight, the markers in
+       BUF_MARKERS(buf) should all be for the buffer whose text it
+       was.  */
+    for (node = itree_iterator_start (&iter, BUF_MARKERS (current_buffer),
+				      PTRDIFF_MIN, PTRDIFF_MAX);
+	 node; node = itree_iterator_next (&iter))
+      {
+	eassert (XMARKER (node->data)->buffer == other_buffer);
+	XMARKER (node->data)->buffer = current_buffer;
+      }
+    for (node = itree_iterator_start (&iter, BUF_MARKERS (other_buffer),
+				      PTRDIFF_MIN, PTRDIFF_MAX);
+	 node; node = itree_iterator_next (&iter))
+      {
+	eassert (XMARKER (node->data)->buffer == current_buffer);
+	XMARKER (node->data)->buffer = other_buffer;
+      }
+  }
+  {
+    struct itree_iterator iter;
+    struct itree_node *node;
+    for (node = itree_iterator_start (&iter, &current_buffer->overlays,
+				      PTRDIFF_MIN, PTRDIFF_MAX);
+	 node; node = itree_iterator_next (&iter))
+      XOVERLAY (node->data)->buffer = current_buffer;
+    for (node = itree_iterator_start (&iter, &other_buffer->overlays,
+				      PTRDIFF_MIN, PTRDIFF_MAX);
+	 node; node = itree_iterator_next (&iter))
+      XOVERLAY (node->data)->buffer = other_buffer;
   }
   { /* Some of the C code expects that both window markers of a
        live window points to that window's buffer.  So since we
@@ -2460,12 +2508,11 @@ If the multibyte flag was really changed, undo information of the
 current buffer is cleared.  */)
   (Lisp_Object flag)
 {
-  struct Lisp_Marker *tail, *markers;
   struct buffer *other;
   ptrdiff_t begv, zv;
   bool narrowed = (BEG != BEGV || Z != ZV);
   bool modified_p = !NILP (Fbuffer_modified_p (Qnil));
-  Lisp_Object old_undo = BVAR (current_buffer, undo_list);
+  Lisp_Object old_undo = buffer_undo_list (current_buffer);
   struct gcpro gcpro1;
 
   if (current_buffer->base_buffer)
@@ -2484,6 +2531,10 @@ current buffer is cleared.  */)
   /* If the cached position is for this buffer, clear it out.  */
   clear_charpos_cache (current_buffer);
 
+  /* The byte lengths of the characters change, so the position index
+     has to be built again.  */
+  free_pos_index (current_buffer);
+
   if (NILP (flag))
     begv = BEGV_BYTE, zv = ZV_BYTE;
   else
@@ -2502,6 +2553,10 @@ current buffer is cleared.  */)
       /* Do this first, so it can use CHAR_TO_BYTE
 	 to calculate the old correspondences.  */
       set_intervals_multibyte (0);
+      FOR_EACH_BUFFER (other)
+	if (other == current_buffer || other->base_buffer == current_buffer)
+	  set_positions_multibyte (&other->overlays, 0);
+      set_positions_multibyte (BUF_MARKERS (current_buffer), 0);
 
       bset_enable_multibyte_characters (current_buffer, Qnil);
 
@@ -2511,10 +2566,6 @@ current buffer is cleared.  */)
       GPT = GPT_BYTE;
       TEMP_SET_PT_BOTH (PT_BYTE, PT_BYTE);
 
-
-      for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-	tail->charpos = tail->bytepos;
-
       /* Convert multibyte form of 8-bit characters to unibyte.  */
       pos = BEG;
       stop = GPT;
@@ -2557,6 +2608,10 @@ current buffer is cleared.  */)
 	}
       if (narrowed)
 	Fnarrow_to_region (make_number (begv), make_number (zv));
+
+      /* The conversions above may have used an index of the multibyte
+	 text.  */
+      free_pos_index (current_buffer);
     }
   else
     {
@@ -2671,25 +2726,10 @@ current buffer is cleared.  */)
 	TEMP_SET_PT_BOTH (position, byte);
       }
 
-      tail = markers = BUF_MARKERS (current_buffer);
-
-      /* This prevents BYTE_TO_CHAR (that is, buf_bytepos_to_charpos) from
-	 getting confused by the markers that have not yet been updated.
-	 It is also a signal that it should never create a marker.  */
-      BUF_MARKERS (current_buffer) = NULL;
-
-      for (; tail; tail = tail->next)
-	{
-	  tail->bytepos = advance_to_char_boundary (tail->bytepos);
-	  tail->charpos = BYTE_TO_CHAR (tail->bytepos);
-	}
-
-      /* Make sure no markers were put on the chain
-	 while the chain value was incorrect.  */
-      if (BUF_MARKERS (current_buffer))
-	emacs_abort ();
-
-      BUF_MARKERS (current_buffer) = markers;
+      set_positions_multibyte (BUF_MARKERS (current_buffer), 1);
+      FOR_EACH_BUFFER (other)
+	if (other == current_buffer || other->base_buffer == current_buffer)
+	  set_positions_multibyte (&other->overlays, 1);
 
       /* Do this last, so it can calculate the new correspondences
 	 between chars and bytes.  */
@@ -2830,38 +2870,19 @@ overlays_at (EMACS_INT pos, bool extend, Lisp_Object **vec_ptr,
 	     ptrdiff_t *len_ptr,
 	     ptrdiff_t *next_ptr, ptrdiff_t *prev_ptr, bool change_req)
 {
-  Lisp_Object overlay, start, end;
-  struct Lisp_Overlay *tail;
+  struct itree_tree *tree = &current_buffer->overlays;
+  struct itree_iterator iter;
+  struct itree_node *node;
   ptrdiff_t idx = 0;
   ptrdiff_t len = *len_ptr;
   Lisp_Object *vec = *vec_ptr;
-  ptrdiff_t next = ZV;
-  ptrdiff_t prev = BEGV;
   bool inhibit_storing = 0;
+  bool empty_at_pos = 0;
 
-  for (tail = current_buffer->overlays_before; tail; tail = tail->next)
+  for (node = itree_iterator_start (&iter, tree, pos, pos); node;
+       node = itree_iterator_next (&iter))
     {
-      ptrdiff_t startpos, endpos;
-
-      XSETMISC (overlay, tail);
-
-      start = OVERLAY_START (overlay);
-      end = OVERLAY_END (overlay);
-      endpos = OVERLAY_POSITION (end);
-      if (endpos < pos)
-	{
-	  if (prev < endpos)
-	    prev = endpos;
-	  break;
-	}
-      startpos = OVERLAY_POSITION (start);
-      /* This one ends at or after POS
-	 so its start counts for PREV_PTR if it's before POS.  */
-      if (prev < startpos && startpos < pos)
-	prev = startpos;
-      if (endpos == pos)
-	continue;
-      if (startpos <= pos)
+      if (pos < node->end)
 	{
 	  if (idx == len)
 	    {
@@ -2879,77 +2900,43 @@ overlays_at (EMACS_INT pos, bool extend, Lisp_Object **vec_ptr,
 	    }
 
 	  if (!inhibit_storing)
-	    vec[idx] = overlay;
+	    vec[idx] = node->data;
 	  /* Keep counting overlays even if we can't return them all.  */
 	  idx++;
 	}
-      else if (startpos < next)
-	next = startpos;
+      else if (node->begin == pos)
+	empty_at_pos = 1;
     }
 
-  for (tail = current_buffer->overlays_after; tail; tail = tail->next)
-    {
-      ptrdiff_t startpos, endpos;
-
-      XSETMISC (overlay, tail);
-
-      start = OVERLAY_START (overlay);
-      end = OVERLAY_END (overlay);
-      startpos = OVERLAY_POSITION (start);
-      if (pos < startpos)
-	{
-	  if (startpos < next)
-	    next = startpos;
-	  break;
-	}
-      endpos = OVERLAY_POSITION (end);
-      if (pos < endpos)
-	{
-	  if (idx == len)
-	    {
-	      if (extend)
-		{
-		  vec = xpalloc (vec, len_ptr, 1, OVERLAY_COUNT_MAX,
-				 sizeof *vec);
-		  *vec_ptr = vec;
-		  len = *len_ptr;
-		}
-	      else
-		inhibit_storing = 1;
-	    }
-
-	  if (!inhibit_storing)
-	    vec[idx] = overlay;
-	  idx++;
+  if (next_ptr)
+    *next_ptr = min (ZV, itree_next_begin (tree, pos));
 
-	  if (startpos < pos && startpos > prev)
-	    prev = startpos;
-	}
-      else if (endpos < pos && endpos > prev)
-	prev = endpos;
-      else if (endpos == pos && startpos > prev
-	       && (!change_req || startpos < pos))
-	prev = startpos;
+  if (prev_ptr)
+    {
+      /* No overlay ending before POS can end before the last one
+	 beginning before POS begins, so only the overlays from there
+	 on matter.  */
+      ptrdiff_t prev = max (BEGV, itree_previous_begin (tree, pos));
+
+      if (empty_at_pos && !change_req)
+	prev = pos;
+      else if (prev < pos)
+	for (node = itree_iterator_start (&iter, tree, prev, pos); node;
+	     node = itree_iterator_next (&iter))
+	  if (prev < node->end && node->end < pos)
+	    prev = node->end;
+      *prev_ptr = prev;
     }
 
-  if (next_ptr)
-    *next_ptr = next;
-  if (prev_ptr)
-    *prev_ptr = prev;
   return idx;
 }
-
+
 /* Find all the overlays in the current buffer that overlap the range
    BEG-END, or are empty at BEG, or are empty at END provided END
    denotes the position at the end of the current buffer.
 
    Return the number found, and store them in a vector in *VEC_PTR.
    Store in *LEN_PTR the size allocated for the vector.
-   Store in *NEXT_PTR the next position after POS where an overlay starts,
-     or ZV if there are no more overlays.
-   Store in *PREV_PTR the previous position before POS where an overlay ends,
-     or BEGV if there are no previous overlays.
-   NEXT_PTR and/or PREV_PTR may be 0, meaning don't store that info.
 
    *VEC_PTR and *LEN_PTR should contain a valid vector and size
    when this function is called.
@@ -2961,35 +2948,22 @@ overlays_at (EMACS_INT pos, bool extend, Lisp_Object **vec_ptr,
 
 static ptrdiff_t
 overlays_in (EMACS_INT beg, EMACS_INT end, bool extend,
-	     Lisp_Object **vec_ptr, ptrdiff_t *len_ptr,
-	     ptrdiff_t *next_ptr, ptrdiff_t *prev_ptr)
+	     Lisp_Object **vec_ptr, ptrdiff_t *len_ptr)
 {
-  Lisp_Object overlay, ostart, oend;
-  struct Lisp_Overlay *tail;
+  struct itree_iterator iter;
+  struct itree_node *node;
   ptrdiff_t idx = 0;
   ptrdiff_t len = *len_ptr;
   Lisp_Object *vec = *vec_ptr;
-  ptrdiff_t next = ZV;
-  ptrdiff_t prev = BEGV;
   bool inhibit_storing = 0;
   bool end_is_Z = end == Z;
 
-  for (tail = current_buffer->overlays_before; tail; tail = tail->next)
+  for (node = itree_iterator_start (&iter, &current_buffer->overlays,
+				    min (beg, end), max (beg, end));
+       node; node = itree_iterator_next (&iter))
     {
-      ptrdiff_t startpos, endpos;
+      ptrdiff_t startpos = node->begin, endpos = node->end;
 
-      XSETMISC (overlay, tail);
-
-      ostart = OVERLAY_START (overlay);
-      oend = OVERLAY_END (overlay);
-      endpos = OVERLAY_POSITION (oend);
-      if (endpos < beg)
-	{
-	  if (prev < endpos)
-	    prev = endpos;
-	  break;
-	}
-      startpos = OVERLAY_POSITION (ostart);
       /* Count an interval if it overlaps the range, is empty at the
 	 start of the range, or is empty at END provided END denotes the
 	 end of the buffer.  */
@@ -3013,62 +2987,12 @@ overlays_in (EMACS_INT beg, EMACS_INT end, bool extend,
 	    }
 
 	  if (!inhibit_storing)
-	    vec[idx] = overlay;
+	    vec[idx] = node->data;
 	  /* Keep counting overlays even if we can't return them all.  */
 	  idx++;
 	}
-      else if (startpos < next)
-	next = startpos;
     }
 
-  for (tail = current_buffer->overlays_after; tail; tail = tail->next)
-    {
-      ptrdiff_t startpos, endpos;
-
-      XSETMISC (overlay, tail);
-
-      ostart = OVERLAY_START (overlay);
-      oend = OVERLAY_END (overlay);
-      startpos = OVERLAY_POSITION (ostart);
-      if (end < startpos)
-	{
-	  if (startpos < next)
-	    next = startpos;
-	  break;
-	}
-      endpos = OVERLAY_POSITION (oend);
-      /* Count an interval if it overlaps the range, is empty at the
-	 start of the range, or is empty at END provided END denotes the
-	 end of the buffer.  */
-      if ((beg < endpos && startpos < end)
-	  || (startpos == endpos
-	      && (beg == endpos || (end_is_Z && endpos == end))))
-	{
-	  if (idx == len)
-	    {
-	      if (extend)
-		{
-		  vec = xpalloc (vec, len_ptr, 1, OVERLAY_COUNT_MAX,
-				 sizeof *vec);
-		  *vec_ptr = vec;
-		  len = *len_ptr;
-		}
-	      else
-		inhibit_storing = 1;
-	    }
-
-	  if (!inhibit_storing)
-	    vec[idx] = overlay;
-	  idx++;
-	}
-      else if (endpos < beg && endpos > prev)
-	prev = endpos;
-    }
-
-  if (next_ptr)
-    *next_ptr = next;
-  if (prev_ptr)
-    *prev_ptr = prev;
   return idx;
 }
 
@@ -3079,18 +3003,18 @@ overlays_in (EMACS_INT beg, EMACS_INT end, bool extend,
 bool
 mouse_face_overlay_overlaps (Lisp_Object overlay)
 {
-  ptrdiff_t start = OVERLAY_POSITION (OVERLAY_START (overlay));
-  ptrdiff_t end = OVERLAY_POSITION (OVERLAY_END (overlay));
+  ptrdiff_t start = OVERLAY_START (overlay);
+  ptrdiff_t end = OVERLAY_END (overlay);
   ptrdiff_t n, i, size;
   Lisp_Object *v, tem;
 
   size = 10;
   v = alloca (size * sizeof *v);
-  n = overlays_in (start, end, 0, &v, &size, NULL, NULL);
+  n = overlays_in (start, end, 0, &v, &size);
   if (n > size)
     {
       v = alloca (n * sizeof *v);
-      overlays_in (start, end, 0, &v, &n, NULL, NULL);
+      overlays_in (start, end, 0, &v, &n);
     }
 
   for (i = 0; i < n; ++i)
@@ -3108,39 +3032,17 @@ mouse_face_overlay_overlaps (Lisp_Object overlay)
 bool
 overlay_touches_p (ptrdiff_t pos)
 {
-  Lisp_Object overlay;
-  struct Lisp_Overlay *tail;
-
-  for (tail = current_buffer->overlays_before; tail; tail = tail->next)
-    {
-      ptrdiff_t endpos;
-
-      XSETMISC (overlay ,tail);
-      eassert (OVERLAYP (overlay));
-
-      endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-      if (endpos < pos)
-	break;
-      if (endpos == pos || OVERLAY_POSITION (OVERLAY_START (overlay)) == pos)
-	return 1;
-    }
-
-  for (tail = current_buffer->overlays_after; tail; tail = tail->next)
-    {
-      ptrdiff_t startpos;
-
-      XSETMISC (overlay, tail);
-      eassert (OVERLAYP (overlay));
+  struct itree_iterator iter;
+  struct itree_node *node;
 
-      startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-      if (pos < startpos)
-	break;
-      if (startpos == pos || OVERLAY_POSITION (OVERLAY_END (overlay)) == pos)
-	return 1;
-    }
+  for (node = itree_iterator_start (&iter, &current_buffer->overlays,
+				    pos, pos);
+       node; node = itree_iterator_next (&iter))
+    if (node->begin == pos || node->end == pos)
+      return 1;
   return 0;
 }
-
+
 struct sortvec
 {
   Lisp_Object overlay;
@@ -3189,8 +3091,8 @@ sort_overlays (Lisp_Object *overlay_vec, ptrdiff_t noverlays, struct window *w)
 
       overlay = overlay_vec[i];
       if (OVERLAYP (overlay)
-	  && OVERLAY_POSITION (OVERLAY_START (overlay)) > 0
-	  && OVERLAY_POSITION (OVERLAY_END (overlay)) > 0)
+	  && OVERLAY_START (overlay) > 0
+	  && OVERLAY_END (overlay) > 0)
 	{
 	  /* If we're interested in a specific window, then ignore
 	     overlays that are limited to some other window.  */
@@ -3205,8 +3107,8 @@ sort_overlays (Lisp_Object *overlay_vec, ptrdiff_t noverlays, struct window *w)
 
 	  /* This overlay is good and counts: put it into sortvec.  */
 	  sortvec[j].overlay = overlay;
-	  sortvec[j].beg = OVERLAY_POSITION (OVERLAY_START (overlay));
-	  sortvec[j].end = OVERLAY_POSITION (OVERLAY_END (overlay));
+	  sortvec[j].beg = OVERLAY_START (overlay);
+	  sortvec[j].end = OVERLAY_END (overlay);
 	  tem = Foverlay_get (overlay, Qpriority);
 	  if (INTEGERP (tem))
 	    sortvec[j].priority = XINT (tem);
@@ -3325,49 +3227,22 @@ ptrdiff_t
 overlay_strings (ptrdiff_t pos, struct window *w, unsigned char **pstr)
 {
   Lisp_Object overlay, window, str;
-  struct Lisp_Overlay *ov;
+  struct itree_iterator iter;
+  struct itree_node *node;
   ptrdiff_t startpos, endpos;
   bool multibyte = ! NILP (BVAR (current_buffer, enable_multibyte_characters));
 
   overlay_heads.used = overlay_heads.bytes = 0;
   overlay_tails.used = overlay_tails.bytes = 0;
-  for (ov = current_buffer->overlays_before; ov; ov = ov->next)
-    {
-      XSETMISC (overlay, ov);
-      eassert (OVERLAYP (overlay));
-
-      startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-      endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-      if (endpos < pos)
-	break;
-      if (endpos != pos && startpos != pos)
-	continue;
-      window = Foverlay_get (overlay, Qwindow);
-      if (WINDOWP (window) && XWINDOW (window) != w)
-	continue;
-      if (startpos == pos
-	  && (str = Foverlay_get (overlay, Qbefore_string), STRINGP (str)))
-	record_overlay_string (&overlay_heads, str,
-			       (startpos == endpos
-				? Foverlay_get (overlay, Qafter_string)
-				: Qnil),
-			       Foverlay_get (overlay, Qpriority),
-			       endpos - startpos);
-      else if (endpos == pos
-	  && (str = Foverlay_get (overlay, Qafter_string), STRINGP (str)))
-	record_overlay_string (&overlay_tails, str, Qnil,
-			       Foverlay_get (overlay, Qpriority),
-			       endpos - startpos);
-    }
-  for (ov = current_buffer->overlays_after; ov; ov = ov->next)
+  for (node = itree_iterator_start (&iter, &current_buffer->overlays,
+				    pos, pos);
+       node; node = itree_iterator_next (&iter))
     {
-      XSETMISC (overlay, ov);
+      overlay = node->data;
       eassert (OVERLAYP (overlay));
 
-      startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-      endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-      if (startpos > pos)
-	break;
+      startpos = node->begin;
+      endpos = node->end;
       if (endpos != pos && startpos != pos)
 	continue;
       window = Foverlay_get (overlay, Qwindow);
@@ -3443,385 +3318,127 @@ overlay_strings (ptrdiff_t pos, struct window *w, unsigned char **pstr)
   return 0;
 }
 
-/* Shift overlays in BUF's overlay lists, to center the lists at POS.  */
+/* Adjust the overlays of the current buffer, and of all the other
+   buffers that share its text, for the insertion of LENGTH characters
+   at POS.  BEFORE_MARKERS says whether the insertion moves every
+   overlay boundary at POS, as it does every marker there.  */
 
 void
-recenter_overlay_lists (struct buffer *buf, ptrdiff_t pos)
+adjust_overlays_for_insert (ptrdiff_t pos, ptrdiff_t length,
+			    bool before_markers)
 {
-  Lisp_Object overlay, beg, end;
-  struct Lisp_Overlay *prev, *tail, *next;
-
-  /* See if anything in overlays_before should move to overlays_after.  */
+  struct buffer *base = (current_buffer->base_buffer
+			 ? current_buffer->base_buffer : current_buffer);
 
-  /* We don't strictly need prev in this loop; it should always be nil.
-     But we use it for symmetry and in case that should cease to be true
-     with some future change.  */
-  prev = NULL;
-  for (tail = buf->overlays_before; tail; prev = tail, tail = next)
+  itree_insert_gap (&base->overlays, pos, length, before_markers);
+  if (base->indirections > 0)
     {
-      next = tail->next;
-      XSETMISC (overlay, tail);
-      eassert (OVERLAYP (overlay));
-
-      beg = OVERLAY_START (overlay);
-      end = OVERLAY_END (overlay);
-
-      if (OVERLAY_POSITION (end) > pos)
-	{
-	  /* OVERLAY needs to be moved.  */
-	  ptrdiff_t where = OVERLAY_POSITION (beg);
-	  struct Lisp_Overlay *other, *other_prev;
-
-	  /* Splice the cons cell TAIL out of overlays_before.  */
-	  if (prev)
-	    prev->next = next;
-	  else
-	    set_buffer_overlays_before (buf, next);
+      struct buffer *b;
 
-	  /* Search thru overlays_after for where to put it.  */
-	  other_prev = NULL;
-	  for (other = buf->overlays_after; other;
-	       other_prev = other, other = other->next)
-	    {
-	      Lisp_Object otherbeg, otheroverlay;
-
-	      XSETMISC (otheroverlay, other);
-	      eassert (OVERLAYP (otheroverlay));
-
-	      otherbeg = OVERLAY_START (otheroverlay);
-	      if (OVERLAY_POSITION (otherbeg) >= where)
-		break;
-	    }
-
-	  /* Add TAIL to overlays_after before OTHER.  */
-	  tail->next = other;
-	  if (other_prev)
-	    other_prev->next = tail;
-	  else
-	    set_buffer_overlays_after (buf, tail);
-	  tail = prev;
-	}
-      else
-	/* We've reached the things that should stay in overlays_before.
-	   All the rest of overlays_before must end even earlier,
-	   so stop now.  */
-	break;
+      FOR_EACH_BUFFER (b)
+	if (b->base_buffer == base)
+	  itree_insert_gap (&b->overlays, pos, length, before_markers);
     }
-
-  /* See if anything in overlays_after should be in overlays_before.  */
-  prev = NULL;
-  for (tail = buf->overlays_after; tail; prev = tail, tail = next)
-    {
-      next = tail->next;
-      XSETMISC (overlay, tail);
-      eassert (OVERLAYP (overlay));
-
-      beg = OVERLAY_START (overlay);
-      end = OVERLAY_END (overlay);
-
-      /* Stop looking, when we know that nothing further
-	 can possibly end before POS.  */
-      if (OVERLAY_POSITION (beg) > pos)
-	break;
-
-      if (OVERLAY_POSITION (end) <= pos)
-	{
-	  /* OVERLAY needs to be moved.  */
-	  ptrdiff_t where = OVERLAY_POSITION (end);
-	  struct Lisp_Overlay *other, *other_prev;
-
-	  /* Splice the cons cell TAIL out of overlays_after.  */
-	  if (prev)
-	    prev->next = next;
-	  else
-	    set_buffer_overlays_after (buf, next);
-
-	  /* Search thru overlays_before for where to put it.  */
-	  other_prev = NULL;
-	  for (other = buf->overlays_before; other;
-	       other_prev = other, other = other->next)
-	    {
-	      Lisp_Object otherend, otheroverlay;
-
-	      XSETMISC (otheroverlay, other);
-	      eassert (OVERLAYP (otheroverlay));
-
-	      otherend = OVERLAY_END (otheroverlay);
-	      if (OVERLAY_POSITION (otherend) <= where)
-		break;
-	    }
-
-	  /* Add TAIL to overlays_before before OTHER.  */
-	  tail->next = other;
-	  if (other_prev)
-	    other_prev->next = tail;
-	  else
-	    set_buffer_overlays_before (buf, tail);
-	  tail = prev;
-	}
-    }
-
-  buf->overlay_center = pos;
 }
 
-void
-adjust_overlays_for_insert (ptrdiff_t pos, ptrdiff_t length)
-{
-  /* After an insertion, the lists are still sorted properly,
-     but we may need to update the value of the overlay center.  */
-  if (current_buffer->overlay_center >= pos)
-    current_buffer->overlay_center += length;
-}
+/* Adjust the overlays of the current buffer, and of all the other
+   buffers that share its text, for the deletion of LENGTH characters
+   at POS.  */
 
 void
 adjust_overlays_for_delete (ptrdiff_t pos, ptrdiff_t length)
 {
-  if (current_buffer->overlay_center < pos)
-    /* The deletion was to our right.  No change needed; the before- and
-       after-lists are still consistent.  */
-    ;
-  else if (current_buffer->overlay_center - pos > length)
-    /* The deletion was to our left.  We need to adjust the center value
-       to account for the change in position, but the lists are consistent
-       given the new value.  */
-    current_buffer->overlay_center -= length;
-  else
-    /* We're right in the middle.  There might be things on the after-list
-       that now belong on the before-list.  Recentering will move them,
-       and also update the center point.  */
-    recenter_overlay_lists (current_buffer, pos);
-}
-
-/* Fix up overlays that were garbled as a result of permuting markers
-   in the range START through END.  Any overlay with at least one
-   endpoint in this range will need to be unlinked from the overlay
-   list and reinserted in its proper place.
-   Such an overlay might even have negative size at this point.
-   If so, we'll make the overlay empty. */
-void
-fix_start_end_in_overlays (register ptrdiff_t start, register ptrdiff_t end)
-{
-  Lisp_Object overlay;
-  struct Lisp_Overlay *before_list IF_LINT (= NULL);
-  struct Lisp_Overlay *after_list IF_LINT (= NULL);
-  /* These are either nil, indicating that before_list or after_list
-     should be assigned, or the cons cell the cdr of which should be
-     assigned.  */
-  struct Lisp_Overlay *beforep = NULL, *afterp = NULL;
-  /* 'Parent', likewise, indicates a cons cell or
-     current_buffer->overlays_before or overlays_after, depending
-     which loop we're in.  */
-  struct Lisp_Overlay *tail, *parent;
-  ptrdiff_t startpos, endpos;
+  struct buffer *base = (current_buffer->base_buffer
+			 ? current_buffer->base_buffer : current_buffer);
 
-  /* This algorithm shifts links around instead of consing and GCing.
-     The loop invariant is that before_list (resp. after_list) is a
-     well-formed list except that its last element, the CDR of beforep
-     (resp. afterp) if beforep (afterp) isn't nil or before_list
-     (after_list) if it is, is still uninitialized.  So it's not a bug
-     that before_list isn't initialized, although it may look
-     strange.  */
-  for (parent = NULL, tail = current_buffer->overlays_before; tail;)
+  itree_delete_gap (&base->overlays, pos, length);
+  if (base->indirections > 0)
     {
-      XSETMISC (overlay, tail);
+      struct buffer *b;
 
-      endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-      startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-
-      /* If the overlay is backwards, make it empty.  */
-      if (endpos < startpos)
-	{
-	  startpos = endpos;
-	  Fset_marker (OVERLAY_START (overlay), make_number (startpos),
-		       Qnil);
-	}
+      FOR_EACH_BUFFER (b)
+	if (b->base_buffer == base)
+	  itree_delete_gap (&b->overlays, pos, length);
+    }
+}
 
-      if (endpos < start)
-	break;
+/* Return true if the deletion of the text from FROM to TO moves an
+   overlay boundary at POS, which moves past text inserted at it if
+   ADVANCE, in a way that undoing the deletion would not revert, as
+   adjust_markers_for_delete decides for markers.  */
 
-      if (endpos < end
-	  || (startpos >= start && startpos < end))
-	{
-	  /* Add it to the end of the wrong list.  Later on,
-	     recenter_overlay_lists will move it to the right place.  */
-	  if (endpos < current_buffer->overlay_center)
-	    {
-	      if (!afterp)
-		after_list = tail;
-	      else
-		afterp->next = tail;
-	      afterp = tail;
-	    }
-	  else
-	    {
-	      if (!beforep)
-		before_list = tail;
-	      else
-		beforep->next = tail;
-	      beforep = tail;
-	    }
-	  if (!parent)
-	    set_buffer_overlays_before (current_buffer, tail->next);
-	  else
-	    parent->next = tail->next;
-	  tail = tail->next;
-	}
-      else
-	parent = tail, tail = parent->next;
-    }
-  for (parent = NULL, tail = current_buffer->overlays_after; tail;)
-    {
-      XSETMISC (overlay, tail);
+static bool
+overlay_boundary_adjusted_p (ptrdiff_t pos, bool advance,
+			     ptrdiff_t from, ptrdiff_t to)
+{
+  if (pos < from || to < pos)
+    return 0;
+  if (pos > from)
+    return !advance || pos < to;
+  return advance;
+}
 
-      startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-      endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
+static void
+record_overlay_adjustments_1 (struct itree_tree *tree,
+			      ptrdiff_t from, ptrdiff_t to)
+{
+  struct itree_iterator iter;
+  struct itree_node *node;
 
-      /* If the overlay is backwards, make it empty.  */
-      if (endpos < startpos)
-	{
-	  startpos = endpos;
-	  Fset_marker (OVERLAY_START (overlay), make_number (startpos),
-		       Qnil);
-	}
+  for (node = itree_iterator_start (&iter, tree, from, to);
+       node; node = itree_iterator_next (&iter))
+    if (overlay_boundary_adjusted_p (node->begin, node->front_advance,
+				     from, to)
+	|| overlay_boundary_adjusted_p (node->end, node->rear_advance,
+					from, to))
+      record_overlay_adjustment (node->data, node->begin, node->end);
+}
 
-      if (startpos >= end)
-	break;
+/* Record for undo how the deletion of the text from FROM to TO is
+   about to move the boundaries of the overlays of the current buffer,
+   and of all the other buffers that share its text.  */
 
-      if (startpos >= start
-	  || (endpos >= start && endpos < end))
-	{
-	  if (endpos < current_buffer->overlay_center)
-	    {
-	      if (!afterp)
-		after_list = tail;
-	      else
-		afterp->next = tail;
-	      afterp = tail;
-	    }
-	  else
-	    {
-	      if (!beforep)
-		before_list = tail;
-	      else
-		beforep->next = tail;
-	      beforep = tail;
-	    }
-	  if (!parent)
-	    set_buffer_overlays_after (current_buffer, tail->next);
-	  else
-	    parent->next = tail->next;
-	  tail = tail->next;
-	}
-      else
-	parent = tail, tail = parent->next;
-    }
+void
+record_overlay_adjustments (ptrdiff_t from, ptrdiff_t to)
+{
+  struct buffer *base = (current_buffer->base_buffer
+			 ? current_buffer->base_buffer : current_buffer);
 
-  /* Splice the constructed (wrong) lists into the buffer's lists,
-     and let the recenter function make it sane again.  */
-  if (beforep)
+  record_overlay_adjustments_1 (&base->overlays, from, to);
+  if (base->indirections > 0)
     {
-      beforep->next = current_buffer->overlays_before;
-      set_buffer_overlays_before (current_buffer, before_list);
-    }
+      struct buffer *b;
 
-  if (afterp)
-    {
-      afterp->next = current_buffer->overlays_after;
-      set_buffer_overlays_after (current_buffer, after_list);
+      FOR_EACH_BUFFER (b)
+	if (b->base_buffer == base)
+	  record_overlay_adjustments_1 (&b->overlays, from, to);
     }
-  recenter_overlay_lists (current_buffer, current_buffer->overlay_center);
 }
 
-/* We have two types of overlay: the one whose ending marker is
-   after-insertion-marker (this is the usual case) and the one whose
-   ending marker is before-insertion-marker.  When `overlays_before'
-   contains overlays of the latter type and the former type in this
-   order and both overlays end at inserting position, inserting a text
-   increases only the ending marker of the latter type, which results
-   in incorrect ordering of `overlays_before'.
-
-   This function fixes ordering of overlays in the slot
-   `overlays_before' of the buffer *BP.  Before the insertion, `point'
-   was at PREV, and now is at POS.  */
+/* Move the boundaries of the overlays that lie in the text from START1
+   to END1 or from START2 to END2, where END1 <= START2, along with that
+   text when the two pieces swap places, in the current buffer and in
+   all the other buffers that share its text.  An overlay left
+   backwards becomes empty at its end.  */
 
 void
-fix_overlays_before (struct buffer *bp, ptrdiff_t prev, ptrdiff_t pos)
-{
-  /* If parent is nil, replace overlays_before; otherwise, parent->next.  */
-  struct Lisp_Overlay *tail = bp->overlays_before, *parent = NULL, *right_pair;
-  Lisp_Object tem;
-  ptrdiff_t end IF_LINT (= 0);
-
-  /* After the insertion, the several overlays may be in incorrect
-     order.  The possibility is that, in the list `overlays_before',
-     an overlay which ends at POS appears after an overlay which ends
-     at PREV.  Since POS is greater than PREV, we must fix the
-     ordering of these overlays, by moving overlays ends at POS before
-     the overlays ends at PREV.  */
-
-  /* At first, find a place where disordered overlays should be linked
-     in.  It is where an overlay which end before POS exists. (i.e. an
-     overlay whose ending marker is after-insertion-marker if disorder
-     exists).  */
-  while (tail
-	 && (XSETMISC (tem, tail),
-	     (end = OVERLAY_POSITION (OVERLAY_END (tem))) >= pos))
-    {
-      parent = tail;
-      tail = tail->next;
-    }
-
-  /* If we don't find such an overlay,
-     or the found one ends before PREV,
-     or the found one is the last one in the list,
-     we don't have to fix anything.  */
-  if (!tail || end < prev || !tail->next)
-    return;
-
-  right_pair = parent;
-  parent = tail;
-  tail = tail->next;
+transpose_overlays (ptrdiff_t start1, ptrdiff_t end1,
+		    ptrdiff_t start2, ptrdiff_t end2)
+{
+  struct buffer *base = (current_buffer->base_buffer
+			 ? current_buffer->base_buffer : current_buffer);
 
-  /* Now, end position of overlays in the list TAIL should be before
-     or equal to PREV.  In the loop, an overlay which ends at POS is
-     moved ahead to the place indicated by the CDR of RIGHT_PAIR.  If
-     we found an overlay which ends before PREV, the remaining
-     overlays are in correct order.  */
-  while (tail)
+  itree_transpose (&base->overlays, start1, end1, start2, end2);
+  if (base->indirections > 0)
     {
-      XSETMISC (tem, tail);
-      end = OVERLAY_POSITION (OVERLAY_END (tem));
-
-      if (end == pos)
-	{			/* This overlay is disordered. */
-	  struct Lisp_Overlay *found = tail;
-
-	  /* Unlink the found overlay.  */
-	  tail = found->next;
-	  parent->next = tail;
-	  /* Move an overlay at RIGHT_PLACE to the next of the found one,
-	     and link it into the right place.  */
-	  if (!right_pair)
-	    {
-	      found->next = bp->overlays_before;
-	      set_buffer_overlays_before (bp, found);
-	    }
-	  else
-	    {
-	      found->next = right_pair->next;
-	      right_pair->next = found;
-	    }
-	}
-      else if (end == prev)
-	{
-	  parent = tail;
-	  tail = tail->next;
-	}
-      else			/* No more disordered overlay. */
-	break;
+      struct buffer *b;
+
+      FOR_EACH_BUFFER (b)
+	if (b->base_buffer == base)
+	  itree_transpose (&b->overlays, start1, end1, start2, end2);
     }
 }
-
+
 DEFUN ("overlayp", Foverlayp, Soverlayp, 1, 1, 0,
        doc: /* Return t if OBJECT is an overlay.  */)
   (Lisp_Object object)
@@ -3865,33 +3482,14 @@ for the rear of the overlay advance when text is inserted there
     }
 
   b = XBUFFER (buffer);
+  if (! BUFFER_LIVE_P (b))
+    error ("Attempt to create an overlay in a dead buffer");
 
-  beg = Fset_marker (Fmake_marker (), beg, buffer);
-  end = Fset_marker (Fmake_marker (), end, buffer);
-
-  if (!NILP (front_advance))
-    XMARKER (beg)->insertion_type = 1;
-  if (!NILP (rear_advance))
-    XMARKER (end)->insertion_type = 1;
-
-  overlay = build_overlay (beg, end, Qnil);
-
-  /* Put the new overlay on the wrong list.  */
-  end = OVERLAY_END (overlay);
-  if (OVERLAY_POSITION (end) < b->overlay_center)
-    {
-      eassert (b->overlays_after || (XOVERLAY (overlay)->next == NULL));
-      XOVERLAY (overlay)->next = b->overlays_after;
-      set_buffer_overlays_after (b, XOVERLAY (overlay));
-    }
-  else
-    {
-      eassert (b->overlays_before || (XOVERLAY (overlay)->next == NULL));
-      XOVERLAY (overlay)->next = b->overlays_before;
-      set_buffer_overlays_before (b, XOVERLAY (overlay));
-    }
-  /* This puts it in the right list, and in the right order.  */
-  recenter_overlay_lists (b, b->overlay_center);
+  overlay = build_overlay (! NILP (front_advance), ! NILP (rear_advance),
+			   Qnil);
+  add_buffer_overlay (b, XOVERLAY (overlay),
+		      clip_to_bounds (BUF_BEG (b), XINT (beg), BUF_Z (b)),
+		      clip_to_bounds (BUF_BEG (b), XINT (end), BUF_Z (b)));
 
   /* We don't need to redisplay the region covered by the overlay, because
      the overlay has no properties at the moment.  */
@@ -3918,35 +3516,6 @@ modify_overlay (struct buffer *buf, ptrdiff_t start, ptrdiff_t end)
   ++BUF_OVERLAY_MODIFF (buf);
 }
 
-/* Remove OVERLAY from LIST.  */
-
-static struct Lisp_Overlay *
-unchain_overlay (struct Lisp_Overlay *list, struct Lisp_Overlay *overlay)
-{
-  register struct Lisp_Overlay *tail, **prev = &list;
-
-  for (tail = list; tail; prev = &tail->next, tail = *prev)
-    if (tail == overlay)
-      {
-	*prev = overlay->next;
-	overlay->next = NULL;
-	break;
-      }
-  return list;
-}
-
-/* Remove OVERLAY from both overlay lists of B.  */
-
-static void
-unchain_both (struct buffer *b, Lisp_Object overlay)
-{
-  struct Lisp_Overlay *ov = XOVERLAY (overlay);
-
-  set_buffer_overlays_before (b, unchain_overlay (b->overlays_before, ov));
-  set_buffer_overlays_after (b, unchain_overlay (b->overlays_after, ov));
-  eassert (XOVERLAY (overlay)->next == NULL);
-}
-
 DEFUN ("move-overlay", Fmove_overlay, Smove_overlay, 3, 4, 0,
        doc: /* Set the endpoints of OVERLAY to BEG and END in BUFFER.
 If BUFFER is omitted, leave OVERLAY in the same buffer it inhabits now.
@@ -3961,7 +3530,7 @@ buffer.  */)
 
   CHECK_OVERLAY (overlay);
   if (NILP (buffer))
-    buffer = Fmarker_buffer (OVERLAY_START (overlay));
+    buffer = Foverlay_buffer (overlay);
   if (NILP (buffer))
     XSETBUFFER (buffer, current_buffer);
   CHECK_BUFFER (buffer);
@@ -3985,25 +3554,30 @@ buffer.  */)
 
   specbind (Qinhibit_quit, Qt);
 
-  obuffer = Fmarker_buffer (OVERLAY_START (overlay));
+  obuffer = Foverlay_buffer (overlay);
   b = XBUFFER (buffer);
 
   if (!NILP (obuffer))
     {
       ob = XBUFFER (obuffer);
 
-      o_beg = OVERLAY_POSITION (OVERLAY_START (overlay));
-      o_end = OVERLAY_POSITION (OVERLAY_END (overlay));
-
-      unchain_both (ob, overlay);
+      o_beg = OVERLAY_START (overlay);
+      o_end = OVERLAY_END (overlay);
     }
 
   /* Set the overlay boundaries, which may clip them.  */
-  Fset_marker (OVERLAY_START (overlay), beg, buffer);
-  Fset_marker (OVERLAY_END (overlay), end, buffer);
+  n_beg = clip_to_bounds (BUF_BEG (b), XINT (beg), BUF_Z (b));
+  n_end = clip_to_bounds (BUF_BEG (b), XINT (end), BUF_Z (b));
 
-  n_beg = marker_position (OVERLAY_START (overlay));
-  n_end = marker_position (OVERLAY_END (overlay));
+  if (ob == b)
+    itree_node_set_region (&b->overlays, XOVERLAY (overlay)->interval,
+			   n_beg, n_end);
+  else
+    {
+      if (ob)
+	remove_buffer_overlay (ob, XOVERLAY (overlay));
+      add_buffer_overlay (b, XOVERLAY (overlay), n_beg, n_end);
+    }
 
   /* If the overlay has changed buffers, do a thorough redisplay.  */
   if (!EQ (buffer, obuffer))
@@ -4031,22 +3605,6 @@ buffer.  */)
   if (n_beg == n_end && !NILP (Foverlay_get (overlay, Qevaporate)))
     return unbind_to (count, Fdelete_overlay (overlay));
 
-  /* Put the overlay into the new buffer's overlay lists, first on the
-     wrong list.  */
-  if (n_end < b->overlay_center)
-    {
-      XOVERLAY (overlay)->next = b->overlays_after;
-      set_buffer_overlays_after (b, XOVERLAY (overlay));
-    }
-  else
-    {
-      XOVERLAY (overlay)->next = b->overlays_before;
-      set_buffer_overlays_before (b, XOVERLAY (overlay));
-    }
-
-  /* This puts it in the right list, and in the right order.  */
-  recenter_overlay_lists (b, b->overlay_center);
-
   return unbind_to (count, overlay);
 }
 
@@ -4054,20 +3612,17 @@ DEFUN ("delete-overlay", Fdelete_overlay, Sdelete_overlay, 1, 1, 0,
        doc: /* Delete the overlay OVERLAY from its buffer.  */)
   (Lisp_Object overlay)
 {
-  Lisp_Object buffer;
   struct buffer *b;
   ptrdiff_t count = SPECPDL_INDEX ();
 
   CHECK_OVERLAY (overlay);
 
-  buffer = Fmarker_buffer (OVERLAY_START (overlay));
-  if (NILP (buffer))
+  b = OVERLAY_BUFFER (overlay);
+  if (! b)
     return Qnil;
 
-  b = XBUFFER (buffer);
   specbind (Qinhibit_quit, Qt);
 
-  unchain_both (b, overlay);
   drop_overlay (b, XOVERLAY (overlay));
 
   /* When deleting an overlay with before or after strings, turn off
@@ -4110,7 +3665,9 @@ DEFUN ("overlay-start", Foverlay_start, Soverlay_start, 1, 1, 0,
 {
   CHECK_OVERLAY (overlay);
 
-  return (Fmarker_position (OVERLAY_START (overlay)));
+  if (! OVERLAY_BUFFER (overlay))
+    return Qnil;
+  return make_number (OVERLAY_START (overlay));
 }
 
 DEFUN ("overlay-end", Foverlay_end, Soverlay_end, 1, 1, 0,
@@ -4119,7 +3676,9 @@ DEFUN ("overlay-end", Foverlay_end, Soverlay_end, 1, 1, 0,
 {
   CHECK_OVERLAY (overlay);
 
-  return (Fmarker_position (OVERLAY_END (overlay)));
+  if (! OVERLAY_BUFFER (overlay))
+    return Qnil;
+  return make_number (OVERLAY_END (overlay));
 }
 
 DEFUN ("overlay-buffer", Foverlay_buffer, Soverlay_buffer, 1, 1, 0,
@@ -4127,9 +3686,14 @@ DEFUN ("overlay-buffer", Foverlay_buffer, Soverlay_buffer, 1, 1, 0,
 Return nil if OVERLAY has been deleted.  */)
   (Lisp_Object overlay)
 {
+  Lisp_Object buffer;
+
   CHECK_OVERLAY (overlay);
 
-  return Fmarker_buffer (OVERLAY_START (overlay));
+  if (! OVERLAY_BUFFER (overlay))
+    return Qnil;
+  XSETBUFFER (buffer, OVERLAY_BUFFER (overlay));
+  return buffer;
 }
 
 DEFUN ("overlay-properties", Foverlay_properties, Soverlay_properties, 1, 1, 0,
@@ -4197,8 +3761,7 @@ end of the buffer.  */)
 
   /* Put all the overlays we want in a vector in overlay_vec.
      Store the length in len.  */
-  noverlays = overlays_in (XINT (beg), XINT (end), 1, &overlay_vec, &len,
-			   NULL, NULL);
+  noverlays = overlays_in (XINT (beg), XINT (end), 1, &overlay_vec, &len);
 
   /* Make a list of them all.  */
   result = Flist (noverlays, overlay_vec);
@@ -4236,11 +3799,7 @@ the value is (point-max).  */)
      use its ending point instead.  */
   for (i = 0; i < noverlays; i++)
     {
-      Lisp_Object oend;
-      ptrdiff_t oendpos;
-
-      oend = OVERLAY_END (overlay_vec[i]);
-      oendpos = OVERLAY_POSITION (oend);
+      ptrdiff_t oendpos = OVERLAY_END (overlay_vec[i]);
       if (oendpos < endpos)
 	endpos = oendpos;
     }
@@ -4286,45 +3845,37 @@ the value is (point-min).  */)
 /* These functions are for debugging overlays.  */
 
 DEFUN ("overlay-lists", Foverlay_lists, Soverlay_lists, 0, 0, 0,
-       doc: /* Return a pair of lists giving all the overlays of the current buffer.
-The car has all the overlays before the overlay center;
-the cdr has all the overlays after the overlay center.
-Recentering overlays moves overlays between these lists.
-The lists you get are copies, so that changing them has no effect.
+       doc: /* Return a list giving all the overlays of the current buffer.
+For compatibility with older versions of Emacs, which kept the overlays
+in two lists, the value is a pair whose car is a list of all the
+overlays, in order of their start positions, and whose cdr is nil.
+The list you get is a copy, so that changing it has no effect.
 However, the overlays you get are the real objects that the buffer uses.  */)
   (void)
 {
-  struct Lisp_Overlay *ol;
-  Lisp_Object before = Qnil, after = Qnil, tmp;
+  struct itree_iterator iter;
+  struct itree_node *node;
+  Lisp_Object overlays = Qnil;
 
-  for (ol = current_buffer->overlays_before; ol; ol = ol->next)
-    {
-      XSETMISC (tmp, ol);
-      before = Fcons (tmp, before);
-    }
-  for (ol = current_buffer->overlays_after; ol; ol = ol->next)
-    {
-      XSETMISC (tmp, ol);
-      after = Fcons (tmp, after);
-    }
+  for (node = itree_iterator_start (&iter, &current_buffer->overlays,
+				    PTRDIFF_MIN, PTRDIFF_MAX);
+       node; node = itree_iterator_next (&iter))
+    overlays = Fcons (node->data, overlays);
 
-  return Fcons (Fnreverse (before), Fnreverse (after));
+  return Fcons (Fnreverse (overlays), Qnil);
 }
 
 DEFUN ("overlay-recenter", Foverlay_recenter, Soverlay_recenter, 1, 1, 0,
        doc: /* Recenter the overlays of the current buffer around position POS.
-That makes overlay lookup faster for positions near POS (but perhaps slower
-for positions far away from POS).  */)
+This does nothing: the overlays are kept in a tree that is as fast to
+search at any position.  It remains for compatibility with older
+versions of Emacs, in which it sped up overlay lookup near POS.  */)
   (Lisp_Object pos)
 {
-  ptrdiff_t p;
   CHECK_NUMBER_COERCE_MARKER (pos);
-
-  p = clip_to_bounds (PTRDIFF_MIN, XINT (pos), PTRDIFF_MAX);
-  recenter_overlay_lists (current_buffer, p);
   return Qnil;
 }
-
+
 DEFUN ("overlay-get", Foverlay_get, Soverlay_get, 2, 2, 0,
        doc: /* Get the property of overlay OVERLAY with property name PROP.  */)
   (Lisp_Object overlay, Lisp_Object prop)
@@ -4343,7 +3894,7 @@ VALUE will be returned.*/)
 
   CHECK_OVERLAY (overlay);
 
-  buffer = Fmarker_buffer (OVERLAY_START (overlay));
+  buffer = Foverlay_buffer (overlay);
 
   for (tail = XOVERLAY (overlay)->plist;
        CONSP (tail) && CONSP (XCDR (tail));
@@ -4363,11 +3914,9 @@ VALUE will be returned.*/)
     {
       if (changed)
 	modify_overlay (XBUFFER (buffer),
-			marker_position (OVERLAY_START (overlay)),
-			marker_position (OVERLAY_END   (overlay)));
+			OVERLAY_START (overlay), OVERLAY_END (overlay));
       if (EQ (prop, Qevaporate) && ! NILP (value)
-	  && (OVERLAY_POSITION (OVERLAY_START (overlay))
-	      == OVERLAY_POSITION (OVERLAY_END (overlay))))
+	  && OVERLAY_START (overlay) == OVERLAY_END (overlay))
 	Fdelete_overlay (overlay);
     }
 
@@ -4426,13 +3975,13 @@ report_overlay_modification (Lisp_Object start, Lisp_Object end, bool after,
 			     Lisp_Object arg1, Lisp_Object arg2, Lisp_Object arg3)
 {
   Lisp_Object prop, overlay;
-  struct Lisp_Overlay *tail;
+  struct itree_iterator iter;
+  struct itree_node *node;
   /* True if this change is an insertion.  */
   bool insertion = (after ? XFASTINT (arg3) == 0 : EQ (start, end));
   struct gcpro gcpro1, gcpro2, gcpro3, gcpro4;
 
   overlay = Qnil;
-  tail = NULL;
 
   /* We used to run the functions as soon as we found them and only register
      them in last_overlay_modification_hooks for the purpose of the `after'
@@ -4447,56 +3996,13 @@ report_overlay_modification (Lisp_Object start, Lisp_Object end, bool after,
       /* We are being called before a change.
 	 Scan the overlays to find the functions to call.  */
       last_overlay_modification_hooks_used = 0;
-      for (tail = current_buffer->overlays_before; tail; tail = tail->next)
-	{
-	  ptrdiff_t startpos, endpos;
-	  Lisp_Object ostart, oend;
-
-	  XSETMISC (overlay, tail);
-
-	  ostart = OVERLAY_START (overlay);
-	  oend = OVERLAY_END (overlay);
-	  endpos = OVERLAY_POSITION (oend);
-	  if (XFASTINT (start) > endpos)
-	    break;
-	  startpos = OVERLAY_POSITION (ostart);
-	  if (insertion && (XFASTINT (start) == startpos
-			    || XFASTINT (end) == startpos))
-	    {
-	      prop = Foverlay_get (overlay, Qinsert_in_front_hooks);
-	      if (!NILP (prop))
-		add_overlay_mod_hooklist (prop, overlay);
-	    }
-	  if (insertion && (XFASTINT (start) == endpos
-			    || XFASTINT (end) == endpos))
-	    {
-	      prop = Foverlay_get (overlay, Qinsert_behind_hooks);
-	      if (!NILP (prop))
-		add_overlay_mod_hooklist (prop, overlay);
-	    }
-	  /* Test for intersecting intervals.  This does the right thing
-	     for both insertion and deletion.  */
-	  if (XFASTINT (end) > startpos && XFASTINT (start) < endpos)
-	    {
-	      prop = Foverlay_get (overlay, Qmodification_hooks);
-	      if (!NILP (prop))
-		add_overlay_mod_hooklist (prop, overlay);
-	    }
-	}
-
-      for (tail = current_buffer->overlays_after; tail; tail = tail->next)
+      for (node = itree_iterator_start (&iter, &current_buffer->overlays,
+					XFASTINT (start), XFASTINT (end));
+	   node; node = itree_iterator_next (&iter))
 	{
-	  ptrdiff_t startpos, endpos;
-	  Lisp_Object ostart, oend;
-
-	  XSETMISC (overlay, tail);
+	  ptrdiff_t startpos = node->begin, endpos = node->end;
 
-	  ostart = OVERLAY_START (overlay);
-	  oend = OVERLAY_END (overlay);
-	  startpos = OVERLAY_POSITION (ostart);
-	  endpos = OVERLAY_POSITION (oend);
-	  if (XFASTINT (end) < startpos)
-	    break;
+	  overlay = node->data;
 	  if (insertion && (XFASTINT (start) == startpos
 			    || XFASTINT (end) == startpos))
 	    {
@@ -4571,34 +4077,17 @@ call_overlay_mod_hooks (Lisp_Object list, Lisp_Object overlay, bool after,
 void
 evaporate_overlays (ptrdiff_t pos)
 {
-  Lisp_Object overlay, hit_list;
-  struct Lisp_Overlay *tail;
+  Lisp_Object hit_list;
+  struct itree_iterator iter;
+  struct itree_node *node;
 
   hit_list = Qnil;
-  if (pos <= current_buffer->overlay_center)
-    for (tail = current_buffer->overlays_before; tail; tail = tail->next)
-      {
-	ptrdiff_t endpos;
-	XSETMISC (overlay, tail);
-	endpos = OVERLAY_POSITION (OVERLAY_END (overlay));
-	if (endpos < pos)
-	  break;
-	if (endpos == pos && OVERLAY_POSITION (OVERLAY_START (overlay)) == pos
-	    && ! NILP (Foverlay_get (overlay, Qevaporate)))
-	  hit_list = Fcons (overlay, hit_list);
-      }
-  else
-    for (tail = current_buffer->overlays_after; tail; tail = tail->next)
-      {
-	ptrdiff_t startpos;
-	XSETMISC (overlay, tail);
-	startpos = OVERLAY_POSITION (OVERLAY_START (overlay));
-	if (startpos > pos)
-	  break;
-	if (startpos == pos && OVERLAY_POSITION (OVERLAY_END (overlay)) == pos
-	    && ! NILP (Foverlay_get (overlay, Qevaporate)))
-	  hit_list = Fcons (overlay, hit_list);
-      }
+  for (node = itree_iterator_start (&iter, &current_buffer->overlays,
+				    pos, pos);
+       node; node = itree_iterator_next (&iter))
+    if (node->begin == pos && node->end == pos
+	&& ! NILP (Foverlay_get (node->data, Qevaporate)))
+      hit_list = Fcons (node->data, hit_list);
   for (; CONSP (hit_list); hit_list = XCDR (hit_list))
     Fdelete_overlay (XCAR (hit_list));
 }
@@ -5105,6 +4594,8 @@ free_buffer_text (struct buffer *b)
 #endif
 
   BUF_BEG_ADDR (b) = NULL;
+  free_pos_index (b);
+  free_newline_index (b);
   unblock_input ();
 }
 
@@ -5164,9 +4655,7 @@ init_buffer_once (void)
   bset_mark_active (&buffer_defaults, Qnil);
   bset_file_format (&buffer_defaults, Qnil);
   bset_auto_save_file_format (&buffer_defaults, Qt);
-  set_buffer_overlays_before (&buffer_defaults, NULL);
-  set_buffer_overlays_after (&buffer_defaults, NULL);
-  buffer_defaults.overlay_center = BEG;
+  itree_init (&buffer_defaults.overlays);
 
   XSETFASTINT (BVAR (&buffer_defaults, tab_width), 8);
   bset_truncate_lines (&buffer_defaults, Qnil);
@@ -21,6 +21,8 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 #include <sys/types.h>
 #include <time.h>
 
+#include "itree.h"
+
 INLINE_HEADER_BEGIN
 
 /* Accessing the parameters of the current buffer.  */
@@ -186,8 +188,8 @@ INLINE_HEADER_BEGIN
 /* Compaction count.  */
 #define BUF_COMPACT(buf) ((buf)->text->compact)
 
-/* Marker chain of buffer.  */
-#define BUF_MARKERS(buf) ((buf)->text->markers)
+/* Marker tree of buffer.  */
+#define BUF_MARKERS(buf) (&(buf)->text->markers)
 
 #define BUF_UNCHANGED_MODIFIED(buf) \
   ((buf)->text->unchanged_modified)
@@ -321,6 +323,13 @@ extern void enlarge_buffer_text (struct buffer *, ptrdiff_t);
 
 #define GAP_BYTES_MIN 20
 
+/* Extra space to reserve when the gap of a buffer of SIZE bytes has
+   to grow.  Making it proportional to the size of large buffers means
+   that a run of insertions into them reallocates the text, and moves
+   the text after the gap, only a logarithmic number of times.  */
+
+#define GAP_BYTES_SLACK(size) max (GAP_BYTES_DFL, (size) / 16)
+
 /* Return the address of byte position N in current buffer.  */
 
 #define BYTE_POS_ADDR(n) \
@@ -463,14 +472,21 @@ struct buffer_text
     /* Properties of this buffer's text.  */
     INTERVAL intervals;
 
-    /* The markers that refer to this buffer.
-       This is actually a single marker ---
-       successive elements in its marker `chain'
-       are the other markers referring to this buffer.
-       This is a singly linked unordered list, which means that it's
-       very cheap to add a marker to the list and it's also very cheap
-       to move a marker within a buffer.  */
-    struct Lisp_Marker *markers;
+    /* The markers that refer to this text, in this buffer or in its
+       indirect buffers, as empty intervals of an interval tree.  An
+       insertion or deletion only visits the markers at the positions
+       it changes, plus O(log N) others, and removing a marker takes
+       O(log N) steps.  */
+    struct itree_tree markers;
+
+    /* The index used to convert between character and byte positions
+       in this text, or NULL if none has been needed since it last
+       changed multibyteness.  See marker.c.  */
+    struct pos_index *pos_index;
+
+    /* The index used to count the newlines of this text, or NULL if
+       none has been needed yet.  See search.c.  */
+    struct newline_index *newline_index;
 
     /* Usually false.  Temporarily true in decode_coding_gap to
        prevent Fgarbage_collect from shrinking the gap and losing
@@ -847,6 +863,10 @@ struct buffer
   struct region_cache *width_run_cache;
   struct region_cache *bidi_paragraph_cache;
 
+  /* The checkpoints of `syntax-ppss', or NULL if there are none yet.
+     Like the caches above, they are kept in the base buffer.  */
+  struct ppss_cache *ppss_cache;
+
   /* Non-zero means don't use redisplay optimizations for
      displaying this buffer.  */
   bool_bf prevent_redisplay_optimizations_p : 1;
@@ -854,16 +874,29 @@ struct buffer
   /* Non-zero whenever the narrowing is changed in this buffer.  */
   bool_bf clip_changed : 1;
 
-  /* List of overlays that end at or before the current center,
-     in order of end-position.  */
-  struct Lisp_Overlay *overlays_before;
-
-  /* List of overlays that end after  the current center,
-     in order of start-position.  */
-  struct Lisp_Overlay *overlays_after;
-
-  /* Position where the overlay lists are centered.  */
-  ptrdiff_t overlay_center;
+  /* The overlays of this buffer, in an interval tree.  */
+  struct itree_tree overlays;
+
+  /* The changes recorded for undo since `buffer-undo-list' was last
+     looked at, or NULL if there are none.  They belong in front of
+     the undo list below, which must then not be t.  See undo.c.  */
+  struct undo_journal *undo_journal;
+
+  /* The bindings in local_var_alist above, indexed by the `slot' of
+     their variables, so that finding the binding of a variable takes
+     constant time.  Entries for variables that have no binding in
+     this buffer are nil.  LOCAL_VAR_CELLS_SIZE is the number of
+     entries.  LOCAL_FWD_CELLS lists the LOCAL_FWD_CELLS_COUNT bindings
+     among them of variables that forward into C variables, which must
+     be loaded whenever the buffer becomes current.  These tables are
+     only meaningful while LOCAL_VAR_CELLS_VALID is true; otherwise they
+     are built again from the alist when needed.  The alist protects
+     the bindings from GC.  See data.c.  */
+  Lisp_Object *local_var_cells;
+  ptrdiff_t local_var_cells_size;
+  Lisp_Object *local_fwd_cells;
+  ptrdiff_t local_fwd_cells_count, local_fwd_cells_size;
+  bool_bf local_var_cells_valid : 1;
 
   /* Changes in the buffer are recorded here for undo, and t means
      don't record anything.  This information belongs to the base
@@ -940,6 +973,7 @@ INLINE void
 bset_local_var_alist (struct buffer *b, Lisp_Object val)
 {
   b->INTERNAL_FIELD (local_var_alist) = val;
+  b->local_var_cells_valid = 0;
 }
 INLINE void
 bset_mark_active (struct buffer *b, Lisp_Object val)
@@ -964,6 +998,9 @@ bset_truncate_lines (struct buffer *b, Lisp_Object val)
 INLINE void
 bset_undo_list (struct buffer *b, Lisp_Object val)
 {
+  /* The changes in the undo journal go with the list they precede.  */
+  if (b->undo_journal)
+    free_undo_journal (b);
   b->INTERNAL_FIELD (undo_list) = val;
 }
 INLINE void
@@ -1074,14 +1111,12 @@ extern void evaporate_overlays (ptrdiff_t);
 extern ptrdiff_t overlays_at (EMACS_INT, bool, Lisp_Object **,
 			      ptrdiff_t *, ptrdiff_t *, ptrdiff_t *, bool);
 extern ptrdiff_t sort_overlays (Lisp_Object *, ptrdiff_t, struct window *);
-extern void recenter_overlay_lists (struct buffer *, ptrdiff_t);
 extern ptrdiff_t overlay_strings (ptrdiff_t, struct window *, unsigned char **);
 extern void validate_region (Lisp_Object *, Lisp_Object *);
 extern void set_buffer_internal_1 (struct buffer *);
 extern void set_buffer_temp (struct buffer *);
 extern Lisp_Object buffer_local_value_1 (Lisp_Object, Lisp_Object);
 extern void record_buffer (Lisp_Object);
-extern void fix_overlays_before (struct buffer *, ptrdiff_t, ptrdiff_t);
 extern void mmap_set_vars (bool);
 extern void restore_buffer (Lisp_Object);
 extern void set_buffer_if_live (Lisp_Object);
@@ -1165,7 +1200,7 @@ set_buffer_intervals (struct buffer *b, INTERVAL i)
 INLINE bool
 buffer_has_overlays (void)
 {
-  return current_buffer->overlays_before || current_buffer->overlays_after;
+  return current_buffer->overlays.root != NULL;
 }
 
 /* Return character code of multi-byte form at byte position POS.  If POS
@@ -1214,25 +1249,65 @@ buffer_window_count (struct buffer *b)
   return b->window_count;
 }
 
+/* Markers */
+
+/* Return the character position of marker M, which points somewhere.  */
+
+INLINE ptrdiff_t
+marker_charpos (struct Lisp_Marker *m)
+{
+  return itree_node_begin (BUF_MARKERS (m->buffer), m->node);
+}
+
+/* Return the byte position of marker M, which points somewhere.  */
+
+INLINE ptrdiff_t
+marker_bytepos (struct Lisp_Marker *m)
+{
+  return buf_charpos_to_bytepos (m->buffer, marker_charpos (m));
+}
+
 /* Overlays */
 
-/* Return the marker that stands for where OV starts in the buffer.  */
+/* Return the buffer OV is in, or null if it has been deleted.  */
+
+INLINE struct buffer *
+OVERLAY_BUFFER (Lisp_Object ov)
+{
+  return XOVERLAY (ov)->buffer;
+}
 
-#define OVERLAY_START(OV) XOVERLAY (OV)->start
+/* Return the position where OV starts in its buffer, or -1 if it has
+   been deleted.  */
 
-/* Return the marker that stands for where OV ends in the buffer.  */
+INLINE ptrdiff_t
+OVERLAY_START (Lisp_Object ov)
+{
+  struct buffer *b = OVERLAY_BUFFER (ov);
+  return b ? itree_node_begin (&b->overlays, XOVERLAY (ov)->interval) : -1;
+}
 
-#define OVERLAY_END(OV) XOVERLAY (OV)->end
+/* Return the position where OV ends in its buffer, or -1 if it has
+   been deleted.  */
 
-/* Return the plist of overlay OV.  */
+INLINE ptrdiff_t
+OVERLAY_END (Lisp_Object ov)
+{
+  struct buffer *b = OVERLAY_BUFFER (ov);
+  return b ? itree_node_end (&b->overlays, XOVERLAY (ov)->interval) : -1;
+}
 
-#define OVERLAY_PLIST(OV) XOVERLAY (OV)->plist
+/* Return true if the start of OV moves past text inserted there.  */
+
+#define OVERLAY_FRONT_ADVANCE_P(OV) (XOVERLAY (OV)->interval->front_advance)
 
-/* Return the actual buffer position for the marker P.
-   We assume you know which buffer it's pointing into.  */
+/* Return true if the end of OV moves past text inserted there.  */
 
-#define OVERLAY_POSITION(P) \
- (MARKERP (P) ? marker_position (P) : (emacs_abort (), 0))
+#define OVERLAY_REAR_ADVANCE_P(OV) (XOVERLAY (OV)->interval->rear_advance)
+
+/* Return the plist of overlay OV.  */
+
+#define OVERLAY_PLIST(OV) XOVERLAY (OV)->plist
 
 
 /***********************************************************************
@@ -1324,19 +1399,35 @@ set_per_buffer_default (int offset, Lisp_Object value)
   *(Lisp_Object *)(offset + (char *) &buffer_defaults) = value;
 }
 
+/* Return the undo list of buffer B, including the changes still in
+   its undo journal.  Code that looks at the elements of the list must
+   get it this way; BVAR (B, undo_list) is good only for comparing it
+   with t.  */
+
+INLINE Lisp_Object
+buffer_undo_list (struct buffer *b)
+{
+  return b->undo_journal ? flush_undo_journal (b) : BVAR (b, undo_list);
+}
+
 /* Functions to get and set buffer-local value of the per-buffer
    variable at offset OFFSET in the buffer structure.  */
 
 INLINE Lisp_Object
 per_buffer_value (struct buffer *b, int offset)
 {
+  if (offset == PER_BUFFER_VAR_OFFSET (undo_list))
+    return buffer_undo_list (b);
   return *(Lisp_Object *)(offset + (char *) b);
 }
 
 INLINE void
 set_per_buffer_value (struct buffer *b, int offset, Lisp_Object value)
 {
-  *(Lisp_Object *)(offset + (char *) b) = value;
+  if (offset == PER_BUFFER_VAR_OFFSET (undo_list))
+    bset_undo_list (b, value);
+  else
+    *(Lisp_Object *)(offset + (char *) b) = value;
 }
 
 /* Downcase a character C, or make no change if that cannot be done.  */
@@ -298,7 +298,7 @@ At the end, it runs `post-self-insert-hook'.  */)
     }
 
   if (remove_boundary
-      && CONSP (BVAR (current_buffer, undo_list))
+      && CONSP (buffer_undo_list (current_buffer))
       && NILP (XCAR (BVAR (current_buffer, undo_list)))
       /* Only remove auto-added boundaries, not boundaries
 	 added be explicit calls to undo-boundary.  */
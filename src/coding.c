@@ -7363,7 +7363,7 @@ decode_coding (struct coding_system *coding)
       if (MODIFF <= SAVE_MODIFF)
 	record_first_change ();
 
-      undo_list = BVAR (current_buffer, undo_list);
+      undo_list = buffer_undo_list (current_buffer);
       bset_undo_list (current_buffer, Qt);
     }
 
@@ -7997,6 +7997,70 @@ decode_coding_gap (struct coding_system *coding,
 }
 
 
+/* Flag the markers of the current buffer that are to be put back at
+   the edges of the text from FROM to TO once it is replaced by its
+   conversion: those at FROM that advance, and those at TO that do not.
+   Return true if there are any.  */
+
+static bool
+flag_markers_for_conversion (ptrdiff_t from, ptrdiff_t to)
+{
+  struct itree_iterator iter;
+  struct itree_node *node;
+  bool flagged = 0;
+
+  for (node = itree_iterator_start (&iter, BUF_MARKERS (current_buffer),
+				    from, to);
+       node; node = itree_iterator_next (&iter))
+    {
+      struct Lisp_Marker *tail = XMARKER (node->data);
+
+      tail->need_adjustment
+	= node->begin == (tail->insertion_type ? from : to);
+      flagged |= tail->need_adjustment;
+    }
+  return flagged;
+}
+
+/* Put the markers flagged by flag_markers_for_conversion at the edges
+   of the text that CODING produced at FROM.  */
+
+static void
+adjust_flagged_markers (struct coding_system *coding, ptrdiff_t from)
+{
+  struct itree_tree *markers = BUF_MARKERS (current_buffer);
+  struct itree_iterator iter;
+  struct itree_node *node, **nodes;
+  ptrdiff_t to = (NILP (BVAR (current_buffer, enable_multibyte_characters))
+		  ? from + coding->produced : from + coding->produced_char);
+  ptrdiff_t i, n = 0;
+  USE_SAFE_ALLOCA;
+
+  /* The flagged markers were all in the converted text, so they are
+     now in the text that replaced it.  Moving them changes the tree,
+     so collect them first.  */
+  for (node = itree_iterator_start (&iter, markers, from, to);
+       node; node = itree_iterator_next (&iter))
+    n += XMARKER (node->data)->need_adjustment;
+  if (n == 0)
+    return;
+  SAFE_NALLOCA (nodes, 1, n);
+  for (i = 0, node = itree_iterator_start (&iter, markers, from, to);
+       node; node = itree_iterator_next (&iter))
+    if (XMARKER (node->data)->need_adjustment)
+      nodes[i++] = node;
+
+  for (i = 0; i < n; i++)
+    {
+      struct Lisp_Marker *tail = XMARKER (nodes[i]->data);
+      ptrdiff_t pos = tail->insertion_type ? from : to;
+
+      tail->need_adjustment = 0;
+      itree_node_set_region (markers, nodes[i], pos, pos);
+    }
+  SAFE_FREE ();
+}
+
 /* Decode the text in the range FROM/FROM_BYTE and TO/TO_BYTE in
    SRC_OBJECT into DST_OBJECT by coding context CODING.
 
@@ -8068,14 +8132,7 @@ decode_coding_object (struct coding_system *coding,
 	move_gap_both (from, from_byte);
       if (EQ (src_object, dst_object))
 	{
-	  struct Lisp_Marker *tail;
-
-	  for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-	    {
-	      tail->need_adjustment
-		= tail->charpos == (tail->insertion_type ? from : to);
-	      need_marker_adjustment |= tail->need_adjustment;
-	    }
+	  need_marker_adjustment = flag_markers_for_conversion (from, to);
 	  saved_pt = PT, saved_pt_byte = PT_BYTE;
 	  TEMP_SET_PT_BOTH (from, from_byte);
 	  current_buffer->text->inhibit_shrinking = 1;
@@ -8182,27 +8239,7 @@ decode_coding_object (struct coding_system *coding,
 			  saved_pt_byte + (coding->produced - bytes));
 
       if (need_marker_adjustment)
-	{
-	  struct Lisp_Marker *tail;
-
-	  for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-	    if (tail->need_adjustment)
-	      {
-		tail->need_adjustment = 0;
-		if (tail->insertion_type)
-		  {
-		    tail->bytepos = from_byte;
-		    tail->charpos = from;
-		  }
-		else
-		  {
-		    tail->bytepos = from_byte + coding->produced;
-		    tail->charpos
-		      = (NILP (BVAR (current_buffer, enable_multibyte_characters))
-			 ? tail->bytepos : from + coding->produced_char);
-		  }
-	      }
-	}
+	adjust_flagged_markers (coding, from);
     }
 
   Vdeactivate_mark = old_deactivate_mark;
@@ -8236,16 +8273,7 @@ encode_coding_object (struct coding_system *coding,
   attrs = CODING_ID_ATTRS (coding->id);
 
   if (EQ (src_object, dst_object))
-    {
-      struct Lisp_Marker *tail;
-
-      for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-	{
-	  tail->need_adjustment
-	    = tail->charpos == (tail->insertion_type ? from : to);
-	  need_marker_adjustment |= tail->need_adjustment;
-	}
-    }
+    need_marker_adjustment = flag_markers_for_conversion (from, to);
 
   if (! NILP (CODING_ATTR_PRE_WRITE (attrs)))
     {
@@ -8388,27 +8416,7 @@ encode_coding_object (struct coding_system *coding,
 			  saved_pt_byte + (coding->produced - bytes));
 
       if (need_marker_adjustment)
-	{
-	  struct Lisp_Marker *tail;
-
-	  for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-	    if (tail->need_adjustment)
-	      {
-		tail->need_adjustment = 0;
-		if (tail->insertion_type)
-		  {
-		    tail->bytepos = from_byte;
-		    tail->charpos = from;
-		  }
-		else
-		  {
-		    tail->bytepos = from_byte + coding->produced;
-		    tail->charpos
-		      = (NILP (BVAR (current_buffer, enable_multibyte_characters))
-			 ? tail->bytepos : from + coding->produced_char);
-		  }
-	      }
-	}
+	adjust_flagged_markers (coding, from);
     }
 
   if (kill_src_buffer)
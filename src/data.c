@@ -87,7 +87,7 @@ Lisp_Object Qfont_spec, Qfont_entity, Qfont_object;
 static Lisp_Object Qdefun;
 
 Lisp_Object Qinteractive_form;
-static Lisp_Object Qdefalias_fset_function;
+Lisp_Object Qdefalias_fset_function;
 
 static void swap_in_symval_forwarding (struct Lisp_Symbol *, struct Lisp_Buffer_Local_Value *);
 
@@ -1045,6 +1045,115 @@ store_symval_forwarding (union Lisp_Fwd *valcontents, register Lisp_Object newva
     }
 }
 
+/* Make sure the table of buffer-local bindings of buffer B has an
+   entry for SLOT.  */
+
+static void
+grow_local_var_cells (struct buffer *b, ptrdiff_t slot)
+{
+  ptrdiff_t i = b->local_var_cells_size;
+
+  if (slot < i)
+    return;
+  b->local_var_cells = xpalloc (b->local_var_cells, &b->local_var_cells_size,
+				slot + 1 - i, -1, sizeof *b->local_var_cells);
+  for (; i < b->local_var_cells_size; i++)
+    b->local_var_cells[i] = Qnil;
+}
+
+/* Add BINDING to the forwarded bindings of buffer B.  */
+
+static void
+add_local_fwd_cell (struct buffer *b, Lisp_Object binding)
+{
+  if (b->local_fwd_cells_count == b->local_fwd_cells_size)
+    b->local_fwd_cells = xpalloc (b->local_fwd_cells, &b->local_fwd_cells_size,
+				  1, -1, sizeof *b->local_fwd_cells);
+  b->local_fwd_cells[b->local_fwd_cells_count++] = binding;
+}
+
+/* Build the tables of the buffer-local bindings of buffer B again from
+   its local_var_alist.  */
+
+static void
+index_local_var_cells (struct buffer *b)
+{
+  Lisp_Object tail;
+  ptrdiff_t i;
+
+  for (i = 0; i < b->local_var_cells_size; i++)
+    b->local_var_cells[i] = Qnil;
+  b->local_fwd_cells_count = 0;
+
+  for (tail = BVAR (b, local_var_alist); CONSP (tail); tail = XCDR (tail))
+    {
+      Lisp_Object elt = XCAR (tail);
+      struct Lisp_Symbol *sym = XSYMBOL (XCAR (elt));
+
+      if (sym->redirect == SYMBOL_LOCALIZED)
+	{
+	  ptrdiff_t slot = SYMBOL_BLV (sym)->slot;
+
+	  grow_local_var_cells (b, slot);
+	  /* As with `assq', the first binding in the alist counts.  */
+	  if (NILP (b->local_var_cells[slot]))
+	    {
+	      b->local_var_cells[slot] = elt;
+	      if (SYMBOL_BLV (sym)->fwd)
+		add_local_fwd_cell (b, elt);
+	    }
+	}
+    }
+  b->local_var_cells_valid = 1;
+}
+
+/* Return the binding in buffer B of the variable whose value cell is
+   BLV, that is, its element of B's local_var_alist, or nil if the
+   variable is not local in B.  This takes constant time, unless the
+   alist changed in other ways than by adding bindings since the last
+   time, in which case it takes time proportional to its length.  */
+
+Lisp_Object
+buffer_local_binding (struct buffer *b, struct Lisp_Buffer_Local_Value *blv)
+{
+  if (!b->local_var_cells_valid)
+    index_local_var_cells (b);
+  return (blv->slot < b->local_var_cells_size
+	  ? b->local_var_cells[blv->slot] : Qnil);
+}
+
+/* Return the number of bindings in buffer B of variables that
+   forward into C variables, which are the first elements of
+   B->local_fwd_cells.  */
+
+ptrdiff_t
+buffer_local_fwd_bindings (struct buffer *b)
+{
+  if (!b->local_var_cells_valid)
+    index_local_var_cells (b);
+  return b->local_fwd_cells_count;
+}
+
+/* Give buffer B the new buffer-local BINDING for the variable whose
+   value cell is BLV.  */
+
+static void
+add_local_binding (struct buffer *b, struct Lisp_Buffer_Local_Value *blv,
+		   Lisp_Object binding)
+{
+  bool valid = b->local_var_cells_valid;
+
+  bset_local_var_alist (b, Fcons (binding, BVAR (b, local_var_alist)));
+  if (valid)
+    {
+      grow_local_var_cells (b, blv->slot);
+      b->local_var_cells[blv->slot] = binding;
+      if (blv->fwd)
+	add_local_fwd_cell (b, binding);
+      b->local_var_cells_valid = 1;
+    }
+}
+
 /* Set up SYMBOL to refer to its global binding.  This makes it safe
    to alter the status of other bindings.  BEWARE: this may be called
    during the mark phase of GC, where we assume that Lisp_Object slots
@@ -1106,7 +1215,7 @@ swap_in_symval_forwarding (struct Lisp_Symbol *symbol, struct Lisp_Buffer_Local_
 	  }
 	else
 	  {
-	    tem1 = assq_no_quit (var, BVAR (current_buffer, local_var_alist));
+	    tem1 = buffer_local_binding (current_buffer, blv);
 	    set_blv_where (blv, Fcurrent_buffer ());
 	  }
       }
@@ -1241,10 +1350,9 @@ set_internal (Lisp_Object symbol, Lisp_Object newval, Lisp_Object where,
 
 	    /* Find the new binding.  */
 	    XSETSYMBOL (symbol, sym); /* May have changed via aliasing.  */
-	    tem1 = Fassq (symbol,
-			  (blv->frame_local
-			   ? XFRAME (where)->param_alist
-			   : BVAR (XBUFFER (where), local_var_alist)));
+	    tem1 = (blv->frame_local
+		    ? Fassq (symbol, XFRAME (where)->param_alist)
+		    : buffer_local_binding (XBUFFER (where), blv));
 	    set_blv_where (blv, where);
 	    blv->found = 1;
 
@@ -1275,9 +1383,7 @@ set_internal (Lisp_Object symbol, Lisp_Object newval, Lisp_Object where,
 		       bindings, not for frame-local bindings.  */
 		    eassert (!blv->frame_local);
 		    tem1 = Fcons (symbol, XCDR (blv->defcell));
-		    bset_local_var_alist
-		      (XBUFFER (where),
-		       Fcons (tem1, BVAR (XBUFFER (where), local_var_alist)));
+		    add_local_binding (XBUFFER (where), blv, tem1);
 		  }
 	      }
 
@@ -1512,6 +1618,25 @@ usage: (setq-default [VAR VALUE]...)  */)
 
 /* Lisp functions for creating and removing buffer-local variables.  */
 
+/* The number of slots given to variables with buffer-local bindings
+   so far, and the slots of the variables freed since then, which can
+   be given again.  */
+static ptrdiff_t blv_slots;
+static ptrdiff_t *free_blv_slots;
+static ptrdiff_t free_blv_slots_count, free_blv_slots_size;
+
+/* Free BLV, the value cell of a symbol that is no longer used.  */
+
+void
+free_blv (struct Lisp_Buffer_Local_Value *blv)
+{
+  if (free_blv_slots_count == free_blv_slots_size)
+    free_blv_slots = xpalloc (free_blv_slots, &free_blv_slots_size, 1, -1,
+			      sizeof *free_blv_slots);
+  free_blv_slots[free_blv_slots_count++] = blv->slot;
+  xfree (blv);
+}
+
 union Lisp_Val_Fwd
   {
     Lisp_Object value;
@@ -1542,6 +1667,8 @@ make_blv (struct Lisp_Symbol *sym, bool forwarded,
   set_blv_defcell (blv, tem);
   set_blv_valcell (blv, tem);
   set_blv_found (blv, 0);
+  blv->slot = (free_blv_slots_count
+	       ? free_blv_slots[--free_blv_slots_count] : blv_slots++);
   return blv;
 }
 
@@ -1702,7 +1829,7 @@ Instead, use `add-hook' and specify t for the LOCAL argument.  */)
 
   /* Make sure this buffer has its own value of symbol.  */
   XSETSYMBOL (variable, sym);	/* Update in case of aliasing.  */
-  tem = Fassq (variable, BVAR (current_buffer, local_var_alist));
+  tem = buffer_local_binding (current_buffer, blv);
   if (NILP (tem))
     {
       if (let_shadows_buffer_binding_p (sym))
@@ -1714,10 +1841,8 @@ Instead, use `add-hook' and specify t for the LOCAL argument.  */)
 	 default value.  */
       find_symbol_value (variable);
 
-      bset_local_var_alist
-	(current_buffer,
-	 Fcons (Fcons (variable, XCDR (blv->defcell)),
-		BVAR (current_buffer, local_var_alist)));
+      add_local_binding (current_buffer, blv,
+			 Fcons (variable, XCDR (blv->defcell)));
 
       /* Make sure symbol does not think it is set up for this buffer;
 	 force it to look once again for this buffer's value.  */
@@ -1781,7 +1906,7 @@ From now on the default value will apply in this buffer.  Return VARIABLE.  */)
 
   /* Get rid of this buffer's alist element, if any.  */
   XSETSYMBOL (variable, sym);	/* Propagate variable indirection.  */
-  tem = Fassq (variable, BVAR (current_buffer, local_var_alist));
+  tem = buffer_local_binding (current_buffer, blv);
   if (!NILP (tem))
     bset_local_var_alist
       (current_buffer,
@@ -1905,23 +2030,17 @@ BUFFER defaults to the current buffer.  */)
     case SYMBOL_PLAINVAL: return Qnil;
     case SYMBOL_LOCALIZED:
       {
-	Lisp_Object tail, elt, tmp;
+	Lisp_Object tmp;
 	struct Lisp_Buffer_Local_Value *blv = SYMBOL_BLV (sym);
 	XSETBUFFER (tmp, buf);
-	XSETSYMBOL (variable, sym); /* Update in case of aliasing.  */
 
 	if (EQ (blv->where, tmp)) /* The binding is already loaded.  */
 	  return blv_found (blv) ? Qt : Qnil;
-	else
-	  for (tail = BVAR (buf, local_var_alist); CONSP (tail); tail = XCDR (tail))
-	    {
-	      elt = XCAR (tail);
-	      if (EQ (variable, XCAR (elt)))
-		{
-		  eassert (!blv->frame_local);
-		  return Qt;
-		}
-	    }
+	else if (!NILP (buffer_local_binding (buf, blv)))
+	  {
+	    eassert (!blv->frame_local);
+	    return Qt;
+	  }
 	return Qnil;
       }
     case SYMBOL_FORWARDED:
@@ -42,6 +42,126 @@ static ptrdiff_t get_doc_string_buffer_size;
 
 static unsigned char *read_bytecode_pointer;
 
+/* Offsets of the ^_ that starts each entry of the DOC file, in
+   increasing order, followed by the size of the file.  This is filled
+   in by Snarf-documentation, so that a docstring can be fetched from
+   the DOC file with a single read of exactly the right size.  */
+static EMACS_INT *doc_index;
+static ptrdiff_t doc_index_size;
+static ptrdiff_t doc_index_used;
+
+/* Descriptor for the DOC file, kept open between calls to
+   get_doc_string, and the name under which it was opened.  */
+static int doc_fd;
+static char *doc_fd_name;
+
+/* Recently fetched docstrings from the DOC file, most recently used
+   first.  Each entry takes two slots: the position, then the string.
+   The strings are never handed out, only copies of them, since the
+   callers may modify the docstrings they get.  */
+#define DOC_CACHE_SIZE 64
+static Lisp_Object doc_cache;
+
+/* Return a copy of the cached docstring for POSITION in the DOC file,
+   or nil.  */
+
+static Lisp_Object
+doc_cache_lookup (EMACS_INT position)
+{
+  ptrdiff_t i;
+
+  for (i = 0; i < DOC_CACHE_SIZE; i++)
+    {
+      Lisp_Object key = AREF (doc_cache, 2 * i);
+      if (NILP (key))
+	break;
+      if (XINT (key) == position)
+	{
+	  Lisp_Object doc = AREF (doc_cache, 2 * i + 1);
+	  for (; i > 0; i--)
+	    {
+	      ASET (doc_cache, 2 * i, AREF (doc_cache, 2 * i - 2));
+	      ASET (doc_cache, 2 * i + 1, AREF (doc_cache, 2 * i - 1));
+	    }
+	  ASET (doc_cache, 0, key);
+	  ASET (doc_cache, 1, doc);
+	  return Fcopy_sequence (doc);
+	}
+    }
+  return Qnil;
+}
+
+/* Remember a copy of DOC as the docstring at POSITION in the DOC file,
+   discarding the least recently used entry if the cache is full.  */
+
+static void
+doc_cache_store (EMACS_INT position, Lisp_Object doc)
+{
+  ptrdiff_t i;
+
+  for (i = DOC_CACHE_SIZE - 1; i > 0; i--)
+    {
+      ASET (doc_cache, 2 * i, AREF (doc_cache, 2 * i - 2));
+      ASET (doc_cache, 2 * i + 1, AREF (doc_cache, 2 * i - 1));
+    }
+  ASET (doc_cache, 0, make_number (position));
+  ASET (doc_cache, 1, Fcopy_sequence (doc));
+}
+
+/* Read the DOC file entry that contains the docstring at POSITION
+   from FD into get_doc_string_buffer, using doc_index to read exactly
+   that entry.  Set *OFFSET to the offset of the docstring in the
+   buffer, and *END to its end.  Return false if the index does not
+   cover POSITION or the file does not match the index.  */
+
+static bool
+read_indexed_doc (int fd, EMACS_INT position, int *offset, char **end)
+{
+  ptrdiff_t lo = 0, hi = doc_index_used - 1;
+  ptrdiff_t want, nread;
+  EMACS_INT start, limit;
+  bool last;
+
+  if (doc_index_used < 2
+      || position <= doc_index[0] || doc_index[hi] <= position)
+    return 0;
+
+  /* Find the last entry that starts before POSITION.  */
+  while (hi - lo > 1)
+    {
+      ptrdiff_t mid = lo + (hi - lo) / 2;
+      if (doc_index[mid] < position)
+	lo = mid;
+      else
+	hi = mid;
+    }
+  start = doc_index[lo];
+  limit = doc_index[hi];
+  if (INT_MAX - 1 < limit - start)
+    return 0;
+
+  /* Read the ^_ that starts the next entry too, as a consistency
+     check, unless this is the last entry in the file.  */
+  last = hi == doc_index_used - 1;
+  want = limit - start + !last;
+  if (get_doc_string_buffer_size <= want)
+    get_doc_string_buffer
+      = xpalloc (get_doc_string_buffer, &get_doc_string_buffer_size,
+		 want + 1 - get_doc_string_buffer_size, -1, 1);
+
+  if (TYPE_MAXIMUM (off_t) < start || lseek (fd, start, 0) < 0)
+    return 0;
+  nread = emacs_read (fd, get_doc_string_buffer, want);
+  if (nread != want || get_doc_string_buffer[0] != '\037'
+      || (!last && get_doc_string_buffer[want - 1] != '\037'))
+    return 0;
+
+  *offset = position - start;
+  *end = get_doc_string_buffer + (limit - start);
+  **end = 0;
+  return 1;
+}
+
 /* `readchar' in lread.c calls back here to fetch the next byte.
    If UNREADFLAG is 1, we unread a byte.  */
 
@@ -102,6 +222,13 @@ get_doc_string (Lisp_Object filepos, bool unibyte, bool definition)
 
   position = eabs (XINT (pos));
 
+  if (INTEGERP (filepos) && !unibyte && !definition)
+    {
+      tem = doc_cache_lookup (position);
+      if (STRINGP (tem))
+	return tem;
+    }
+
   if (!STRINGP (Vdoc_directory))
     return Qnil;
 
@@ -129,7 +256,20 @@ get_doc_string (Lisp_Object filepos, bool unibyte, bool definition)
       name = SSDATA (file);
     }
 
-  fd = emacs_open (name, O_RDONLY, 0);
+  count = SPECPDL_INDEX ();
+  if (INTEGERP (filepos) && 0 <= doc_fd && !strcmp (name, doc_fd_name))
+    fd = doc_fd;
+  else
+    fd = emacs_open (name, O_RDONLY, 0);
+  if (0 <= fd && fd != doc_fd && INTEGERP (filepos))
+    {
+      /* Keep the DOC file open for the next docstring.  */
+      if (0 <= doc_fd)
+	emacs_close (doc_fd);
+      xfree (doc_fd_name);
+      doc_fd = fd;
+      doc_fd_name = xstrdup (name);
+    }
   if (fd < 0)
     {
 #ifndef CANNOT_DUMP
@@ -150,8 +290,11 @@ get_doc_string (Lisp_Object filepos, bool unibyte, bool definition)
 			  file, build_string ("\"\n"));
 	}
     }
-  count = SPECPDL_INDEX ();
-  record_unwind_protect_int (close_file_unwind, fd);
+  if (fd != doc_fd)
+    record_unwind_protect_int (close_file_unwind, fd);
+
+  if (fd == doc_fd && read_indexed_doc (fd, position, &offset, &p))
+    goto read_done;
 
   /* Seek only to beginning of disk block.  */
   /* Make sure we read at least 1024 bytes before `position'
@@ -206,6 +349,7 @@ get_doc_string (Lisp_Object filepos, bool unibyte, bool definition)
 	}
       p += nread;
     }
+ read_done:
   unbind_to (count, Qnil);
   SAFE_FREE ();
 
@@ -287,9 +431,12 @@ Invalid data in documentation file -- %c followed by code %03o",
 	= multibyte_chars_in_text (((unsigned char *) get_doc_string_buffer
 				    + offset),
 				   to - (get_doc_string_buffer + offset));
-      return make_string_from_bytes (get_doc_string_buffer + offset,
-				     nchars,
-				     to - (get_doc_string_buffer + offset));
+      tem = make_string_from_bytes (get_doc_string_buffer + offset,
+				    nchars,
+				    to - (get_doc_string_buffer + offset));
+      if (INTEGERP (filepos))
+	doc_cache_store (position, tem);
+      return tem;
     }
 }
 
@@ -554,6 +701,7 @@ the same file name is found in the `doc-directory'.  */)
   char buf[1024 + 1];
   int filled;
   EMACS_INT pos;
+  ptrdiff_t nentries;
   Lisp_Object sym;
   char *p, *name;
   bool skip_file = 0;
@@ -608,6 +756,15 @@ the same file name is found in the `doc-directory'.  */)
   count = SPECPDL_INDEX ();
   record_unwind_protect_int (close_file_unwind, fd);
   Vdoc_file_name = filename;
+
+  /* The file may have changed since we last read from it.  */
+  if (0 <= doc_fd)
+    emacs_close (doc_fd);
+  doc_fd = -1;
+  Ffillarray (doc_cache, Qnil);
+  doc_index_used = 0;
+  nentries = 0;
+
   filled = 0;
   pos = 0;
   while (1)
@@ -624,6 +781,11 @@ the same file name is found in the `doc-directory'.  */)
       /* p points to ^_Ffunctionname\n or ^_Vvarname\n or ^_Sfilename\n.  */
       if (p)
 	{
+	  if (doc_index_size <= nentries + 1)
+	    doc_index = xpalloc (doc_index, &doc_index_size, 1, -1,
+				 sizeof *doc_index);
+	  doc_index[nentries++] = pos + p - buf;
+
 	  end = strchr (p, '\n');
 
           /* See if this is a file name, and if it is a file in build-files.  */
@@ -685,6 +847,11 @@ the same file name is found in the `doc-directory'.  */)
       filled -= end - buf;
       memmove (buf, end, filled);
     }
+  if (doc_index_size <= nentries)
+    doc_index = xpalloc (doc_index, &doc_index_size, 1, -1,
+			 sizeof *doc_index);
+  doc_index[nentries++] = pos;
+  doc_index_used = nentries;
   return unbind_to (count, Qnil);
 }
 
@@ -951,11 +1118,22 @@ Otherwise, return a new string, without any text properties.  */)
   RETURN_UNGCPRO (tem);
 }
 
+void
+init_doc (void)
+{
+  /* A descriptor inherited from the dumping Emacs is not open here.  */
+  doc_fd = -1;
+}
+
 void
 syms_of_doc (void)
 {
   DEFSYM (Qfunction_documentation, "function-documentation");
 
+  doc_fd = -1;
+  doc_cache = Fmake_vector (make_number (2 * DOC_CACHE_SIZE), Qnil);
+  staticpro (&doc_cache);
+
   DEFVAR_LISP ("internal-doc-file-name", Vdoc_file_name,
 	       doc: /* Name of file containing documentation strings of built-in symbols.  */);
   Vdoc_file_name = Qnil;
@@ -298,46 +298,18 @@ If you set the marker not to point anywhere, the buffer will have no mark.  */)
 static ptrdiff_t
 overlays_around (EMACS_INT pos, Lisp_Object *vec, ptrdiff_t len)
 {
-  Lisp_Object overlay, start, end;
-  struct Lisp_Overlay *tail;
-  ptrdiff_t startpos, endpos;
+  struct itree_iterator iter;
+  struct itree_node *node;
   ptrdiff_t idx = 0;
 
-  for (tail = current_buffer->overlays_before; tail; tail = tail->next)
+  for (node = itree_iterator_start (&iter, &current_buffer->overlays,
+				    pos, pos);
+       node; node = itree_iterator_next (&iter))
     {
-      XSETMISC (overlay, tail);
-
-      end = OVERLAY_END (overlay);
-      endpos = OVERLAY_POSITION (end);
-      if (endpos < pos)
-	  break;
-      start = OVERLAY_START (overlay);
-      startpos = OVERLAY_POSITION (start);
-      if (startpos <= pos)
-	{
-	  if (idx < len)
-	    vec[idx] = overlay;
-	  /* Keep counting overlays even if we can't return them all.  */
-	  idx++;
-	}
-    }
-
-  for (tail = current_buffer->overlays_after; tail; tail = tail->next)
-    {
-      XSETMISC (overlay, tail);
-
-      start = OVERLAY_START (overlay);
-      startpos = OVERLAY_POSITION (start);
-      if (pos < startpos)
-	break;
-      end = OVERLAY_END (overlay);
-      endpos = OVERLAY_POSITION (end);
-      if (pos <= endpos)
-	{
-	  if (idx < len)
-	    vec[idx] = overlay;
-	  idx++;
-	}
+      if (idx < len)
+	vec[idx] = node->data;
+      /* Keep counting overlays even if we can't return them all.  */
+      idx++;
     }
 
   return idx;
@@ -399,11 +371,10 @@ at POSITION.  */)
 	  if (!NILP (tem))
 	    {
 	      /* Check the overlay is indeed active at point.  */
-	      Lisp_Object start = OVERLAY_START (ol), finish = OVERLAY_END (ol);
-	      if ((OVERLAY_POSITION (start) == posn
-		   && XMARKER (start)->insertion_type == 1)
-		  || (OVERLAY_POSITION (finish) == posn
-		      && XMARKER (finish)->insertion_type == 0))
+	      if ((OVERLAY_START (ol) == posn
+		   && OVERLAY_FRONT_ADVANCE_P (ol))
+		  || (OVERLAY_END (ol) == posn
+		      && ! OVERLAY_REAR_ADVANCE_P (ol)))
 		; /* The overlay will not cover a char inserted at point.  */
 	      else
 		{
@@ -818,6 +789,63 @@ This function does not move point.  */)
 			      Qnil, Qt, Qnil);
 }
 
+DEFUN ("line-number-at-pos", Fline_number_at_pos, Sline_number_at_pos,
+       0, 2, 0,
+       doc: /* Return the buffer line number at position POS.
+If POS is nil, use the current buffer location.
+Counting starts at (point-min), so the value refers to the contents of
+the accessible portion of the buffer, and POS is taken to be in that
+portion.  If ABSOLUTE is non-nil, ignore any narrowing, and count from
+the beginning of the buffer.
+
+In a large buffer, this takes a time proportional to the logarithm of
+the number of its lines, wherever POS is.  See also `position-of-line'.  */)
+  (Lisp_Object pos, Lisp_Object absolute)
+{
+  ptrdiff_t start = BEGV, start_byte = BEGV_BYTE, end = ZV;
+  ptrdiff_t charpos, shortage, count;
+
+  if (!NILP (absolute))
+    start = BEG, start_byte = BEG_BYTE, end = Z;
+  if (NILP (pos))
+    charpos = PT;
+  else
+    {
+      CHECK_NUMBER_COERCE_MARKER (pos);
+      charpos = clip_to_bounds (start, XINT (pos), end);
+    }
+
+  /* Look for more newlines than there can be, to count them all.  */
+  count = charpos - start + 1;
+  find_newline (start, start_byte, charpos, -1, count, &shortage, NULL, 1);
+  return make_number (count - shortage + 1);
+}
+
+DEFUN ("position-of-line", Fposition_of_line, Sposition_of_line, 1, 2, 0,
+       doc: /* Return the position of the beginning of line LINE.
+Lines are numbered from 1 at (point-min), or at the beginning of the
+buffer if ABSOLUTE is non-nil, as `line-number-at-pos' does.  If LINE
+is less than 1, return the beginning of the first line; if there are
+fewer than LINE lines, return the end of the last one.
+
+In a large buffer, this takes a time proportional to the logarithm of
+the number of its lines, whatever LINE is.  */)
+  (Lisp_Object line, Lisp_Object absolute)
+{
+  ptrdiff_t start = BEGV, start_byte = BEGV_BYTE;
+  ptrdiff_t end = ZV, end_byte = ZV_BYTE;
+
+  CHECK_NUMBER (line);
+  if (!NILP (absolute))
+    start = BEG, start_byte = BEG_BYTE, end = Z, end_byte = Z_BYTE;
+  if (XINT (line) <= 1 || start == end)
+    return make_number (start);
+  return make_number (find_newline (start, start_byte, end, end_byte,
+				    clip_to_bounds (1, XINT (line) - 1,
+						    PTRDIFF_MAX),
+				    NULL, NULL, 1));
+}
+
 /* Save current buffer state for `save-excursion' special form.
    We (ab)use Lisp_Misc_Save_Value to allow explicit free and so
    offload some work from GC.  */
@@ -2883,7 +2911,7 @@ Both characters must have the same length of multi-byte form.  */)
   if (!changed && !NILP (noundo))
     {
       record_unwind_protect (subst_char_in_region_unwind,
-			     BVAR (current_buffer, undo_list));
+			     buffer_undo_list (current_buffer));
       bset_undo_list (current_buffer, Qt);
       /* Don't do file-locking.  */
       record_unwind_protect (subst_char_in_region_unwind_1,
@@ -2951,7 +2979,7 @@ Both characters must have the same length of multi-byte form.  */)
 
 	      struct gcpro gcpro1;
 
-	      tem = BVAR (current_buffer, undo_list);
+	      tem = buffer_undo_list (current_buffer);
 	      GCPRO1 (tem);
 
 	      /* Make a multibyte string containing this single character.  */
@@ -3345,21 +3373,26 @@ save_restriction_restore (Lisp_Object data)
       eassert (buf == end->buffer);
 
       if (buf /* Verify marker still points to a buffer.  */
-	  && (beg->charpos != BUF_BEGV (buf) || end->charpos != BUF_ZV (buf)))
+	  && (marker_charpos (beg) != BUF_BEGV (buf)
+	      || marker_charpos (end) != BUF_ZV (buf)))
 	/* The restriction has changed from the saved one, so restore
 	   the saved restriction.  */
 	{
 	  ptrdiff_t pt = BUF_PT (buf);
+	  ptrdiff_t beg_charpos = marker_charpos (beg);
+	  ptrdiff_t end_charpos = marker_charpos (end);
+	  ptrdiff_t beg_bytepos = marker_bytepos (beg);
+	  ptrdiff_t end_bytepos = marker_bytepos (end);
 
-	  SET_BUF_BEGV_BOTH (buf, beg->charpos, beg->bytepos);
-	  SET_BUF_ZV_BOTH (buf, end->charpos, end->bytepos);
+	  SET_BUF_BEGV_BOTH (buf, beg_charpos, beg_bytepos);
+	  SET_BUF_ZV_BOTH (buf, end_charpos, end_bytepos);
 
-	  if (pt < beg->charpos || pt > end->charpos)
+	  if (pt < beg_charpos || pt > end_charpos)
 	    /* The point is outside the new visible range, move it inside. */
 	    SET_BUF_PT_BOTH (buf,
-			     clip_to_bounds (beg->charpos, pt, end->charpos),
-			     clip_to_bounds (beg->bytepos, BUF_PT_BYTE (buf),
-					     end->bytepos));
+			     clip_to_bounds (beg_charpos, pt, end_charpos),
+			     clip_to_bounds (beg_bytepos, BUF_PT_BYTE (buf),
+					     end_bytepos));
 
 	  buf->clip_changed = 1; /* Remember that the narrowing changed. */
 	}
@@ -4401,9 +4434,8 @@ Case is ignored if `case-fold-search' is non-nil in the current buffer.  */)
    START2, END2 are the character positions of the second region.
    START2_BYTE, END2_BYTE are the byte positions.
 
-   Traverses the entire marker list of the buffer to do so, adding an
-   appropriate amount to some, subtracting from some, and leaving the
-   rest untouched.  Most of this is copied from adjust_markers in insdel.c.
+   Only the markers from START1 to END2 are visited; the marker tree
+   moves them as a block, region by region.
 
    It's the caller's job to ensure that START1 <= END1 <= START2 <= END2.  */
 
@@ -4413,9 +4445,6 @@ transpose_markers (ptrdiff_t start1, ptrdiff_t end1,
 		   ptrdiff_t start1_byte, ptrdiff_t end1_byte,
 		   ptrdiff_t start2_byte, ptrdiff_t end2_byte)
 {
-  register ptrdiff_t amt1, amt1_byte, amt2, amt2_byte, diff, diff_byte, mpos;
-  register struct Lisp_Marker *marker;
-
   /* Update point as if it were a marker.  */
   if (PT < start1)
     ;
@@ -4430,50 +4459,7 @@ transpose_markers (ptrdiff_t start1, ptrdiff_t end1,
     TEMP_SET_PT_BOTH (PT - (start2 - start1),
 		      PT_BYTE - (start2_byte - start1_byte));
 
-  /* We used to adjust the endpoints here to account for the gap, but that
-     isn't good enough.  Even if we assume the caller has tried to move the
-     gap out of our way, it might still be at start1 exactly, for example;
-     and that places it `inside' the interval, for our purposes.  The amount
-     of adjustment is nontrivial if there's a `denormalized' marker whose
-     position is between GPT and GPT + GAP_SIZE, so it's simpler to leave
-     the dirty work to Fmarker_position, below.  */
-
-  /* The difference between the region's lengths */
-  diff = (end2 - start2) - (end1 - start1);
-  diff_byte = (end2_byte - start2_byte) - (end1_byte - start1_byte);
-
-  /* For shifting each marker in a region by the length of the other
-     region plus the distance between the regions.  */
-  amt1 = (end2 - start2) + (start2 - end1);
-  amt2 = (end1 - start1) + (start2 - end1);
-  amt1_byte = (end2_byte - start2_byte) + (start2_byte - end1_byte);
-  amt2_byte = (end1_byte - start1_byte) + (start2_byte - end1_byte);
-
-  for (marker = BUF_MARKERS (current_buffer); marker; marker = marker->next)
-    {
-      mpos = marker->bytepos;
-      if (mpos >= start1_byte && mpos < end2_byte)
-	{
-	  if (mpos < end1_byte)
-	    mpos += amt1_byte;
-	  else if (mpos < start2_byte)
-	    mpos += diff_byte;
-	  else
-	    mpos -= amt2_byte;
-	  marker->bytepos = mpos;
-	}
-      mpos = marker->charpos;
-      if (mpos >= start1 && mpos < end2)
-	{
-	  if (mpos < end1)
-	    mpos += amt1;
-	  else if (mpos < start2)
-	    mpos += diff;
-	  else
-	    mpos -= amt2;
-	}
-      marker->charpos = mpos;
-    }
+  itree_transpose (BUF_MARKERS (current_buffer), start1, end1, start2, end2);
 }
 
 DEFUN ("transpose-regions", Ftranspose_regions, Stranspose_regions, 4, 5, 0,
@@ -4646,6 +4632,15 @@ Transposing beyond buffer boundaries is an error.  */)
                                    len1, current_buffer, 0);
       graft_intervals_into_buffer (tmp_interval2, start1,
                                    len2, current_buffer, 0);
+      /* The characters of the text between START1 and END2 have
+	 moved around; the position and newline indexes only keep
+	 their sums.  */
+      adjust_pos_index_for_delete (start1, start1_byte, end2, end2_byte);
+      adjust_pos_index_for_insert (start1, end2 - start1,
+				   end2_byte - start1_byte);
+      adjust_newline_index_for_delete (start1_byte, end2_byte);
+      adjust_newline_index_for_insert (start1_byte, end2_byte - start1_byte);
+
       update_compositions (start1, start1 + len2, CHECK_BORDER);
       update_compositions (start1 + len2, end2, CHECK_TAIL);
     }
@@ -4754,6 +4749,12 @@ Transposing beyond buffer boundaries is an error.  */)
                                        len2, current_buffer, 0);
         }
 
+      adjust_pos_index_for_delete (start1, start1_byte, end2, end2_byte);
+      adjust_pos_index_for_insert (start1, end2 - start1,
+				   end2_byte - start1_byte);
+      adjust_newline_index_for_delete (start1_byte, end2_byte);
+      adjust_newline_index_for_insert (start1_byte, end2_byte - start1_byte);
+
       update_compositions (start1, start1 + len2, CHECK_BORDER);
       update_compositions (end2 - len1, end2, CHECK_BORDER);
     }
@@ -4766,7 +4767,7 @@ Transposing beyond buffer boundaries is an error.  */)
       transpose_markers (start1, end1, start2, end2,
 			 start1_byte, start1_byte + len1_byte,
 			 start2_byte, start2_byte + len2_byte);
-      fix_start_end_in_overlays (start1, end2);
+      transpose_overlays (start1, end1, start2, end2);
     }
 
   signal_after_change (start1, end2 - start1, end2 - start1);
@@ -4851,6 +4852,8 @@ functions if all the text being accessed has this property.  */);
 
   defsubr (&Sline_beginning_position);
   defsubr (&Sline_end_position);
+  defsubr (&Sline_number_at_pos);
+  defsubr (&Sposition_of_line);
 
   defsubr (&Ssave_excursion);
   defsubr (&Ssave_current_buffer);
@@ -96,7 +96,7 @@ extern void moncontrol (int mode);
 #include <locale.h>
 #endif
 
-#ifdef HAVE_SETRLIMIT
+#if defined HAVE_SETRLIMIT || defined HAVE_GETRUSAGE
 #include <sys/time.h>
 #include <sys/resource.h>
 #endif
@@ -696,6 +696,210 @@ close_output_streams (void)
      _exit (EXIT_FAILURE);
 }
 
+/* Startup tracing.  When the environment variable EMACS_STARTUP_TRACE
+   is set, each phase of `main', each call to `load' and each call to
+   `startup-trace-call' is recorded in startup_trace_entries, in the
+   order in which they begin, until top_level_1 has run the startup
+   code and clears startup_trace.  */
+
+bool startup_trace;
+
+struct startup_trace_entry
+{
+  /* What is being timed, as a C string allocated with xmalloc.  */
+  char *name;
+
+  /* Index of the entry that was running when this one began, or -1.  */
+  ptrdiff_t parent;
+
+  /* True if this entry has finished.  */
+  bool done;
+
+  /* Wall clock time, CPU time, number of garbage collections and bytes
+     allocated when the entry began and, if DONE, when it ended.  */
+  struct timespec wall[2], cpu[2];
+  EMACS_INT gcs[2], bytes[2];
+};
+
+static struct startup_trace_entry *startup_trace_entries;
+static ptrdiff_t startup_trace_size;
+static ptrdiff_t startup_trace_used;
+
+/* Index of the innermost running entry, or -1.  */
+static ptrdiff_t startup_trace_current;
+
+/* Index of the running phase of `main', or -1.  */
+static ptrdiff_t startup_trace_main_phase;
+
+static struct timespec
+startup_trace_cpu_time (void)
+{
+#ifdef HAVE_GETRUSAGE
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) == 0)
+    return timespec_add (make_timespec (usage.ru_utime.tv_sec,
+					usage.ru_utime.tv_usec * 1000),
+			 make_timespec (usage.ru_stime.tv_sec,
+					usage.ru_stime.tv_usec * 1000));
+#endif
+  return make_timespec (0, 0);
+}
+
+/* Return the number of bytes of Lisp data allocated so far, from the
+   counters that `memory-use-counts' reports.  */
+
+static EMACS_INT
+startup_trace_bytes (void)
+{
+  return (cons_cells_consed * sizeof (struct Lisp_Cons)
+	  + floats_consed * sizeof (struct Lisp_Float)
+	  + vector_cells_consed * word_size
+	  + symbols_consed * sizeof (struct Lisp_Symbol)
+	  + string_chars_consed
+	  + misc_objects_consed * sizeof (union Lisp_Misc)
+	  + intervals_consed * sizeof (struct interval)
+	  + strings_consed * sizeof (struct Lisp_String));
+}
+
+static void
+startup_trace_sample (struct startup_trace_entry *e, int i)
+{
+  e->wall[i] = current_timespec ();
+  e->cpu[i] = startup_trace_cpu_time ();
+  e->gcs[i] = gcs_done;
+  e->bytes[i] = startup_trace_bytes ();
+}
+
+/* Start timing NAME, nested in the innermost running entry.  */
+
+void
+startup_trace_begin (char const *name)
+{
+  struct startup_trace_entry *e;
+
+  if (startup_trace_used == startup_trace_size)
+    startup_trace_entries
+      = xpalloc (startup_trace_entries, &startup_trace_size, 1, -1,
+		 sizeof *startup_trace_entries);
+  e = &startup_trace_entries[startup_trace_used];
+  e->name = xstrdup (name);
+  e->parent = startup_trace_current;
+  e->done = 0;
+  startup_trace_current = startup_trace_used++;
+  startup_trace_sample (e, 0);
+}
+
+/* Stop timing the innermost running entry.  */
+
+void
+startup_trace_end (void)
+{
+  struct startup_trace_entry *e;
+
+  if (startup_trace_current < 0)
+    return;
+  e = &startup_trace_entries[startup_trace_current];
+  startup_trace_sample (e, 1);
+  e->done = 1;
+  startup_trace_current = e->parent;
+}
+
+/* End the running phase of `main', if any, and start timing NAME as
+   the next one.  If NAME is null, just end the running phase.  */
+
+static void
+startup_trace_phase (char const *name)
+{
+  if (!startup_trace)
+    return;
+  if (0 <= startup_trace_main_phase)
+    while (startup_trace_main_phase <= startup_trace_current)
+      startup_trace_end ();
+  startup_trace_main_phase = -1;
+  if (name)
+    {
+      startup_trace_begin (name);
+      startup_trace_main_phase = startup_trace_current;
+    }
+}
+
+DEFUN ("startup-trace", Fstartup_trace, Sstartup_trace, 0, 0, 0,
+       doc: /* Return the startup trace, or nil if it was not recorded.
+Emacs records the trace when the environment variable
+EMACS_STARTUP_TRACE is set when it starts.  The trace covers each
+phase of Emacs's C initialization, each call to `load', and each call
+to `startup-trace-call', until `normal-top-level' returns and Emacs
+enters its command loop.  It is kept after that, but no longer grows.
+
+The value is a list of nodes, one for each outermost entry, in the
+order in which they began.  Each node has the form
+
+  (NAME WALL-TIME CPU-TIME GCS BYTES . CHILDREN)
+
+NAME is a string: the name of the phase, or the name of the file that
+was loaded.  WALL-TIME and CPU-TIME are the elapsed real time and CPU
+time in seconds, GCS is the number of garbage collections and BYTES
+the number of bytes of Lisp data allocated.  These include the
+entries nested within this one, which are listed in CHILDREN, a list
+of nodes of the same form.  For an entry that has not finished, the
+values are measured up to now.  */)
+  (void)
+{
+  Lisp_Object nodes, top = Qnil;
+  struct startup_trace_entry now;
+  ptrdiff_t i;
+
+  if (startup_trace_used == 0)
+    return Qnil;
+
+  startup_trace_sample (&now, 1);
+  nodes = Fmake_vector (make_number (startup_trace_used), Qnil);
+
+  /* Children begin after their parent, so going backward completes
+     each entry's list of children before the entry itself is seen.  */
+  for (i = startup_trace_used - 1; 0 <= i; i--)
+    {
+      struct startup_trace_entry *e = &startup_trace_entries[i];
+      struct startup_trace_entry *end = e->done ? e : &now;
+      struct timespec cpu = timespec_sub (end->cpu[1], e->cpu[0]);
+      Lisp_Object node
+	= Fcons (make_number (end->bytes[1] - e->bytes[0]), AREF (nodes, i));
+
+      /* The CPU time of a daemon restarts from zero when it forks.  */
+      if (timespec_sign (cpu) < 0)
+	cpu = make_timespec (0, 0);
+
+      node = Fcons (make_number (end->gcs[1] - e->gcs[0]), node);
+      node = Fcons (make_float (timespectod (cpu)), node);
+      node = Fcons (make_float (timespectod (timespec_sub (end->wall[1],
+							   e->wall[0]))),
+		    node);
+      node = Fcons (build_string (e->name), node);
+      if (e->parent < 0)
+	top = Fcons (node, top);
+      else
+	ASET (nodes, e->parent, Fcons (node, AREF (nodes, e->parent)));
+    }
+  return top;
+}
+
+DEFUN ("startup-trace-call", Fstartup_trace_call, Sstartup_trace_call,
+       2, 2, 0,
+       doc: /* Call FUNCTION with no arguments, timing it as NAME.
+If Emacs is recording the startup trace, add an entry named NAME for
+the call.  See `startup-trace'.  Return the value of FUNCTION.  */)
+  (Lisp_Object name, Lisp_Object function)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+
+  CHECK_STRING (name);
+  if (!startup_trace)
+    return call0 (function);
+  startup_trace_begin (SSDATA (name));
+  record_unwind_protect_void (startup_trace_end);
+  return unbind_to (count, call0 (function));
+}
+
 /* ARGSUSED */
 int
 main (int argc, char **argv)
@@ -725,6 +929,15 @@ main (int argc, char **argv)
   stack_base = &dummy;
 #endif
 
+  /* Discard any trace inherited from the dumping Emacs.  init_alloc
+     resets the count of garbage collections too, but do it now so that
+     the trace does not see the count go down.  */
+  startup_trace = getenv ("EMACS_STARTUP_TRACE") != 0;
+  startup_trace_used = 0;
+  startup_trace_current = startup_trace_main_phase = -1;
+  gcs_done = 0;
+  startup_trace_phase ("init: early");
+
 #ifdef G_SLICE_ALWAYS_MALLOC
   /* This is used by the Cygwin build.  It's not needed starting with
      cygwin-1.7.24, but it doesn't do any harm.  */
@@ -1155,6 +1368,8 @@ Using an Emacs configured with --with-x-toolkit=lucid does not have this problem
 
   init_signals (dumping);
 
+  startup_trace_phase ("init: Lisp data");
+
   noninteractive1 = noninteractive;
 
   /* Perform basic initializations (not merely interning symbols).  */
@@ -1349,6 +1564,8 @@ Using an Emacs configured with --with-x-toolkit=lucid does not have this problem
   init_ntproc (dumping); /* must precede init_editfns.  */
 #endif
 
+  startup_trace_phase ("init: environment");
+
   /* Initialize and GC-protect Vinitial_environment and
      Vprocess_environment before set_initial_environment fills them
      in.  */
@@ -1388,6 +1605,7 @@ Using an Emacs configured with --with-x-toolkit=lucid does not have this problem
   init_callproc ();	/* Must follow init_cmdargs but not init_sys_modes.  */
   init_fileio ();
   init_lread ();
+  init_doc ();
 #ifdef WINDOWSNT
   /* Check to see if Emacs has been installed correctly.  */
   check_windows_init_file ();
@@ -1396,6 +1614,8 @@ Using an Emacs configured with --with-x-toolkit=lucid does not have this problem
   /* Intern the names of all standard functions and variables;
      define standard keys.  */
 
+  startup_trace_phase ("init: symbols");
+
   if (!initialized)
     {
       /* The basic levels of Lisp must come first.  Note that
@@ -1549,17 +1769,23 @@ Using an Emacs configured with --with-x-toolkit=lucid does not have this problem
 #endif
     }
 
+  startup_trace_phase ("init: keyboard and processes");
+
   init_charset ();
 
   init_editfns (); /* init_process_emacs uses Voperating_system_release. */
   init_process_emacs (); /* init_display uses add_keyboard_wait_descriptor. */
   init_keyboard ();	/* This too must precede init_sys_modes.  */
   if (!noninteractive)
-    init_display ();	/* Determine terminal type.  Calls init_sys_modes.  */
+    {
+      startup_trace_phase ("init: display");
+      init_display ();	/* Determine terminal type.  Calls init_sys_modes.  */
+    }
 #if HAVE_W32NOTIFY
   else
     init_crit ();	/* w32notify.c needs this in batch mode.  */
 #endif	/* HAVE_W32NOTIFY */
+  startup_trace_phase ("init: windows");
   init_xdisp ();
 #ifdef HAVE_WINDOW_SYSTEM
   init_fringe ();
@@ -1642,6 +1868,8 @@ Using an Emacs configured with --with-x-toolkit=lucid does not have this problem
   tzset ();
 #endif /* defined (LOCALTIME_CACHE) */
 
+  startup_trace_phase (NULL);
+
   /* Enter editor command loop.  This never returns.  */
   Frecursive_edit ();
   /* NOTREACHED */
@@ -2422,6 +2650,8 @@ syms_of_emacs (void)
   defsubr (&Sinvocation_directory);
   defsubr (&Sdaemonp);
   defsubr (&Sdaemon_initialized);
+  defsubr (&Sstartup_trace);
+  defsubr (&Sstartup_trace_call);
 
   DEFVAR_LISP ("command-line-args", Vcommand_line_args,
 	       doc: /* Args passed by shell to Emacs, as a list of strings.
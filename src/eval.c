@@ -1918,6 +1918,37 @@ un_autoload (Lisp_Object oldqueue)
     }
 }
 
+/* If the autoload FUNDEF says where its definition was saved, install
+   that definition in FUNNAME as if by `defalias' and return it.
+   The location is the (FILE . POSITION) pair that follows the TYPE
+   element of FUNDEF.  Otherwise, return nil.  */
+
+static Lisp_Object
+load_saved_definition (Lisp_Object fundef, Lisp_Object funname)
+{
+  Lisp_Object saved, fun, hook;
+  struct gcpro gcpro1;
+
+  if (NILP (funname) || !AUTOLOADP (fundef))
+    return Qnil;
+  saved = Fnth (make_number (5), fundef);
+  if (! (CONSP (saved) && STRINGP (XCAR (saved))
+	 && INTEGERP (XCDR (saved))))
+    return Qnil;
+  fun = read_doc_string (saved);
+  if (NILP (fun))
+    return Qnil;
+
+  GCPRO1 (fun);
+  hook = Fget (funname, Qdefalias_fset_function);
+  if (!NILP (hook))
+    call2 (hook, funname, fun);
+  else
+    Ffset (funname, fun);
+  UNGCPRO;
+  return Findirect_function (funname, Qnil);
+}
+
 /* Load an autoloaded function.
    FUNNAME is the symbol which is the function's name.
    FUNDEF is the autoload definition (a list).  */
@@ -1927,11 +1958,16 @@ DEFUN ("autoload-do-load", Fautoload_do_load, Sautoload_do_load, 1, 3, 0,
 If non-nil, FUNNAME should be the symbol whose function value is FUNDEF,
 in which case the function returns the new autoloaded function value.
 If equal to `macro', MACRO-ONLY specifies that FUNDEF should only be loaded if
-it is defines a macro.  */)
+it is defines a macro.
+If FUNDEF has a sixth element of the form (FILE . POSITION), and FUNNAME
+is non-nil, the definition is read from POSITION in FILE, which should be
+in the format of dynamic docstrings in byte-compiled files, instead of
+loading the file that FUNDEF names.  */)
   (Lisp_Object fundef, Lisp_Object funname, Lisp_Object macro_only)
 {
   ptrdiff_t count = SPECPDL_INDEX ();
   struct gcpro gcpro1, gcpro2, gcpro3;
+  Lisp_Object fun;
 
   if (!CONSP (fundef) || !EQ (Qautoload, XCAR (fundef)))
     return fundef;
@@ -1952,6 +1988,13 @@ it is defines a macro.  */)
   CHECK_SYMBOL (funname);
   GCPRO3 (funname, fundef, macro_only);
 
+  fun = load_saved_definition (fundef, funname);
+  if (!NILP (fun))
+    {
+      UNGCPRO;
+      return fun;
+    }
+
   /* Preserve the match data.  */
   record_unwind_save_match_data ();
 
@@ -1979,13 +2022,18 @@ it is defines a macro.  */)
     return Qnil;
   else
     {
-      Lisp_Object fun = Findirect_function (funname, Qnil);
+      fun = Findirect_function (funname, Qnil);
 
       if (!NILP (Fequal (fun, fundef)))
 	error ("Autoloading failed to define function %s",
 	       SDATA (SYMBOL_NAME (funname)));
       else
-	return fun;
+	{
+	  /* The file may have defined FUNNAME as an autoload whose
+	     definition was saved elsewhere.  */
+	  Lisp_Object saved = load_saved_definition (fun, funname);
+	  return NILP (saved) ? fun : saved;
+	}
     }
 }
 
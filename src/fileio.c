@@ -3311,7 +3311,6 @@ decide_coding_unwind (Lisp_Object unwind_data)
 
   set_buffer_internal (XBUFFER (buffer));
   adjust_markers_for_delete (BEG, BEG_BYTE, Z, Z_BYTE);
-  adjust_overlays_for_delete (BEG, Z - BEG);
   set_buffer_intervals (current_buffer, NULL);
   TEMP_SET_PT_BOTH (BEG, BEG_BYTE);
 
@@ -3434,7 +3433,7 @@ by calling `format-decode', which see.  */)
   /* If the undo log only contains the insertion, there's no point
      keeping it.  It's typically when we first fill a file-buffer.  */
   bool empty_undo_list_p
-    = (!NILP (visit) && NILP (BVAR (current_buffer, undo_list))
+    = (!NILP (visit) && NILP (buffer_undo_list (current_buffer))
        && BEG == Z);
   Lisp_Object old_Vdeactivate_mark = Vdeactivate_mark;
   bool we_locked_file = 0;
@@ -3635,8 +3634,7 @@ by calling `format-decode', which see.  */)
 		  bset_read_only (buf, Qnil);
 		  bset_filename (buf, Qnil);
 		  bset_undo_list (buf, Qt);
-		  eassert (buf->overlays_before == NULL);
-		  eassert (buf->overlays_after == NULL);
+		  eassert (buf->overlays.root == NULL);
 
 		  set_buffer_internal (buf);
 		  Ferase_buffer ();
@@ -4236,7 +4234,7 @@ by calling `format-decode', which see.  */)
 	  ptrdiff_t count1 = SPECPDL_INDEX ();
 
 	  unwind_data = Fcons (BVAR (current_buffer, enable_multibyte_characters),
-			       Fcons (BVAR (current_buffer, undo_list),
+			       Fcons (buffer_undo_list (current_buffer),
 				      Fcurrent_buffer ()));
 	  bset_enable_multibyte_characters (current_buffer, Qnil);
 	  bset_undo_list (current_buffer, Qt);
@@ -4375,7 +4373,7 @@ by calling `format-decode', which see.  */)
       specbind (Qinhibit_modification_hooks, Qt);
 
       /* Save old undo list and don't record undo for decoding.  */
-      old_undo = BVAR (current_buffer, undo_list);
+      old_undo = buffer_undo_list (current_buffer);
       bset_undo_list (current_buffer, Qt);
 
       if (NILP (replace))
@@ -2056,10 +2056,10 @@ internal_equal (Lisp_Object o1, Lisp_Object o2, int depth, bool props,
 	return 0;
       if (OVERLAYP (o1))
 	{
-	  if (!internal_equal (OVERLAY_START (o1), OVERLAY_START (o2),
-			       depth + 1, props, ht)
-	      || !internal_equal (OVERLAY_END (o1), OVERLAY_END (o2),
-				  depth + 1, props, ht))
+	  if (OVERLAY_BUFFER (o1) != OVERLAY_BUFFER (o2)
+	      || (OVERLAY_BUFFER (o1)
+		  && (OVERLAY_START (o1) != OVERLAY_START (o2)
+		      || OVERLAY_END (o1) != OVERLAY_END (o2))))
 	    return 0;
 	  o1 = XOVERLAY (o1)->plist;
 	  o2 = XOVERLAY (o2)->plist;
@@ -2069,7 +2069,8 @@ internal_equal (Lisp_Object o1, Lisp_Object o2, int depth, bool props,
 	{
 	  return (XMARKER (o1)->buffer == XMARKER (o2)->buffer
 		  && (XMARKER (o1)->buffer == 0
-		      || XMARKER (o1)->bytepos == XMARKER (o2)->bytepos));
+		      || (marker_charpos (XMARKER (o1))
+			  == marker_charpos (XMARKER (o2)))));
 	}
       break;
 
@@ -23,9 +23,6 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
    Have to ensure that we can't put symbol nil on a plist, or some
    functions may work incorrectly.
 
-   An idea:  Have the owner of the tree keep count of splits and/or
-   insertion lengths (in intervals), and balance after every N.
-
    Need to call *_left_hook when buffer is killed.
 
    Scan for zero-length, or 0-length to see notes about handling
@@ -322,6 +319,22 @@ root_interval (INTERVAL interval)
 }
 #endif
 
+/* Return the height of the subtree rooted at I, 0 if I is null.  */
+
+static int
+interval_height (INTERVAL i)
+{
+  return i ? i->height : 0;
+}
+
+/* Recompute the height of I from those of its children.  */
+
+static void
+update_interval_height (INTERVAL i)
+{
+  i->height = 1 + max (interval_height (i->left), interval_height (i->right));
+}
+
 /* Assuming that a left child exists, perform the following operation:
 
      A		  B
@@ -366,6 +379,9 @@ rotate_right (INTERVAL interval)
   B->total_length = old_total;
   eassert (TOTAL_LENGTH (B) >= 0);
 
+  update_interval_height (interval);
+  update_interval_height (B);
+
   return B;
 }
 
@@ -413,109 +429,158 @@ rotate_left (INTERVAL interval)
   B->total_length = old_total;
   eassert (TOTAL_LENGTH (B) >= 0);
 
+  update_interval_height (interval);
+  update_interval_height (B);
+
   return B;
 }
 
-/* Balance an interval tree with the assumption that the subtrees
-   themselves are already balanced.  */
+/* Rebalance the subtree rooted at I, whose own subtrees are balanced
+   and differ in height by at most two, with one or two rotations.
+   Return the interval at the root of the subtree afterwards.  */
 
 static INTERVAL
 balance_an_interval (INTERVAL i)
 {
-  register ptrdiff_t old_diff, new_diff;
+  int diff = interval_height (i->left) - interval_height (i->right);
 
-  while (1)
+  if (diff > 1)
     {
-      old_diff = LEFT_TOTAL_LENGTH (i) - RIGHT_TOTAL_LENGTH (i);
-      if (old_diff > 0)
-	{
-	  /* Since the left child is longer, there must be one.  */
-	  new_diff = i->total_length - i->left->total_length
-	    + RIGHT_TOTAL_LENGTH (i->left) - LEFT_TOTAL_LENGTH (i->left);
-	  if (eabs (new_diff) >= old_diff)
-	    break;
-	  i = rotate_right (i);
-	  balance_an_interval (i->right);
-	}
-      else if (old_diff < 0)
-	{
-	  /* Since the right child is longer, there must be one.  */
-	  new_diff = i->total_length - i->right->total_length
-	    + LEFT_TOTAL_LENGTH (i->right) - RIGHT_TOTAL_LENGTH (i->right);
-	  if (eabs (new_diff) >= -old_diff)
-	    break;
-	  i = rotate_left (i);
-	  balance_an_interval (i->left);
-	}
-      else
-	break;
+      if (interval_height (i->left->left) < interval_height (i->left->right))
+	rotate_left (i->left);
+      i = rotate_right (i);
     }
+  else if (diff < -1)
+    {
+      if (interval_height (i->right->right) < interval_height (i->right->left))
+	rotate_right (i->right);
+      i = rotate_left (i);
+    }
+  else
+    update_interval_height (i);
+
   return i;
 }
 
-/* Balance INTERVAL, potentially stuffing it back into its parent
-   Lisp Object.  */
+/* Store ROOT, the root of an interval tree, in the buffer or string
+   that the tree belongs to, if any.  */
 
-static INTERVAL
-balance_possible_root_interval (INTERVAL interval)
+static void
+set_root_interval (INTERVAL root)
 {
-  Lisp_Object parent;
-  bool have_parent = 0;
+  Lisp_Object owner;
+
+  if (! INTERVAL_HAS_OBJECT (root))
+    return;
 
-  if (!INTERVAL_HAS_OBJECT (interval) && !INTERVAL_HAS_PARENT (interval))
-    return interval;
+  GET_INTERVAL_OBJECT (owner, root);
+  if (BUFFERP (owner))
+    set_buffer_intervals (XBUFFER (owner), root);
+  else if (STRINGP (owner))
+    set_string_intervals (owner, root);
+}
 
-  if (INTERVAL_HAS_OBJECT (interval))
-    {
-      have_parent = 1;
-      GET_INTERVAL_OBJECT (parent, interval);
-    }
-  interval = balance_an_interval (interval);
+/* Restore the balance of the tree of I after a change to the subtree
+   rooted at I, going up towards the root for as long as the heights
+   of the subtrees change.  */
 
-  if (have_parent)
+static void
+rebalance_intervals (INTERVAL i)
+{
+  while (1)
     {
-      if (BUFFERP (parent))
-	set_buffer_intervals (XBUFFER (parent), interval);
-      else if (STRINGP (parent))
-	set_string_intervals (parent, interval);
+      int old_height = i->height;
+
+      i = balance_an_interval (i);
+      if (ROOT_INTERVAL_P (i))
+	{
+	  set_root_interval (i);
+	  return;
+	}
+      if (i->height == old_height)
+	return;
+      i = INTERVAL_PARENT (i);
     }
+}
 
-  return interval;
+/* Return the number of intervals in the tree TREE.  */
+
+static ptrdiff_t
+interval_count (INTERVAL tree)
+{
+  return (tree
+	  ? 1 + interval_count (tree->left) + interval_count (tree->right)
+	  : 0);
 }
 
-/* Balance the interval tree TREE.  Balancing is by weight
-   (the amount of text).  */
+/* Store in NODES the intervals of the tree TREE, in order, with the
+   length of each in its own TOTAL_LENGTH field.  Return the number of
+   intervals stored.  */
 
-static INTERVAL
-balance_intervals_internal (register INTERVAL tree)
+static ptrdiff_t
+flatten_intervals (INTERVAL tree, INTERVAL *nodes)
 {
-  /* Balance within each side.  */
+  ptrdiff_t n = 0, length = LENGTH (tree);
+
   if (tree->left)
-    balance_intervals_internal (tree->left);
+    n += flatten_intervals (tree->left, nodes);
+  nodes[n++] = tree;
   if (tree->right)
-    balance_intervals_internal (tree->right);
-  return balance_an_interval (tree);
+    n += flatten_intervals (tree->right, nodes + n);
+  tree->total_length = length;
+  return n;
 }
 
-/* Advertised interface to balance intervals.  */
+/* Link the N intervals in NODES, whose TOTAL_LENGTH fields hold their
+   own lengths, into a balanced tree, and return its root.  */
 
-INTERVAL
-balance_intervals (INTERVAL tree)
+static INTERVAL
+build_balanced_intervals (INTERVAL *nodes, ptrdiff_t n)
 {
-  return tree ? balance_intervals_internal (tree) : NULL;
+  ptrdiff_t mid = n / 2;
+  INTERVAL i = nodes[mid];
+
+  set_interval_left (i, mid > 0 ? build_balanced_intervals (nodes, mid) : NULL);
+  set_interval_right (i, (mid + 1 < n
+			  ? build_balanced_intervals (nodes + mid + 1,
+						      n - mid - 1)
+			  : NULL));
+  if (i->left)
+    {
+      set_interval_parent (i->left, i);
+      i->total_length += i->left->total_length;
+    }
+  if (i->right)
+    {
+      set_interval_parent (i->right, i);
+      i->total_length += i->right->total_length;
+    }
+  update_interval_height (i);
+  return i;
 }
 
-/* Rebalance text properties of B.  */
+/* Rebuild the interval tree TREE, whose heights may be out of date,
+   into a balanced tree, and return the root of the new tree, which
+   takes the place of TREE in the buffer or string that owns it.  */
 
-static void
-buffer_balance_intervals (struct buffer *b)
+static INTERVAL
+balance_intervals (INTERVAL tree)
 {
-  INTERVAL i;
+  INTERVAL *nodes;
+  ptrdiff_t n;
+  USE_SAFE_ALLOCA;
 
-  eassert (b != NULL);
-  i = buffer_intervals (b);
-  if (i)
-    set_buffer_intervals (b, balance_an_interval (i));
+  if (!tree)
+    return NULL;
+
+  n = interval_count (tree);
+  SAFE_NALLOCA (nodes, 1, n);
+  flatten_intervals (tree, nodes);
+  copy_interval_parent (nodes[n / 2], tree);
+  tree = build_balanced_intervals (nodes, n);
+  set_root_interval (tree);
+  SAFE_FREE ();
+  return tree;
 }
 
 /* Split INTERVAL into two pieces, starting the second piece at
@@ -528,8 +593,8 @@ buffer_balance_intervals (struct buffer *b)
    is reset, thus it is up to the caller to do the right thing with the
    result.
 
-   Note that this does not change the position of INTERVAL;  if it is a root,
-   it is still a root after this operation.  */
+   The tree is rebalanced afterwards, so INTERVAL may no longer be its
+   root if it was one.  */
 
 INTERVAL
 split_interval_right (INTERVAL interval, ptrdiff_t offset)
@@ -539,26 +604,31 @@ split_interval_right (INTERVAL interval, ptrdiff_t offset)
   ptrdiff_t new_length = LENGTH (interval) - offset;
 
   new->position = position + offset;
-  set_interval_parent (new, interval);
+  new->total_length = new_length;
+  eassert (TOTAL_LENGTH (new) >= 0);
 
   if (NULL_RIGHT_CHILD (interval))
     {
       set_interval_right (interval, new);
-      new->total_length = new_length;
-      eassert (TOTAL_LENGTH (new) >= 0);
+      set_interval_parent (new, interval);
     }
   else
     {
-      /* Insert the new node between INTERVAL and its right child.  */
-      set_interval_right (new, interval->right);
-      set_interval_parent (interval->right, new);
-      set_interval_right (interval, new);
-      new->total_length = new_length + new->right->total_length;
-      eassert (TOTAL_LENGTH (new) >= 0);
-      balance_an_interval (new);
+      /* Make the new interval the leftmost leaf of the right subtree
+	 of INTERVAL, whose text it precedes.  */
+      INTERVAL i = interval->right;
+
+      i->total_length += new_length;
+      while (i->left)
+	{
+	  i = i->left;
+	  i->total_length += new_length;
+	}
+      set_interval_left (i, new);
+      set_interval_parent (new, i);
     }
 
-  balance_possible_root_interval (interval);
+  rebalance_intervals (INTERVAL_PARENT (new));
 
   return new;
 }
@@ -573,8 +643,8 @@ split_interval_right (INTERVAL interval, ptrdiff_t offset)
    is reset, thus it is up to the caller to do the right thing with the
    result.
 
-   Note that this does not change the position of INTERVAL;  if it is a root,
-   it is still a root after this operation.  */
+   The tree is rebalanced afterwards, so INTERVAL may no longer be its
+   root if it was one.  */
 
 INTERVAL
 split_interval_left (INTERVAL interval, ptrdiff_t offset)
@@ -584,30 +654,35 @@ split_interval_left (INTERVAL interval, ptrdiff_t offset)
 
   new->position = interval->position;
   interval->position = interval->position + offset;
-  set_interval_parent (new, interval);
+  new->total_length = new_length;
+  eassert (TOTAL_LENGTH (new) >= 0);
 
   if (NULL_LEFT_CHILD (interval))
     {
       set_interval_left (interval, new);
-      new->total_length = new_length;
-      eassert (TOTAL_LENGTH (new) >= 0);
+      set_interval_parent (new, interval);
     }
   else
     {
-      /* Insert the new node between INTERVAL and its left child.  */
-      set_interval_left (new, interval->left);
-      set_interval_parent (new->left, new);
-      set_interval_left (interval, new);
-      new->total_length = new_length + new->left->total_length;
-      eassert (TOTAL_LENGTH (new) >= 0);
-      balance_an_interval (new);
+      /* Make the new interval the rightmost leaf of the left subtree
+	 of INTERVAL, whose text it follows.  */
+      INTERVAL i = interval->left;
+
+      i->total_length += new_length;
+      while (i->right)
+	{
+	  i = i->right;
+	  i->total_length += new_length;
+	}
+      set_interval_right (i, new);
+      set_interval_parent (new, i);
     }
 
-  balance_possible_root_interval (interval);
+  rebalance_intervals (INTERVAL_PARENT (new));
 
   return new;
 }
-
+
 /* Return the proper position for the first character
    described by the interval tree SOURCE.
    This is 1 if the parent is a buffer,
@@ -663,8 +738,6 @@ find_interval (register INTERVAL tree, register ptrdiff_t position)
 
   eassert (relative_position <= TOTAL_LENGTH (tree));
 
-  tree = balance_possible_root_interval (tree);
-
   while (1)
     {
       eassert (tree);
@@ -951,7 +1024,6 @@ adjust_intervals_for_insertion (INTERVAL tree,
 	{
 	  temp->total_length += length;
 	  eassert (TOTAL_LENGTH (temp) >= 0);
-	  temp = balance_possible_root_interval (temp);
 	}
 
       /* If at least one interval has sticky properties,
@@ -1007,7 +1079,6 @@ adjust_intervals_for_insertion (INTERVAL tree,
 	{
 	  temp->total_length += length;
 	  eassert (TOTAL_LENGTH (temp) >= 0);
-	  temp = balance_possible_root_interval (temp);
 	}
     }
 
@@ -1216,13 +1287,16 @@ delete_node (register INTERVAL i)
 }
 
 /* Delete interval I from its tree by calling `delete_node'
-   and properly connecting the resultant subtree.
+   and properly connecting the resultant subtree.  This leaves the
+   tree unbalanced and the heights of its intervals out of date, so
+   it is only for set_intervals_multibyte_1, which rebuilds the tree
+   afterwards; use delete_interval otherwise.
 
    I is presumed to be empty; that is, no adjustments are made
    for the length of I.  */
 
 static void
-delete_interval (register INTERVAL i)
+delete_interval_unbalanced (register INTERVAL i)
 {
   register INTERVAL parent;
   ptrdiff_t amt = LENGTH (i);
@@ -1262,10 +1336,92 @@ delete_interval (register INTERVAL i)
     }
 }
 
+/* Delete interval I from its tree, moving its successor in its place
+   if it has two children, and rebalance the tree.  The other
+   intervals of the tree stay in it.
+
+   I is presumed to be empty; that is, no adjustments are made
+   for the length of I.  */
+
+static void
+delete_interval (INTERVAL i)
+{
+  INTERVAL replacement, changed, p;
+
+  eassert (LENGTH (i) == 0);	/* Only used on zero-length intervals now.  */
+
+  if (!i->left || !i->right)
+    {
+      replacement = i->left ? i->left : i->right;
+      changed = NULL_PARENT (i) ? NULL : INTERVAL_PARENT (i);
+    }
+  else
+    {
+      ptrdiff_t length;
+
+      replacement = i->right;
+      while (replacement->left)
+	replacement = replacement->left;
+      length = LENGTH (replacement);
+
+      if (replacement == i->right)
+	changed = replacement;
+      else
+	{
+	  /* Unlink the successor, and subtract its length from the
+	     intervals between it and I.  */
+	  changed = INTERVAL_PARENT (replacement);
+	  set_interval_left (changed, replacement->right);
+	  if (replacement->right)
+	    set_interval_parent (replacement->right, changed);
+	  for (p = changed; p != i; p = INTERVAL_PARENT (p))
+	    {
+	      p->total_length -= length;
+	      eassert (TOTAL_LENGTH (p) >= 0);
+	    }
+	  set_interval_right (replacement, i->right);
+	  set_interval_parent (i->right, replacement);
+	}
+      set_interval_left (replacement, i->left);
+      set_interval_parent (i->left, replacement);
+      replacement->total_length = i->total_length;
+      replacement->height = i->height;
+    }
+
+  if (ROOT_INTERVAL_P (i))
+    {
+      Lisp_Object owner;
+      GET_INTERVAL_OBJECT (owner, i);
+      if (replacement)
+	set_interval_object (replacement, owner);
+
+      if (BUFFERP (owner))
+	set_buffer_intervals (XBUFFER (owner), replacement);
+      else if (STRINGP (owner))
+	set_string_intervals (owner, replacement);
+      else
+	emacs_abort ();
+    }
+  else
+    {
+      if (AM_LEFT_CHILD (i))
+	set_interval_left (INTERVAL_PARENT (i), replacement);
+      else
+	set_interval_right (INTERVAL_PARENT (i), replacement);
+      if (replacement)
+	copy_interval_parent (replacement, i);
+    }
+
+  if (changed)
+    rebalance_intervals (changed);
+}
+
 /* Find the interval in TREE corresponding to the relative position
    FROM and delete as much as possible of AMOUNT from that interval.
    Return the amount actually deleted, and if the interval was
-   zeroed-out, delete that interval node from the tree.
+   zeroed-out, store it in *EMPTIED, for the caller to delete it from
+   the tree once the lengths of all the intervals above it are up to
+   date.
 
    Note that FROM is actually origin zero, aka relative to the
    leftmost edge of tree.  This is appropriate since we call ourselves
@@ -1276,7 +1432,7 @@ delete_interval (register INTERVAL i)
 
 static ptrdiff_t
 interval_deletion_adjustment (register INTERVAL tree, register ptrdiff_t from,
-			      register ptrdiff_t amount)
+			      register ptrdiff_t amount, INTERVAL *emptied)
 {
   register ptrdiff_t relative_position = from;
 
@@ -1288,7 +1444,7 @@ interval_deletion_adjustment (register INTERVAL tree, register ptrdiff_t from,
     {
       ptrdiff_t subtract = interval_deletion_adjustment (tree->left,
 							 relative_position,
-							 amount);
+							 amount, emptied);
       tree->total_length -= subtract;
       eassert (TOTAL_LENGTH (tree) >= 0);
       return subtract;
@@ -1303,7 +1459,7 @@ interval_deletion_adjustment (register INTERVAL tree, register ptrdiff_t from,
 			    - RIGHT_TOTAL_LENGTH (tree));
       subtract = interval_deletion_adjustment (tree->right,
 					       relative_position,
-					       amount);
+					       amount, emptied);
       tree->total_length -= subtract;
       eassert (TOTAL_LENGTH (tree) >= 0);
       return subtract;
@@ -1322,7 +1478,7 @@ interval_deletion_adjustment (register INTERVAL tree, register ptrdiff_t from,
       tree->total_length -= amount;
       eassert (TOTAL_LENGTH (tree) >= 0);
       if (LENGTH (tree) == 0)
-	delete_interval (tree);
+	*emptied = tree;
 
       return amount;
     }
@@ -1370,8 +1526,12 @@ adjust_intervals_for_deletion (struct buffer *buffer,
     start = offset + TOTAL_LENGTH (tree);
   while (left_to_delete > 0)
     {
+      INTERVAL emptied = NULL;
+
       left_to_delete -= interval_deletion_adjustment (tree, start - offset,
-						      left_to_delete);
+						      left_to_delete, &emptied);
+      if (emptied)
+	delete_interval (emptied);
       tree = buffer_intervals (buffer);
       if (left_to_delete == tree->total_length)
 	{
@@ -1522,6 +1682,7 @@ reproduce_interval (INTERVAL source)
 
   target->total_length = source->total_length;
   target->position = source->position;
+  target->height = source->height;
 
   copy_properties (source, target);
 
@@ -1615,8 +1776,6 @@ graft_intervals_into_buffer (INTERVAL source, ptrdiff_t position,
 				 Qnil, buf,
 				 find_interval (tree, position));
 	}
-      /* Shouldn't be necessary.  --Stef  */
-      buffer_balance_intervals (buffer);
       return;
     }
 
@@ -1722,8 +1881,6 @@ graft_intervals_into_buffer (INTERVAL source, ptrdiff_t position,
       /* Always advance to a new target interval.  */
       under = next_interval (this);
     }
-
-  buffer_balance_intervals (buffer);
 }
 
 /* Get the value of property PROP from PLIST,
@@ -1858,8 +2015,8 @@ adjust_for_invis_intang (ptrdiff_t pos, ptrdiff_t test_offs, ptrdiff_t adj,
 	     == (test_offs == 0 ? 1 : -1))
 	  /* Invisible property is from an overlay.  */
 	  : (test_offs == 0
-	     ? XMARKER (OVERLAY_START (invis_overlay))->insertion_type == 0
-	     : XMARKER (OVERLAY_END (invis_overlay))->insertion_type == 1)))
+	     ? ! OVERLAY_FRONT_ADVANCE_P (invis_overlay)
+	     : OVERLAY_REAR_ADVANCE_P (invis_overlay))))
     pos += adj;
 
   return pos;
@@ -2279,7 +2436,10 @@ copy_intervals (INTERVAL tree, ptrdiff_t start, ptrdiff_t length)
       got += prevlen;
     }
 
-  return balance_an_interval (new);
+  /* Rebalancing after the splits may have moved NEW down the tree.  */
+  while (! NULL_PARENT (new))
+    new = INTERVAL_PARENT (new);
+  return new;
 }
 
 /* Give STRING the properties of BUFFER from POSITION to LENGTH.  */
@@ -2352,7 +2512,7 @@ set_intervals_multibyte_1 (INTERVAL i, bool multi_flag,
 
   if (TOTAL_LENGTH (i) == 0)
     {
-      delete_interval (i);
+      delete_interval_unbalanced (i);
       return;
     }
 
@@ -2435,13 +2595,13 @@ set_intervals_multibyte_1 (INTERVAL i, bool multi_flag,
 	{
 	  set_interval_plist (i, i->left->plist);
 	  (i)->left->total_length = 0;
-	  delete_interval ((i)->left);
+	  delete_interval_unbalanced ((i)->left);
 	}
       else
 	{
 	  set_interval_plist (i, i->right->plist);
 	  (i)->right->total_length = 0;
-	  delete_interval ((i)->right);
+	  delete_interval_unbalanced ((i)->right);
 	}
     }
 }
@@ -2456,5 +2616,9 @@ set_intervals_multibyte (bool multi_flag)
   INTERVAL i = buffer_intervals (current_buffer);
 
   if (i)
-    set_intervals_multibyte_1 (i, multi_flag, BEG, BEG_BYTE, Z, Z_BYTE);
+    {
+      set_intervals_multibyte_1 (i, multi_flag, BEG, BEG_BYTE, Z, Z_BYTE);
+      /* Intervals may have been deleted without rebalancing the tree.  */
+      balance_intervals (buffer_intervals (current_buffer));
+    }
 }
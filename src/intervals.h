@@ -46,6 +46,11 @@ struct interval
 
   bool_bf gcmarkbit : 1;
 
+  /* Height of the subtree rooted at this interval, 1 for a leaf.
+     The heights of the two subtrees of an interval differ by at most
+     one, which keeps the tree balanced.  */
+  unsigned int height : 7;
+
   /* The remaining components are `properties' of the interval.
      The first four are duplicates for things which can be on the list,
      for purposes of speed.  */
@@ -166,6 +171,7 @@ set_interval_plist (INTERVAL i, Lisp_Object plist)
   (i)->total_length = (i)->position = 0;      \
   (i)->left = (i)->right = NULL;	      \
   set_interval_parent (i, NULL);	      \
+  (i)->height = 1;			      \
   (i)->write_protect = false;		      \
   (i)->visible = false;			      \
   (i)->front_sticky = (i)->rear_sticky = false;	\
@@ -250,7 +256,6 @@ extern void graft_intervals_into_buffer (INTERVAL, ptrdiff_t, ptrdiff_t,
                                          struct buffer *, bool);
 extern void verify_interval_modification (struct buffer *,
 					  ptrdiff_t, ptrdiff_t);
-extern INTERVAL balance_intervals (INTERVAL);
 extern void copy_intervals_to_string (Lisp_Object, struct buffer *,
                                              ptrdiff_t, ptrdiff_t);
 extern INTERVAL copy_intervals (INTERVAL, ptrdiff_t, ptrdiff_t);
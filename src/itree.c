@@ -0,0 +1,816 @@
+/* Interval trees, used to store the overlays and markers of buffers.
+
+Copyright (C) 2014 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* See itree.h for an overview.
+
+   The BEGIN, END and LIMIT of a node are relative to the offsets of
+   its ancestors: the real values are the stored ones plus the sum of
+   the OFFSETs of all the nodes above it.  Pushing the offset of a node
+   down to its children therefore changes none of the real values, and
+   neither does a rotation, once the offsets of the two nodes it swaps
+   have been pushed down.
+
+   A node whose OTICK equals that of the tree has no ancestor with a
+   pending offset, so its stored values are the real ones.  This holds
+   because an offset is only ever left on a node whose descendants are
+   all out of date: the updates that leave offsets behind increment the
+   OTICK of the tree first, and pushing an offset down only moves it to
+   nodes further down.  */
+
+#include <config.h>
+
+#include "lisp.h"
+#include "itree.h"
+
+/* Shift the positions of NODE, and of all the nodes below it, by
+   DELTA.  */
+
+static void
+itree_shift (struct itree_node *node, ptrdiff_t delta)
+{
+  node->begin += delta;
+  node->end += delta;
+  node->limit += delta;
+  node->offset += delta;
+}
+
+/* Push the offset of NODE down to its children.  */
+
+static void
+itree_push_down (struct itree_node *node)
+{
+  if (node->offset)
+    {
+      if (node->left)
+	itree_shift (node->left, node->offset);
+      if (node->right)
+	itree_shift (node->right, node->offset);
+      node->offset = 0;
+    }
+}
+
+/* Recompute the limit of NODE from its end and those of its
+   children.  */
+
+static void
+itree_update_limit (struct itree_node *node)
+{
+  ptrdiff_t limit = node->end;
+
+  if (node->left && limit < node->left->limit + node->offset)
+    limit = node->left->limit + node->offset;
+  if (node->right && limit < node->right->limit + node->offset)
+    limit = node->right->limit + node->offset;
+  node->limit = limit;
+}
+
+/* Make the stored values of NODE in TREE the real ones, by pushing
+   down the offsets of its ancestors.  */
+
+static void
+itree_validate (struct itree_tree *tree, struct itree_node *node)
+{
+  if (node->otick != tree->otick)
+    {
+      if (node->parent)
+	{
+	  itree_validate (tree, node->parent);
+	  itree_push_down (node->parent);
+	}
+      node->otick = tree->otick;
+    }
+}
+
+/* Initialize NODE, which will hold an interval of DATA.
+   FRONT_ADVANCE and REAR_ADVANCE say whether its beginning and its end
+   move past text inserted at them.  */
+
+void
+itree_node_init (struct itree_node *node, bool front_advance,
+		 bool rear_advance, Lisp_Object data)
+{
+  node->parent = node->left = node->right = NULL;
+  node->begin = node->end = node->limit = -1;
+  node->offset = 0;
+  node->otick = 0;
+  node->data = data;
+  node->red = false;
+  node->front_advance = front_advance;
+  node->rear_advance = rear_advance;
+}
+
+/* Return the beginning of NODE in TREE.  */
+
+ptrdiff_t
+itree_node_begin (struct itree_tree *tree, struct itree_node *node)
+{
+  itree_validate (tree, node);
+  return node->begin;
+}
+
+/* Return the end of NODE in TREE.  */
+
+ptrdiff_t
+itree_node_end (struct itree_tree *tree, struct itree_node *node)
+{
+  itree_validate (tree, node);
+  return node->end;
+}
+
+/* Make TREE empty.  */
+
+void
+itree_init (struct itree_tree *tree)
+{
+  tree->root = NULL;
+  tree->otick = 1;
+  tree->size = 0;
+}
+
+
+/* Rebalancing.  */
+
+/* Put NEW in the place of OLD in TREE, as far as the parent of OLD is
+   concerned.  NEW may be null.  */
+
+static void
+itree_replace_child (struct itree_tree *tree, struct itree_node *old,
+		     struct itree_node *new)
+{
+  if (!old->parent)
+    tree->root = new;
+  else if (old == old->parent->left)
+    old->parent->left = new;
+  else
+    old->parent->right = new;
+  if (new)
+    new->parent = old->parent;
+}
+
+/* Make the right child of NODE its parent.  */
+
+static void
+itree_rotate_left (struct itree_tree *tree, struct itree_node *node)
+{
+  struct itree_node *right = node->right;
+
+  itree_push_down (node);
+  itree_push_down (right);
+  node->right = right->left;
+  if (right->left)
+    right->left->parent = node;
+  itree_replace_child (tree, node, right);
+  right->left = node;
+  node->parent = right;
+  itree_update_limit (node);
+  itree_update_limit (right);
+}
+
+/* Make the left child of NODE its parent.  */
+
+static void
+itree_rotate_right (struct itree_tree *tree, struct itree_node *node)
+{
+  struct itree_node *left = node->left;
+
+  itree_push_down (node);
+  itree_push_down (left);
+  node->left = left->right;
+  if (left->right)
+    left->right->parent = node;
+  itree_replace_child (tree, node, left);
+  left->right = node;
+  node->parent = left;
+  itree_update_limit (node);
+  itree_update_limit (left);
+}
+
+/* Restore the balance of TREE after NODE has been inserted into it.  */
+
+static void
+itree_insert_fix (struct itree_tree *tree, struct itree_node *node)
+{
+  while (node->parent && node->parent->red)
+    {
+      struct itree_node *parent = node->parent;
+      struct itree_node *grandparent = parent->parent;
+
+      if (parent == grandparent->left)
+	{
+	  struct itree_node *uncle = grandparent->right;
+
+	  if (uncle && uncle->red)
+	    {
+	      parent->red = false;
+	      uncle->red = false;
+	      grandparent->red = true;
+	      node = grandparent;
+	    }
+	  else
+	    {
+	      if (node == parent->right)
+		{
+		  node = parent;
+		  itree_rotate_left (tree, node);
+		  parent = node->parent;
+		}
+	      parent->red = false;
+	      grandparent->red = true;
+	      itree_rotate_right (tree, grandparent);
+	    }
+	}
+      else
+	{
+	  struct itree_node *uncle = grandparent->left;
+
+	  if (uncle && uncle->red)
+	    {
+	      parent->red = false;
+	      uncle->red = false;
+	      grandparent->red = true;
+	      node = grandparent;
+	    }
+	  else
+	    {
+	      if (node == parent->left)
+		{
+		  node = parent;
+		  itree_rotate_right (tree, node);
+		  parent = node->parent;
+		}
+	      parent->red = false;
+	      grandparent->red = true;
+	      itree_rotate_left (tree, grandparent);
+	    }
+	}
+    }
+  tree->root->red = false;
+}
+
+/* Restore the balance of TREE after a black node has been removed from
+   it.  NODE, which may be null, took its place under PARENT.  */
+
+static void
+itree_remove_fix (struct itree_tree *tree, struct itree_node *node,
+		  struct itree_node *parent)
+{
+  while (parent && (!node || !node->red))
+    {
+      if (node == parent->left)
+	{
+	  struct itree_node *other = parent->right;
+
+	  if (other->red)
+	    {
+	      other->red = false;
+	      parent->red = true;
+	      itree_rotate_left (tree, parent);
+	      other = parent->right;
+	    }
+	  if ((!other->left || !other->left->red)
+	      && (!other->right || !other->right->red))
+	    {
+	      other->red = true;
+	      node = parent;
+	      parent = node->parent;
+	    }
+	  else
+	    {
+	      if (!other->right || !other->right->red)
+		{
+		  other->left->red = false;
+		  other->red = true;
+		  itree_rotate_right (tree, other);
+		  other = parent->right;
+		}
+	      other->red = parent->red;
+	      parent->red = false;
+	      if (other->right)
+		other->right->red = false;
+	      itree_rotate_left (tree, parent);
+	      node = tree->root;
+	      parent = NULL;
+	    }
+	}
+      else
+	{
+	  struct itree_node *other = parent->left;
+
+	  if (other->red)
+	    {
+	      other->red = false;
+	      parent->red = true;
+	      itree_rotate_right (tree, parent);
+	      other = parent->left;
+	    }
+	  if ((!other->left || !other->left->red)
+	      && (!other->right || !other->right->red))
+	    {
+	      other->red = true;
+	      node = parent;
+	      parent = node->parent;
+	    }
+	  else
+	    {
+	      if (!other->left || !other->left->red)
+		{
+		  other->right->red = false;
+		  other->red = true;
+		  itree_rotate_left (tree, other);
+		  other = parent->left;
+		}
+	      other->red = parent->red;
+	      parent->red = false;
+	      if (other->left)
+		other->left->red = false;
+	      itree_rotate_right (tree, parent);
+	      node = tree->root;
+	      parent = NULL;
+	    }
+	}
+    }
+  if (node)
+    node->red = false;
+}
+
+
+/* Insertion and removal of nodes.  */
+
+/* Insert NODE into TREE, with the interval [BEGIN, END].  */
+
+void
+itree_insert (struct itree_tree *tree, struct itree_node *node,
+	      ptrdiff_t begin, ptrdiff_t end)
+{
+  struct itree_node *parent = NULL, *child = tree->root;
+
+  eassert (begin <= end && !node->parent && node != tree->root);
+
+  while (child)
+    {
+      itree_push_down (child);
+      if (child->limit < end)
+	child->limit = end;
+      parent = child;
+      child = begin < child->begin ? child->left : child->right;
+    }
+
+  node->parent = parent;
+  node->left = node->right = NULL;
+  node->begin = begin;
+  node->end = node->limit = end;
+  node->offset = 0;
+  node->otick = tree->otick;
+  node->red = true;
+  if (!parent)
+    tree->root = node;
+  else if (begin < parent->begin)
+    parent->left = node;
+  else
+    parent->right = node;
+  tree->size++;
+  itree_insert_fix (tree, node);
+}
+
+/* Remove NODE from TREE.  Its BEGIN and END keep the positions it had
+   there.  */
+
+void
+itree_remove (struct itree_tree *tree, struct itree_node *node)
+{
+  struct itree_node *child, *parent, *ancestor;
+  bool removed_black;
+
+  itree_validate (tree, node);
+  itree_push_down (node);
+
+  if (!node->left || !node->right)
+    {
+      child = node->left ? node->left : node->right;
+      parent = node->parent;
+      removed_black = !node->red;
+      itree_replace_child (tree, node, child);
+    }
+  else
+    {
+      /* Put the next node in the place of NODE.  */
+      struct itree_node *next = node->right;
+
+      itree_push_down (next);
+      while (next->left)
+	{
+	  next = next->left;
+	  itree_push_down (next);
+	}
+      child = next->right;
+      removed_black = !next->red;
+      if (next->parent == node)
+	parent = next;
+      else
+	{
+	  parent = next->parent;
+	  itree_replace_child (tree, next, child);
+	  next->right = node->right;
+	  next->right->parent = next;
+	}
+      itree_replace_child (tree, node, next);
+      next->left = node->left;
+      next->left->parent = next;
+      next->red = node->red;
+    }
+
+  for (ancestor = parent; ancestor; ancestor = ancestor->parent)
+    itree_update_limit (ancestor);
+  if (removed_black)
+    itree_remove_fix (tree, child, parent);
+
+  node->parent = node->left = node->right = NULL;
+  node->limit = node->end;
+  tree->size--;
+}
+
+/* Change the interval of NODE in TREE to [BEGIN, END].  */
+
+void
+itree_node_set_region (struct itree_tree *tree, struct itree_node *node,
+		       ptrdiff_t begin, ptrdiff_t end)
+{
+  itree_validate (tree, node);
+  if (begin != node->begin)
+    {
+      itree_remove (tree, node);
+      itree_insert (tree, node, begin, end);
+    }
+  else if (end != node->end)
+    {
+      struct itree_node *ancestor;
+
+      node->end = end;
+      for (ancestor = node; ancestor; ancestor = ancestor->parent)
+	itree_update_limit (ancestor);
+    }
+}
+
+
+/* Insertion and deletion of text.  */
+
+/* Shift the nodes of the subtree at NODE for an insertion of LENGTH
+   characters at POS, except for those that begin at POS and advance,
+   which are out of the tree.  */
+
+static void
+itree_insert_gap_1 (struct itree_tree *tree, struct itree_node *node,
+		    ptrdiff_t pos, ptrdiff_t length, bool before_markers)
+{
+  /* Nothing in this subtree reaches POS.  */
+  if (!node || node->limit < pos)
+    return;
+
+  itree_push_down (node);
+  node->otick = tree->otick;
+  if (node->begin > pos || (node->begin == pos && before_markers))
+    {
+      /* This node and all the ones after it move as a whole.  */
+      if (node->right)
+	itree_shift (node->right, length);
+      node->begin += length;
+      node->end += length;
+      itree_insert_gap_1 (tree, node->left, pos, length, before_markers);
+    }
+  else
+    {
+      itree_insert_gap_1 (tree, node->left, pos, length, before_markers);
+      itree_insert_gap_1 (tree, node->right, pos, length, before_markers);
+      if (node->end > pos
+	  || (node->end == pos && (before_markers || node->rear_advance)))
+	node->end += length;
+    }
+  itree_update_limit (node);
+}
+
+/* Adjust the nodes of TREE for an insertion of LENGTH characters at
+   POS.  The beginning of a node at POS moves past the new text if the
+   node is FRONT_ADVANCE, and its end if it is REAR_ADVANCE; both do if
+   BEFORE_MARKERS.  A node whose beginning would move past its end
+   becomes empty.  */
+
+void
+itree_insert_gap (struct itree_tree *tree, ptrdiff_t pos, ptrdiff_t length,
+		  bool before_markers)
+{
+  struct itree_node **moved = NULL;
+  ptrdiff_t nmoved = 0, i;
+  USE_SAFE_ALLOCA;
+
+  if (length <= 0 || !tree->root)
+    return;
+
+  /* The nodes that begin at POS and advance would end up after those
+     that begin at POS and stay, which could be anywhere around them in
+     the tree: take them out, and put them back afterwards.  */
+  if (!before_markers)
+    {
+      struct itree_iterator iter;
+      struct itree_node *node;
+
+      for (node = itree_iterator_start (&iter, tree, pos, pos); node;
+	   node = itree_iterator_next (&iter))
+	if (node->begin == pos && node->front_advance)
+	  nmoved++;
+      if (nmoved)
+	{
+	  SAFE_NALLOCA (moved, 1, nmoved);
+	  i = 0;
+	  for (node = itree_iterator_start (&iter, tree, pos, pos); node;
+	       node = itree_iterator_next (&iter))
+	    if (node->begin == pos && node->front_advance)
+	      moved[i++] = node;
+	  for (i = 0; i < nmoved; i++)
+	    itree_remove (tree, moved[i]);
+	}
+    }
+
+  tree->otick++;
+  itree_insert_gap_1 (tree, tree->root, pos, length, before_markers);
+
+  for (i = 0; i < nmoved; i++)
+    {
+      struct itree_node *node = moved[i];
+      ptrdiff_t end = node->end;
+
+      if (end > pos || node->rear_advance)
+	end += length;
+      itree_insert (tree, node, min (pos + length, end), end);
+    }
+  SAFE_FREE ();
+}
+
+/* Move POS according to a deletion of LENGTH characters at FROM.  */
+
+static ptrdiff_t
+itree_delete_pos (ptrdiff_t pos, ptrdiff_t from, ptrdiff_t length)
+{
+  return (pos <= from ? pos
+	  : pos <= from + length ? from
+	  : pos - length);
+}
+
+/* Shift the nodes of the subtree at NODE for a deletion of LENGTH
+   characters at POS.  */
+
+static void
+itree_delete_gap_1 (struct itree_tree *tree, struct itree_node *node,
+		    ptrdiff_t pos, ptrdiff_t length)
+{
+  /* Nothing in this subtree goes past POS.  */
+  if (!node || node->limit <= pos)
+    return;
+
+  itree_push_down (node);
+  node->otick = tree->otick;
+  if (node->begin > pos + length)
+    {
+      /* This node and all the ones after it move as a whole.  */
+      if (node->right)
+	itree_shift (node->right, -length);
+      node->begin -= length;
+      node->end -= length;
+      itree_delete_gap_1 (tree, node->left, pos, length);
+    }
+  else
+    {
+      itree_delete_gap_1 (tree, node->left, pos, length);
+      itree_delete_gap_1 (tree, node->right, pos, length);
+      node->begin = itree_delete_pos (node->begin, pos, length);
+      node->end = itree_delete_pos (node->end, pos, length);
+    }
+  itree_update_limit (node);
+}
+
+/* Adjust the nodes of TREE for a deletion of LENGTH characters at POS.
+   Nodes that began or ended in the deleted text now do at POS.  This
+   keeps them in order, so no node has to move in the tree.  */
+
+void
+itree_delete_gap (struct itree_tree *tree, ptrdiff_t pos, ptrdiff_t length)
+{
+  if (length <= 0 || !tree->root)
+    return;
+
+  tree->otick++;
+  itree_delete_gap_1 (tree, tree->root, pos, length);
+}
+
+/* Return where the text at POS goes when the text from START1 to END1
+   is swapped with the text from START2 to END2.  */
+
+static ptrdiff_t
+itree_transpose_pos (ptrdiff_t pos, ptrdiff_t start1, ptrdiff_t end1,
+		     ptrdiff_t start2, ptrdiff_t end2)
+{
+  if (pos < start1 || end2 <= pos)
+    return pos;
+  else if (pos < end1)
+    return pos + (end2 - end1);
+  else if (pos < start2)
+    return pos + (end2 - start2) - (end1 - start1);
+  else
+    return pos - (start2 - start1);
+}
+
+/* Adjust the nodes of TREE for the text from START1 to END1 and the
+   text from START2 to END2, where END1 <= START2, swapping places.
+   The boundaries in either text move along with it, and a node left
+   backwards becomes empty at its end.  */
+
+void
+itree_transpose (struct itree_tree *tree, ptrdiff_t start1, ptrdiff_t end1,
+		 ptrdiff_t start2, ptrdiff_t end2)
+{
+  struct itree_iterator iter;
+  struct itree_node *node, **nodes;
+  ptrdiff_t i, n = 0;
+  USE_SAFE_ALLOCA;
+
+  for (node = itree_iterator_start (&iter, tree, start1, end2 - 1);
+       node; node = itree_iterator_next (&iter))
+    if (start1 <= node->begin || node->end < end2)
+      n++;
+  if (! n)
+    return;
+
+  /* Moving a node changes the tree, so collect them first.  */
+  SAFE_NALLOCA (nodes, 1, n);
+  i = 0;
+  for (node = itree_iterator_start (&iter, tree, start1, end2 - 1);
+       node; node = itree_iterator_next (&iter))
+    if (start1 <= node->begin || node->end < end2)
+      nodes[i++] = node;
+
+  for (i = 0; i < n; i++)
+    {
+      ptrdiff_t begin = itree_transpose_pos (nodes[i]->begin,
+					     start1, end1, start2, end2);
+      ptrdiff_t end = itree_transpose_pos (nodes[i]->end,
+					   start1, end1, start2, end2);
+
+      if (end < begin)
+	begin = end;
+      itree_node_set_region (tree, nodes[i], begin, end);
+    }
+
+  SAFE_FREE ();
+}
+
+
+/* Searching.  */
+
+/* Return the smallest beginning of a node of TREE that is after POS,
+   or PTRDIFF_MAX if there is none.  */
+
+ptrdiff_t
+itree_next_begin (struct itree_tree *tree, ptrdiff_t pos)
+{
+  struct itree_node *node = tree->root;
+  ptrdiff_t next = PTRDIFF_MAX;
+
+  while (node)
+    {
+      itree_push_down (node);
+      if (node->begin > pos)
+	{
+	  next = node->begin;
+	  node = node->left;
+	}
+      else
+	node = node->right;
+    }
+  return next;
+}
+
+/* Return the largest beginning of a node of TREE that is before POS,
+   or PTRDIFF_MIN if there is none.  */
+
+ptrdiff_t
+itree_previous_begin (struct itree_tree *tree, ptrdiff_t pos)
+{
+  struct itree_node *node = tree->root;
+  ptrdiff_t previous = PTRDIFF_MIN;
+
+  while (node)
+    {
+      itree_push_down (node);
+      if (node->begin < pos)
+	{
+	  previous = node->begin;
+	  node = node->right;
+	}
+      else
+	node = node->left;
+    }
+  return previous;
+}
+
+/* Make NODE exact and push its offset down, as a node its iterator
+   goes through.  */
+
+static void
+itree_iterator_visit (struct itree_iterator *iter, struct itree_node *node)
+{
+  itree_push_down (node);
+  node->otick = iter->tree->otick;
+}
+
+/* Return the first node of the subtree at NODE, leaving out the parts
+   that end before the positions ITER looks for.  */
+
+static struct itree_node *
+itree_iterator_descend (struct itree_iterator *iter, struct itree_node *node)
+{
+  itree_iterator_visit (iter, node);
+  while (node->left && node->left->limit >= iter->begin)
+    {
+      node = node->left;
+      itree_iterator_visit (iter, node);
+    }
+  return node;
+}
+
+/* Move ITER to the node after its current one, leaving out the
+   subtrees that end before the positions it looks for.  */
+
+static void
+itree_iterator_advance (struct itree_iterator *iter)
+{
+  struct itree_node *node = iter->node;
+
+  if (node->right && node->right->limit >= iter->begin)
+    iter->node = itree_iterator_descend (iter, node->right);
+  else
+    {
+      while (node->parent && node == node->parent->right)
+	node = node->parent;
+      iter->node = node->parent;
+    }
+}
+
+/* Return the current node of ITER if it is one it looks for, or else
+   the next such node, or null if there are no more.  */
+
+static struct itree_node *
+itree_iterator_match (struct itree_iterator *iter)
+{
+  while (iter->node)
+    {
+      /* All the nodes after this one begin after the end, too.  */
+      if (iter->node->begin > iter->end)
+	iter->node = NULL;
+      else if (iter->node->end >= iter->begin)
+	return iter->node;
+      else
+	itree_iterator_advance (iter);
+    }
+  return NULL;
+}
+
+/* Start ITER on a search for the nodes of TREE that intersect [BEGIN,
+   END], and return the first one, or null if there is none.  */
+
+struct itree_node *
+itree_iterator_start (struct itree_iterator *iter, struct itree_tree *tree,
+		      ptrdiff_t begin, ptrdiff_t end)
+{
+  iter->tree = tree;
+  iter->begin = begin;
+  iter->end = end;
+  iter->node = (tree->root && tree->root->limit >= begin
+		? itree_iterator_descend (iter, tree->root)
+		: NULL);
+  return itree_iterator_match (iter);
+}
+
+/* Return the next node that ITER looks for, or null if there are no
+   more.  */
+
+struct itree_node *
+itree_iterator_next (struct itree_iterator *iter)
+{
+  itree_iterator_advance (iter);
+  return itree_iterator_match (iter);
+}
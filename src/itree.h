@@ -0,0 +1,117 @@
+/* Interval trees, used to store the overlays and markers of buffers.
+
+Copyright (C) 2014 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef EMACS_ITREE_H
+#define EMACS_ITREE_H
+
+/* An interval tree is a red-black tree of intervals [BEGIN, END],
+   ordered by BEGIN, in which every node also records the largest END
+   of its subtree.  That lets a search skip every subtree that ends
+   before the positions it is looking for, so finding the K intervals
+   that contain a position takes O(log N + K) steps.
+
+   Insertions and deletions of text shift the positions of all the
+   intervals after them.  Rather than visit each of these, a node
+   records an OFFSET by which its children, and everything below them,
+   still have to be shifted; the offset is pushed down to the children
+   when a search or an update goes through the node.  An edit thus
+   only visits the intervals that contain the edited position, plus
+   O(log N) others.
+
+   Since the values of a node are only exact once the offsets of all
+   its ancestors have been pushed down to it, they must be read with
+   itree_node_begin and itree_node_end, except for the nodes returned
+   by an iterator, which are exact until the tree next changes.  */
+
+struct itree_node
+{
+  /* The links of the node in its tree.  */
+  struct itree_node *parent;
+  struct itree_node *left;
+  struct itree_node *right;
+
+  /* The interval.  */
+  ptrdiff_t begin;
+  ptrdiff_t end;
+
+  /* The largest END of the subtree rooted at this node.  */
+  ptrdiff_t limit;
+
+  /* The amount by which the positions of all the nodes below this one
+     have yet to be shifted.  */
+  ptrdiff_t offset;
+
+  /* The value of the OTICK of the tree when BEGIN, END and LIMIT were
+     last known to be exact.  */
+  uintmax_t otick;
+
+  /* The object the interval belongs to, such as an overlay.  */
+  Lisp_Object data;
+
+  bool_bf red : 1;
+
+  /* Whether BEGIN and END move past text inserted at them.  */
+  bool_bf front_advance : 1;
+  bool_bf rear_advance : 1;
+};
+
+struct itree_tree
+{
+  struct itree_node *root;
+
+  /* Incremented each time the offsets of the nodes change.  */
+  uintmax_t otick;
+
+  /* The number of nodes in the tree.  */
+  ptrdiff_t size;
+};
+
+/* A search for the nodes of TREE that intersect [BEGIN, END], in
+   increasing order of their beginnings.  The tree must not change
+   while the search goes on.  */
+struct itree_iterator
+{
+  struct itree_tree *tree;
+  ptrdiff_t begin;
+  ptrdiff_t end;
+  struct itree_node *node;
+};
+
+extern void itree_node_init (struct itree_node *, bool, bool, Lisp_Object);
+extern ptrdiff_t itree_node_begin (struct itree_tree *, struct itree_node *);
+extern ptrdiff_t itree_node_end (struct itree_tree *, struct itree_node *);
+extern void itree_init (struct itree_tree *);
+extern void itree_insert (struct itree_tree *, struct itree_node *,
+			  ptrdiff_t, ptrdiff_t);
+extern void itree_remove (struct itree_tree *, struct itree_node *);
+extern void itree_node_set_region (struct itree_tree *, struct itree_node *,
+				   ptrdiff_t, ptrdiff_t);
+extern void itree_insert_gap (struct itree_tree *, ptrdiff_t, ptrdiff_t,
+			      bool);
+extern void itree_delete_gap (struct itree_tree *, ptrdiff_t, ptrdiff_t);
+extern void itree_transpose (struct itree_tree *, ptrdiff_t, ptrdiff_t,
+			     ptrdiff_t, ptrdiff_t);
+extern ptrdiff_t itree_next_begin (struct itree_tree *, ptrdiff_t);
+extern ptrdiff_t itree_previous_begin (struct itree_tree *, ptrdiff_t);
+extern struct itree_node *itree_iterator_start (struct itree_iterator *,
+						struct itree_tree *,
+						ptrdiff_t, ptrdiff_t);
+extern struct itree_node *itree_iterator_next (struct itree_iterator *);
+
+#endif /* EMACS_ITREE_H */
@@ -1193,6 +1193,10 @@ top_level_1 (Lisp_Object ignore)
     message1 ("Bare impure Emacs (standard Lisp code not loaded)");
   else
     message1 ("Bare Emacs (standard Lisp code not loaded)");
+
+  /* Startup is over, so stop adding to the startup trace, which would
+     otherwise grow with each file loaded for the rest of the session.  */
+  startup_trace = 0;
   return Qnil;
 }
 
@@ -1547,7 +1551,7 @@ command_loop_1 (void)
 
             if (NILP (KVAR (current_kboard, Vprefix_arg))) /* FIXME: Why?  --Stef  */
               {
-		Lisp_Object undo = BVAR (current_buffer, undo_list);
+		Lisp_Object undo = buffer_undo_list (current_buffer);
 		Fundo_boundary ();
 		last_undo_boundary
 		  = (EQ (undo, BVAR (current_buffer, undo_list))
@@ -1744,8 +1748,8 @@ adjust_point_for_property (ptrdiff_t last_pt, bool modified)
 	  && display_prop_intangible_p (val, overlay, PT, PT_BYTE)
 	  && (!OVERLAYP (overlay)
 	      ? get_property_and_range (PT, Qdisplay, &val, &beg, &end, Qnil)
-	      : (beg = OVERLAY_POSITION (OVERLAY_START (overlay)),
-		 end = OVERLAY_POSITION (OVERLAY_END (overlay))))
+	      : (beg = OVERLAY_START (overlay),
+		 end = OVERLAY_END (overlay)))
 	  && (beg < PT /* && end > PT   <- It's always the case.  */
 	      || (beg <= PT && STRINGP (val) && SCHARS (val) == 0)))
 	{
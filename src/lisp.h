@@ -1859,55 +1859,34 @@ struct Lisp_Marker
      leaves the marker after the inserted text.  */
   bool_bf insertion_type : 1;
   /* This is the buffer that the marker points into, or 0 if it points nowhere.
-     Note: a chain of markers can contain markers pointing into different
-     buffers (the chain is per buffer_text rather than per buffer, so it's
+     Note: the tree of markers can contain markers pointing into different
+     buffers (the tree is per buffer_text rather than per buffer, so it's
      shared between indirect buffers).  */
   /* This is used for (other than NULL-checking):
      - Fmarker_buffer
      - Fset_marker: check eq(oldbuf, newbuf) to avoid unchain+rechain.
-     - unchain_marker: to find the list from which to unchain.
+     - unchain_marker: to find the tree from which to unchain.
      - Fkill_buffer: to only unchain the markers of current indirect buffer.
      */
   struct buffer *buffer;
 
-  /* The remaining fields are meaningless in a marker that
-     does not point anywhere.  */
-
-  /* For markers that point somewhere,
-     this is used to chain of all the markers in a given buffer.  */
-  /* We could remove it and use an array in buffer_text instead.
-     That would also allow to preserve it ordered.  */
-  struct Lisp_Marker *next;
-  /* This is the char position where the marker points.  */
-  ptrdiff_t charpos;
-  /* This is the byte position.
-     It's mostly used as a charpos<->bytepos cache (i.e. it's not directly
-     used to implement the functionality of markers, but rather to (ab)use
-     markers as a cache for char<->byte mappings).  */
-  ptrdiff_t bytepos;
+  /* For a marker that points somewhere, its node in the tree of all
+     the markers in the buffer text, which holds its character
+     position as an empty interval; see marker_charpos and
+     marker_bytepos.  NULL for a marker that points nowhere.  */
+  struct itree_node *node;
 };
 
-/* START and END are markers in the overlay's buffer, and
+/* BUFFER is the buffer the overlay is in, or null if it has been
+   deleted, INTERVAL holds its place in the overlay tree of BUFFER, and
    PLIST is the overlay's property list.  */
 struct Lisp_Overlay
-/* An overlay's real data content is:
-   - plist
-   - buffer (really there are two buffer pointers, one per marker,
-     and both points to the same buffer)
-   - insertion type of both ends (per-marker fields)
-   - start & start byte (of start marker)
-   - end & end byte (of end marker)
-   - next (singly linked list of overlays)
-   - next fields of start and end markers (singly linked list of markers).
-   I.e. 9words plus 2 bits, 3words of which are for external linked lists.
-*/
   {
     ENUM_BF (Lisp_Misc_Type) type : 16;	/* = Lisp_Misc_Overlay */
     bool_bf gcmarkbit : 1;
     unsigned spacer : 15;
-    struct Lisp_Overlay *next;
-    Lisp_Object start;
-    Lisp_Object end;
+    struct buffer *buffer;
+    struct itree_node *interval;
     Lisp_Object plist;
   };
 
@@ -2202,6 +2181,10 @@ struct Lisp_Buffer_Local_Value
        Also if the currently loaded binding is the default binding, then
        this is `eq'ual to defcell.  */
     Lisp_Object valcell;
+    /* The index of the variable in the tables of buffer-local bindings
+       that buffers keep beside their `local_var_alist'.  Each variable
+       that can have buffer-local bindings has its own index.  */
+    ptrdiff_t slot;
   };
 
 /* Like Lisp_Objfwd except that value lives in a slot in the
@@ -3327,7 +3310,7 @@ extern Lisp_Object Qintegerp, Qwholenump, Qsymbolp, Qlistp, Qconsp;
 extern Lisp_Object Qstringp, Qarrayp, Qsequencep, Qbufferp;
 extern Lisp_Object Qchar_or_string_p, Qmarkerp, Qinteger_or_marker_p, Qvectorp;
 extern Lisp_Object Qbuffer_or_string_p;
-extern Lisp_Object Qfboundp;
+extern Lisp_Object Qfboundp, Qdefalias_fset_function;
 extern Lisp_Object Qchar_table_p, Qvector_or_char_table_p;
 
 extern Lisp_Object Qcdr;
@@ -3394,6 +3377,10 @@ extern Lisp_Object do_symval_forwarding (union Lisp_Fwd *);
 extern void set_internal (Lisp_Object, Lisp_Object, Lisp_Object, bool);
 extern void syms_of_data (void);
 extern void swap_in_global_binding (struct Lisp_Symbol *);
+extern Lisp_Object buffer_local_binding (struct buffer *,
+					 struct Lisp_Buffer_Local_Value *);
+extern ptrdiff_t buffer_local_fwd_bindings (struct buffer *);
+extern void free_blv (struct Lisp_Buffer_Local_Value *);
 
 /* Defined in cmds.c */
 extern void syms_of_cmds (void);
@@ -3426,6 +3413,10 @@ struct charset;
 extern void syms_of_composite (void);
 
 /* Defined in syntax.c.  */
+extern void invalidate_ppss_cache (struct buffer *, ptrdiff_t, ptrdiff_t);
+extern void flush_ppss_cache (struct buffer *, ptrdiff_t);
+extern void free_ppss_cache (struct buffer *);
+extern void mark_ppss_cache (struct buffer *);
 extern void init_syntax_once (void);
 extern void syms_of_syntax (void);
 
@@ -3733,7 +3724,7 @@ extern Lisp_Object make_save_funcptr_ptr_obj (void (*) (void), void *,
 					      Lisp_Object);
 extern Lisp_Object make_save_memory (Lisp_Object *, ptrdiff_t);
 extern void free_save_value (Lisp_Object);
-extern Lisp_Object build_overlay (Lisp_Object, Lisp_Object, Lisp_Object);
+extern Lisp_Object build_overlay (bool, bool, Lisp_Object);
 extern void free_marker (Lisp_Object);
 extern void free_cons (struct Lisp_Cons *);
 extern void init_alloc_once (void);
@@ -3789,6 +3780,7 @@ extern Lisp_Object internal_with_output_to_temp_buffer
         (const char *, Lisp_Object (*) (Lisp_Object), Lisp_Object);
 enum FLOAT_TO_STRING_BUFSIZE { FLOAT_TO_STRING_BUFSIZE = 350 };
 extern int float_to_string (char *, double);
+extern void mark_print_stack (void);
 extern void init_print_once (void);
 extern void syms_of_print (void);
 
@@ -3824,6 +3816,7 @@ extern Lisp_Object string_to_number (char const *, int, bool);
 extern void map_obarray (Lisp_Object, void (*) (Lisp_Object, Lisp_Object),
                          Lisp_Object);
 extern void dir_warning (const char *, Lisp_Object);
+extern void mark_data_frames (void);
 extern void init_obarray (void);
 extern void init_lread (void);
 extern void syms_of_lread (void);
@@ -3936,9 +3929,10 @@ extern void set_time_zone_rule (const char *);
 /* Defined in buffer.c.  */
 extern bool mouse_face_overlay_overlaps (Lisp_Object);
 extern _Noreturn void nsberror (Lisp_Object);
-extern void adjust_overlays_for_insert (ptrdiff_t, ptrdiff_t);
+extern void adjust_overlays_for_insert (ptrdiff_t, ptrdiff_t, bool);
 extern void adjust_overlays_for_delete (ptrdiff_t, ptrdiff_t);
-extern void fix_start_end_in_overlays (ptrdiff_t, ptrdiff_t);
+extern void record_overlay_adjustments (ptrdiff_t, ptrdiff_t);
+extern void transpose_overlays (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t);
 extern void report_overlay_modification (Lisp_Object, Lisp_Object, bool,
                                          Lisp_Object, Lisp_Object, Lisp_Object);
 extern bool overlay_touches_p (ptrdiff_t);
@@ -3954,9 +3948,16 @@ extern void keys_of_buffer (void);
 extern ptrdiff_t marker_position (Lisp_Object);
 extern ptrdiff_t marker_byte_position (Lisp_Object);
 extern void clear_charpos_cache (struct buffer *);
+extern void free_pos_index (struct buffer *);
+extern void adjust_pos_index_for_insert (ptrdiff_t, ptrdiff_t, ptrdiff_t);
+extern void adjust_pos_index_for_delete (ptrdiff_t, ptrdiff_t,
+					 ptrdiff_t, ptrdiff_t);
 extern ptrdiff_t buf_charpos_to_bytepos (struct buffer *, ptrdiff_t);
 extern ptrdiff_t buf_bytepos_to_charpos (struct buffer *, ptrdiff_t);
 extern void unchain_marker (struct Lisp_Marker *marker);
+extern void unchain_buffer_markers (struct buffer *);
+extern void attach_marker (struct Lisp_Marker *, struct buffer *,
+			   ptrdiff_t, ptrdiff_t);
 extern Lisp_Object set_marker_restricted (Lisp_Object, Lisp_Object, Lisp_Object);
 extern Lisp_Object set_marker_both (Lisp_Object, Lisp_Object, ptrdiff_t, ptrdiff_t);
 extern Lisp_Object set_marker_restricted_both (Lisp_Object, Lisp_Object,
@@ -3993,6 +3994,7 @@ extern Lisp_Object Qdelete_file;
 
 /* Defined in search.c.  */
 extern void shrink_regexp_cache (void);
+extern void mark_regexp_cache (void);
 extern void restore_search_regs (void);
 extern void record_unwind_save_match_data (void);
 struct re_registers;
@@ -4013,6 +4015,12 @@ extern ptrdiff_t find_newline_no_quit (ptrdiff_t, ptrdiff_t,
 				       ptrdiff_t, ptrdiff_t *);
 extern ptrdiff_t find_before_next_newline (ptrdiff_t, ptrdiff_t,
 					   ptrdiff_t, ptrdiff_t *);
+extern void free_newline_index (struct buffer *);
+extern void adjust_newline_index_for_insert (ptrdiff_t, ptrdiff_t);
+extern void adjust_newline_index_for_delete (ptrdiff_t, ptrdiff_t);
+extern void invalidate_newline_index (struct buffer *, ptrdiff_t, ptrdiff_t);
+extern bool find_newline_by_index (ptrdiff_t, ptrdiff_t, ptrdiff_t,
+				   ptrdiff_t *, ptrdiff_t *);
 extern void syms_of_search (void);
 extern void clear_regexp_cache (void);
 
@@ -4121,6 +4129,11 @@ extern void shut_down_emacs (int, Lisp_Object);
 /* True means don't do interactive redisplay and don't change tty modes.  */
 extern bool noninteractive;
 
+/* True means record the startup trace.  */
+extern bool startup_trace;
+extern void startup_trace_begin (char const *);
+extern void startup_trace_end (void);
+
 /* True means remove site-lisp directories from load-path.  */
 extern bool no_site_lisp;
 
@@ -4177,6 +4190,7 @@ extern void syms_of_callproc (void);
 extern Lisp_Object Qfunction_documentation;
 extern Lisp_Object read_doc_string (Lisp_Object);
 extern Lisp_Object get_doc_string (Lisp_Object, bool, bool);
+extern void init_doc (void);
 extern void syms_of_doc (void);
 extern int read_bytecode_char (bool);
 
@@ -4198,9 +4212,14 @@ extern void syms_of_macros (void);
 extern Lisp_Object Qapply;
 extern Lisp_Object Qinhibit_read_only;
 extern void truncate_undo_list (struct buffer *);
+extern Lisp_Object flush_undo_journal (struct buffer *);
+extern void free_undo_journal (struct buffer *);
+extern void mark_undo_journal (struct buffer *);
 extern void record_marker_adjustment (Lisp_Object, ptrdiff_t);
+extern void record_overlay_adjustment (Lisp_Object, ptrdiff_t, ptrdiff_t);
 extern void record_insert (ptrdiff_t, ptrdiff_t);
 extern void record_delete (ptrdiff_t, Lisp_Object);
+extern void record_delete_text (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t);
 extern void record_first_change (void);
 extern void record_change (ptrdiff_t, ptrdiff_t);
 extern void record_property_change (ptrdiff_t, ptrdiff_t,
@@ -247,8 +247,8 @@ readchar (Lisp_Object readcharfun, bool *multibyte)
 	  bytepos++;
 	}
 
-      XMARKER (readcharfun)->bytepos = bytepos;
-      XMARKER (readcharfun)->charpos++;
+      attach_marker (XMARKER (readcharfun), inbuffer,
+		     marker_position (readcharfun) + 1, bytepos);
 
       return c;
     }
@@ -412,15 +412,15 @@ unreadchar (Lisp_Object readcharfun, int c)
   else if (MARKERP (readcharfun))
     {
       struct buffer *b = XMARKER (readcharfun)->buffer;
-      ptrdiff_t bytepos = XMARKER (readcharfun)->bytepos;
+      ptrdiff_t bytepos = marker_byte_position (readcharfun);
 
-      XMARKER (readcharfun)->charpos--;
       if (! NILP (BVAR (b, enable_multibyte_characters)))
 	BUF_DEC_POS (b, bytepos);
       else
 	bytepos--;
 
-      XMARKER (readcharfun)->bytepos = bytepos;
+      attach_marker (XMARKER (readcharfun), b,
+		     marker_position (readcharfun) - 1, bytepos);
     }
   else if (STRINGP (readcharfun))
     {
@@ -1179,6 +1179,12 @@ Return t if the file exists and loads successfully.  */)
 #endif
     }
 
+  if (startup_trace)
+    {
+      startup_trace_begin (SSDATA (found));
+      record_unwind_protect_void (startup_trace_end);
+    }
+
   if (fd < 0)
     {
       /* Pacify older GCC with --enable-gcc-warnings.  */
@@ -3738,6 +3744,532 @@ read_list (bool flag, Lisp_Object readcharfun)
     }
 }
 
+/* Fast reader for data.
+
+   `read-data' reads the printed representation of data, such as the
+   contents of savehist or recentf files, directly from the bytes of a
+   string or buffer.  Lists, vectors, quote, strings, symbols and
+   numbers are handled here without going through READCHAR; anything
+   else (the `#' and `?' syntaxes, backquotes, unusual escape
+   sequences, non-ASCII symbol names) is read by the general reader,
+   one subform at a time.  If the text is not valid data, or uses
+   `#N=' labels, the whole object is reread by the general reader so
+   that the result and any error are exactly those of `read'.  */
+
+struct data_reader
+{
+  /* The string or buffer being read.  */
+  Lisp_Object source;
+
+  /* Where reading started, and the byte position after the last byte
+     to read.  For strings, positions are 0-based indices.  */
+  ptrdiff_t start, start_byte, end, end_byte;
+
+  /* The next byte to read.  */
+  ptrdiff_t pos_byte;
+
+  /* True if the source is multibyte.  */
+  bool multibyte;
+};
+
+/* A list, vector or quote being read by read_data.  The objects of
+   the frames in use are marked by mark_data_frames, since they are
+   not on the C stack.  */
+struct data_frame
+{
+  enum { DATA_LIST, DATA_VECTOR, DATA_QUOTE } kind;
+
+  /* For lists, whether a dot was read, and whether the object after
+     it was read as well.  */
+  enum { DATA_NO_DOT, DATA_DOT, DATA_DOT_TAIL } dot;
+
+  /* The elements read so far, and the last cons of HEAD.  */
+  Lisp_Object head, tail;
+
+  /* The number of elements in HEAD.  */
+  ptrdiff_t count;
+};
+
+static struct data_frame *data_frames;
+static ptrdiff_t data_frames_size;
+
+/* The number of frames in use.  This is reset at the start of each
+   read, so after a nonlocal exit the frames of an abandoned read are
+   marked only until the next one.  */
+static ptrdiff_t data_frames_used;
+
+/* Mark the objects of the frames of read_data in use.  */
+
+void
+mark_data_frames (void)
+{
+  ptrdiff_t i;
+
+  for (i = 0; i < data_frames_used; i++)
+    {
+      mark_object (data_frames[i].head);
+      mark_object (data_frames[i].tail);
+    }
+}
+
+/* Return true if the ASCII byte C ends a symbol or number.  */
+
+static bool
+data_delimiter_p (int c)
+{
+  switch (c)
+    {
+    case '"': case '\'': case ';': case '(': case ')':
+    case '[': case ']': case '#': case '`': case ',':
+      return 1;
+    default:
+      return c <= 040;
+    }
+}
+
+/* Return a pointer P such that P[BYTEPOS] is the byte at BYTEPOS in
+   RD's source.  Allocation can relocate buffer text, so call this
+   again after allocating.  */
+
+static unsigned char *
+data_reader_base (struct data_reader *rd)
+{
+  if (STRINGP (rd->source))
+    return SDATA (rd->source);
+  return BYTE_POS_ADDR (rd->start_byte) - rd->start_byte;
+}
+
+/* Return the character position corresponding to BYTEPOS in RD.  */
+
+static ptrdiff_t
+data_reader_charpos (struct data_reader *rd, ptrdiff_t bytepos)
+{
+  if (STRINGP (rd->source))
+    return string_byte_to_char (rd->source, bytepos);
+  return BYTE_TO_CHAR (bytepos);
+}
+
+/* Read one object at RD's position with the general reader, and
+   advance the position past it.  */
+
+static Lisp_Object
+read_data_general (struct data_reader *rd)
+{
+  ptrdiff_t pos = data_reader_charpos (rd, rd->pos_byte);
+  Lisp_Object val;
+
+  if (STRINGP (rd->source))
+    {
+      val = read_internal_start (rd->source, make_number (pos),
+				 make_number (rd->end));
+      rd->pos_byte = read_from_string_index_byte;
+    }
+  else
+    {
+      SET_PT_BOTH (pos, rd->pos_byte);
+      val = read_internal_start (Fcurrent_buffer (), Qnil, Qnil);
+      rd->pos_byte = PT_BYTE;
+    }
+  return val;
+}
+
+/* Read a string whose opening quote is at RD's position.  Return nil
+   and leave the position unchanged if the string needs the general
+   reader.  */
+
+static Lisp_Object
+read_data_string (struct data_reader *rd)
+{
+  unsigned char *base = data_reader_base (rd);
+  ptrdiff_t from = rd->pos_byte + 1, i = from;
+  ptrdiff_t nchars = 0;
+  bool escapes = 0, nonascii = 0;
+  Lisp_Object val;
+
+  for (; i < rd->end_byte; i++)
+    {
+      int c = base[i];
+
+      if (c == '"')
+	break;
+      if (c == '\\')
+	{
+	  if (++i == rd->end_byte
+	      || ! strchr ("\"\\abdefnrtv \n", base[i]))
+	    return Qnil;
+	  escapes = 1;
+	}
+      else if (! ASCII_BYTE_P (c))
+	{
+	  /* Leave unibyte sources and raw 8-bit bytes to the general
+	     reader.  */
+	  if (! rd->multibyte || c == 0xC0 || c == 0xC1)
+	    return Qnil;
+	  nonascii = 1;
+	}
+      if (! CHAR_HEAD_P (c))
+	continue;
+      nchars++;
+    }
+  if (i == rd->end_byte)
+    return Qnil;
+
+  rd->pos_byte = i + 1;
+  if (! escapes)
+    {
+      val = (nonascii
+	     ? make_uninit_multibyte_string (nchars, i - from)
+	     : make_uninit_string (i - from));
+      memcpy (SDATA (val), data_reader_base (rd) + from, i - from);
+      return val;
+    }
+  else
+    {
+      char *p;
+      ptrdiff_t j;
+
+      if (read_buffer_size < i - from)
+	{
+	  read_buffer = xpalloc (read_buffer, &read_buffer_size,
+				 i - from - read_buffer_size, -1, 1);
+	  base = data_reader_base (rd);
+	}
+      p = read_buffer;
+      nchars = 0;
+      for (j = from; j < i; j++)
+	{
+	  int c = base[j];
+
+	  if (c == '\\')
+	    {
+	      switch (base[++j])
+		{
+		case 'a': c = '\007'; break;
+		case 'b': c = '\b'; break;
+		case 'd': c = 0177; break;
+		case 'e': c = 033; break;
+		case 'f': c = '\f'; break;
+		case 'n': c = '\n'; break;
+		case 'r': c = '\r'; break;
+		case 't': c = '\t'; break;
+		case 'v': c = '\v'; break;
+		case ' ': case '\n': continue;
+		default: c = base[j]; break;
+		}
+	    }
+	  *p++ = c;
+	  nchars += CHAR_HEAD_P (c);
+	}
+      return make_specified_string (read_buffer, nchars, p - read_buffer,
+				    nonascii);
+    }
+}
+
+/* Read a symbol or a number that starts at RD's position.  Return nil
+   and leave the position unchanged if it needs the general reader;
+   set *DOT if it is a lone dot.  */
+
+static Lisp_Object
+read_data_atom (struct data_reader *rd, bool *dot)
+{
+  unsigned char *base = data_reader_base (rd);
+  ptrdiff_t from = rd->pos_byte, i = from, len;
+  bool digits = 1;
+  Lisp_Object val;
+
+  *dot = 0;
+  for (; i < rd->end_byte; i++)
+    {
+      int c = base[i];
+
+      if (! ASCII_BYTE_P (c) || c == '\\')
+	return Qnil;
+      if (data_delimiter_p (c))
+	break;
+      if (! ('0' <= c && c <= '9')
+	  && ! (i == from && (c == '-' || c == '+')))
+	digits = 0;
+    }
+  len = i - from;
+
+  if (len == 1 && base[from] == '.')
+    {
+      /* Like read1, this is a dot only if followed by a character
+	 that cannot continue a symbol.  */
+      if (i < rd->end_byte && ! strchr ("\"';([#?`, \t\n\f\r", base[i])
+	  && base[i] > 040)
+	return Qnil;
+      rd->pos_byte = i;
+      *dot = 1;
+      return Qnil;
+    }
+
+  rd->pos_byte = i;
+
+  /* Fast path for small decimal integers.  */
+  if (digits && len < INT_STRLEN_BOUND (EMACS_INT) - 1
+      && '0' <= base[i - 1] && base[i - 1] <= '9')
+    {
+      ptrdiff_t j = from + (base[from] == '-' || base[from] == '+');
+      EMACS_INT n = 0;
+
+      for (; j < i; j++)
+	n = 10 * n + (base[j] - '0');
+      if (n <= MOST_POSITIVE_FIXNUM)
+	return make_number (base[from] == '-' ? -n : n);
+    }
+
+  if (read_buffer_size <= len)
+    {
+      read_buffer = xpalloc (read_buffer, &read_buffer_size,
+			     len + 1 - read_buffer_size, -1, 1);
+      base = data_reader_base (rd);
+    }
+  memcpy (read_buffer, base + from, len);
+  read_buffer[len] = 0;
+
+  val = string_to_number (read_buffer, 10, 0);
+  if (NILP (val))
+    {
+      Lisp_Object obarray = check_obarray (Vobarray);
+      val = oblookup (obarray, read_buffer, len, len);
+      if (! SYMBOLP (val))
+	val = Fintern (make_specified_string (read_buffer, len, len,
+					      rd->multibyte),
+		       obarray);
+    }
+  return val;
+}
+
+/* Read one object from RD.  */
+
+static Lisp_Object
+read_data (struct data_reader *rd)
+{
+  struct data_frame *f;
+  Lisp_Object obj;
+
+  data_frames_used = 0;
+  for (;;)
+    {
+      unsigned char *base = data_reader_base (rd);
+      ptrdiff_t i = rd->pos_byte;
+      bool dot;
+      int c;
+
+      /* Skip whitespace and comments.  */
+      for (; i < rd->end_byte; i++)
+	{
+	  c = base[i];
+	  if (c == ';')
+	    {
+	      unsigned char *nl = memchr (base + i, '\n', rd->end_byte - i);
+	      if (! nl)
+		i = rd->end_byte;
+	      else
+		i = nl - base;
+	    }
+	  else if (c > 040)
+	    break;
+	}
+      rd->pos_byte = i;
+      if (i == rd->end_byte)
+	goto general;
+
+      switch (c)
+	{
+	case '(':
+	case '[':
+	case '\'':
+	  rd->pos_byte++;
+	  if (data_frames_used == data_frames_size)
+	    data_frames = xpalloc (data_frames, &data_frames_size, 1, -1,
+				   sizeof *data_frames);
+	  f = &data_frames[data_frames_used++];
+	  f->kind = c == '(' ? DATA_LIST : c == '[' ? DATA_VECTOR : DATA_QUOTE;
+	  f->dot = DATA_NO_DOT;
+	  f->head = f->tail = Qnil;
+	  f->count = 0;
+	  continue;
+
+	case ')':
+	case ']':
+	  if (data_frames_used == 0)
+	    goto general;
+	  f = &data_frames[data_frames_used - 1];
+	  if (f->kind != (c == ')' ? DATA_LIST : DATA_VECTOR)
+	      || f->dot == DATA_DOT)
+	    goto general;
+	  rd->pos_byte++;
+	  data_frames_used--;
+	  if (f->kind == DATA_LIST)
+	    obj = f->head;
+	  else
+	    {
+	      ptrdiff_t n;
+	      Lisp_Object tem = f->head;
+
+	      obj = make_uninit_vector (f->count);
+	      for (n = 0; n < f->count; n++, tem = XCDR (tem))
+		ASET (obj, n, XCAR (tem));
+	    }
+	  break;
+
+	case '"':
+	  obj = read_data_string (rd);
+	  if (rd->pos_byte == i)
+	    goto subform;
+	  break;
+
+	case '#':
+	  /* `#N=' labels can be referred to from other subforms.  */
+	  if (i + 1 < rd->end_byte && '0' <= base[i + 1] && base[i + 1] <= '9')
+	    goto general;
+	  /* Fall through.  */
+	case '?':
+	case '`':
+	case ',':
+	subform:
+	  obj = read_data_general (rd);
+	  if (! NILP (read_objects))
+	    goto general;
+	  break;
+
+	default:
+	  obj = read_data_atom (rd, &dot);
+	  if (dot)
+	    {
+	      /* A dot must follow at least one element of a list.  */
+	      if (data_frames_used == 0)
+		goto general;
+	      f = &data_frames[data_frames_used - 1];
+	      if (f->kind != DATA_LIST || f->dot != DATA_NO_DOT
+		  || f->count == 0)
+		goto general;
+	      f->dot = DATA_DOT;
+	      continue;
+	    }
+	  if (rd->pos_byte == i)
+	    goto subform;
+	  break;
+	}
+
+      /* OBJ is complete; add it to the innermost open list, vector
+	 or quote.  */
+      while (data_frames_used > 0
+	     && data_frames[data_frames_used - 1].kind == DATA_QUOTE)
+	{
+	  obj = list2 (Qquote, obj);
+	  data_frames_used--;
+	}
+      if (data_frames_used == 0)
+	return obj;
+
+      f = &data_frames[data_frames_used - 1];
+      if (f->dot == DATA_DOT)
+	{
+	  XSETCDR (f->tail, obj);
+	  f->dot = DATA_DOT_TAIL;
+	}
+      else if (f->dot == DATA_DOT_TAIL)
+	goto general;
+      else
+	{
+	  Lisp_Object tem = list1 (obj);
+	  if (NILP (f->tail))
+	    f->head = tem;
+	  else
+	    XSETCDR (f->tail, tem);
+	  f->tail = tem;
+	  f->count++;
+	}
+    }
+
+ general:
+  /* Let the general reader handle the whole object, so as to get its
+     result or its error.  */
+  data_frames_used = 0;
+  rd->pos_byte = rd->start_byte;
+  return read_data_general (rd);
+}
+
+DEFUN ("read-data", Fread_data, Sread_data, 1, 3, 0,
+       doc: /* Read one Lisp object from the text of SOURCE, a string or buffer.
+This is like `read-from-string', but faster for large amounts of data,
+such as lists of strings, symbols and numbers saved by `prin1'.  The
+result is the same as with `read-from-string', except that
+`read-with-symbol-positions' is ignored.
+
+START and END optionally delimit the text to read.  For a string, they
+default to 0 and (length SOURCE), as in `read-from-string'.  For a
+buffer, they default to point and the end of the accessible portion.
+
+Returns a cons: (OBJECT-READ . FINAL-POSITION), where FINAL-POSITION
+is the string index or buffer position of the character following the
+text that was read.  Point is not moved.  */)
+  (Lisp_Object source, Lisp_Object start, Lisp_Object end)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  struct data_reader rd;
+  Lisp_Object val;
+
+  rd.source = source;
+  if (STRINGP (source))
+    {
+      rd.end = SCHARS (source);
+      if (!NILP (end))
+	{
+	  CHECK_NUMBER (end);
+	  if (! (0 <= XINT (end) && XINT (end) <= rd.end))
+	    args_out_of_range (source, end);
+	  rd.end = XINT (end);
+	}
+      rd.start = 0;
+      if (!NILP (start))
+	{
+	  CHECK_NUMBER (start);
+	  if (! (0 <= XINT (start) && XINT (start) <= rd.end))
+	    args_out_of_range (source, start);
+	  rd.start = XINT (start);
+	}
+      rd.start_byte = string_char_to_byte (source, rd.start);
+      rd.end_byte = string_char_to_byte (source, rd.end);
+      rd.multibyte = STRING_MULTIBYTE (source);
+    }
+  else
+    {
+      CHECK_BUFFER (source);
+      if (!BUFFER_LIVE_P (XBUFFER (source)))
+	error ("Reading from killed buffer");
+      record_unwind_current_buffer ();
+      set_buffer_internal (XBUFFER (source));
+      record_unwind_protect (save_excursion_restore, save_excursion_save ());
+      record_unwind_protect (save_restriction_restore,
+			     save_restriction_save ());
+
+      if (NILP (start))
+	XSETFASTINT (start, PT);
+      if (NILP (end))
+	XSETFASTINT (end, ZV);
+      validate_region (&start, &end);
+      Fnarrow_to_region (start, end);
+      rd.start = BEGV;
+      rd.end = ZV;
+      rd.start_byte = BEGV_BYTE;
+      rd.end_byte = ZV_BYTE;
+      rd.multibyte = !NILP (BVAR (current_buffer, enable_multibyte_characters));
+
+      /* Make the text contiguous.  */
+      if (rd.start_byte < GPT_BYTE && GPT_BYTE < rd.end_byte)
+	move_gap_both (rd.end, rd.end_byte);
+    }
+
+  rd.pos_byte = rd.start_byte;
+  val = read_data (&rd);
+  val = Fcons (val, make_number (data_reader_charpos (&rd, rd.pos_byte)));
+  return unbind_to (count, val);
+}
+
 static Lisp_Object initial_obarray;
 
 /* `oblookup' stores the bucket number here, for the sake of Funintern.  */
@@ -4449,6 +4981,7 @@ syms_of_lread (void)
 {
   defsubr (&Sread);
   defsubr (&Sread_from_string);
+  defsubr (&Sread_data);
   defsubr (&Sintern);
   defsubr (&Sintern_soft);
   defsubr (&Sunintern);
@@ -76,12 +76,387 @@ clear_charpos_cache (struct buffer *b)
     cached_buffer = 0;
 }
 
+/* The position index of the text of a multibyte buffer divides the
+   text into blocks of whole characters, and records the number of
+   characters and bytes in each block.  The sums of these numbers over
+   the first blocks, kept in a Fenwick tree, give the block that holds
+   any character or byte position in O(log N) steps, along with the
+   positions of its ends, so that a conversion only has to scan part
+   of one block.
+
+   Insertions and deletions update the numbers of the blocks they touch
+   without looking at the text, so they can be recorded at any point
+   of an edit.  A block that insertions have made too large is split
+   when a conversion next looks into it, and blocks that deletions have
+   made too small are merged once there are too many of them.  */
+
+/* The size in bytes of the blocks made by scanning the text, and the
+   size beyond which a block is split.  */
+
+enum { POS_INDEX_BLOCK = 1024, POS_INDEX_BLOCK_MAX = 4 * POS_INDEX_BLOCK };
+
+struct pos_index_entry
+{
+  ptrdiff_t chars;
+  ptrdiff_t bytes;
+};
+
+struct pos_index
+{
+  /* The number of blocks, which is at least 1, and the number of
+     elements allocated for BLOCKS.  */
+  ptrdiff_t nblocks, size;
+
+  /* The characters and bytes of the whole text.  */
+  struct pos_index_entry total;
+
+  /* The characters and bytes of each block.  */
+  struct pos_index_entry *blocks;
+
+  /* The Fenwick tree: for I from 1 to NBLOCKS, SUMS[I] is the sum of
+     the blocks from I - (I & -I) to I - 1.  It has SIZE + 1
+     elements.  */
+  struct pos_index_entry *sums;
+};
+
+/* Free the position index of the text of B.  */
+
+void
+free_pos_index (struct buffer *b)
+{
+  struct pos_index *index = b->text->pos_index;
+
+  if (index)
+    {
+      xfree (index->blocks);
+      xfree (index->sums);
+      xfree (index);
+      b->text->pos_index = NULL;
+    }
+}
+
+/* Recompute the Fenwick tree of INDEX from its blocks.  */
+
+static void
+pos_index_rebuild_sums (struct pos_index *index)
+{
+  ptrdiff_t i, j, n = index->nblocks;
+
+  for (i = 1; i <= n; i++)
+    index->sums[i] = index->blocks[i - 1];
+  for (i = 1; i <= n; i++)
+    if ((j = i + (i & -i)) <= n)
+      {
+	index->sums[j].chars += index->sums[i].chars;
+	index->sums[j].bytes += index->sums[i].bytes;
+      }
+}
+
+/* Add CHARS characters and BYTES bytes to block BLOCK of INDEX.  */
+
+static void
+pos_index_add (struct pos_index *index, ptrdiff_t block,
+	       ptrdiff_t chars, ptrdiff_t bytes)
+{
+  ptrdiff_t i;
+
+  index->blocks[block].chars += chars;
+  index->blocks[block].bytes += bytes;
+  index->total.chars += chars;
+  index->total.bytes += bytes;
+  for (i = block + 1; i <= index->nblocks; i += i & -i)
+    {
+      index->sums[i].chars += chars;
+      index->sums[i].bytes += bytes;
+    }
+}
+
+/* Return the block of INDEX that holds POS, which counts the bytes
+   from the start of the text if BYTE, and the characters otherwise.
+   A position at the end of a block belongs to the next one, if any.
+   Store in *START the characters and bytes before the block.  */
+
+static ptrdiff_t
+pos_index_find (struct pos_index *index, ptrdiff_t pos, bool byte,
+		struct pos_index_entry *start)
+{
+  ptrdiff_t block = 0, step = 1;
+  struct pos_index_entry sum = { 0, 0 };
+
+  while (step <= index->nblocks / 2)
+    step *= 2;
+
+  /* Descend the tree to the last block that starts at or before POS.  */
+  for (; step > 0; step /= 2)
+    if (block + step <= index->nblocks)
+      {
+	struct pos_index_entry *s = &index->sums[block + step];
+
+	if ((byte ? sum.bytes + s->bytes : sum.chars + s->chars) <= pos)
+	  {
+	    block += step;
+	    sum.chars += s->chars;
+	    sum.bytes += s->bytes;
+	  }
+      }
+
+  /* POS is at the end of the text.  */
+  if (block == index->nblocks)
+    {
+      block--;
+      sum.chars -= index->blocks[block].chars;
+      sum.bytes -= index->blocks[block].bytes;
+    }
+
+  *start = sum;
+  return block;
+}
+
+/* Return the number of characters of B that start between FROM_BYTE
+   and TO_BYTE.  */
+
+static ptrdiff_t
+count_buffer_chars (struct buffer *b, ptrdiff_t from_byte, ptrdiff_t to_byte)
+{
+  ptrdiff_t chars = 0;
+
+  while (from_byte < to_byte)
+    {
+      /* Count up to the gap, then from its end.  */
+      ptrdiff_t stop = (from_byte < BUF_GPT_BYTE (b)
+			? min (to_byte, BUF_GPT_BYTE (b)) : to_byte);
+      unsigned char *p = BUF_BYTE_ADDRESS (b, from_byte);
+      unsigned char *end = p + (stop - from_byte);
+
+      for (; p < end; p++)
+	chars += CHAR_HEAD_P (*p);
+      from_byte = stop;
+    }
+
+  return chars;
+}
+
+/* Divide the text of B from FROM_BYTE to TO_BYTE, which are character
+   boundaries, into blocks of POS_INDEX_BLOCK bytes or a little more,
+   the last of which may be shorter.  Store them in BLOCKS, which has
+   room for them all, and return their number.  */
+
+static ptrdiff_t
+divide_buffer_text (struct buffer *b, ptrdiff_t from_byte, ptrdiff_t to_byte,
+		    struct pos_index_entry *blocks)
+{
+  ptrdiff_t n = 0;
+
+  while (from_byte < to_byte)
+    {
+      ptrdiff_t end = min (from_byte + POS_INDEX_BLOCK, to_byte);
+
+      while (end < to_byte && ! CHAR_HEAD_P (BUF_FETCH_BYTE (b, end)))
+	end++;
+      blocks[n].chars = count_buffer_chars (b, from_byte, end);
+      blocks[n].bytes = end - from_byte;
+      n++;
+      from_byte = end;
+    }
+
+  return n;
+}
+
+/* Make a position index for the text of B by scanning it.  Return it,
+   or NULL if the text is not valid multibyte text.  */
+
+static struct pos_index *
+build_pos_index (struct buffer *b)
+{
+  struct pos_index *index = xmalloc (sizeof *index);
+  ptrdiff_t i;
+
+  index->size = (BUF_Z_BYTE (b) - BUF_BEG_BYTE (b)) / POS_INDEX_BLOCK + 1;
+  index->blocks = xnmalloc (index->size, sizeof *index->blocks);
+  index->sums = xnmalloc (index->size + 1, sizeof *index->sums);
+  index->nblocks = divide_buffer_text (b, BUF_BEG_BYTE (b), BUF_Z_BYTE (b),
+				       index->blocks);
+  if (index->nblocks == 0)
+    {
+      index->blocks[0].chars = index->blocks[0].bytes = 0;
+      index->nblocks = 1;
+    }
+  index->total.chars = index->total.bytes = 0;
+  for (i = 0; i < index->nblocks; i++)
+    {
+      index->total.chars += index->blocks[i].chars;
+      index->total.bytes += index->blocks[i].bytes;
+    }
+  pos_index_rebuild_sums (index);
+  b->text->pos_index = index;
+
+  /* Counting the characters by their first bytes goes wrong if some
+     are malformed, as they can be while the text is being decoded.  */
+  if (index->total.chars != BUF_Z (b) - BUF_BEG (b))
+    {
+      free_pos_index (b);
+      return NULL;
+    }
+
+  return index;
+}
+
+/* Split block BLOCK of the index INDEX of B, which starts at
+   START_BYTE, into blocks of the usual size.  */
+
+static void
+split_pos_index_block (struct buffer *b, struct pos_index *index,
+		       ptrdiff_t block, ptrdiff_t start_byte)
+{
+  ptrdiff_t bytes = index->blocks[block].bytes;
+  struct pos_index_entry *pieces
+    = xnmalloc (bytes / POS_INDEX_BLOCK + 1, sizeof *pieces);
+  ptrdiff_t n = divide_buffer_text (b, start_byte, start_byte + bytes, pieces);
+
+  if (index->nblocks + n - 1 > index->size)
+    {
+      index->blocks = xpalloc (index->blocks, &index->size,
+			       index->nblocks + n - 1 - index->size, -1,
+			       sizeof *index->blocks);
+      index->sums = xnrealloc (index->sums, index->size + 1,
+			       sizeof *index->sums);
+    }
+  memmove (index->blocks + block + n, index->blocks + block + 1,
+	   (index->nblocks - block - 1) * sizeof *index->blocks);
+  memcpy (index->blocks + block, pieces, n * sizeof *pieces);
+  index->nblocks += n - 1;
+  xfree (pieces);
+  pos_index_rebuild_sums (index);
+}
+
+/* Merge the adjacent blocks of INDEX that are small enough, so that
+   the index has about as many blocks as a scan of the text makes.  */
+
+static void
+compact_pos_index (struct pos_index *index)
+{
+  ptrdiff_t i, n = 1;
+
+  for (i = 1; i < index->nblocks; i++)
+    {
+      struct pos_index_entry *last = &index->blocks[n - 1];
+
+      if (last->bytes + index->blocks[i].bytes <= 2 * POS_INDEX_BLOCK)
+	{
+	  last->chars += index->blocks[i].chars;
+	  last->bytes += index->blocks[i].bytes;
+	}
+      else
+	index->blocks[n++] = index->blocks[i];
+    }
+  index->nblocks = n;
+  pos_index_rebuild_sums (index);
+}
+
+/* Find the block of the position index of B that holds POS, counted
+   like BYTEPOS if BYTE and like CHARPOS otherwise.  Store the
+   positions of its start in *START and of its end in *END, and return
+   true.  Return false if B has no usable index.  */
+
+static bool
+find_pos_index_block (struct buffer *b, ptrdiff_t pos, bool byte,
+		      struct pos_index_entry *start,
+		      struct pos_index_entry *end)
+{
+  struct pos_index *index = b->text->pos_index;
+  ptrdiff_t block;
+
+  /* An index that does not account for the whole text has missed
+     some change to it.  */
+  if (index
+      && (index->total.chars != BUF_Z (b) - BUF_BEG (b)
+	  || index->total.bytes != BUF_Z_BYTE (b) - BUF_BEG_BYTE (b)))
+    free_pos_index (b);
+  if (! b->text->pos_index && ! build_pos_index (b))
+    return false;
+  index = b->text->pos_index;
+
+  pos -= byte ? BUF_BEG_BYTE (b) : BUF_BEG (b);
+  block = pos_index_find (index, pos, byte, start);
+  if (index->blocks[block].bytes > POS_INDEX_BLOCK_MAX)
+    {
+      split_pos_index_block (b, index, block, BUF_BEG_BYTE (b) + start->bytes);
+      block = pos_index_find (index, pos, byte, start);
+    }
+
+  start->chars += BUF_BEG (b);
+  start->bytes += BUF_BEG_BYTE (b);
+  end->chars = start->chars + index->blocks[block].chars;
+  end->bytes = start->bytes + index->blocks[block].bytes;
+  return true;
+}
+
+/* Record in the position index of the current buffer, if it has one,
+   an insertion at FROM of NCHARS characters and NBYTES bytes.  */
+
+void
+adjust_pos_index_for_insert (ptrdiff_t from, ptrdiff_t nchars, ptrdiff_t nbytes)
+{
+  struct pos_index *index = current_buffer->text->pos_index;
+  struct pos_index_entry start;
+
+  if (!index)
+    return;
+  from -= BEG;
+  if (from > index->total.chars)
+    free_pos_index (current_buffer);
+  else
+    pos_index_add (index, pos_index_find (index, from, false, &start),
+		   nchars, nbytes);
+}
+
+/* Record in the position index of the current buffer, if it has one,
+   the deletion of the text from FROM / FROM_BYTE to TO / TO_BYTE.  */
+
+void
+adjust_pos_index_for_delete (ptrdiff_t from, ptrdiff_t from_byte,
+			     ptrdiff_t to, ptrdiff_t to_byte)
+{
+  struct pos_index *index = current_buffer->text->pos_index;
+  struct pos_index_entry start;
+  ptrdiff_t block;
+
+  if (!index)
+    return;
+  from -= BEG, from_byte -= BEG_BYTE;
+  to -= BEG, to_byte -= BEG_BYTE;
+  if (to > index->total.chars || to_byte > index->total.bytes)
+    {
+      free_pos_index (current_buffer);
+      return;
+    }
+
+  /* Take from each block the part of it that is deleted.  */
+  for (block = pos_index_find (index, from, false, &start);
+       block < index->nblocks && start.chars < to;
+       block++)
+    {
+      struct pos_index_entry *b = &index->blocks[block];
+      ptrdiff_t chars = min (to, start.chars + b->chars) - max (from, start.chars);
+      ptrdiff_t bytes = (min (to_byte, start.bytes + b->bytes)
+			 - max (from_byte, start.bytes));
+
+      start.chars += b->chars;
+      start.bytes += b->bytes;
+      pos_index_add (index, block, -chars, -bytes);
+    }
+
+  if (index->nblocks > 2 * (index->total.bytes / POS_INDEX_BLOCK) + 8)
+    compact_pos_index (index);
+}
+
 /* Converting between character positions and byte positions.  */
 
 /* There are several places in the buffer where we know
    the correspondence: BEG, BEGV, PT, GPT, ZV and Z,
-   and everywhere there is a marker.  So we find the one of these places
-   that is closest to the specified position, and scan from there.  */
+   and the ends of each block of the position index.  So we find the
+   one of these places that is closest to the specified position, and
+   scan from there.  */
 
 /* This macro is a subroutine of buf_charpos_to_bytepos.
    Note that it is desirable that BYTEPOS is not evaluated
@@ -138,7 +513,6 @@ CHECK_MARKER (Lisp_Object x)
 ptrdiff_t
 buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
 {
-  struct Lisp_Marker *tail;
   ptrdiff_t best_above, best_above_byte;
   ptrdiff_t best_below, best_below_byte;
 
@@ -173,15 +547,17 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
   if (b == cached_buffer && BUF_MODIFF (b) == cached_modiff)
     CONSIDER (cached_charpos, cached_bytepos);
 
-  for (tail = BUF_MARKERS (b); tail; tail = tail->next)
+  /* If the known places are still far apart, use the ends of the
+     block of the position index that holds CHARPOS.  */
+  if (best_above - best_below > POS_INDEX_BLOCK)
     {
-      CONSIDER (tail->charpos, tail->bytepos);
+      struct pos_index_entry start, end;
 
-      /* If we are down to a range of 50 chars,
-	 don't bother checking any other markers;
-	 scan the intervening chars directly now.  */
-      if (best_above - best_below < 50)
-	break;
+      if (find_pos_index_block (b, charpos, false, &start, &end))
+	{
+	  CONSIDER (start.chars, start.bytes);
+	  CONSIDER (end.chars, end.bytes);
+	}
     }
 
   /* We get here if we did not exactly hit one of the known places.
@@ -190,20 +566,12 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
 
   if (charpos - best_below < best_above - charpos)
     {
-      bool record = charpos - best_below > 5000;
-
       while (best_below != charpos)
 	{
 	  best_below++;
 	  BUF_INC_POS (b, best_below_byte);
 	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.  */
-      if (record)
-	build_marker (b, best_below, best_below_byte);
-
       byte_char_debug_check (b, best_below, best_below_byte);
 
       cached_buffer = b;
@@ -215,20 +583,12 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
     }
   else
     {
-      bool record = best_above - charpos > 5000;
-
       while (best_above != charpos)
 	{
 	  best_above--;
 	  BUF_DEC_POS (b, best_above_byte);
 	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.  */
-      if (record)
-	build_marker (b, best_above, best_above_byte);
-
       byte_char_debug_check (b, best_above, best_above_byte);
 
       cached_buffer = b;
@@ -290,7 +650,6 @@ buf_charpos_to_bytepos (struct buffer *b, ptrdiff_t charpos)
 ptrdiff_t
 buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
 {
-  struct Lisp_Marker *tail;
   ptrdiff_t best_above, best_above_byte;
   ptrdiff_t best_below, best_below_byte;
 
@@ -316,15 +675,17 @@ buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
   if (b == cached_buffer && BUF_MODIFF (b) == cached_modiff)
     CONSIDER (cached_bytepos, cached_charpos);
 
-  for (tail = BUF_MARKERS (b); tail; tail = tail->next)
+  /* If the known places are still far apart, use the ends of the
+     block of the position index that holds BYTEPOS.  */
+  if (best_above_byte - best_below_byte > POS_INDEX_BLOCK)
     {
-      CONSIDER (tail->bytepos, tail->charpos);
+      struct pos_index_entry start, end;
 
-      /* If we are down to a range of 50 chars,
-	 don't bother checking any other markers;
-	 scan the intervening chars directly now.  */
-      if (best_above - best_below < 50)
-	break;
+      if (find_pos_index_block (b, bytepos, true, &start, &end))
+	{
+	  CONSIDER (start.bytes, start.chars);
+	  CONSIDER (end.bytes, end.chars);
+	}
     }
 
   /* We get here if we did not exactly hit one of the known places.
@@ -333,22 +694,12 @@ buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
 
   if (bytepos - best_below_byte < best_above_byte - bytepos)
     {
-      bool record = bytepos - best_below_byte > 5000;
-
       while (best_below_byte < bytepos)
 	{
 	  best_below++;
 	  BUF_INC_POS (b, best_below_byte);
 	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.
-	 But don't do it if BUF_MARKERS is nil;
-	 that is a signal from Fset_buffer_multibyte.  */
-      if (record && BUF_MARKERS (b))
-	build_marker (b, best_below, best_below_byte);
-
       byte_char_debug_check (b, best_below, best_below_byte);
 
       cached_buffer = b;
@@ -360,22 +711,12 @@ buf_bytepos_to_charpos (struct buffer *b, ptrdiff_t bytepos)
     }
   else
     {
-      bool record = best_above_byte - bytepos > 5000;
-
       while (best_above_byte > bytepos)
 	{
 	  best_above--;
 	  BUF_DEC_POS (b, best_above_byte);
 	}
 
-      /* If this position is quite far from the nearest known position,
-	 cache the correspondence by creating a marker here.
-	 It will last until the next GC.
-	 But don't do it if BUF_MARKERS is nil;
-	 that is a signal from Fset_buffer_multibyte.  */
-      if (record && BUF_MARKERS (b))
-	build_marker (b, best_above, best_above_byte);
-
       byte_char_debug_check (b, best_above, best_above_byte);
 
       cached_buffer = b;
@@ -418,34 +759,43 @@ Returns nil if MARKER points nowhere.  */)
 {
   CHECK_MARKER (marker);
   if (XMARKER (marker)->buffer)
-    return make_number (XMARKER (marker)->charpos);
+    return make_number (marker_charpos (XMARKER (marker)));
 
   return Qnil;
 }
 
-/* Change M so it points to B at CHARPOS and BYTEPOS.  */
+/* Change M so it points to B at CHARPOS and BYTEPOS.  Only CHARPOS is
+   recorded, and marker_bytepos computes the byte position when it is
+   needed; BYTEPOS is only checked, and is -1 if the caller lacks it.  */
 
-static void
+void
 attach_marker (struct Lisp_Marker *m, struct buffer *b,
 	       ptrdiff_t charpos, ptrdiff_t bytepos)
 {
   /* In a single-byte buffer, two positions must be equal.
      Otherwise, every character is at least one byte.  */
-  if (BUF_Z (b) == BUF_Z_BYTE (b))
+  if (bytepos < 0)
+    ;
+  else if (BUF_Z (b) == BUF_Z_BYTE (b))
     eassert (charpos == bytepos);
   else
     eassert (charpos <= bytepos);
 
-  m->charpos = charpos;
-  m->bytepos = bytepos;
-
-  if (m->buffer != b)
+  /* Markers in the indirect buffers of a buffer share its tree.  */
+  if (m->buffer && m->buffer->text == b->text)
+    itree_node_set_region (BUF_MARKERS (b), m->node, charpos, charpos);
+  else
     {
+      Lisp_Object marker;
+
       unchain_marker (m);
-      m->buffer = b;
-      m->next = BUF_MARKERS (b);
-      BUF_MARKERS (b) = m;
+      XSETMISC (marker, m);
+      m->node = xmalloc (sizeof *m->node);
+      itree_node_init (m->node, m->insertion_type, m->insertion_type,
+		       marker);
+      itree_insert (BUF_MARKERS (b), m->node, charpos, charpos);
     }
+  m->buffer = b;
 }
 
 /* If BUFFER is nil, return current buffer pointer.  Next, check
@@ -497,38 +847,27 @@ set_marker_internal (Lisp_Object marker, Lisp_Object position,
   else if (MARKERP (position) && b == XMARKER (position)->buffer
 	   && b == m->buffer)
     {
-      m->bytepos = XMARKER (position)->bytepos;
-      m->charpos = XMARKER (position)->charpos;
+      ptrdiff_t charpos = marker_charpos (XMARKER (position));
+
+      itree_node_set_region (BUF_MARKERS (b), m->node, charpos, charpos);
     }
 
   else
     {
-      register ptrdiff_t charpos, bytepos;
+      register ptrdiff_t charpos;
 
-      /* Do not use CHECK_NUMBER_COERCE_MARKER because we
-	 don't want to call buf_charpos_to_bytepos if POSITION
-	 is a marker and so we know the bytepos already.  */
       if (INTEGERP (position))
-	charpos = XINT (position), bytepos = -1;
+	charpos = XINT (position);
       else if (MARKERP (position))
-	{
-	  charpos = XMARKER (position)->charpos;
-	  bytepos = XMARKER (position)->bytepos;
-	}
+	charpos = marker_charpos (XMARKER (position));
       else
 	wrong_type_argument (Qinteger_or_marker_p, position);
 
       charpos = clip_to_bounds
 	(restricted ? BUF_BEGV (b) : BUF_BEG (b), charpos,
 	 restricted ? BUF_ZV (b) : BUF_Z (b));
-      if (bytepos == -1)
-	bytepos = buf_charpos_to_bytepos (b, charpos);
-      else
-	bytepos = clip_to_bounds
-	  (restricted ? BUF_BEGV_BYTE (b) : BUF_BEG_BYTE (b),
-	   bytepos, restricted ? BUF_ZV_BYTE (b) : BUF_Z_BYTE (b));
 
-      attach_marker (m, b, charpos, bytepos);
+      attach_marker (m, b, charpos, -1);
     }
   return marker;
 }
@@ -596,10 +935,10 @@ set_marker_restricted_both (Lisp_Object marker, Lisp_Object buffer,
   return marker;
 }
 
-/* Remove MARKER from the chain of whatever buffer it is in,
+/* Remove MARKER from the tree of whatever buffer it is in,
    leaving it points to nowhere.  This is called during garbage
    collection, so we must be careful to ignore and preserve
-   mark bits, including those in chain fields of markers.  */
+   mark bits; the tree itself is not part of any Lisp object.  */
 
 void
 unchain_marker (register struct Lisp_Marker *marker)
@@ -608,35 +947,41 @@ unchain_marker (register struct Lisp_Marker *marker)
 
   if (b)
     {
-      register struct Lisp_Marker *tail, **prev;
-
       /* No dead buffers here.  */
       eassert (BUFFER_LIVE_P (b));
 
+      itree_remove (BUF_MARKERS (b), marker->node);
+      xfree (marker->node);
+      marker->node = NULL;
       marker->buffer = NULL;
-      prev = &BUF_MARKERS (b);
+    }
+}
 
-      for (tail = BUF_MARKERS (b); tail; prev = &tail->next, tail = *prev)
-	if (marker == tail)
-	  {
-	    if (*prev == BUF_MARKERS (b))
-	      {
-		/* Deleting first marker from the buffer's chain.  Crash
-		   if new first marker in chain does not say it belongs
-		   to the same buffer, or at least that they have the same
-		   base buffer.  */
-		if (tail->next && b->text != tail->next->buffer->text)
-		  emacs_abort ();
-	      }
-	    *prev = tail->next;
-	    /* We have removed the marker from the chain;
-	       no need to scan the rest of the chain.  */
-	    break;
-	  }
+/* Make all the markers that point into buffer B point nowhere,
+   leaving those of the other buffers that share its text.  */
 
-      /* Error if marker was not in it's chain.  */
-      eassert (tail != NULL);
-    }
+void
+unchain_buffer_markers (struct buffer *b)
+{
+  struct itree_tree *tree = BUF_MARKERS (b);
+  struct itree_iterator iter;
+  struct itree_node *node, **nodes;
+  ptrdiff_t i, n = 0;
+  USE_SAFE_ALLOCA;
+
+  if (tree->size == 0)
+    return;
+
+  /* Unchaining a marker changes the tree, so collect them first.  */
+  SAFE_NALLOCA (nodes, 1, tree->size);
+  for (node = itree_iterator_start (&iter, tree, PTRDIFF_MIN, PTRDIFF_MAX);
+       node; node = itree_iterator_next (&iter))
+    if (XMARKER (node->data)->buffer == b)
+      nodes[n++] = node;
+  for (i = 0; i < n; i++)
+    unchain_marker (XMARKER (nodes[i]->data));
+
+  SAFE_FREE ();
 }
 
 /* Return the char position of marker MARKER, as a C integer.  */
@@ -646,13 +991,15 @@ marker_position (Lisp_Object marker)
 {
   register struct Lisp_Marker *m = XMARKER (marker);
   register struct buffer *buf = m->buffer;
+  ptrdiff_t charpos;
 
   if (!buf)
     error ("Marker does not point anywhere");
 
-  eassert (BUF_BEG (buf) <= m->charpos && m->charpos <= BUF_Z (buf));
+  charpos = marker_charpos (m);
+  eassert (BUF_BEG (buf) <= charpos && charpos <= BUF_Z (buf));
 
-  return m->charpos;
+  return charpos;
 }
 
 /* Return the byte position of marker MARKER, as a C integer.  */
@@ -666,9 +1013,7 @@ marker_byte_position (Lisp_Object marker)
   if (!buf)
     error ("Marker does not point anywhere");
 
-  eassert (BUF_BEG_BYTE (buf) <= m->bytepos && m->bytepos <= BUF_Z_BYTE (buf));
-
-  return m->bytepos;
+  return marker_bytepos (m);
 }
 
 DEFUN ("copy-marker", Fcopy_marker, Scopy_marker, 0, 2, 0,
@@ -720,16 +1065,14 @@ DEFUN ("buffer-has-markers-at", Fbuffer_has_markers_at, Sbuffer_has_markers_at,
        doc: /* Return t if there are markers pointing at POSITION in the current buffer.  */)
   (Lisp_Object position)
 {
-  register struct Lisp_Marker *tail;
+  struct itree_iterator iter;
   register ptrdiff_t charpos;
 
   charpos = clip_to_bounds (BEG, XINT (position), Z);
 
-  for (tail = BUF_MARKERS (current_buffer); tail; tail = tail->next)
-    if (tail->charpos == charpos)
-      return Qt;
-
-  return Qnil;
+  return (itree_iterator_start (&iter, BUF_MARKERS (current_buffer),
+				charpos, charpos)
+	  ? Qt : Qnil);
 }
 
 #ifdef MARKER_DEBUG
@@ -739,13 +1082,7 @@ DEFUN ("buffer-has-markers-at", Fbuffer_has_markers_at, Sbuffer_has_markers_at,
 int
 count_markers (struct buffer *buf)
 {
-  int total = 0;
-  struct Lisp_Marker *tail;
-
-  for (tail = BUF_MARKERS (buf); tail; tail = tail->next)
-    total++;
-
-  return total;
+  return BUF_MARKERS (buf)->size;
 }
 
 /* For debugging -- recompute the bytepos corresponding
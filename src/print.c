@@ -54,9 +54,10 @@ static ptrdiff_t print_depth;
 /* Level of nesting inside outputting backquote in new style.  */
 static ptrdiff_t new_backquote_output;
 
-/* Detect most circularities to print finite output.  */
-#define PRINT_CIRCLE 200
-static Lisp_Object being_printed[PRINT_CIRCLE];
+/* The objects being printed at each depth, to detect circularities
+   and print finite output when print-circle is nil.  */
+static Lisp_Object *being_printed;
+static ptrdiff_t being_printed_size;
 
 /* When printing into a buffer, first we put the text in this
    block, then insert it all at once.  */
@@ -492,8 +493,7 @@ temp_output_buffer_setup (const char *bufname)
   bset_read_only (current_buffer, Qnil);
   bset_filename (current_buffer, Qnil);
   bset_undo_list (current_buffer, Qt);
-  eassert (current_buffer->overlays_before == NULL);
-  eassert (current_buffer->overlays_after == NULL);
+  eassert (current_buffer->overlays.root == NULL);
   bset_enable_multibyte_characters
     (current_buffer, BVAR (&buffer_defaults, enable_multibyte_characters));
   specbind (Qinhibit_read_only, Qt);
@@ -1081,10 +1081,114 @@ float_to_string (char *buf, double data)
 }
 
 
+/* Entries in print_stack.  print_object and print_preprocess walk
+   lists, vectors and hash tables using this stack instead of the C
+   stack, so that printing deeply nested data cannot overflow it.  */
+
+enum print_entry_type
+  {
+    PE_list,			/* Printing the elements of a list.  */
+    PE_rbrac,			/* Print END when the next object is done.  */
+    PE_vector,			/* Printing the elements of a vector.  */
+    PE_hash,			/* Printing the data of a hash table.  */
+    PE_pp_list,			/* print_preprocess walking a list.  */
+    PE_pp_vector		/* print_preprocess walking a vector.  */
+  };
+
+struct print_stack_entry
+{
+  enum print_entry_type type;
+
+  /* The list tail or vector being walked.  */
+  Lisp_Object obj;
+
+  /* For lists, used to detect circularity as in print_object.  */
+  Lisp_Object halftail;
+
+  /* Number of elements already handled, or index of the next one.  */
+  ptrdiff_t n;
+
+  /* Number of elements to handle, and the real number of elements if
+     print-length truncates the output.  */
+  ptrdiff_t size, real_size;
+
+  /* For PE_rbrac, the text to print and the adjustment to
+     new_backquote_output to make afterwards.  */
+  const char *end;
+  int backquote;
+
+  /* For PE_hash, true if the value of element N - 1 comes next.  */
+  bool value_next;
+};
+
+static struct print_stack_entry *print_stack;
+static ptrdiff_t print_stack_size;
+static ptrdiff_t print_stack_sp;
+
+/* Push a new entry of type TYPE for OBJ onto print_stack and return it.
+   The result is valid only until the next push.  */
+
+static struct print_stack_entry *
+print_stack_push (enum print_entry_type type, Lisp_Object obj)
+{
+  struct print_stack_entry *e;
+
+  if (print_stack_sp == print_stack_size)
+    print_stack = xpalloc (print_stack, &print_stack_size, 1, -1,
+			   sizeof *print_stack);
+  e = &print_stack[print_stack_sp++];
+  e->type = type;
+  e->obj = obj;
+  e->halftail = Qnil;
+  e->n = e->size = e->real_size = 0;
+  e->end = "";
+  e->backquote = 0;
+  e->value_next = 0;
+  return e;
+}
+
+/* Push a PE_rbrac entry, printing END and adjusting
+   new_backquote_output by BACKQUOTE when the next object is done.  */
+
+static void
+print_stack_push_rbrac (const char *end, int backquote)
+{
+  struct print_stack_entry *e = print_stack_push (PE_rbrac, Qnil);
+  e->end = end;
+  e->backquote = backquote;
+}
+
+/* Pop print_stack back to SP, a fixnum, after a nonlocal exit from
+   print.  */
+
+static void
+print_stack_unwind (Lisp_Object sp)
+{
+  print_stack_sp = XFASTINT (sp);
+}
+
+/* Mark the objects on print_stack; a Lisp PRINTCHARFUN can cause a
+   garbage collection while they are being printed.  */
+
+void
+mark_print_stack (void)
+{
+  ptrdiff_t i;
+
+  for (i = 0; i < print_stack_sp; i++)
+    {
+      mark_object (print_stack[i].obj);
+      mark_object (print_stack[i].halftail);
+    }
+}
+
 static void
 print (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 {
+  ptrdiff_t count = SPECPDL_INDEX ();
+
   new_backquote_output = 0;
+  record_unwind_protect (print_stack_unwind, make_number (print_stack_sp));
 
   /* Reset print_number_index and Vprint_number_table only when
      the variable Vprint_continuous_numbering is nil.  Otherwise,
@@ -1120,6 +1224,26 @@ print (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 
   print_depth = 0;
   print_object (obj, printcharfun, escapeflag);
+  unbind_to (count, Qnil);
+}
+
+/* Return the depth at which OBJ is already being printed, if it is.
+   Otherwise, record OBJ as being printed at the current depth and
+   return -1.  */
+
+static ptrdiff_t
+print_being_printed (Lisp_Object obj)
+{
+  ptrdiff_t i;
+
+  for (i = 0; i < print_depth; i++)
+    if (EQ (obj, being_printed[i]))
+      return i;
+  if (print_depth == being_printed_size)
+    being_printed = xpalloc (being_printed, &being_printed_size, 1, -1,
+			     sizeof *being_printed);
+  being_printed[print_depth] = obj;
+  return -1;
 }
 
 #define PRINT_CIRCLE_CANDIDATE_P(obj)					\
@@ -1142,28 +1266,20 @@ print (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 static void
 print_preprocess (Lisp_Object obj)
 {
-  int i;
-  ptrdiff_t size;
-  int loop_count = 0;
+  ptrdiff_t base_sp = print_stack_sp;
+  struct print_stack_entry *e;
+  ptrdiff_t loop_count;
   Lisp_Object halftail;
 
+ walk:
   /* Avoid infinite recursion for circular nested structure
      in the case where Vprint_circle is nil.  */
-  if (NILP (Vprint_circle))
-    {
-      /* Give up if we go so deep that print_object will get an error.  */
-      /* See similar code in print_object.  */
-      if (print_depth >= PRINT_CIRCLE)
-	error ("Apparently circular structure being printed");
-
-      for (i = 0; i < print_depth; i++)
-	if (EQ (obj, being_printed[i]))
-	  return;
-      being_printed[print_depth] = obj;
-    }
+  if (NILP (Vprint_circle) && print_being_printed (obj) >= 0)
+    goto next;
 
   print_depth++;
   halftail = obj;
+  loop_count = 0;
 
  loop:
   if (PRINT_CIRCLE_CANDIDATE_P (obj))
@@ -1197,7 +1313,7 @@ print_preprocess (Lisp_Object obj)
 			    Vprint_number_table);
 		}
 	      print_depth--;
-	      return;
+	      goto next;
 	    }
 	  else
 	    /* OBJ is not yet recorded.  Let's add to the table.  */
@@ -1217,33 +1333,57 @@ print_preprocess (Lisp_Object obj)
 	     just as in print_object.  */
 	  if (loop_count && EQ (obj, halftail))
 	    break;
-	  print_preprocess (XCAR (obj));
-	  obj = XCDR (obj);
-	  loop_count++;
-	  if (!(loop_count & 1))
-	    halftail = XCDR (halftail);
-	  goto loop;
+	  e = print_stack_push (PE_pp_list, obj);
+	  e->halftail = halftail;
+	  e->n = loop_count;
+	  obj = XCAR (obj);
+	  goto walk;
 
 	case Lisp_Vectorlike:
-	  size = ASIZE (obj);
-	  if (size & PSEUDOVECTOR_FLAG)
-	    size &= PSEUDOVECTOR_SIZE_MASK;
-	  for (i = 0; i < size; i++)
-	    print_preprocess (AREF (obj, i));
-	  if (HASH_TABLE_P (obj))
-	    { /* For hash tables, the key_and_value slot is past
-		 `size' because it needs to be marked specially in case
-		 the table is weak.  */
-	      struct Lisp_Hash_Table *h = XHASH_TABLE (obj);
-	      print_preprocess (h->key_and_value);
-	    }
-	  break;
+	  e = print_stack_push (PE_pp_vector, obj);
+	  e->size = ASIZE (obj);
+	  if (e->size & PSEUDOVECTOR_FLAG)
+	    e->size &= PSEUDOVECTOR_SIZE_MASK;
+	  goto next;
 
 	default:
 	  break;
 	}
     }
   print_depth--;
+
+ next:
+  if (print_stack_sp == base_sp)
+    return;
+  e = &print_stack[print_stack_sp - 1];
+  if (e->type == PE_pp_list)
+    {
+      /* The car is done; go on with the cdr at the same depth.  */
+      obj = XCDR (e->obj);
+      halftail = e->halftail;
+      loop_count = e->n + 1;
+      if (!(loop_count & 1))
+	halftail = XCDR (halftail);
+      print_stack_sp--;
+      goto loop;
+    }
+  if (e->n < e->size)
+    {
+      obj = AREF (e->obj, e->n);
+      e->n++;
+      goto walk;
+    }
+  if (HASH_TABLE_P (e->obj) && e->n == e->size)
+    { /* For hash tables, the key_and_value slot is past
+	 `size' because it needs to be marked specially in case
+	 the table is weak.  */
+      obj = XHASH_TABLE (e->obj)->key_and_value;
+      e->n++;
+      goto walk;
+    }
+  print_stack_sp--;
+  print_depth--;
+  goto next;
 }
 
 static void
@@ -1334,30 +1474,26 @@ print_prune_string_charset (Lisp_Object string)
 static void
 print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 {
+  ptrdiff_t base_sp = print_stack_sp;
   char buf[max (sizeof "from..to..in " + 2 * INT_STRLEN_BOUND (EMACS_INT),
 		max (sizeof " . #" + INT_STRLEN_BOUND (printmax_t),
 		     40))];
 
+ print_obj:
   QUIT;
 
   /* Detect circularities and truncate them.  */
   if (NILP (Vprint_circle))
     {
       /* Simple but incomplete way.  */
-      int i;
-
-      /* See similar code in print_preprocess.  */
-      if (print_depth >= PRINT_CIRCLE)
-	error ("Apparently circular structure being printed");
+      ptrdiff_t i = print_being_printed (obj);
 
-      for (i = 0; i < print_depth; i++)
-	if (EQ (obj, being_printed[i]))
-	  {
-	    int len = sprintf (buf, "#%d", i);
-	    strout (buf, len, len, printcharfun);
-	    return;
-	  }
-      being_printed[print_depth] = obj;
+      if (i >= 0)
+	{
+	  int len = sprintf (buf, "#%"pD"d", i);
+	  strout (buf, len, len, printcharfun);
+	  goto next_obj;
+	}
     }
   else if (PRINT_CIRCLE_CANDIDATE_P (obj))
     {
@@ -1379,7 +1515,7 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 	      /* Just print #n# if OBJ has already been printed.  */
 	      int len = sprintf (buf, "#%"pI"d#", n);
 	      strout (buf, len, len, printcharfun);
-	      return;
+	      goto next_obj;
 	    }
 	}
     }
@@ -1436,6 +1572,33 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 		 corresponding character code before handing it to PRINTCHAR.  */
 	      int c;
 
+	      /* Output a run of ASCII characters that need no escapes
+		 with one call to strout, when that cannot relocate
+		 OBJ.  */
+	      if (!need_nonhex
+		  && (NILP (printcharfun)
+		      || (noninteractive && EQ (printcharfun, Qt))))
+		{
+		  unsigned char *p = SDATA (obj) + i_byte;
+		  ptrdiff_t run = 0;
+
+		  while (i_byte + run < size_byte)
+		    {
+		      c = p[run];
+		      if (! ASCII_BYTE_P (c) || c == '\"' || c == '\\'
+			  || ((c == '\n' || c == '\f') && print_escape_newlines))
+			break;
+		      run++;
+		    }
+		  if (run)
+		    {
+		      strout ((char *) p, run, run, printcharfun);
+		      i += run;
+		      i_byte += run;
+		      continue;
+		    }
+		}
+
 	      FETCH_STRING_CHAR_ADVANCE (c, obj, i, i_byte);
 
 	      QUIT;
@@ -1593,22 +1756,27 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 	       && (EQ (XCAR (obj), Qquote)))
 	{
 	  PRINTCHAR ('\'');
-	  print_object (XCAR (XCDR (obj)), printcharfun, escapeflag);
+	  print_stack_push_rbrac ("", 0);
+	  obj = XCAR (XCDR (obj));
+	  goto print_obj;
 	}
       else if (print_quoted && CONSP (XCDR (obj)) && NILP (XCDR (XCDR (obj)))
 	       && (EQ (XCAR (obj), Qfunction)))
 	{
 	  PRINTCHAR ('#');
 	  PRINTCHAR ('\'');
-	  print_object (XCAR (XCDR (obj)), printcharfun, escapeflag);
+	  print_stack_push_rbrac ("", 0);
+	  obj = XCAR (XCDR (obj));
+	  goto print_obj;
 	}
       else if (print_quoted && CONSP (XCDR (obj)) && NILP (XCDR (XCDR (obj)))
 	       && ((EQ (XCAR (obj), Qbackquote))))
 	{
 	  print_object (XCAR (obj), printcharfun, 0);
 	  new_backquote_output++;
-	  print_object (XCAR (XCDR (obj)), printcharfun, escapeflag);
-	  new_backquote_output--;
+	  print_stack_push_rbrac ("", -1);
+	  obj = XCAR (XCDR (obj));
+	  goto print_obj;
 	}
       else if (print_quoted && CONSP (XCDR (obj)) && NILP (XCDR (XCDR (obj)))
 	       && new_backquote_output
@@ -1619,80 +1787,27 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 	{
 	  print_object (XCAR (obj), printcharfun, 0);
 	  new_backquote_output--;
-	  print_object (XCAR (XCDR (obj)), printcharfun, escapeflag);
-	  new_backquote_output++;
+	  print_stack_push_rbrac ("", 1);
+	  obj = XCAR (XCDR (obj));
+	  goto print_obj;
 	}
       else
 	{
-	  PRINTCHAR ('(');
-
-	  {
-	    printmax_t i, print_length;
-	    Lisp_Object halftail = obj;
-
-	    /* Negative values of print-length are invalid in CL.
-	       Treat them like nil, as CMUCL does.  */
-	    if (NATNUMP (Vprint_length))
-	      print_length = XFASTINT (Vprint_length);
-	    else
-	      print_length = TYPE_MAXIMUM (printmax_t);
-
-	    i = 0;
-	    while (CONSP (obj))
-	      {
-		/* Detect circular list.  */
-		if (NILP (Vprint_circle))
-		  {
-		    /* Simple but incomplete way.  */
-		    if (i != 0 && EQ (obj, halftail))
-		      {
-			int len = sprintf (buf, " . #%"pMd, i / 2);
-			strout (buf, len, len, printcharfun);
-			goto end_of_list;
-		      }
-		  }
-		else
-		  {
-		    /* With the print-circle feature.  */
-		    if (i != 0)
-		      {
-			Lisp_Object num = Fgethash (obj, Vprint_number_table, Qnil);
-			if (INTEGERP (num))
-			  {
-			    strout (" . ", 3, 3, printcharfun);
-			    print_object (obj, printcharfun, escapeflag);
-			    goto end_of_list;
-			  }
-		      }
-		  }
-
-		if (i)
-		  PRINTCHAR (' ');
-
-		if (print_length <= i)
-		  {
-		    strout ("...", 3, 3, printcharfun);
-		    goto end_of_list;
-		  }
+	  struct print_stack_entry *e;
 
-		i++;
-		print_object (XCAR (obj), printcharfun, escapeflag);
-
-		obj = XCDR (obj);
-		if (!(i & 1))
-		  halftail = XCDR (halftail);
-	      }
-	  }
+	  PRINTCHAR ('(');
 
-	  /* OBJ non-nil here means it's the end of a dotted list.  */
-	  if (!NILP (obj))
-	    {
-	      strout (" . ", 3, 3, printcharfun);
-	      print_object (obj, printcharfun, escapeflag);
-	    }
+	  /* The elements are printed by the PE_list case below.  */
+	  e = print_stack_push (PE_list, obj);
+	  e->halftail = obj;
 
-	end_of_list:
-	  PRINTCHAR (')');
+	  /* Negative values of print-length are invalid in CL.
+	     Treat them like nil, as CMUCL does.  */
+	  if (NATNUMP (Vprint_length))
+	    e->size = min (XFASTINT (Vprint_length), PTRDIFF_MAX);
+	  else
+	    e->size = PTRDIFF_MAX;
+	  goto next_obj;
 	}
       break;
 
@@ -1805,7 +1920,7 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
       else if (HASH_TABLE_P (obj))
 	{
 	  struct Lisp_Hash_Table *h = XHASH_TABLE (obj);
-	  ptrdiff_t i;
+	  struct print_stack_entry *e;
 	  ptrdiff_t real_size, size;
 	  int len;
 #if 0
@@ -1867,21 +1982,12 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 	    size = XFASTINT (Vprint_length);
 
 	  PRINTCHAR ('(');
-	  for (i = 0; i < size; i++)
-	    if (!NILP (HASH_HASH (h, i)))
-	      {
-		if (i) PRINTCHAR (' ');
-		print_object (HASH_KEY (h, i), printcharfun, escapeflag);
-		PRINTCHAR (' ');
-		print_object (HASH_VALUE (h, i), printcharfun, escapeflag);
-	      }
-
-	  if (size < real_size)
-	    strout (" ...", 4, 4, printcharfun);
-
-	  PRINTCHAR (')');
-	  PRINTCHAR (')');
 
+	  /* The elements are printed by the PE_hash case below.  */
+	  e = print_stack_push (PE_hash, obj);
+	  e->size = size;
+	  e->real_size = real_size;
+	  goto next_obj;
 	}
       else if (BUFFERP (obj))
 	{
@@ -1981,8 +2087,7 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 
 	  PRINTCHAR ('[');
 	  {
-	    register int i;
-	    register Lisp_Object tem;
+	    struct print_stack_entry *e;
 	    ptrdiff_t real_size = size;
 
 	    /* Don't print more elements than the specified maximum.  */
@@ -1990,16 +2095,12 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 		&& XFASTINT (Vprint_length) < size)
 	      size = XFASTINT (Vprint_length);
 
-	    for (i = 0; i < size; i++)
-	      {
-		if (i) PRINTCHAR (' ');
-		tem = AREF (obj, i);
-		print_object (tem, printcharfun, escapeflag);
-	      }
-	    if (size < real_size)
-	      strout (" ...", 4, 4, printcharfun);
+	    /* The elements are printed by the PE_vector case below.  */
+	    e = print_stack_push (PE_vector, obj);
+	    e->size = size;
+	    e->real_size = real_size;
+	    goto next_obj;
 	  }
-	  PRINTCHAR (']');
 	}
       break;
 
@@ -2025,16 +2126,14 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 
 	case Lisp_Misc_Overlay:
 	  strout ("#<overlay ", -1, -1, printcharfun);
-	  if (! XMARKER (OVERLAY_START (obj))->buffer)
+	  if (! OVERLAY_BUFFER (obj))
 	    strout ("in no buffer", -1, -1, printcharfun);
 	  else
 	    {
 	      int len = sprintf (buf, "from %"pD"d to %"pD"d in ",
-				 marker_position (OVERLAY_START (obj)),
-				 marker_position (OVERLAY_END   (obj)));
+				 OVERLAY_START (obj), OVERLAY_END (obj));
 	      strout (buf, len, len, printcharfun);
-	      print_string (BVAR (XMARKER (OVERLAY_START (obj))->buffer, name),
-			    printcharfun);
+	      print_string (BVAR (OVERLAY_BUFFER (obj), name), printcharfun);
 	    }
 	  PRINTCHAR ('>');
 	  break;
@@ -2166,6 +2265,139 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
     }
 
   print_depth--;
+
+ next_obj:
+  /* Continue with whatever list, vector or hash table OBJ was part
+     of, or return if OBJ was the outermost object.  */
+  if (print_stack_sp > base_sp)
+    {
+      struct print_stack_entry *e = &print_stack[print_stack_sp - 1];
+
+      switch (e->type)
+	{
+	case PE_list:
+	  obj = e->obj;
+	  if (!CONSP (obj))
+	    {
+	      /* OBJ non-nil here means it's the end of a dotted list.  */
+	      if (!NILP (obj))
+		{
+		  strout (" . ", 3, 3, printcharfun);
+		  e->type = PE_rbrac;
+		  e->end = ")";
+		  goto print_obj;
+		}
+	      goto end_of_list;
+	    }
+
+	  /* Detect circular list.  */
+	  if (NILP (Vprint_circle))
+	    {
+	      /* Simple but incomplete way.  */
+	      if (e->n != 0 && EQ (obj, e->halftail))
+		{
+		  int len = sprintf (buf, " . #%"pD"d", e->n / 2);
+		  strout (buf, len, len, printcharfun);
+		  goto end_of_list;
+		}
+	    }
+	  else
+	    {
+	      /* With the print-circle feature.  */
+	      if (e->n != 0)
+		{
+		  Lisp_Object num = Fgethash (obj, Vprint_number_table, Qnil);
+		  if (INTEGERP (num))
+		    {
+		      strout (" . ", 3, 3, printcharfun);
+		      e->type = PE_rbrac;
+		      e->end = ")";
+		      goto print_obj;
+		    }
+		}
+	    }
+
+	  if (e->n)
+	    PRINTCHAR (' ');
+
+	  if (e->size <= e->n)
+	    {
+	      strout ("...", 3, 3, printcharfun);
+	      goto end_of_list;
+	    }
+
+	  e->n++;
+	  e->obj = XCDR (obj);
+	  if (!(e->n & 1))
+	    e->halftail = XCDR (e->halftail);
+	  obj = XCAR (obj);
+	  goto print_obj;
+
+	end_of_list:
+	  PRINTCHAR (')');
+	  print_stack_sp--;
+	  print_depth--;
+	  goto next_obj;
+
+	case PE_rbrac:
+	  if (*e->end)
+	    strout (e->end, -1, -1, printcharfun);
+	  new_backquote_output += e->backquote;
+	  print_stack_sp--;
+	  print_depth--;
+	  goto next_obj;
+
+	case PE_vector:
+	  if (e->n < e->size)
+	    {
+	      if (e->n)
+		PRINTCHAR (' ');
+	      obj = AREF (e->obj, e->n);
+	      e->n++;
+	      goto print_obj;
+	    }
+	  if (e->size < e->real_size)
+	    strout (" ...", 4, 4, printcharfun);
+	  PRINTCHAR (']');
+	  print_stack_sp--;
+	  print_depth--;
+	  goto next_obj;
+
+	case PE_hash:
+	  {
+	    struct Lisp_Hash_Table *h = XHASH_TABLE (e->obj);
+
+	    if (e->value_next)
+	      {
+		PRINTCHAR (' ');
+		e->value_next = 0;
+		obj = HASH_VALUE (h, e->n - 1);
+		goto print_obj;
+	      }
+	    while (e->n < e->size && NILP (HASH_HASH (h, e->n)))
+	      e->n++;
+	    if (e->n < e->size)
+	      {
+		if (e->n)
+		  PRINTCHAR (' ');
+		e->value_next = 1;
+		obj = HASH_KEY (h, e->n);
+		e->n++;
+		goto print_obj;
+	      }
+	    if (e->size < e->real_size)
+	      strout (" ...", 4, 4, printcharfun);
+	    PRINTCHAR (')');
+	    PRINTCHAR (')');
+	    print_stack_sp--;
+	    print_depth--;
+	    goto next_obj;
+	  }
+
+	default:
+	  emacs_abort ();
+	}
+    }
 }
 
 
@@ -2274,10 +2506,10 @@ shared once again when the text is read back.  */);
 
   DEFVAR_LISP ("print-circle", Vprint_circle,
 	       doc: /* Non-nil means print recursive structures using #N= and #N# syntax.
-If nil, printing proceeds recursively and may lead to
-`max-lisp-eval-depth' being exceeded or an error may occur:
-\"Apparently circular structure being printed.\"  Also see
-`print-length' and `print-level'.
+If nil, an object inside itself is printed as #LEVEL, where LEVEL is
+the nesting level at which it is being printed, and other shared
+substructures are printed in full each time.  Also see `print-length'
+and `print-level'.
 If non-nil, shared substructures anywhere in the structure are printed
 with `#N=' before the first occurrence (in the order of the print
 representation) and `#N#' in place of each subsequent occurrence,
@@ -22,8 +22,6 @@
    - merge with glibc's regex.[ch].
    - replace (succeed_n + jump_n + set_number_at) with something that doesn't
      need to modify the compiled regexp so that re_match can be reentrant.
-   - get rid of on_failure_jump_smart by doing the optimization in re_comp
-     rather than at run-time, so that re_match can be reentrant.
 */
 
 /* AIX requires this to be the first thing in the file.  */
@@ -290,6 +288,10 @@ enum syntaxcode { Swhitespace = 0, Sword = 1, Ssymbol = 2 };
 /* isalpha etc. are used for the character classes.  */
 #include <ctype.h>
 
+/* vsnprintf is used to describe compiled patterns.  */
+#include <stdarg.h>
+#include <stdio.h>
+
 #ifdef emacs
 
 /* 1 if C is an ASCII character.  */
@@ -617,6 +619,14 @@ typedef enum
 	   current string position when executed.  */
   on_failure_keep_string_jump,
 
+	/* Like `on_failure_keep_string_jump', at the start of a loop
+	   whose body matches one character, with `anychar', `charset'
+	   or `charset_not', and is followed by a jump back to the body.
+	   The matcher skips all the characters that the body matches
+	   and jumps to the address right away.  `optimize_pattern'
+	   puts it there.  */
+  on_failure_keep_string_span,
+
 	/* Just like `on_failure_jump', except that it checks that we
 	   don't get stuck in an infinite loop (matching an empty string
 	   indefinitely).  */
@@ -820,66 +830,55 @@ extract_number_and_incr (re_char **source)
     }									\
   while (0)
 
-/* If DEBUG is defined, Regex prints many voluminous messages about what
-   it is doing (if the variable `debug' is nonzero).  If linked with the
-   main program in `iregex.c', you can enter patterns and strings
-   interactively.  And if linked with the main program in `main.c' and
-   the other test files, you can run the already-written tests.  */
-
-#ifdef DEBUG
-
-/* We use standard I/O for debugging.  */
-# include <stdio.h>
-
-/* It is useful to test things that ``must'' be true when debugging.  */
-# include <assert.h>
-
-static int debug = -100000;
-
-# define DEBUG_STATEMENT(e) e
-# define DEBUG_PRINT(...) if (debug > 0) printf (__VA_ARGS__)
-# define DEBUG_COMPILES_ARGUMENTS
-# define DEBUG_PRINT_COMPILED_PATTERN(p, s, e)				\
-  if (debug > 0) print_partial_compiled_pattern (s, e)
-# define DEBUG_PRINT_DOUBLE_STRING(w, s1, sz1, s2, sz2)			\
-  if (debug > 0) print_double_string (w, s1, sz1, s2, sz2)
-
+/* A string to which text can be appended.  */
+struct re_text
+{
+  char *data;
+  size_t used, allocated;
+};
 
-/* Print the fastmap in human-readable form.  */
+/* Append to TEXT the output of printf for FORMAT and the arguments
+   that follow.  */
 
 static void
-print_fastmap (char *fastmap)
+re_text_printf (struct re_text *text, const char *format, ...)
 {
-  unsigned was_a_range = 0;
-  unsigned i = 0;
+  va_list ap;
+  int n;
 
-  while (i < (1 << BYTEWIDTH))
+  if (!text->data)
     {
-      if (fastmap[i++])
+      text->allocated = 256;
+      text->data = malloc (text->allocated);
+      text->data[0] = '\0';
+    }
+  for (;;)
+    {
+      size_t room = text->allocated - text->used;
+
+      va_start (ap, format);
+      n = vsnprintf (text->data + text->used, room, format, ap);
+      va_end (ap);
+      if (n < 0)
 	{
-	  was_a_range = 0;
-	  putchar (i - 1);
-	  while (i < (1 << BYTEWIDTH)  &&  fastmap[i])
-	    {
-	      was_a_range = 1;
-	      i++;
-	    }
-	  if (was_a_range)
-	    {
-	      printf ("-");
-	      putchar (i - 1);
-	    }
+	  text->data[text->used] = '\0';
+	  return;
 	}
+      if (n < room)
+	break;
+      text->allocated = 2 * text->allocated + n;
+      text->data = realloc (text->data, text->allocated);
     }
-  putchar ('\n');
+  text->used += n;
 }
 
-
-/* Print a compiled pattern string in human-readable form, starting at
-   the START pointer into it and ending just before the pointer END.  */
+/* Append to TEXT a description of a compiled pattern in human-readable
+   form, starting at the START pointer into it and ending just before
+   the pointer END.  */
 
 static void
-print_partial_compiled_pattern (re_char *start, re_char *end)
+describe_partial_compiled_pattern (struct re_text *text,
+				   re_char *start, re_char *end)
 {
   int mcnt, mcnt2;
   re_char *p = start;
@@ -887,49 +886,52 @@ print_partial_compiled_pattern (re_char *start, re_char *end)
 
   if (start == NULL)
     {
-      fprintf (stderr, "(null)\n");
+      re_text_printf (text, "(null)\n");
       return;
     }
 
   /* Loop over pattern commands.  */
   while (p < pend)
     {
-      fprintf (stderr, "%td:\t", p - start);
+      re_text_printf (text, "%td:\t", p - start);
 
       switch ((re_opcode_t) *p++)
 	{
 	case no_op:
-	  fprintf (stderr, "/no_op");
+	  re_text_printf (text, "/no_op");
 	  break;
 
 	case succeed:
-	  fprintf (stderr, "/succeed");
+	  re_text_printf (text, "/succeed");
 	  break;
 
 	case exactn:
 	  mcnt = *p++;
-	  fprintf (stderr, "/exactn/%d", mcnt);
+	  re_text_printf (text, "/exactn/%d", mcnt);
 	  do
 	    {
-	      fprintf (stderr, "/%c", *p++);
+	      if (*p < ' ' || *p == 0177)
+		re_text_printf (text, "/\\%o", *p++);
+	      else
+		re_text_printf (text, "/%c", *p++);
 	    }
 	  while (--mcnt);
 	  break;
 
 	case start_memory:
-	  fprintf (stderr, "/start_memory/%d", *p++);
+	  re_text_printf (text, "/start_memory/%d", *p++);
 	  break;
 
 	case stop_memory:
-	  fprintf (stderr, "/stop_memory/%d", *p++);
+	  re_text_printf (text, "/stop_memory/%d", *p++);
 	  break;
 
 	case duplicate:
-	  fprintf (stderr, "/duplicate/%d", *p++);
+	  re_text_printf (text, "/duplicate/%d", *p++);
 	  break;
 
 	case anychar:
-	  fprintf (stderr, "/anychar");
+	  re_text_printf (text, "/anychar");
 	  break;
 
 	case charset:
@@ -940,11 +942,11 @@ print_partial_compiled_pattern (re_char *start, re_char *end)
 	    int length = CHARSET_BITMAP_SIZE (p - 1);
 	    int has_range_table = CHARSET_RANGE_TABLE_EXISTS_P (p - 1);
 
-	    fprintf (stderr, "/charset [%s",
-		     (re_opcode_t) *(p - 1) == charset_not ? "^" : "");
+	    re_text_printf (text, "/charset [%s",
+			    (re_opcode_t) *(p - 1) == charset_not ? "^" : "");
 
 	    if (p + *p >= pend)
-	      fprintf (stderr, " !extends past end of pattern! ");
+	      re_text_printf (text, " !extends past end of pattern! ");
 
 	    for (c = 0; c < 256; c++)
 	      if (c / 8 < length
@@ -953,33 +955,33 @@ print_partial_compiled_pattern (re_char *start, re_char *end)
 		  /* Are we starting a range?  */
 		  if (last + 1 == c && ! in_range)
 		    {
-		      fprintf (stderr, "-");
+		      re_text_printf (text, "-");
 		      in_range = 1;
 		    }
 		  /* Have we broken a range?  */
 		  else if (last + 1 != c && in_range)
 		    {
-		      fprintf (stderr, "%c", last);
+		      re_text_printf (text, "%c", last);
 		      in_range = 0;
 		    }
 
 		  if (! in_range)
-		    fprintf (stderr, "%c", c);
+		    re_text_printf (text, "%c", c);
 
 		  last = c;
 	      }
 
 	    if (in_range)
-	      fprintf (stderr, "%c", last);
+	      re_text_printf (text, "%c", last);
 
-	    fprintf (stderr, "]");
+	    re_text_printf (text, "]");
 
 	    p += 1 + length;
 
 	    if (has_range_table)
 	      {
 		int count;
-		fprintf (stderr, "has-range-table");
+		re_text_printf (text, "has-range-table");
 
 		/* ??? Should print the range table; for now, just skip it.  */
 		p += 2;		/* skip range table bits */
@@ -990,146 +992,238 @@ print_partial_compiled_pattern (re_char *start, re_char *end)
 	  break;
 
 	case begline:
-	  fprintf (stderr, "/begline");
+	  re_text_printf (text, "/begline");
 	  break;
 
 	case endline:
-	  fprintf (stderr, "/endline");
+	  re_text_printf (text, "/endline");
 	  break;
 
 	case on_failure_jump:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
-	  fprintf (stderr, "/on_failure_jump to %td", p + mcnt - start);
+	  re_text_printf (text, "/on_failure_jump to %td", p + mcnt - start);
 	  break;
 
 	case on_failure_keep_string_jump:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
-	  fprintf (stderr, "/on_failure_keep_string_jump to %td",
-		   p + mcnt - start);
+	  re_text_printf (text, "/on_failure_keep_string_jump to %td",
+			  p + mcnt - start);
+	  break;
+
+	case on_failure_keep_string_span:
+	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
+	  re_text_printf (text, "/on_failure_keep_string_span to %td",
+			  p + mcnt - start);
 	  break;
 
 	case on_failure_jump_nastyloop:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
-	  fprintf (stderr, "/on_failure_jump_nastyloop to %td",
-		   p + mcnt - start);
+	  re_text_printf (text, "/on_failure_jump_nastyloop to %td",
+			  p + mcnt - start);
 	  break;
 
 	case on_failure_jump_loop:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
-	  fprintf (stderr, "/on_failure_jump_loop to %td",
-		   p + mcnt - start);
+	  re_text_printf (text, "/on_failure_jump_loop to %td",
+			  p + mcnt - start);
 	  break;
 
 	case on_failure_jump_smart:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
-	  fprintf (stderr, "/on_failure_jump_smart to %td",
-		   p + mcnt - start);
+	  re_text_printf (text, "/on_failure_jump_smart to %td",
+			  p + mcnt - start);
 	  break;
 
 	case jump:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
-	  fprintf (stderr, "/jump to %td", p + mcnt - start);
+	  re_text_printf (text, "/jump to %td", p + mcnt - start);
 	  break;
 
 	case succeed_n:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
 	  EXTRACT_NUMBER_AND_INCR (mcnt2, p);
-	  fprintf (stderr, "/succeed_n to %td, %d times",
-		   p - 2 + mcnt - start, mcnt2);
+	  re_text_printf (text, "/succeed_n to %td, %d times",
+			  p - 2 + mcnt - start, mcnt2);
 	  break;
 
 	case jump_n:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
 	  EXTRACT_NUMBER_AND_INCR (mcnt2, p);
-	  fprintf (stderr, "/jump_n to %td, %d times",
-		   p - 2 + mcnt - start, mcnt2);
+	  re_text_printf (text, "/jump_n to %td, %d times",
+			  p - 2 + mcnt - start, mcnt2);
 	  break;
 
 	case set_number_at:
 	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
 	  EXTRACT_NUMBER_AND_INCR (mcnt2, p);
-	  fprintf (stderr, "/set_number_at location %td to %d",
-		   p - 2 + mcnt - start, mcnt2);
+	  re_text_printf (text, "/set_number_at location %td to %d",
+			  p - 2 + mcnt - start, mcnt2);
 	  break;
 
 	case wordbound:
-	  fprintf (stderr, "/wordbound");
+	  re_text_printf (text, "/wordbound");
 	  break;
 
 	case notwordbound:
-	  fprintf (stderr, "/notwordbound");
+	  re_text_printf (text, "/notwordbound");
 	  break;
 
 	case wordbeg:
-	  fprintf (stderr, "/wordbeg");
+	  re_text_printf (text, "/wordbeg");
 	  break;
 
 	case wordend:
-	  fprintf (stderr, "/wordend");
+	  re_text_printf (text, "/wordend");
 	  break;
 
 	case symbeg:
-	  fprintf (stderr, "/symbeg");
+	  re_text_printf (text, "/symbeg");
 	  break;
 
 	case symend:
-	  fprintf (stderr, "/symend");
+	  re_text_printf (text, "/symend");
 	  break;
 
 	case syntaxspec:
-	  fprintf (stderr, "/syntaxspec");
+	  re_text_printf (text, "/syntaxspec");
 	  mcnt = *p++;
-	  fprintf (stderr, "/%d", mcnt);
+	  re_text_printf (text, "/%d", mcnt);
 	  break;
 
 	case notsyntaxspec:
-	  fprintf (stderr, "/notsyntaxspec");
+	  re_text_printf (text, "/notsyntaxspec");
 	  mcnt = *p++;
-	  fprintf (stderr, "/%d", mcnt);
+	  re_text_printf (text, "/%d", mcnt);
 	  break;
 
 # ifdef emacs
 	case before_dot:
-	  fprintf (stderr, "/before_dot");
+	  re_text_printf (text, "/before_dot");
 	  break;
 
 	case at_dot:
-	  fprintf (stderr, "/at_dot");
+	  re_text_printf (text, "/at_dot");
 	  break;
 
 	case after_dot:
-	  fprintf (stderr, "/after_dot");
+	  re_text_printf (text, "/after_dot");
 	  break;
 
 	case categoryspec:
-	  fprintf (stderr, "/categoryspec");
+	  re_text_printf (text, "/categoryspec");
 	  mcnt = *p++;
-	  fprintf (stderr, "/%d", mcnt);
+	  re_text_printf (text, "/%d", mcnt);
 	  break;
 
 	case notcategoryspec:
-	  fprintf (stderr, "/notcategoryspec");
+	  re_text_printf (text, "/notcategoryspec");
 	  mcnt = *p++;
-	  fprintf (stderr, "/%d", mcnt);
+	  re_text_printf (text, "/%d", mcnt);
 	  break;
 # endif /* emacs */
 
 	case begbuf:
-	  fprintf (stderr, "/begbuf");
+	  re_text_printf (text, "/begbuf");
 	  break;
 
 	case endbuf:
-	  fprintf (stderr, "/endbuf");
+	  re_text_printf (text, "/endbuf");
 	  break;
 
 	default:
-	  fprintf (stderr, "?%d", *(p-1));
+	  re_text_printf (text, "?%d", *(p-1));
 	}
 
-      fprintf (stderr, "\n");
+      re_text_printf (text, "\n");
+    }
+
+  re_text_printf (text, "%td:\tend of pattern.\n", p - start);
+}
+
+#ifdef emacs
+
+/* Return a description of the compiled pattern of BUFP, one operation
+   per line, in memory allocated with malloc.  */
+
+char *
+re_describe_pattern (struct re_pattern_buffer *bufp)
+{
+  struct re_text text = { NULL, 0, 0 };
+
+  describe_partial_compiled_pattern (&text, bufp->buffer,
+				     bufp->buffer + bufp->used);
+  return text.data;
+}
+
+#endif /* emacs */
+
+
+/* If DEBUG is defined, Regex prints many voluminous messages about what
+   it is doing (if the variable `debug' is nonzero).  If linked with the
+   main program in `iregex.c', you can enter patterns and strings
+   interactively.  And if linked with the main program in `main.c' and
+   the other test files, you can run the already-written tests.  */
+
+#ifdef DEBUG
+
+/* We use standard I/O for debugging.  */
+# include <stdio.h>
+
+/* It is useful to test things that ``must'' be true when debugging.  */
+# include <assert.h>
+
+static int debug = -100000;
+
+# define DEBUG_STATEMENT(e) e
+# define DEBUG_PRINT(...) if (debug > 0) printf (__VA_ARGS__)
+# define DEBUG_COMPILES_ARGUMENTS
+# define DEBUG_PRINT_COMPILED_PATTERN(p, s, e)				\
+  if (debug > 0) print_partial_compiled_pattern (s, e)
+# define DEBUG_PRINT_DOUBLE_STRING(w, s1, sz1, s2, sz2)			\
+  if (debug > 0) print_double_string (w, s1, sz1, s2, sz2)
+
+
+/* Print the fastmap in human-readable form.  */
+
+static void
+print_fastmap (char *fastmap)
+{
+  unsigned was_a_range = 0;
+  unsigned i = 0;
+
+  while (i < (1 << BYTEWIDTH))
+    {
+      if (fastmap[i++])
+	{
+	  was_a_range = 0;
+	  putchar (i - 1);
+	  while (i < (1 << BYTEWIDTH)  &&  fastmap[i])
+	    {
+	      was_a_range = 1;
+	      i++;
+	    }
+	  if (was_a_range)
+	    {
+	      printf ("-");
+	      putchar (i - 1);
+	    }
+	}
     }
+  putchar ('\n');
+}
+
 
-  fprintf (stderr, "%td:\tend of pattern.\n", p - start);
+/* Print a compiled pattern string in human-readable form, starting at
+   the START pointer into it and ending just before the pointer END.  */
+
+static void
+print_partial_compiled_pattern (re_char *start, re_char *end)
+{
+  struct re_text text = { NULL, 0, 0 };
+
+  describe_partial_compiled_pattern (&text, start, end);
+  fputs (text.data, stderr);
+  free (text.data);
 }
 
 
@@ -1635,6 +1729,12 @@ static boolean at_begline_loc_p (re_char *pattern, re_char *p,
 static boolean at_endline_loc_p (re_char *p, re_char *pend,
 				 reg_syntax_t syntax);
 static re_char *skip_one_char (re_char *p);
+static re_char *skip_op (re_char *p);
+static void optimize_pattern (struct re_pattern_buffer *bufp);
+#ifdef emacs
+static void dfa_free (struct re_dfa *dfa);
+static void analyse_literal (struct re_pattern_buffer *bufp);
+#endif
 static int analyse_first (re_char *p, re_char *pend,
 			  char *fastmap, const int multibyte);
 
@@ -2499,6 +2599,14 @@ regex_compile (const_re_char *pattern, size_t size, reg_syntax_t syntax,
   bufp->fastmap_accurate = 0;
   bufp->not_bol = bufp->not_eol = 0;
   bufp->used_syntax = 0;
+#ifdef emacs
+  if (bufp->dfa)
+    {
+      dfa_free (bufp->dfa);
+      bufp->dfa = NULL;
+    }
+  bufp->literal_size = 0;
+#endif
 
   /* Set `used' to zero, so that if we return an error, the pattern
      printer (for debugging) will think there's no pattern.  We reset it
@@ -3675,6 +3783,12 @@ regex_compile (const_re_char *pattern, size_t size, reg_syntax_t syntax,
   /* We have succeeded; set the length of the buffer.  */
   bufp->used = b - bufp->buffer;
 
+  optimize_pattern (bufp);
+
+#ifdef emacs
+  analyse_literal (bufp);
+#endif
+
 #ifdef DEBUG
   if (debug > 0)
     {
@@ -4068,6 +4182,7 @@ analyse_first (const_re_char *p, const_re_char *pend, char *fastmap,
 	    {
 	    case on_failure_jump:
 	    case on_failure_keep_string_jump:
+	    case on_failure_keep_string_span:
 	    case on_failure_jump_loop:
 	    case on_failure_jump_nastyloop:
 	    case on_failure_jump_smart:
@@ -4082,6 +4197,7 @@ analyse_first (const_re_char *p, const_re_char *pend, char *fastmap,
 
 	case on_failure_jump:
 	case on_failure_keep_string_jump:
+	case on_failure_keep_string_span:
 	case on_failure_jump_nastyloop:
 	case on_failure_jump_loop:
 	case on_failure_jump_smart:
@@ -4177,6 +4293,170 @@ re_compile_fastmap (struct re_pattern_buffer *bufp)
   bufp->can_be_null = (analysis != 0);
   return 0;
 } /* re_compile_fastmap */
+
+#ifdef emacs
+
+/* Return a rough measure of how often the byte C occurs in text: the
+   higher, the more often.  */
+
+int
+re_byte_frequency (int c)
+{
+  if (c == ' ' || (c && strchr ("\n\tetaoinsrhl", c)))
+    return 3;
+  if (('a' <= c && c <= 'z') || ('0' <= c && c <= '9'))
+    return 2;
+  if (c >= 0x80 || (c && strchr ("-_.,;:()'\"", c)))
+    return 1;
+  return 0;
+}
+
+/* Record in BUFP the SIZE bytes at RUN, a string that every match
+   contains, if it is longer than the one recorded so far.  PREFIX
+   says whether every match starts with it.  */
+
+static void
+keep_literal (struct re_pattern_buffer *bufp, re_char *run, int size,
+	      bool prefix)
+{
+  int i, rare = 0;
+
+  if (size == 0 || size < bufp->literal_size
+      || (size == bufp->literal_size && (bufp->literal_prefix || !prefix)))
+    return;
+
+  memcpy (bufp->literal, run, size);
+  bufp->literal_size = size;
+  bufp->literal_prefix = prefix;
+  bufp->literal_multibyte = false;
+  for (i = 0; i < size; i++)
+    {
+      if (run[i] >= 0x80)
+	bufp->literal_multibyte = true;
+      if (re_byte_frequency (run[i]) < re_byte_frequency (run[rare]))
+	rare = i;
+    }
+  bufp->literal_rare = rare;
+}
+
+/* Find strings that every match of the compiled pattern in BUFP
+   contains, for `re_search_2' to look for before trying to match, and
+   record the longest one with `keep_literal'.
+
+   Only the operations that every match goes through are considered,
+   so those between a jump and the place where the paths that start
+   there join again, like the body of a loop or the alternatives of a
+   group, are skipped.  The strings must be comparable byte by byte
+   with the target: with a translation table, which is for case
+   folding, only the ASCII characters that are not letters and that
+   translate to themselves are kept, and non-ASCII bytes only in a
+   multibyte pattern without one.  */
+
+static void
+analyse_literal (struct re_pattern_buffer *bufp)
+{
+  re_char *p = bufp->buffer, *pend = p + bufp->used;
+  RE_TRANSLATE_TYPE translate = bufp->translate;
+  const boolean multibyte = RE_MULTIBYTE_P (bufp);
+  unsigned char run[RE_LITERAL_MAX];
+  int size = 0, mcnt;
+  bool prefix = true;
+
+  while (p && p < pend)
+    {
+      re_char *q, *dest, *end;
+
+      switch (*p)
+	{
+	case exactn:
+	  for (q = p + 2, end = q + p[1]; q < end; q++)
+	    {
+	      int c = *q;
+	      if (c < 0x80
+		  ? (! RE_TRANSLATE_P (translate)
+		     || (! ('a' <= c && c <= 'z') && ! ('A' <= c && c <= 'Z')
+			 && RE_TRANSLATE (translate, c) == c))
+		  : multibyte && ! RE_TRANSLATE_P (translate))
+		{
+		  if (size < RE_LITERAL_MAX)
+		    run[size++] = c;
+		}
+	      else
+		{
+		  keep_literal (bufp, run, size, prefix);
+		  size = 0;
+		  prefix = false;
+		}
+	    }
+	  p = end;
+	  continue;
+
+	case no_op:
+	case begline:
+	case endline:
+	case begbuf:
+	case endbuf:
+	case wordbeg:
+	case wordend:
+	case wordbound:
+	case notwordbound:
+	case symbeg:
+	case symend:
+	case before_dot:
+	case at_dot:
+	case after_dot:
+	case start_memory:
+	case stop_memory:
+	  /* These match the empty string.  */
+	  p = skip_op (p);
+	  continue;
+
+	case jump:
+	case on_failure_jump:
+	case on_failure_keep_string_jump:
+	case on_failure_keep_string_span:
+	case on_failure_jump_loop:
+	case on_failure_jump_nastyloop:
+	case on_failure_jump_smart:
+	  EXTRACT_NUMBER (mcnt, p + 1);
+	  dest = p + 3 + mcnt;
+	  if (mcnt >= 0)
+	    {
+	      /* Skip to where all the jumps in between lead.  */
+	      for (q = p + 3; q && q < dest; q = skip_op (q))
+		if (*q >= jump && *q <= jump_n)
+		  {
+		    EXTRACT_NUMBER (mcnt, q + 1);
+		    if (q + 3 + mcnt > dest)
+		      dest = q + 3 + mcnt;
+		  }
+	      p = q ? dest : NULL;
+	    }
+	  else if (*p != jump)
+	    /* The end of a non-greedy loop: what follows is on every
+	       path, but not next to what precedes.  */
+	    p += 3;
+	  else
+	    p = NULL;
+	  break;
+
+	case duplicate:
+	  p += 2;
+	  break;
+
+	default:
+	  /* A character, or an operation that is not analyzed.  */
+	  p = skip_one_char (p);
+	  break;
+	}
+
+      keep_literal (bufp, run, size, prefix);
+      size = 0;
+      prefix = false;
+    }
+  keep_literal (bufp, run, size, prefix);
+}
+#endif
 
 /* Set REGS to hold NUM_REGS registers, storing them in STARTS and
    ENDS.  Subsequent matches using PATTERN_BUFFER and REGS will use
@@ -4232,26 +4512,1667 @@ WEAK_ALIAS (__re_search, re_search)
 #define POS_ADDR_VSTRING(POS)					\
   (((POS) >= size1 ? string2 - size1 : string1) + (POS))
 
-/* Using the compiled pattern in BUFP->buffer, first tries to match the
-   virtual concatenation of STRING1 and STRING2, starting first at index
-   STARTPOS, then at STARTPOS + 1, and so on.
+#ifdef emacs
 
-   STRING1 and STRING2 have length SIZE1 and SIZE2, respectively.
+/* Return the first position at or after FROM in the virtual
+   concatenation of STRING1 and STRING2 where the literal string of
+   BUFP starts and ends at or before LIMIT, or -1 if there is none.
+   The rarest byte of the string is looked for with memchr, which the C
+   library vectorizes, and the rest is compared where it is found.  */
+
+static ssize_t
+literal_search (struct re_pattern_buffer *bufp,
+		re_char *string1, ssize_t size1,
+		re_char *string2, ssize_t size2,
+		ssize_t from, ssize_t limit)
+{
+  re_char *literal = bufp->literal;
+  int size = bufp->literal_size, rare = bufp->literal_rare;
+  ssize_t pos = from + rare, last = limit - size + rare;
 
-   RANGE is how far to scan while trying to match.  RANGE = 0 means try
-   only at STARTPOS; in general, the last start tried is STARTPOS +
-   RANGE.
+  while (pos <= last)
+    {
+      re_char *d = POS_ADDR_VSTRING (pos);
+      ssize_t n = (pos < size1 ? min (size1 - 1, last) : last) - pos + 1;
+      re_char *found = memchr (d, literal[rare], n);
+      ssize_t start, i;
 
-   In REGS, return the indices of the virtual concatenation of STRING1
-   and STRING2 that matched the entire BUFP->buffer and its contained
-   subexpressions.
+      if (!found)
+	{
+	  pos += n;
+	  continue;
+	}
+      pos += found - d;
+      start = pos - rare;
+      if (start >= size1 || start + size <= size1)
+	{
+	  if (memcmp (POS_ADDR_VSTRING (start), literal, size) == 0)
+	    return start;
+	}
+      else
+	{
+	  /* The string would straddle the gap.  */
+	  for (i = 0; i < size; i++)
+	    if (*POS_ADDR_VSTRING (start + i) != literal[i])
+	      break;
+	  if (i == size)
+	    return start;
+	}
+      pos++;
+    }
+  return -1;
+}
 
-   Do not consider matching one past the index STOP in the virtual
-   concatenation of STRING1 and STRING2.
+/* Return the last position at or before FROM, and at or after LOWEST,
+   in the virtual concatenation of STRING1 and STRING2 where the literal
+   string of BUFP starts and ends at or before LIMIT, or -1 if there is
+   none.  This is literal_search backward, with memrchr.  */
 
-   We return either the position in the strings at which the match was
-   found, -1 if no match, or -2 if error (such as failure
-   stack overflow).  */
+static ssize_t
+literal_search_backward (struct re_pattern_buffer *bufp,
+			 re_char *string1, ssize_t size1,
+			 re_char *string2, ssize_t size2,
+			 ssize_t from, ssize_t lowest, ssize_t limit)
+{
+  re_char *literal = bufp->literal;
+  int size = bufp->literal_size, rare = bufp->literal_rare;
+  ssize_t pos = min (from, limit - size) + rare, first = lowest + rare;
+
+  while (pos >= first)
+    {
+      ssize_t low = pos < size1 ? first : max (first, size1);
+      re_char *d = POS_ADDR_VSTRING (low);
+      re_char *found = memrchr (d, literal[rare], pos - low + 1);
+      ssize_t start, i;
+
+      if (!found)
+	{
+	  pos = low - 1;
+	  continue;
+	}
+      pos = low + (found - d);
+      start = pos - rare;
+      if (start >= size1 || start + size <= size1)
+	{
+	  if (memcmp (POS_ADDR_VSTRING (start), literal, size) == 0)
+	    return start;
+	}
+      else
+	{
+	  /* The string would straddle the gap.  */
+	  for (i = 0; i < size; i++)
+	    if (*POS_ADDR_VSTRING (start + i) != literal[i])
+	      break;
+	  if (i == size)
+	    return start;
+	}
+      pos--;
+    }
+  return -1;
+}
+
+
+/* Lazy DFA.
+
+   re_search_2 uses a DFA to find out quickly whether, and where, a
+   match can start, and calls re_match_2_internal only where one does.
+   This way a search never backtracks at positions where the pattern
+   cannot match, which is where backtracking can take exponential time,
+   as for "\\(a*\\)*b".  The backtracking matcher still computes the
+   match and its registers, so the results don't change.
+
+   The DFA runs the compiled pattern as an NFA whose nodes are its
+   operations.  A DFA state is the set of nodes that come right after a
+   character (its "kernel"), plus what the zero-width operations need
+   to know about that character.  States, and their transitions on
+   characters, are computed when first needed and cached with the
+   pattern.  Patterns with back-references, counted repetitions,
+   categories, assertions about point, or the character classes that
+   depend on the case table don't use a DFA.  Nor do patterns that
+   depend on the syntax table when `parse-sexp-lookup-properties' is
+   non-nil, since the syntax of a character then depends on its
+   position.
+
+   Backward searches run a second DFA, made from the NFA with its
+   edges reversed, from where matches may end back to where they
+   start.  It takes the zero-width operations to succeed everywhere,
+   so it finds all the places where a match starts, and maybe others,
+   where re_match_2_internal then fails.  */
+
+/* Kinds of NFA nodes.  */
+enum dfa_node_type
+{
+  DFA_MATCH,
+  DFA_JUMP,
+  DFA_SPLIT,
+  DFA_BOL,
+  DFA_EOL,
+  DFA_BOB,
+  DFA_EOB,
+  DFA_WORDBOUND,
+  DFA_NOTWORDBOUND,
+  DFA_WORDBEG,
+  DFA_WORDEND,
+  DFA_SYMBEG,
+  DFA_SYMEND,
+  /* The nodes from here on match one character.  */
+  DFA_CHAR,
+  DFA_ANYCHAR,
+  DFA_CHARSET,
+  DFA_SYNTAXSPEC,
+  DFA_NOTSYNTAXSPEC
+};
+
+struct dfa_node
+{
+  unsigned char type;
+  /* The syntax code of DFA_SYNTAXSPEC and DFA_NOTSYNTAXSPEC.  */
+  unsigned char syntax;
+  /* The character of DFA_CHAR, in the form the target is compared
+     with, or -1 if nothing in the target can match it.  */
+  int c;
+  /* The offset of the charset operation of DFA_CHARSET.  */
+  ptrdiff_t charset;
+  /* The node that follows, and the alternative of DFA_SPLIT.  */
+  int next, alt;
+};
+
+/* What a DFA state knows about the character before its position.  */
+enum
+{
+  DFA_AT_BEG = 1,		/* There is none.  */
+  DFA_AFTER_NL = 2,		/* It is a newline.  */
+  DFA_AFTER_WORD = 4,		/* Its syntax is Sword.  */
+  DFA_AFTER_SYMBOL = 8,		/* Its syntax is Ssymbol.  */
+  DFA_AFTER_WIDE = 16,		/* It is a multibyte word constituent.  */
+  DFA_FLOATING = 32		/* A match can also start here.  */
+};
+
+struct dfa_state
+{
+  /* The next state in the same hash bucket, or -1.  */
+  int chain;
+  int flags;
+  /* Whether this state can never lead to a match.  */
+  bool dead;
+  /* Whether a match ends here at the end of the text: -1 if unknown.  */
+  signed char accepts_at_end;
+  /* The transitions on characters below 256, 0 if not computed yet.
+     Otherwise, twice the index of the next state plus one, plus 1 if
+     a match ends right before the character.  */
+  unsigned short next[1 << BYTEWIDTH];
+  int nkernel;
+  int kernel[FLEXIBLE_ARRAY_MEMBER];
+};
+
+/* The number of states a DFA may cache, the number of times it may
+   flush them in one search before giving up, and the size of the
+   cache of transitions on characters above 255.  */
+enum { DFA_MAX_STATES = 500, DFA_MAX_FLUSHES = 4, DFA_WIDE_CACHE = 1024 };
+verify (2 * DFA_MAX_STATES + 1 <= USHRT_MAX);
+
+/* An entry of the cache of transitions on characters above 255.  */
+struct dfa_wide
+{
+  int state, c, next;
+};
+
+/* Patterns with more nodes than this don't use a DFA.  */
+#define DFA_MAX_NODES 20000
+
+struct re_dfa
+{
+  /* False if the pattern can't use a DFA.  */
+  bool usable;
+  /* The value of `target_multibyte' the nodes were made for.  */
+  bool target_multibyte;
+  /* Whether some nodes look up the syntax table.  */
+  bool uses_syntax;
+  /* The state flags that matter to this pattern.  */
+  int flag_mask;
+  /* The syntax table the cached states were computed with.  */
+  Lisp_Object syntax_table;
+
+  int nnodes, start;
+  struct dfa_node *nodes;
+
+  /* The cached states, and as many hash buckets for them, or -1.
+     These tables, and the cache of transitions on characters above
+     255, are allocated when first needed, since most patterns are
+     never searched with the DFA, and the tables grow with the number
+     of states.  */
+  struct dfa_state **states;
+  int *buckets;
+  int nstates, states_size, flushes;
+  struct dfa_wide *wide;
+  /* The states with an empty kernel, by flags, or -1.  */
+  int empty[2 * DFA_FLOATING];
+
+  /* Work areas, with one element per node, or three for STACK.  */
+  int *mark, *stack, *closure, *kernel;
+  int generation;
+
+  /* The DFA for backward searches, or zero if none was made yet.  */
+  struct re_dfa *reverse;
+};
+
+/* Where a backward scan of the reverse DFA is: its state, or -1 if it
+   has not started, and its position.  */
+struct dfa_cursor
+{
+  int state;
+  ssize_t pos;
+};
+
+/* Kinds of lookahead for dfa_closure: a character, a character that
+   is past the limit of the match, and the end of the text.  */
+enum dfa_lookahead { DFA_LA_CHAR, DFA_LA_LIMIT, DFA_LA_END };
+
+/* Forget the states of DFA, and free its tables.  */
+
+static void
+dfa_flush (struct re_dfa *dfa)
+{
+  int i;
+
+  for (i = 0; i < dfa->nstates; i++)
+    xfree (dfa->states[i]);
+  xfree (dfa->states);
+  xfree (dfa->buckets);
+  xfree (dfa->wide);
+  dfa->states = NULL;
+  dfa->buckets = NULL;
+  dfa->wide = NULL;
+  dfa->nstates = dfa->states_size = 0;
+  for (i = 0; i < 2 * DFA_FLOATING; i++)
+    dfa->empty[i] = -1;
+}
+
+static void
+dfa_free (struct re_dfa *dfa)
+{
+  if (dfa->usable)
+    {
+      dfa_flush (dfa);
+      xfree (dfa->nodes);
+      xfree (dfa->mark);
+      xfree (dfa->stack);
+      xfree (dfa->closure);
+      xfree (dfa->kernel);
+    }
+  if (dfa->reverse)
+    dfa_free (dfa->reverse);
+  xfree (dfa);
+}
+
+/* Forget the states cached for the pattern BUFP.  */
+
+void
+re_flush_dfa (struct re_pattern_buffer *bufp)
+{
+  if (bufp->dfa && bufp->dfa->usable)
+    {
+      dfa_flush (bufp->dfa);
+      bufp->dfa->syntax_table = Qnil;
+      if (bufp->dfa->reverse)
+	{
+	  dfa_flush (bufp->dfa->reverse);
+	  bufp->dfa->reverse->syntax_table = Qnil;
+	}
+    }
+}
+
+/* Free the DFA of the pattern BUFP.  The next search that can use
+   one makes it again.  */
+
+void
+re_free_dfa (struct re_pattern_buffer *bufp)
+{
+  if (bufp->dfa)
+    {
+      dfa_free (bufp->dfa);
+      bufp->dfa = NULL;
+    }
+}
+
+/* Free the memory of the compiled pattern BUFP, except its fastmap.  */
+
+void
+re_free_pattern (struct re_pattern_buffer *bufp)
+{
+  re_free_dfa (bufp);
+  free (bufp->buffer);
+  bufp->buffer = NULL;
+  bufp->allocated = 0;
+  bufp->used = 0;
+}
+
+/* Return the address just past the charset operation at P.  */
+
+static re_char *
+dfa_charset_end (re_char *p)
+{
+  if (CHARSET_RANGE_TABLE_EXISTS_P (p))
+    {
+      int count;
+      re_char *range_table = CHARSET_RANGE_TABLE (p);
+      EXTRACT_NUMBER_AND_INCR (count, range_table);
+      return CHARSET_RANGE_TABLE_END (range_table, count);
+    }
+  return p + 2 + CHARSET_BITMAP_SIZE (p);
+}
+
+/* Make the DFA for the compiled pattern BUFP.  */
+
+static struct re_dfa *
+dfa_build (struct re_pattern_buffer *bufp)
+{
+  re_char *pattern = bufp->buffer, *pend = pattern + bufp->used, *p;
+  const boolean multibyte = RE_MULTIBYTE_P (bufp);
+  struct re_dfa *dfa = xzalloc (sizeof *dfa);
+  int *node_at = xnmalloc (bufp->used + 1, sizeof *node_at);
+  bool uses_bol = false, uses_prev_syntax = false, uses_assertion = false;
+  int nnodes = 0, i, mcnt;
+
+  dfa->target_multibyte = bufp->target_multibyte;
+  for (i = 0; i <= bufp->used; i++)
+    node_at[i] = -1;
+
+  /* First check the operations, and number the nodes.  */
+  for (p = pattern; p < pend; )
+    {
+      node_at[p - pattern] = nnodes++;
+      switch (*p)
+	{
+	case exactn:
+	  {
+	    re_char *q = p + 2, *end = q + p[1];
+	    nnodes--;
+	    while (q < end)
+	      {
+		q += multibyte ? BYTES_BY_CHAR_HEAD (*q) : 1;
+		nnodes++;
+	      }
+	    p = end;
+	  }
+	  break;
+
+	case charset:
+	case charset_not:
+	  if (CHARSET_RANGE_TABLE_EXISTS_P (p))
+	    {
+	      int bits = CHARSET_RANGE_TABLE_BITS (p);
+	      if (bits & (BIT_LOWER | BIT_UPPER))
+		goto unusable;
+	      if (bits & (BIT_PUNCT | BIT_SPACE | BIT_WORD))
+		dfa->uses_syntax = true;
+	    }
+	  p = dfa_charset_end (p);
+	  break;
+
+	case begline:
+	  uses_bol = true;
+	  /* Fall through.  */
+	case endline:
+	case begbuf:
+	case endbuf:
+	  uses_assertion = true;
+	  p++;
+	  break;
+
+	case wordbound:
+	case notwordbound:
+	case wordbeg:
+	case wordend:
+	case symbeg:
+	case symend:
+	  uses_assertion = uses_prev_syntax = dfa->uses_syntax = true;
+	  p++;
+	  break;
+
+	case syntaxspec:
+	case notsyntaxspec:
+	  dfa->uses_syntax = true;
+	  p += 2;
+	  break;
+
+	case no_op:
+	case succeed:
+	case anychar:
+	  p++;
+	  break;
+
+	case start_memory:
+	case stop_memory:
+	  p += 2;
+	  break;
+
+	case jump:
+	case on_failure_jump:
+	case on_failure_keep_string_jump:
+	case on_failure_keep_string_span:
+	case on_failure_jump_loop:
+	case on_failure_jump_nastyloop:
+	case on_failure_jump_smart:
+	  p += 3;
+	  break;
+
+	default:
+	  goto unusable;
+	}
+      if (nnodes > DFA_MAX_NODES)
+	goto unusable;
+    }
+  node_at[bufp->used] = nnodes++;
+
+  /* Then make the nodes.  */
+  dfa->nnodes = nnodes;
+  dfa->nodes = xnmalloc (nnodes, sizeof *dfa->nodes);
+  for (p = pattern; p < pend; )
+    {
+      struct dfa_node *node = &dfa->nodes[node_at[p - pattern]];
+      re_char *q;
+
+      node->next = -1;
+      switch (*p)
+	{
+	case exactn:
+	  {
+	    re_char *end = p + 2 + p[1];
+	    for (q = p + 2; q < end; node++)
+	      {
+		int c, len;
+		if (multibyte)
+		  c = STRING_CHAR_AND_LENGTH (q, len);
+		else
+		  c = RE_CHAR_TO_MULTIBYTE (*q), len = 1;
+		if (! bufp->target_multibyte)
+		  c = multibyte ? RE_CHAR_TO_UNIBYTE (c) : *q;
+		node->type = DFA_CHAR;
+		node->c = c;
+		node->next = node_at[end - pattern];
+		if (q + len < end)
+		  node->next = node + 1 - dfa->nodes;
+		q += len;
+	      }
+	    p = end;
+	  }
+	  continue;
+
+	case charset:
+	case charset_not:
+	  node->type = DFA_CHARSET;
+	  node->charset = p - pattern;
+	  q = dfa_charset_end (p);
+	  break;
+
+	case succeed:
+	  node->type = DFA_MATCH;
+	  q = p + 1;
+	  break;
+
+	case anychar:
+	case begline:
+	case endline:
+	case begbuf:
+	case endbuf:
+	case wordbound:
+	case notwordbound:
+	case wordbeg:
+	case wordend:
+	case symbeg:
+	case symend:
+	case no_op:
+	  node->type = (*p == anychar ? DFA_ANYCHAR
+			: *p == begline ? DFA_BOL
+			: *p == endline ? DFA_EOL
+			: *p == begbuf ? DFA_BOB
+			: *p == endbuf ? DFA_EOB
+			: *p == wordbound ? DFA_WORDBOUND
+			: *p == notwordbound ? DFA_NOTWORDBOUND
+			: *p == wordbeg ? DFA_WORDBEG
+			: *p == wordend ? DFA_WORDEND
+			: *p == symbeg ? DFA_SYMBEG
+			: *p == symend ? DFA_SYMEND
+			: DFA_JUMP);
+	  q = p + 1;
+	  break;
+
+	case syntaxspec:
+	case notsyntaxspec:
+	  node->type = *p == syntaxspec ? DFA_SYNTAXSPEC : DFA_NOTSYNTAXSPEC;
+	  node->syntax = p[1];
+	  q = p + 2;
+	  break;
+
+	case start_memory:
+	case stop_memory:
+	  node->type = DFA_JUMP;
+	  q = p + 2;
+	  break;
+
+	case jump:
+	  EXTRACT_NUMBER (mcnt, p + 1);
+	  node->type = DFA_JUMP;
+	  node->next = node_at[p + 3 + mcnt - pattern];
+	  q = p + 3;
+	  {
+	    /* optimize_pattern turns the loops it finds simple into
+	       a loop that jumps back past its on_failure_keep_string_jump,
+	       which keeps the exit open for later iterations.  In the
+	       DFA, the exit must be on the way back.  */
+	    re_char *dest = q + mcnt;
+	    if (dest - 3 >= pattern && node_at[dest - 3 - pattern] >= 0
+		&& ((re_opcode_t) dest[-3] == on_failure_keep_string_jump
+		    || ((re_opcode_t) dest[-3]
+			== on_failure_keep_string_span)))
+	      {
+		EXTRACT_NUMBER (mcnt, dest - 2);
+		if (dest + mcnt == q)
+		  node->next = node_at[dest - 3 - pattern];
+	      }
+	  }
+	  break;
+
+	default:
+	  /* One of the on_failure_jump operations.  */
+	  EXTRACT_NUMBER (mcnt, p + 1);
+	  node->type = DFA_SPLIT;
+	  node->alt = node_at[p + 3 + mcnt - pattern];
+	  q = p + 3;
+	  break;
+	}
+      if (node->next < 0)
+	node->next = node_at[q - pattern];
+      p = q;
+    }
+  dfa->nodes[nnodes - 1].type = DFA_MATCH;
+  dfa->start = node_at[0];
+  xfree (node_at);
+
+  dfa->flag_mask = (DFA_FLOATING
+		    | (uses_assertion ? DFA_AT_BEG : 0)
+		    | (uses_bol ? DFA_AFTER_NL : 0)
+		    | (uses_prev_syntax
+		       ? DFA_AFTER_WORD | DFA_AFTER_SYMBOL | DFA_AFTER_WIDE
+		       : 0));
+  dfa->syntax_table = Qnil;
+  dfa->mark = xzalloc (nnodes * sizeof *dfa->mark);
+  dfa->stack = xnmalloc (3 * nnodes + 1, sizeof *dfa->stack);
+  dfa->closure = xnmalloc (nnodes, sizeof *dfa->closure);
+  dfa->kernel = xnmalloc (nnodes, sizeof *dfa->kernel);
+  dfa_flush (dfa);
+  dfa->usable = true;
+  return dfa;
+
+ unusable:
+  xfree (node_at);
+  dfa->usable = false;
+  return dfa;
+}
+
+/* Make the reverse of DFA, which must be usable.
+
+   Its node U is a copy of node U of DFA if that matches a character;
+   it goes to the entry of U, which stands for the place before U.
+   The entry of a node V leads, through a tree of DFA_SPLIT nodes, to
+   the copy of each node that matches a character and goes to V, to
+   the entry of each other node that goes to V, and to a DFA_MATCH
+   node if V is where DFA starts.  Zero-width assertions become plain
+   jumps.  The reverse DFA starts at the entries of the DFA_MATCH
+   nodes of DFA.  */
+
+static struct re_dfa *
+dfa_build_reverse (struct re_dfa *dfa)
+{
+  struct re_dfa *rev = xzalloc (sizeof *rev);
+  int n = dfa->nnodes, i, j, k;
+  /* For each node, the number of nodes that go to it, and then the
+     index in PREDS of the first one.  */
+  int *first = xzalloc ((n + 1) * sizeof *first);
+  int *preds, *entry = xnmalloc (n, sizeof *entry);
+  int nedges = 0, nmatch = 0, nnodes, match, start;
+  struct dfa_node *nodes;
+
+  for (i = 0; i < n; i++)
+    switch (dfa->nodes[i].type)
+      {
+      case DFA_MATCH:
+	nmatch++;
+	break;
+      case DFA_SPLIT:
+	first[dfa->nodes[i].alt]++;
+	nedges++;
+	/* Fall through.  */
+      default:
+	first[dfa->nodes[i].next]++;
+	nedges++;
+      }
+  first[dfa->start]++;
+
+  /* One node per edge, or one for a node that nothing goes to, plus
+     the copies, the final DFA_MATCH node and the start.  */
+  nnodes = n;
+  for (i = 0; i < n; i++)
+    {
+      entry[i] = nnodes;
+      nnodes += max (first[i], 1);
+    }
+  match = nnodes++;
+  start = nnodes;
+  nnodes += max (nmatch, 1);
+
+  /* Turn the counts into the start of each node's list.  */
+  for (i = 0, k = 0; i <= n; i++)
+    {
+      int count = first[i];
+      first[i] = k;
+      k += count;
+    }
+  preds = xnmalloc (nedges + 1, sizeof *preds);
+  for (i = 0; i < n; i++)
+    {
+      struct dfa_node *node = &dfa->nodes[i];
+      int from = node->type >= DFA_CHAR ? i : entry[i];
+      if (node->type == DFA_MATCH)
+	continue;
+      preds[first[node->next]++] = from;
+      if (node->type == DFA_SPLIT)
+	preds[first[node->alt]++] = from;
+    }
+  preds[first[dfa->start]++] = match;
+  /* Now FIRST[I] is the end of the list of I; the list of I starts
+     where the list of I - 1 ends.  */
+
+  rev->nnodes = nnodes;
+  rev->nodes = nodes = xnmalloc (nnodes, sizeof *nodes);
+  for (i = 0; i < n; i++)
+    {
+      nodes[i] = dfa->nodes[i];
+      if (nodes[i].type >= DFA_CHAR)
+	nodes[i].next = entry[i];
+      else
+	{
+	  /* Never reached.  */
+	  nodes[i].type = DFA_CHAR;
+	  nodes[i].c = -1;
+	  nodes[i].next = match;
+	}
+    }
+  nodes[match].type = DFA_MATCH;
+  nodes[match].next = match;
+
+  /* Make a tree of splits at BASE that leads to the COUNT nodes of
+     LIST, or a node that matches nothing if COUNT is zero.  */
+#define REVERSE_FANOUT(base, list, count)			\
+  do								\
+    {								\
+      int base_ = (base), count_ = (count);			\
+      if (count_ == 0)						\
+	{							\
+	  nodes[base_].type = DFA_CHAR;				\
+	  nodes[base_].c = -1;					\
+	  nodes[base_].next = match;				\
+	}							\
+      for (j = 0; j < count_; j++)				\
+	{							\
+	  nodes[base_ + j].type					\
+	    = j < count_ - 1 ? DFA_SPLIT : DFA_JUMP;		\
+	  nodes[base_ + j].next = (list)[j];			\
+	  nodes[base_ + j].alt = base_ + j + 1;			\
+	}							\
+    }								\
+  while (false)
+
+  for (i = 0; i < n; i++)
+    {
+      int from = i == 0 ? 0 : first[i - 1];
+      REVERSE_FANOUT (entry[i], preds + from, first[i] - from);
+    }
+  for (i = 0, k = 0; i < n; i++)
+    if (dfa->nodes[i].type == DFA_MATCH)
+      preds[k++] = entry[i];
+  REVERSE_FANOUT (start, preds, k);
+#undef REVERSE_FANOUT
+
+  xfree (preds);
+  xfree (entry);
+  xfree (first);
+
+  rev->target_multibyte = dfa->target_multibyte;
+  rev->uses_syntax = dfa->uses_syntax;
+  rev->flag_mask = DFA_FLOATING;
+  rev->syntax_table = Qnil;
+  rev->start = start;
+  rev->mark = xzalloc (nnodes * sizeof *rev->mark);
+  rev->stack = xnmalloc (3 * nnodes + 1, sizeof *rev->stack);
+  rev->closure = xnmalloc (nnodes, sizeof *rev->closure);
+  rev->kernel = xnmalloc (nnodes, sizeof *rev->kernel);
+  dfa_flush (rev);
+  rev->usable = true;
+  return rev;
+}
+
+/* Return the flags of DFA, for BUFP, describing the target
+   character C.  */
+
+static int
+dfa_char_flags (struct re_pattern_buffer *bufp, struct re_dfa *dfa, int c)
+{
+  int flags = c == '\n' ? DFA_AFTER_NL : 0;
+
+  if (dfa->flag_mask & DFA_AFTER_WORD)
+    {
+      int c1 = bufp->target_multibyte ? c : RE_CHAR_TO_MULTIBYTE (c);
+      switch (SYNTAX (c1))
+	{
+	case Sword:
+	  flags |= DFA_AFTER_WORD;
+	  if (! SINGLE_BYTE_CHAR_P (c1))
+	    flags |= DFA_AFTER_WIDE;
+	  break;
+	case Ssymbol:
+	  flags |= DFA_AFTER_SYMBOL;
+	  break;
+	default:
+	  break;
+	}
+    }
+  return flags & dfa->flag_mask;
+}
+
+/* Return 1 if the zero-width node of type TYPE succeeds after a
+   character described by FLAGS and before the target character LA,
+   whose kind is KIND; 0 if it fails; and -1 if this depends on more
+   than that, i.e., on the characters themselves through
+   WORD_BOUNDARY_P.  This mirrors re_match_2_internal.  */
+
+static int
+dfa_assertion (struct re_pattern_buffer *bufp, int type, int flags,
+	       int la, enum dfa_lookahead kind)
+{
+  bool at_beg = flags & DFA_AT_BEG, at_end = kind == DFA_LA_END;
+  bool after_word = flags & DFA_AFTER_WORD;
+  bool after_symbol = after_word || (flags & DFA_AFTER_SYMBOL);
+  int c2 = (at_end || bufp->target_multibyte
+	    ? la : RE_CHAR_TO_MULTIBYTE (la));
+  int s2;
+
+  switch (type)
+    {
+    case DFA_BOL:
+      return at_beg ? !bufp->not_bol : (flags & DFA_AFTER_NL) != 0;
+
+    case DFA_EOL:
+      return at_end ? !bufp->not_eol : la == '\n';
+
+    case DFA_BOB:
+      return at_beg;
+
+    case DFA_EOB:
+      return at_end;
+
+    case DFA_WORDBOUND:
+    case DFA_NOTWORDBOUND:
+      {
+	bool bound;
+	if (at_beg || at_end)
+	  bound = true;
+	else if (after_word != (SYNTAX (c2) == Sword))
+	  bound = true;
+	else if (! after_word)
+	  bound = false;
+	else if ((flags & DFA_AFTER_WIDE) || ! SINGLE_BYTE_CHAR_P (c2))
+	  return -1;
+	else
+	  bound = false;
+	return bound == (type == DFA_WORDBOUND);
+      }
+
+    case DFA_WORDBEG:
+      if (at_end || kind == DFA_LA_LIMIT || SYNTAX (c2) != Sword)
+	return 0;
+      if (at_beg || ! after_word)
+	return 1;
+      return ((flags & DFA_AFTER_WIDE) || ! SINGLE_BYTE_CHAR_P (c2)) ? -1 : 0;
+
+    case DFA_WORDEND:
+      if (at_beg || ! after_word)
+	return 0;
+      if (at_end || SYNTAX (c2) != Sword)
+	return 1;
+      return ((flags & DFA_AFTER_WIDE) || ! SINGLE_BYTE_CHAR_P (c2)) ? -1 : 0;
+
+    case DFA_SYMBEG:
+      if (at_end || kind == DFA_LA_LIMIT)
+	return 0;
+      s2 = SYNTAX (la);
+      return (s2 == Sword || s2 == Ssymbol) && (at_beg || ! after_symbol);
+
+    case DFA_SYMEND:
+      if (at_beg || ! after_symbol)
+	return 0;
+      if (at_end)
+	return 1;
+      s2 = SYNTAX (la);
+      return s2 != Sword && s2 != Ssymbol;
+
+    default:
+      emacs_abort ();
+    }
+}
+
+/* Return true if the charset operation at P matches the target
+   character C.  This mirrors re_match_2_internal.  */
+
+static bool
+dfa_charset_matches (struct re_pattern_buffer *bufp, re_char *p, int c)
+{
+  RE_TRANSLATE_TYPE translate = bufp->translate;
+  bool not = (re_opcode_t) *p == charset_not;
+  bool unibyte_char = false;
+
+  if (bufp->target_multibyte)
+    {
+      int c1;
+
+      c = TRANSLATE (c);
+      c1 = RE_CHAR_TO_UNIBYTE (c);
+      if (c1 >= 0)
+	{
+	  unibyte_char = true;
+	  c = c1;
+	}
+    }
+  else
+    {
+      int c1 = RE_CHAR_TO_MULTIBYTE (c);
+
+      if (! CHAR_BYTE8_P (c1))
+	{
+	  c1 = TRANSLATE (c1);
+	  c1 = RE_CHAR_TO_UNIBYTE (c1);
+	  if (c1 >= 0)
+	    {
+	      unibyte_char = true;
+	      c = c1;
+	    }
+	}
+      else
+	unibyte_char = true;
+    }
+
+  if (unibyte_char && c < (1 << BYTEWIDTH))
+    {
+      if (c < (unsigned) (CHARSET_BITMAP_SIZE (p) * BYTEWIDTH)
+	  && p[2 + c / BYTEWIDTH] & (1 << (c % BYTEWIDTH)))
+	not = !not;
+    }
+  else if (CHARSET_RANGE_TABLE_EXISTS_P (p))
+    {
+      int class_bits = CHARSET_RANGE_TABLE_BITS (p);
+      re_char *range_table = CHARSET_RANGE_TABLE (p);
+      int count;
+
+      EXTRACT_NUMBER_AND_INCR (count, range_table);
+      if (  (class_bits & BIT_MULTIBYTE)
+	  | (class_bits & BIT_PUNCT && ISPUNCT (c))
+	  | (class_bits & BIT_SPACE && ISSPACE (c))
+	  | (class_bits & BIT_WORD  && ISWORD (c)))
+	not = !not;
+      else
+	CHARSET_LOOKUP_RANGE_TABLE_RAW (not, c, range_table, count);
+    }
+  return not;
+}
+
+/* Return true if NODE, which matches one character, matches the
+   target character C.  This mirrors re_match_2_internal.  */
+
+static bool
+dfa_node_matches (struct re_pattern_buffer *bufp, struct dfa_node *node,
+		  int c)
+{
+  RE_TRANSLATE_TYPE translate = bufp->translate;
+  const boolean target_multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+
+  switch (node->type)
+    {
+    case DFA_CHAR:
+      if (target_multibyte)
+	return TRANSLATE (c) == node->c;
+      else
+	{
+	  int buf_ch = RE_CHAR_TO_MULTIBYTE (c);
+	  if (! CHAR_BYTE8_P (buf_ch))
+	    {
+	      buf_ch = TRANSLATE (buf_ch);
+	      buf_ch = RE_CHAR_TO_UNIBYTE (buf_ch);
+	      if (buf_ch < 0)
+		buf_ch = c;
+	    }
+	  else
+	    buf_ch = c;
+	  return buf_ch == node->c;
+	}
+
+    case DFA_ANYCHAR:
+      c = TRANSLATE (c);
+      return ! ((!(bufp->syntax & RE_DOT_NEWLINE) && c == '\n')
+		|| ((bufp->syntax & RE_DOT_NOT_NULL) && c == '\000'));
+
+    case DFA_CHARSET:
+      return dfa_charset_matches (bufp, bufp->buffer + node->charset, c);
+
+    case DFA_SYNTAXSPEC:
+    case DFA_NOTSYNTAXSPEC:
+      if (! target_multibyte)
+	c = RE_CHAR_TO_MULTIBYTE (c);
+      return ((SYNTAX (c) == node->syntax)
+	      == (node->type == DFA_SYNTAXSPEC));
+
+    default:
+      emacs_abort ();
+    }
+}
+
+/* Start a new generation of marks in DFA, and return it.  */
+
+static int
+dfa_new_generation (struct re_dfa *dfa)
+{
+  if (dfa->generation == INT_MAX)
+    {
+      memset (dfa->mark, 0, dfa->nnodes * sizeof *dfa->mark);
+      dfa->generation = 0;
+    }
+  return ++dfa->generation;
+}
+
+/* Store in the closure work area of DFA, for BUFP, the nodes matching
+   one character that state S reaches before the target character LA,
+   of kind KIND.  Set *ACCEPT to whether a match ends there.  Return
+   the number of nodes, or -1 if the DFA can't tell.  */
+
+static int
+dfa_closure (struct re_pattern_buffer *bufp, struct re_dfa *dfa, int s,
+	     int la, enum dfa_lookahead kind, int *accept)
+{
+  struct dfa_state *state = dfa->states[s];
+  int gen = dfa_new_generation (dfa);
+  int sp = 0, n = 0, i;
+
+  *accept = 0;
+  for (i = 0; i < state->nkernel; i++)
+    dfa->stack[sp++] = state->kernel[i];
+  if (state->flags & DFA_FLOATING)
+    dfa->stack[sp++] = dfa->start;
+
+  while (sp > 0)
+    {
+      int index = dfa->stack[--sp];
+      struct dfa_node *node = &dfa->nodes[index];
+      int ok;
+
+      if (dfa->mark[index] == gen)
+	continue;
+      dfa->mark[index] = gen;
+      switch (node->type)
+	{
+	case DFA_MATCH:
+	  *accept = 1;
+	  break;
+
+	case DFA_SPLIT:
+	  dfa->stack[sp++] = node->alt;
+	  /* Fall through.  */
+	case DFA_JUMP:
+	  dfa->stack[sp++] = node->next;
+	  break;
+
+	default:
+	  if (node->type >= DFA_CHAR)
+	    dfa->closure[n++] = index;
+	  else
+	    {
+	      ok = dfa_assertion (bufp, node->type, state->flags, la, kind);
+	      if (ok < 0)
+		return -1;
+	      if (ok)
+		dfa->stack[sp++] = node->next;
+	    }
+	}
+    }
+  return n;
+}
+
+static int
+dfa_compare_ints (const void *a, const void *b)
+{
+  int x = *(const int *) a, y = *(const int *) b;
+  return (x > y) - (x < y);
+}
+
+/* Return the hash code of the state with the N nodes of KERNEL and
+   FLAGS.  */
+
+static size_t
+dfa_hash (int *kernel, int n, int flags)
+{
+  size_t hash = flags;
+  int i;
+
+  for (i = 0; i < n; i++)
+    hash = hash * 31 + kernel[i];
+  return hash;
+}
+
+/* Make room for one more state in the tables of DFA, and rehash its
+   states if the number of buckets changes.  */
+
+static void
+dfa_grow_states (struct re_dfa *dfa)
+{
+  ptrdiff_t size = dfa->states_size;
+  int i;
+
+  dfa->states = xpalloc (dfa->states, &size, 1, DFA_MAX_STATES,
+			 sizeof *dfa->states);
+  dfa->states_size = size;
+  dfa->buckets = xnrealloc (dfa->buckets, size, sizeof *dfa->buckets);
+  for (i = 0; i < size; i++)
+    dfa->buckets[i] = -1;
+  for (i = 0; i < dfa->nstates; i++)
+    {
+      struct dfa_state *state = dfa->states[i];
+      int bucket = (dfa_hash (state->kernel, state->nkernel, state->flags)
+		    % size);
+      state->chain = dfa->buckets[bucket];
+      dfa->buckets[bucket] = i;
+    }
+}
+
+/* Return the index of the state of DFA with the N nodes of KERNEL,
+   sorted, and FLAGS, making it if necessary.  Return -1 if the DFA
+   gave up.  */
+
+static int
+dfa_intern (struct re_dfa *dfa, int *kernel, int n, int flags)
+{
+  size_t hash = dfa_hash (kernel, n, flags);
+  int bucket, i;
+  struct dfa_state *state;
+
+  if (dfa->states_size > 0)
+    for (i = dfa->buckets[hash % dfa->states_size]; i >= 0;
+	 i = state->chain)
+      {
+	state = dfa->states[i];
+	if (state->flags == flags && state->nkernel == n
+	    && memcmp (state->kernel, kernel, n * sizeof *kernel) == 0)
+	  return i;
+      }
+
+  if (dfa->nstates == DFA_MAX_STATES)
+    {
+      if (++dfa->flushes > DFA_MAX_FLUSHES)
+	return -1;
+      dfa_flush (dfa);
+    }
+  if (dfa->nstates == dfa->states_size)
+    dfa_grow_states (dfa);
+  bucket = hash % dfa->states_size;
+
+  state = xmalloc (offsetof (struct dfa_state, kernel)
+		   + n * sizeof *kernel);
+  memset (state->next, 0, sizeof state->next);
+  memcpy (state->kernel, kernel, n * sizeof *kernel);
+  state->nkernel = n;
+  state->flags = flags;
+  state->dead = n == 0 && !(flags & DFA_FLOATING);
+  state->accepts_at_end = -1;
+  state->chain = dfa->buckets[bucket];
+  i = dfa->nstates;
+  dfa->states[i] = state;
+  dfa->nstates = i + 1;
+  dfa->buckets[bucket] = i;
+  return i;
+}
+
+/* Return the transition of state S of DFA, for BUFP, on the target
+   character C, encoded as in the NEXT field of states, or -1 if the
+   DFA gave up.  */
+
+static int
+dfa_transition (struct re_pattern_buffer *bufp, struct re_dfa *dfa,
+		int s, int c)
+{
+  int flushes = dfa->flushes;
+  int accept, n, nkernel = 0, gen, i, next, flags, t;
+
+  n = dfa_closure (bufp, dfa, s, c, DFA_LA_CHAR, &accept);
+  if (n < 0)
+    return -1;
+
+  gen = dfa_new_generation (dfa);
+  for (i = 0; i < n; i++)
+    {
+      struct dfa_node *node = &dfa->nodes[dfa->closure[i]];
+      if (dfa->mark[node->next] != gen
+	  && dfa_node_matches (bufp, node, c))
+	{
+	  dfa->mark[node->next] = gen;
+	  dfa->kernel[nkernel++] = node->next;
+	}
+    }
+  qsort (dfa->kernel, nkernel, sizeof *dfa->kernel, dfa_compare_ints);
+
+  flags = (dfa_char_flags (bufp, dfa, c)
+	   | (dfa->states[s]->flags & DFA_FLOATING));
+  next = dfa_intern (dfa, dfa->kernel, nkernel, flags);
+  if (next < 0)
+    return -1;
+  t = 2 * (next + 1) + accept;
+
+  /* Cache the transition, unless making the next state flushed S.  */
+  if (dfa->flushes == flushes)
+    {
+      if (c < (1 << BYTEWIDTH))
+	dfa->states[s]->next[c] = t;
+      else
+	{
+	  if (! dfa->wide)
+	    {
+	      dfa->wide = xnmalloc (DFA_WIDE_CACHE, sizeof *dfa->wide);
+	      for (i = 0; i < DFA_WIDE_CACHE; i++)
+		dfa->wide[i].state = -1;
+	    }
+	  i = (s * 31u + c) % DFA_WIDE_CACHE;
+	  dfa->wide[i].state = s;
+	  dfa->wide[i].c = c;
+	  dfa->wide[i].next = t;
+	}
+    }
+  return t;
+}
+
+/* Return the cached transition of state S of DFA on the character C,
+   which is above 255, or 0 if none is cached.  */
+
+static int
+dfa_wide_transition (struct re_dfa *dfa, int s, int c)
+{
+  struct dfa_wide *wide;
+
+  if (! dfa->wide)
+    return 0;
+  wide = &dfa->wide[(s * 31u + c) % DFA_WIDE_CACHE];
+  return wide->state == s && wide->c == c ? wide->next : 0;
+}
+
+/* Return 1 if a match ends when state S of DFA, for BUFP, is before
+   LA, of kind KIND, which is not DFA_LA_CHAR; 0 if not; or -1 if the
+   DFA can't tell.  */
+
+static int
+dfa_accepts (struct re_pattern_buffer *bufp, struct re_dfa *dfa, int s,
+	     int la, enum dfa_lookahead kind)
+{
+  struct dfa_state *state = dfa->states[s];
+  int accept;
+
+  if (kind == DFA_LA_END && state->accepts_at_end >= 0)
+    return state->accepts_at_end;
+  if (dfa_closure (bufp, dfa, s, la, kind, &accept) < 0)
+    return -1;
+  if (kind == DFA_LA_END)
+    state->accepts_at_end = accept;
+  return accept;
+}
+
+/* Prepare the DFA of BUFP for a search that has set up gl_state, and
+   return true if the search can use it.  */
+
+static bool
+dfa_prepare (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *dfa = bufp->dfa;
+
+  if (! search_use_dfa)
+    return false;
+  if (! dfa || dfa->target_multibyte != bufp->target_multibyte)
+    {
+#ifdef REL_ALLOC
+      /* Don't relocate the text about to be searched.  */
+      r_alloc_inhibit_buffer_relocation (1);
+#endif
+      if (dfa)
+	dfa_free (dfa);
+      bufp->dfa = dfa = dfa_build (bufp);
+#ifdef REL_ALLOC
+      r_alloc_inhibit_buffer_relocation (0);
+#endif
+    }
+  if (! dfa->usable)
+    return false;
+  if (dfa->uses_syntax)
+    {
+      if (parse_sexp_lookup_properties)
+	return false;
+      if (! EQ (dfa->syntax_table, gl_state.current_syntax_table))
+	{
+#ifdef REL_ALLOC
+	  r_alloc_inhibit_buffer_relocation (1);
+#endif
+	  dfa_flush (dfa);
+#ifdef REL_ALLOC
+	  r_alloc_inhibit_buffer_relocation (0);
+#endif
+	  dfa->syntax_table = gl_state.current_syntax_table;
+	}
+    }
+  dfa->flushes = 0;
+  return true;
+}
+
+/* Prepare the reverse DFA of BUFP for a backward search, once
+   dfa_prepare has returned true.  */
+
+static void
+dfa_prepare_reverse (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *rev = bufp->dfa->reverse;
+
+#ifdef REL_ALLOC
+  r_alloc_inhibit_buffer_relocation (1);
+#endif
+  if (! rev)
+    bufp->dfa->reverse = rev = dfa_build_reverse (bufp->dfa);
+  else if (rev->uses_syntax
+	   && ! EQ (rev->syntax_table, gl_state.current_syntax_table))
+    dfa_flush (rev);
+#ifdef REL_ALLOC
+  r_alloc_inhibit_buffer_relocation (0);
+#endif
+  rev->syntax_table = gl_state.current_syntax_table;
+  rev->flushes = 0;
+}
+
+/* Return the DFA flags describing the character before POS in the
+   virtual concatenation of STRING1 and STRING2, of sizes SIZE1 and
+   SIZE2.  */
+
+static int
+dfa_flags_before (struct re_pattern_buffer *bufp,
+		  re_char *string1, ssize_t size1, re_char *string2,
+		  ssize_t pos)
+{
+  re_char *d, *limit;
+  int c;
+
+  if (pos == 0)
+    return DFA_AT_BEG & bufp->dfa->flag_mask;
+  d = pos <= size1 ? string1 + pos : string2 + (pos - size1);
+  limit = pos <= size1 ? string1 : string2;
+  if (RE_TARGET_MULTIBYTE_P (bufp))
+    {
+      do
+	d--;
+      while (d > limit && ! CHAR_HEAD_P (*d));
+      c = STRING_CHAR (d);
+    }
+  else
+    c = d[-1];
+  return dfa_char_flags (bufp, bufp->dfa, c);
+}
+
+/* Return the first position from POS, and before LIMIT, where the
+   fastmap of BUFP says a match can start, or LIMIT if there is none.
+   The text from POS to LIMIT starts at D, and is contiguous.  This
+   mirrors the fastmap loop of re_search_2.  */
+
+static ssize_t
+dfa_skip (struct re_pattern_buffer *bufp, re_char *d, ssize_t pos,
+	  ssize_t limit)
+{
+  RE_TRANSLATE_TYPE translate = bufp->translate;
+  char *fastmap = bufp->fastmap;
+
+  if (RE_TARGET_MULTIBYTE_P (bufp))
+    while (pos < limit)
+      {
+	int len, c = STRING_CHAR_AND_LENGTH (d, len);
+	c = TRANSLATE (c);
+	if (fastmap[CHAR_LEADING_CODE (c)])
+	  break;
+	d += len;
+	pos += len;
+      }
+  else if (RE_TRANSLATE_P (translate))
+    while (pos < limit)
+      {
+	int c = *d, ch = RE_CHAR_TO_MULTIBYTE (c);
+	int translated = RE_TRANSLATE (translate, ch);
+	if (translated != ch && (ch = RE_CHAR_TO_UNIBYTE (translated)) >= 0)
+	  c = ch;
+	if (fastmap[c])
+	  break;
+	d++;
+	pos++;
+      }
+  else
+    while (pos < limit && !fastmap[*d])
+      {
+	d++;
+	pos++;
+      }
+  return pos;
+}
+
+/* Subroutine of dfa_scan, which see.  */
+
+static ssize_t
+dfa_scan_1 (struct re_pattern_buffer *bufp,
+	  re_char *string1, ssize_t size1, re_char *string2, ssize_t size2,
+	  ssize_t startpos, ssize_t endpos, ssize_t stop, bool floating,
+	  ssize_t *from)
+{
+  struct re_dfa *dfa = bufp->dfa;
+  const boolean multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+  ssize_t total_size = size1 + size2, pos = startpos;
+  int s, t, c, len;
+  /* Whether the fastmap can skip positions where no match starts.  */
+  bool skip = (floating && bufp->fastmap && bufp->fastmap_accurate
+	       && !bufp->can_be_null && !RE_TRANSLATE_P (bufp->translate));
+  int flags = dfa_flags_before (bufp, string1, size1, string2, pos);
+
+  if (floating)
+    s = dfa_intern (dfa, NULL, 0, flags | DFA_FLOATING);
+  else
+    s = dfa_intern (dfa, &dfa->start, 1, flags);
+
+  while (s >= 0)
+    {
+      struct dfa_state *state;
+      re_char *d;
+
+      if (floating && pos > endpos)
+	{
+	  /* No match can start from here on.  */
+	  state = dfa->states[s];
+	  memcpy (dfa->kernel, state->kernel,
+		  state->nkernel * sizeof *state->kernel);
+	  s = dfa_intern (dfa, dfa->kernel, state->nkernel,
+			  state->flags & ~DFA_FLOATING);
+	  floating = skip = false;
+	  continue;
+	}
+      state = dfa->states[s];
+      if (floating && state->nkernel == 0)
+	*from = pos;
+
+      if (pos == total_size)
+	{
+	  t = dfa_accepts (bufp, dfa, s, -1, DFA_LA_END);
+	  return t < 0 ? -2 : t ? pos : -1;
+	}
+      d = POS_ADDR_VSTRING (pos);
+
+      if (skip && state->nkernel == 0 && pos < stop)
+	{
+	  /* No match is under way, so go straight to the next position
+	     where one can start.  */
+	  ssize_t limit = min (stop, endpos + 1);
+	  ssize_t next;
+
+	  if (pos < size1)
+	    limit = min (limit, size1);
+	  next = dfa_skip (bufp, d, pos, limit);
+	  if (next > pos)
+	    {
+	      if (next > endpos)
+		return -1;
+	      pos = next;
+	      flags = (dfa_flags_before (bufp, string1, size1, string2, pos)
+		       | DFA_FLOATING);
+	      s = dfa->empty[flags];
+	      if (s < 0)
+		s = dfa->empty[flags] = dfa_intern (dfa, NULL, 0, flags);
+	      continue;
+	    }
+	}
+
+      if (! state->dead)
+	{
+	  /* Follow the transitions already computed on single bytes as
+	     far as possible, in the part of the text where nothing else
+	     needs checking.  */
+	  ssize_t limit = min (pos < size1 ? size1 : total_size, stop);
+	  int limit_byte = multibyte ? 0x80 : 1 << BYTEWIDTH;
+	  ssize_t pos0 = pos;
+
+	  if (floating)
+	    limit = min (limit, endpos + 1);
+	  while (pos < limit && *d < limit_byte)
+	    {
+	      t = state->next[*d];
+	      if (t <= 1 || (t & 1))
+		break;
+	      s = t / 2 - 1;
+	      state = dfa->states[s];
+	      d++;
+	      pos++;
+	      if (state->nkernel == 0)
+		{
+		  if (! floating)
+		    return -1;
+		  *from = pos;
+		}
+	    }
+	  if (pos > pos0)
+	    continue;
+	}
+
+      if (multibyte)
+	c = STRING_CHAR_AND_LENGTH (d, len);
+      else
+	c = *d, len = 1;
+
+      if (pos >= stop)
+	{
+	  t = dfa_accepts (bufp, dfa, s, c, DFA_LA_LIMIT);
+	  return t < 0 ? -2 : t ? pos : -1;
+	}
+      if (state->dead)
+	return -1;
+
+      if (c < (1 << BYTEWIDTH))
+	t = state->next[c];
+      else
+	t = dfa_wide_transition (dfa, s, c);
+      if (t == 0)
+	t = dfa_transition (bufp, dfa, s, c);
+      if (t < 0)
+	break;
+      if (t & 1)
+	return pos;
+      s = t / 2 - 1;
+      pos += len;
+    }
+  return -2;
+}
+
+/* Run the DFA of BUFP over the virtual concatenation of STRING1 and
+   STRING2, of sizes SIZE1 and SIZE2, from STARTPOS, without matching
+   characters at or past STOP.  If FLOATING, a match can start at any
+   position up to ENDPOS, else only at STARTPOS.  Return the position
+   where the first match found ends, -1 if there is none, or -2 if the
+   DFA can't tell.  If FLOATING and a match is found, set *FROM to a
+   position where no match that starts before it is under way: the
+   leftmost match starts there or after.  */
+
+static ssize_t
+dfa_scan (struct re_pattern_buffer *bufp,
+	  re_char *string1, ssize_t size1, re_char *string2, ssize_t size2,
+	  ssize_t startpos, ssize_t endpos, ssize_t stop, bool floating,
+	  ssize_t *from)
+{
+  ssize_t val;
+
+#ifdef REL_ALLOC
+  /* Computing states allocates memory, which must not relocate the
+     text being searched.  */
+  r_alloc_inhibit_buffer_relocation (1);
+#endif
+  val = dfa_scan_1 (bufp, string1, size1, string2, size2,
+		    startpos, endpos, stop, floating, from);
+#ifdef REL_ALLOC
+  r_alloc_inhibit_buffer_relocation (0);
+#endif
+  return val;
+}
+
+/* Subroutine of dfa_scan_backward, which see.  */
+
+static ssize_t
+dfa_scan_backward_1 (struct re_pattern_buffer *bufp,
+		     re_char *string1, ssize_t size1,
+		     re_char *string2, ssize_t size2,
+		     ssize_t startpos, ssize_t endpos, ssize_t stop,
+		     struct dfa_cursor *cursor)
+{
+  struct re_dfa *dfa = bufp->dfa->reverse;
+  const boolean multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+  int limit_byte = multibyte ? 0x80 : 1 << BYTEWIDTH;
+  ssize_t pos = cursor->pos;
+  int s = cursor->state, t, c, len;
+
+  if (s < 0)
+    {
+      pos = min (stop, size1 + size2);
+      s = dfa_intern (dfa, NULL, 0, DFA_FLOATING);
+    }
+
+  while (s >= 0)
+    {
+      struct dfa_state *state = dfa->states[s];
+      re_char *d, *head;
+      ssize_t limit;
+
+      if (pos < endpos)
+	return -1;
+      if (pos == 0)
+	{
+	  t = dfa_accepts (bufp, dfa, s, -1, DFA_LA_END);
+	  cursor->state = s;
+	  cursor->pos = pos;
+	  return t < 0 ? -2 : t ? pos : -1;
+	}
+      head = pos <= size1 ? string1 : string2;
+      d = pos <= size1 ? string1 + pos : string2 + (pos - size1);
+
+      /* Follow the transitions already computed on single bytes as far
+	 as possible, within the string that POS is in.  */
+      limit = max (pos <= size1 ? 0 : size1, endpos);
+      if (pos > limit && d[-1] < limit_byte)
+	{
+	  ssize_t pos0 = pos;
+	  while (pos > limit && d[-1] < limit_byte)
+	    {
+	      t = state->next[d[-1]];
+	      if (t <= 1 || ((t & 1) && pos <= startpos))
+		break;
+	      s = t / 2 - 1;
+	      state = dfa->states[s];
+	      d--;
+	      pos--;
+	    }
+	  if (pos < pos0)
+	    continue;
+	}
+
+      if (multibyte)
+	{
+	  re_char *p = d;
+	  do
+	    p--;
+	  while (p > head && ! CHAR_HEAD_P (*p));
+	  c = STRING_CHAR (p);
+	  len = d - p;
+	}
+      else
+	c = d[-1], len = 1;
+
+      if (c < (1 << BYTEWIDTH))
+	t = state->next[c];
+      else
+	t = dfa_wide_transition (dfa, s, c);
+      if (t == 0)
+	t = dfa_transition (bufp, dfa, s, c);
+      if (t < 0)
+	break;
+      if ((t & 1) && pos <= startpos)
+	{
+	  cursor->state = s;
+	  cursor->pos = pos;
+	  return pos;
+	}
+      s = t / 2 - 1;
+      pos -= len;
+    }
+  return -2;
+}
+
+/* Run the reverse DFA of BUFP backward over the virtual concatenation
+   of STRING1 and STRING2, of sizes SIZE1 and SIZE2, from STOP, or from
+   where CURSOR was left if its state is not negative.  Return the last
+   position at or before STARTPOS, and at or after ENDPOS, where a
+   match that ends at or before STOP may start, -1 if there is none, or
+   -2 if the DFA can't tell.  Leave CURSOR there, so that the search
+   can go on from there if no match starts there after all.  */
+
+static ssize_t
+dfa_scan_backward (struct re_pattern_buffer *bufp,
+		   re_char *string1, ssize_t size1,
+		   re_char *string2, ssize_t size2,
+		   ssize_t startpos, ssize_t endpos, ssize_t stop,
+		   struct dfa_cursor *cursor)
+{
+  ssize_t val;
+
+#ifdef REL_ALLOC
+  r_alloc_inhibit_buffer_relocation (1);
+#endif
+  val = dfa_scan_backward_1 (bufp, string1, size1, string2, size2,
+			     startpos, endpos, stop, cursor);
+#ifdef REL_ALLOC
+  r_alloc_inhibit_buffer_relocation (0);
+#endif
+  return val;
+}
+
+#endif /* emacs */
+
+/* Using the compiled pattern in BUFP->buffer, first tries to match the
+   virtual concatenation of STRING1 and STRING2, starting first at index
+   STARTPOS, then at STARTPOS + 1, and so on.
+
+   STRING1 and STRING2 have length SIZE1 and SIZE2, respectively.
+
+   RANGE is how far to scan while trying to match.  RANGE = 0 means try
+   only at STARTPOS; in general, the last start tried is STARTPOS +
+   RANGE.
+
+   In REGS, return the indices of the virtual concatenation of STRING1
+   and STRING2 that matched the entire BUFP->buffer and its contained
+   subexpressions.
+
+   Do not consider matching one past the index STOP in the virtual
+   concatenation of STRING1 and STRING2.
+
+   We return either the position in the strings at which the match was
+   found, -1 if no match, or -2 if error (such as failure
+   stack overflow).  */
 
 regoff_t
 re_search_2 (struct re_pattern_buffer *bufp, const char *str1, size_t size1,
@@ -4268,6 +6189,11 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, size_t size1,
   boolean anchored_start;
   /* Nonzero if we are searching multibyte string.  */
   const boolean multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+#ifdef emacs
+  bool use_dfa, use_literal, use_reverse, backward;
+  ssize_t literal_pos = -1, literal_limit = min (stop, total_size);
+  struct dfa_cursor cursor = { -1, 0 };
+#endif
 
   /* Check for out-of-range STARTPOS.  */
   if (startpos < 0 || startpos > total_size)
@@ -4302,6 +6228,35 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, size_t size1,
     }
 #endif /* emacs */
 
+#ifdef emacs
+  /* In a forward search, give up at once if the text lacks the literal
+     string that every match contains.  In a backward search, a match
+     starts at or before the last place where it occurs.  */
+  backward = range < 0;
+  use_literal = (range != 0 && bufp->literal_size > 0
+		 && (multibyte || !bufp->literal_multibyte));
+  if (use_literal && !backward)
+    {
+      literal_pos = literal_search (bufp, string1, size1, string2, size2,
+				    startpos, literal_limit);
+      if (literal_pos < 0)
+	return -1;
+    }
+  else if (use_literal && !bufp->literal_prefix)
+    {
+      literal_pos = literal_search_backward (bufp, string1, size1,
+					     string2, size2, literal_limit,
+					     endpos, literal_limit);
+      if (literal_pos < 0)
+	return -1;
+      if (literal_pos < startpos)
+	{
+	  range += startpos - literal_pos;
+	  startpos = literal_pos;
+	}
+    }
+#endif
+
   /* Update the fastmap now if not correct already.  */
   if (fastmap && !bufp->fastmap_accurate)
     re_compile_fastmap (bufp);
@@ -4316,11 +6271,91 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, size_t size1,
 
     SETUP_SYNTAX_TABLE_FOR_OBJECT (re_match_object, charpos, 1);
   }
+
+  /* In a forward search, let the DFA find the end of the first match
+     that starts at or after STARTPOS.  The leftmost match starts
+     before that, and after the last position where the DFA had no
+     match under way.  */
+  use_dfa = startpos <= stop && dfa_prepare (bufp);
+  if (use_dfa && range > 0 && startpos + range <= stop)
+    {
+      ssize_t from = startpos;
+      ssize_t end = dfa_scan (bufp, string1, size1, string2, size2,
+			      startpos, startpos + range, stop, true, &from);
+      if (end == -1)
+	return -1;
+      if (end == -2)
+	use_dfa = false;
+      else
+	{
+	  range = min (range, end - startpos) - (from - startpos);
+	  startpos = from;
+	}
+    }
+
+  /* In a backward search, let the reverse DFA find the places where
+     matches can start, instead of checking each place with the DFA,
+     which could read the rest of the text from each.  */
+  use_reverse = use_dfa && backward;
+  if (use_reverse)
+    dfa_prepare_reverse (bufp);
 #endif
 
   /* Loop through the string, looking for a place to start matching.  */
   for (;;)
     {
+#ifdef emacs
+      if (use_reverse)
+	{
+	  ssize_t from = dfa_scan_backward (bufp, string1, size1,
+					    string2, size2,
+					    startpos, endpos, stop, &cursor);
+	  if (from == -1)
+	    return -1;
+	  if (from == -2)
+	    use_reverse = false;
+	  else
+	    {
+	      range += startpos - from;
+	      startpos = from;
+	    }
+	}
+
+      /* A match contains the literal string after where it starts, and
+	 maybe right there.  */
+      if (use_literal && backward)
+	{
+	  if (bufp->literal_prefix)
+	    {
+	      literal_pos = literal_search_backward (bufp, string1, size1,
+						     string2, size2, startpos,
+						     endpos, literal_limit);
+	      if (literal_pos < 0)
+		return -1;
+	      range += startpos - literal_pos;
+	      startpos = literal_pos;
+	    }
+	}
+      else if (use_literal && range > 0)
+	{
+	  if (literal_pos < startpos)
+	    {
+	      literal_pos = literal_search (bufp, string1, size1,
+					    string2, size2,
+					    startpos, literal_limit);
+	      if (literal_pos < 0)
+		return -1;
+	    }
+	  if (bufp->literal_prefix)
+	    {
+	      if (literal_pos - startpos > range)
+		return -1;
+	      range -= literal_pos - startpos;
+	      startpos = literal_pos;
+	    }
+	}
+#endif
+
       /* If the pattern is anchored,
 	 skip quickly past places we cannot match.
 	 We don't bother to treat startpos == 0 specially
@@ -4438,6 +6473,20 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, size_t size1,
 	  && !bufp->can_be_null)
 	return -1;
 
+#ifdef emacs
+      /* Don't backtrack where the DFA knows no match starts.  */
+      if (use_dfa && !use_reverse)
+	switch (dfa_scan (bufp, string1, size1, string2, size2,
+			  startpos, startpos, stop, false, NULL))
+	  {
+	  case -1:
+	    goto advance;
+	  case -2:
+	    use_dfa = false;
+	    break;
+	  }
+#endif
+
       val = re_match_2_internal (bufp, string1, size1, string2, size2,
 				 startpos, regs, stop);
 
@@ -4635,6 +6684,57 @@ skip_one_char (const_re_char *p)
 }
 
 
+/* Return a pointer to the operation that follows the one at P, or
+   NULL if P is not at a valid operation.  */
+static re_char *
+skip_op (const_re_char *p)
+{
+  switch (*p)
+    {
+    case no_op:
+    case succeed:
+    case begline:
+    case endline:
+    case begbuf:
+    case endbuf:
+    case wordbeg:
+    case wordend:
+    case wordbound:
+    case notwordbound:
+    case symbeg:
+    case symend:
+#ifdef emacs
+    case before_dot:
+    case at_dot:
+    case after_dot:
+#endif /* emacs */
+      return p + 1;
+
+    case start_memory:
+    case stop_memory:
+    case duplicate:
+      return p + 2;
+
+    case jump:
+    case on_failure_jump:
+    case on_failure_keep_string_jump:
+    case on_failure_keep_string_span:
+    case on_failure_jump_loop:
+    case on_failure_jump_nastyloop:
+    case on_failure_jump_smart:
+      return p + 3;
+
+    case succeed_n:
+    case jump_n:
+    case set_number_at:
+      return p + 5;
+
+    default:
+      return skip_one_char (p);
+    }
+}
+
+
 /* Jump over non-matching operations.  */
 static re_char *
 skip_noops (const_re_char *p, const_re_char *pend)
@@ -4863,6 +6963,260 @@ mutually_exclusive_p (struct re_pattern_buffer *bufp, const_re_char *p1,
   return 0;
 }
 
+
+/* Optimize the compiled pattern of BUFP in place once it is complete.
+   This decides up front how to run the simple greedy loops that
+   regex_compile leaves to on_failure_jump_smart, and turns into
+   on_failure_keep_string_span those whose body matches one character
+   from a set.  It merges adjacent exactn operations, and moves an
+   anchor that every match starts with before the start_memory
+   operations that precede it, where re_search_2 looks for it.  */
+
+static void
+optimize_pattern (struct re_pattern_buffer *bufp)
+{
+  unsigned char *pattern = bufp->buffer;
+  size_t used = bufp->used, i, j;
+  unsigned char *pend = pattern + used, *p, *next;
+  unsigned char *exact = NULL, *exact_end = NULL;
+  char *target, *dead;
+  boolean any_dead = false;
+  int mcnt;
+
+  if (used == 0)
+    return;
+
+  /* Decide how to run the simple loops, as re_match_2_internal would
+     when it first gets to their on_failure_jump_smart.  */
+  for (p = pattern; p && p < pend; p = (unsigned char *) skip_op (p))
+    if (*p == on_failure_jump_smart)
+      {
+	unsigned char *p1 = p + 3, *p2;
+
+	EXTRACT_NUMBER (mcnt, p + 1);
+	p2 = p1 + mcnt;
+	assert (skip_one_char (p1) == p2 - 3);
+	assert ((re_opcode_t) p2[-3] == jump);
+	if (mutually_exclusive_p (bufp, p1, p2))
+	  {
+	    /* Jump back to the body of the loop rather than to P, so
+	       that P pushes its failure point only once.  */
+	    EXTRACT_NUMBER (mcnt, p2 - 2);
+	    STORE_NUMBER (p2 - 2, mcnt + 3);
+	    *p = (*p1 == anychar || *p1 == charset || *p1 == charset_not
+		  ? on_failure_keep_string_span : on_failure_keep_string_jump);
+	  }
+	else
+	  *p = on_failure_jump;
+      }
+
+  /* Find the places that jumps lead to.  */
+  target = malloc (used + 1);
+  dead = malloc (used + 1);
+  memset (target, 0, used + 1);
+  memset (dead, 0, used + 1);
+  for (p = pattern; p && p < pend; p = (unsigned char *) skip_op (p))
+    if (*p >= jump && *p <= set_number_at)
+      {
+	EXTRACT_NUMBER (mcnt, p + 1);
+	if (p + 3 + mcnt >= pattern && p + 3 + mcnt <= pend)
+	  target[p + 3 + mcnt - pattern] = 1;
+      }
+
+  /* Merge each exactn that no jump leads to with the exactn right
+     before it, if any.  The bytes after the merged text are dead.  */
+  for (p = pattern; p && p < pend; p = next)
+    {
+      next = (unsigned char *) skip_op (p);
+      if (*p != exactn)
+	exact = NULL;
+      else if (exact && exact_end == p && !target[p - pattern]
+	       && exact[1] + p[1] <= 255)
+	{
+	  int size = p[1];
+	  memmove (exact + 2 + exact[1], p + 2, size);
+	  memset (dead + (exact + 2 + exact[1] - pattern), 0, size);
+	  exact[1] += size;
+	  for (i = exact + 2 + exact[1] - pattern; i < next - pattern; i++)
+	    {
+	      pattern[i] = no_op;
+	      dead[i] = 1;
+	    }
+	  any_dead = true;
+	  exact_end = next;
+	}
+      else
+	{
+	  exact = p;
+	  exact_end = next;
+	}
+    }
+
+  /* Move the anchor.  */
+  for (p = pattern; p < pend && *p == start_memory; p += 2)
+    ;
+  if (p > pattern && p < pend
+      && (*p == begbuf || *p == begline
+#ifdef emacs
+	  || *p == at_dot
+#endif
+	  ))
+    {
+      for (i = 1; i <= p - pattern && !target[i]; i++)
+	;
+      if (i > p - pattern)
+	{
+	  unsigned char anchor = *p;
+	  memmove (pattern + 1, pattern, p - pattern);
+	  *pattern = anchor;
+	}
+    }
+
+  /* Remove the dead bytes and adjust the jumps over them.  */
+  if (any_dead)
+    {
+      size_t *newpos = malloc ((used + 1) * sizeof *newpos);
+
+      for (i = j = 0; i <= used; i++)
+	{
+	  newpos[i] = j;
+	  if (i < used && !dead[i])
+	    j++;
+	}
+      for (p = pattern; p && p < pend; p = (unsigned char *) skip_op (p))
+	if (*p >= jump && *p <= set_number_at)
+	  {
+	    size_t from = p + 3 - pattern;
+	    EXTRACT_NUMBER (mcnt, p + 1);
+	    STORE_NUMBER (p + 1, ((ptrdiff_t) newpos[from + mcnt]
+				  - (ptrdiff_t) newpos[from]));
+	  }
+      for (i = j = 0; i < used; i++)
+	if (!dead[i])
+	  pattern[j++] = pattern[i];
+      bufp->used = j;
+      free (newpos);
+    }
+
+  free (dead);
+  free (target);
+}
+
+/* Return true if the charset or charset_not operation at P matches
+   the character C of the target, which is multibyte if
+   TARGET_MULTIBYTE, once translated with TRANSLATE.  */
+
+static boolean
+charset_matches (re_char *p, re_wchar_t c, RE_TRANSLATE_TYPE translate,
+		 boolean target_multibyte)
+{
+  boolean not = (re_opcode_t) *p == charset_not;
+
+  /* Whether matching against a unibyte character.  */
+  boolean unibyte_char = false;
+
+  if (target_multibyte)
+    {
+      int c1;
+
+      c = TRANSLATE (c);
+      c1 = RE_CHAR_TO_UNIBYTE (c);
+      if (c1 >= 0)
+	{
+	  unibyte_char = true;
+	  c = c1;
+	}
+    }
+  else
+    {
+      int c1 = RE_CHAR_TO_MULTIBYTE (c);
+
+      if (! CHAR_BYTE8_P (c1))
+	{
+	  c1 = TRANSLATE (c1);
+	  c1 = RE_CHAR_TO_UNIBYTE (c1);
+	  if (c1 >= 0)
+	    {
+	      unibyte_char = true;
+	      c = c1;
+	    }
+	}
+      else
+	unibyte_char = true;
+    }
+
+  if (unibyte_char && c < (1 << BYTEWIDTH))
+    {			/* Lookup bitmap.  */
+      /* Cast to `unsigned' instead of `unsigned char' in
+	 case the bit list is a full 32 bytes long.  */
+      if (c < (unsigned) (CHARSET_BITMAP_SIZE (p) * BYTEWIDTH)
+	  && p[2 + c / BYTEWIDTH] & (1 << (c % BYTEWIDTH)))
+	not = !not;
+    }
+#ifdef emacs
+  else if (CHARSET_RANGE_TABLE_EXISTS_P (p))
+    {
+      int class_bits = CHARSET_RANGE_TABLE_BITS (p);
+      re_char *range_table = CHARSET_RANGE_TABLE (p);
+      int count;
+
+      EXTRACT_NUMBER_AND_INCR (count, range_table);
+      if (  (class_bits & BIT_LOWER && ISLOWER (c))
+	  | (class_bits & BIT_MULTIBYTE)
+	  | (class_bits & BIT_PUNCT && ISPUNCT (c))
+	  | (class_bits & BIT_SPACE && ISSPACE (c))
+	  | (class_bits & BIT_UPPER && ISUPPER (c))
+	  | (class_bits & BIT_WORD  && ISWORD (c)))
+	not = !not;
+      else
+	CHARSET_LOOKUP_RANGE_TABLE_RAW (not, c, range_table, count);
+    }
+#endif /* emacs */
+
+  return not;
+}
+
+/* Return the end of the characters from D on, up to DEND, that the
+   operation at P matches, for on_failure_keep_string_span.  */
+
+static re_char *
+span_chars (struct re_pattern_buffer *bufp, re_char *p,
+	    re_char *d, re_char *dend)
+{
+  RE_TRANSLATE_TYPE translate = bufp->translate;
+  const boolean target_multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+
+  if (*p == anychar && !RE_TRANSLATE_P (translate)
+      && !(bufp->syntax & RE_DOT_NOT_NULL))
+    {
+      /* Only a newline can stop the loop, and it cannot be part of a
+	 multibyte character.  */
+      re_char *newline;
+      if (bufp->syntax & RE_DOT_NEWLINE)
+	return dend;
+      newline = memchr (d, '\n', dend - d);
+      return newline ? newline : dend;
+    }
+
+  while (d < dend)
+    {
+      int len;
+      re_wchar_t c = RE_STRING_CHAR_AND_LENGTH (d, len, target_multibyte);
+
+      if (*p == anychar)
+	{
+	  c = TRANSLATE (c);
+	  if ((!(bufp->syntax & RE_DOT_NEWLINE) && c == '\n')
+	      || ((bufp->syntax & RE_DOT_NOT_NULL) && c == '\000'))
+	    break;
+	}
+      else if (!charset_matches (p, c, translate, target_multibyte))
+	break;
+      d += len;
+    }
+  return d;
+}
+
 
 /* Matching routines.  */
 
@@ -5437,97 +7791,16 @@ re_match_2_internal (struct re_pattern_buffer *bufp, const_re_char *string1,
 	case charset_not:
 	  {
 	    register unsigned int c;
-	    boolean not = (re_opcode_t) *(p - 1) == charset_not;
 	    int len;
 
-	    /* Start of actual range_table, or end of bitmap if there is no
-	       range table.  */
-	    re_char *range_table IF_LINT (= NULL);
-
-	    /* Nonzero if there is a range table.  */
-	    int range_table_exists;
-
-	    /* Number of ranges of range table.  This is not included
-	       in the initial byte-length of the command.  */
-	    int count = 0;
-
-	    /* Whether matching against a unibyte character.  */
-	    boolean unibyte_char = false;
-
-	    DEBUG_PRINT ("EXECUTING charset%s.\n", not ? "_not" : "");
-
-	    range_table_exists = CHARSET_RANGE_TABLE_EXISTS_P (&p[-1]);
-
-	    if (range_table_exists)
-	      {
-		range_table = CHARSET_RANGE_TABLE (&p[-1]); /* Past the bitmap.  */
-		EXTRACT_NUMBER_AND_INCR (count, range_table);
-	      }
+	    DEBUG_PRINT ("EXECUTING charset%s.\n",
+			 (re_opcode_t) *(p - 1) == charset_not ? "_not" : "");
 
 	    PREFETCH ();
 	    c = RE_STRING_CHAR_AND_LENGTH (d, len, target_multibyte);
-	    if (target_multibyte)
-	      {
-		int c1;
-
-		c = TRANSLATE (c);
-		c1 = RE_CHAR_TO_UNIBYTE (c);
-		if (c1 >= 0)
-		  {
-		    unibyte_char = true;
-		    c = c1;
-		  }
-	      }
-	    else
-	      {
-		int c1 = RE_CHAR_TO_MULTIBYTE (c);
-
-		if (! CHAR_BYTE8_P (c1))
-		  {
-		    c1 = TRANSLATE (c1);
-		    c1 = RE_CHAR_TO_UNIBYTE (c1);
-		    if (c1 >= 0)
-		      {
-			unibyte_char = true;
-			c = c1;
-		      }
-		  }
-		else
-		  unibyte_char = true;
-	      }
-
-	    if (unibyte_char && c < (1 << BYTEWIDTH))
-	      {			/* Lookup bitmap.  */
-		/* Cast to `unsigned' instead of `unsigned char' in
-		   case the bit list is a full 32 bytes long.  */
-		if (c < (unsigned) (CHARSET_BITMAP_SIZE (&p[-1]) * BYTEWIDTH)
-		    && p[1 + c / BYTEWIDTH] & (1 << (c % BYTEWIDTH)))
-		  not = !not;
-	      }
-#ifdef emacs
-	    else if (range_table_exists)
-	      {
-		int class_bits = CHARSET_RANGE_TABLE_BITS (&p[-1]);
-
-		if (  (class_bits & BIT_LOWER && ISLOWER (c))
-		    | (class_bits & BIT_MULTIBYTE)
-		    | (class_bits & BIT_PUNCT && ISPUNCT (c))
-		    | (class_bits & BIT_SPACE && ISSPACE (c))
-		    | (class_bits & BIT_UPPER && ISUPPER (c))
-		    | (class_bits & BIT_WORD  && ISWORD (c)))
-		  not = !not;
-		else
-		  CHARSET_LOOKUP_RANGE_TABLE_RAW (not, c, range_table, count);
-	      }
-#endif /* emacs */
-
-	    if (range_table_exists)
-	      p = CHARSET_RANGE_TABLE_END (range_table, count);
-	    else
-	      p += CHARSET_BITMAP_SIZE (&p[-1]) + 1;
-
-	    if (!not) goto fail;
-
+	    if (!charset_matches (p - 1, c, translate, target_multibyte))
+	      goto fail;
+	    p = (unsigned char *) skip_one_char (p - 1);
 	    d += len;
 	  }
 	  break;
@@ -5727,6 +8000,28 @@ re_match_2_internal (struct re_pattern_buffer *bufp, const_re_char *string1,
 	  PUSH_FAILURE_POINT (p - 3, NULL);
 	  break;
 
+	/* on_failure_keep_string_span starts a loop like the one above
+	   whose body matches one character from a set.  It skips the
+	   characters that the body matches, and leaves the loop right
+	   away, where on_failure_keep_string_jump would go once the
+	   body fails; so it needs no failure point.  */
+	case on_failure_keep_string_span:
+	  EXTRACT_NUMBER_AND_INCR (mcnt, p);
+	  DEBUG_PRINT ("EXECUTING on_failure_keep_string_span %d (to %p):\n",
+		       mcnt, p + mcnt);
+
+	  for (;;)
+	    {
+	      d = span_chars (bufp, p, d, dend);
+	      /* Go on with STRING2 at the end of STRING1, like PREFETCH.  */
+	      if (d != dend || dend == end_match_2)
+		break;
+	      d = string2;
+	      dend = end_match_2;
+	    }
+	  p += mcnt;
+	  break;
+
 	  /* A nasty loop is introduced by the non-greedy *? and +?.
 	     With such loops, the stack only ever contains one failure point
 	     at a time, so that a plain on_failure_jump_loop kind of
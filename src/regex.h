@@ -319,6 +319,13 @@ typedef enum
   REG_ERANGEX		/* Range striding over charsets.  */
 } reg_errcode_t;
 
+#ifdef emacs
+struct re_dfa;
+
+/* The longest string that `re_search_2' looks for before matching.  */
+# define RE_LITERAL_MAX 64
+#endif
+
 /* This data structure represents a compiled pattern.  Before calling
    the pattern compiler, the fields `buffer', `allocated', `fastmap',
    `translate', and `no_sub' can be set.  After the pattern has been
@@ -405,6 +412,27 @@ struct re_pattern_buffer
 
   /* Charset of unibyte characters at compiling time. */
   int charset_unibyte;
+
+  /* The lazy DFA that `re_search_2' uses to find where matches can
+     start, or zero if none was made yet.  */
+  struct re_dfa *dfa;
+
+  /* A string of LITERAL_SIZE bytes that every match contains, which
+     `re_search_2' looks for before trying to match; it starts every
+     match if LITERAL_PREFIX is true.  LITERAL_SIZE is zero if the
+     pattern has no such string.  */
+  unsigned char literal[RE_LITERAL_MAX];
+  unsigned char literal_size;
+
+  /* The index in LITERAL of the byte to look for first, the one that
+     is likely to be the rarest in text.  */
+  unsigned char literal_rare;
+
+  unsigned literal_prefix : 1;
+
+  /* If true, LITERAL has non-ASCII bytes, so it can only be looked for
+     in multibyte targets.  */
+  unsigned literal_multibyte : 1;
 #endif
 
 /* [[[end pattern_buffer]]] */
@@ -519,6 +547,27 @@ extern void re_set_registers (struct re_pattern_buffer *__buffer,
 			      unsigned __num_regs,
 			      regoff_t *__starts, regoff_t *__ends);
 
+#ifdef emacs
+/* Forget the states that the lazy DFA of PATTERN_BUFFER computed so far.
+   They depend on the syntax table.  */
+extern void re_flush_dfa (struct re_pattern_buffer *__buffer);
+
+/* Free the lazy DFA of PATTERN_BUFFER, which is made again when a
+   search needs it.  */
+extern void re_free_dfa (struct re_pattern_buffer *__buffer);
+
+/* Free the memory of the compiled pattern in BUFFER, except its
+   fastmap, which the caller allocated.  */
+extern void re_free_pattern (struct re_pattern_buffer *__buffer);
+
+/* Return a rough measure of how often the byte C occurs in text.  */
+extern int re_byte_frequency (int __c);
+
+/* Return a description of the compiled pattern of BUFFER, one
+   operation per line, in memory allocated with malloc.  */
+extern char *re_describe_pattern (struct re_pattern_buffer *__buffer);
+#endif
+
 #if defined _REGEX_RE_COMP || defined _LIBC
 # ifndef _CRAY
 /* 4.2 bsd compatibility.  */
@@ -35,13 +35,22 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 #include <sys/types.h>
 #include "regex.h"
 
-#define REGEXP_CACHE_SIZE 20
+/* The number of compiled regexps that the cache keeps at least, and
+   at most.  Between both, it keeps as many as it finds in use.  */
+#define REGEXP_CACHE_MIN_SIZE 20
+#define REGEXP_CACHE_MAX_SIZE 1000
 
 /* If the regexp is non-nil, then the buffer contains the compiled form
    of that regexp, suitable for searching.  */
 struct regexp_cache
 {
-  struct regexp_cache *next;
+  /* The neighbors in the list of entries from the most recently used
+     to the least recently used.  */
+  struct regexp_cache *next, *prev;
+  /* The next entry in the same bucket of the hash table, and the hash
+     code of the regexp; only meaningful if the regexp is non-nil.  */
+  struct regexp_cache *hash_next;
+  EMACS_UINT hash;
   Lisp_Object regexp, whitespace_regexp;
   /* Syntax table for which the regexp applies.  We need this because
      of character classes.  If this is t, then the compiled pattern is valid
@@ -51,14 +60,26 @@ struct regexp_cache
   char fastmap[0400];
   /* True means regexp was compiled to do full POSIX backtracking.  */
   bool posix;
+  /* True if the regexp was used since the last garbage collection.  */
+  bool used;
 };
 
-/* The instances of that struct.  */
-static struct regexp_cache searchbufs[REGEXP_CACHE_SIZE];
+/* The head and tail of the list of entries; the head is the most
+   recently used, and entries whose regexp is nil are at the tail.  */
+static struct regexp_cache *searchbuf_head, *searchbuf_tail;
 
-/* The head of the linked list; points to the most recently used buffer.  */
-static struct regexp_cache *searchbuf_head;
+/* The hash table of the entries, and its number of buckets, which is
+   a power of 2.  */
+static struct regexp_cache **searchbuf_table;
+static ptrdiff_t searchbuf_table_size;
 
+/* The number of entries, and how many there can be.  */
+static ptrdiff_t searchbuf_count, searchbuf_limit;
+
+/* The number of entries reused for another regexp since the limit
+   changed, and the number of entries used since the last garbage
+   collection.  */
+static ptrdiff_t searchbuf_evictions, searchbuf_used;
 
 /* Every call to re_match, etc., must pass &search_regs as the regs
    argument unless you can show it is unnecessary (i.e., if re_match
@@ -95,6 +116,10 @@ static void save_search_regs (void);
 static EMACS_INT simple_search (EMACS_INT, unsigned char *, ptrdiff_t,
 				ptrdiff_t, Lisp_Object, ptrdiff_t, ptrdiff_t,
                                 ptrdiff_t, ptrdiff_t);
+static bool case_variants (unsigned char *, ptrdiff_t, bool,
+			   Lisp_Object, Lisp_Object, unsigned char *);
+static EMACS_INT memchr_search (EMACS_INT, unsigned char *, unsigned char *,
+				ptrdiff_t, ptrdiff_t, ptrdiff_t);
 static EMACS_INT boyer_moore (EMACS_INT, unsigned char *, ptrdiff_t,
                               Lisp_Object, Lisp_Object, ptrdiff_t,
                               ptrdiff_t, int);
@@ -164,8 +189,172 @@ compile_pattern_1 (struct regexp_cache *cp, Lisp_Object pattern,
   cp->regexp = Fcopy_sequence (pattern);
 }
 
+/* Remove the entry CP from the list of entries.  */
+
+static void
+regexp_cache_unlink (struct regexp_cache *cp)
+{
+  if (cp->prev)
+    cp->prev->next = cp->next;
+  else
+    searchbuf_head = cp->next;
+  if (cp->next)
+    cp->next->prev = cp->prev;
+  else
+    searchbuf_tail = cp->prev;
+  cp->next = cp->prev = 0;
+}
+
+/* Put the entry CP at the head of the list of entries if FRONT is
+   true, and at its tail otherwise.  */
+
+static void
+regexp_cache_link (struct regexp_cache *cp, bool front)
+{
+  if (front)
+    {
+      cp->next = searchbuf_head;
+      if (searchbuf_head)
+	searchbuf_head->prev = cp;
+      else
+	searchbuf_tail = cp;
+      searchbuf_head = cp;
+    }
+  else
+    {
+      cp->prev = searchbuf_tail;
+      if (searchbuf_tail)
+	searchbuf_tail->next = cp;
+      else
+	searchbuf_head = cp;
+      searchbuf_tail = cp;
+    }
+}
+
+/* Return the hash code of the regexp PATTERN compiled with the
+   translation table TRANSLATE, with full backtracking if POSIX.  */
+
+static EMACS_UINT
+regexp_cache_hash (Lisp_Object pattern, Lisp_Object translate, bool posix)
+{
+  EMACS_UINT hash = hash_string (SSDATA (pattern), SBYTES (pattern));
+  hash = sxhash_combine (hash, XHASH (translate));
+  return sxhash_combine (hash, posix);
+}
+
+/* Forget the regexp of the entry CP, and move CP to the tail of the
+   list of entries, so that it is reused first.  */
+
+static void
+regexp_cache_forget (struct regexp_cache *cp)
+{
+  struct regexp_cache **cpp;
+
+  if (NILP (cp->regexp))
+    return;
+  for (cpp = &searchbuf_table[cp->hash & (searchbuf_table_size - 1)];
+       *cpp != cp; cpp = &(*cpp)->hash_next)
+    continue;
+  *cpp = cp->hash_next;
+  cp->regexp = Qnil;
+  regexp_cache_unlink (cp);
+  regexp_cache_link (cp, false);
+}
+
+/* Let the cache hold up to LIMIT entries, growing its hash table if
+   needed.  The entries beyond LIMIT are freed by regexp_cache_trim.  */
+
+static void
+regexp_cache_set_limit (ptrdiff_t limit)
+{
+  searchbuf_limit = limit;
+  searchbuf_evictions = 0;
+  if (searchbuf_table_size < 2 * limit)
+    {
+      ptrdiff_t size = searchbuf_table_size ? searchbuf_table_size : 64;
+      struct regexp_cache **table, *cp;
+
+      while (size < 2 * limit)
+	size *= 2;
+      table = xzalloc (size * sizeof *table);
+      for (cp = searchbuf_head; cp; cp = cp->next)
+	if (!NILP (cp->regexp))
+	  {
+	    cp->hash_next = table[cp->hash & (size - 1)];
+	    table[cp->hash & (size - 1)] = cp;
+	  }
+      xfree (searchbuf_table);
+      searchbuf_table = table;
+      searchbuf_table_size = size;
+    }
+}
+
+/* Free the entries beyond the limit of the cache, which are the least
+   recently used ones.  */
+
+static void
+regexp_cache_trim (void)
+{
+  struct regexp_cache *cp;
+
+  while (searchbuf_count > searchbuf_limit)
+    {
+      cp = searchbuf_tail;
+      regexp_cache_forget (cp);
+      regexp_cache_unlink (cp);
+      re_free_pattern (&cp->buf);
+      xfree (cp);
+      searchbuf_count--;
+    }
+}
+
+/* Return an entry of the cache in which to compile a regexp.  This is
+   an entry with no regexp if there is one, else a new entry if the
+   cache is not full, else the least recently used entry.  When that
+   entry was reused for another regexp as many times as the cache has
+   entries since its size last changed, the working set is larger than
+   the cache, so the cache grows instead.  */
+
+static struct regexp_cache *
+regexp_cache_entry (void)
+{
+  struct regexp_cache *cp;
+
+  regexp_cache_trim ();
+
+  cp = searchbuf_tail;
+  if (cp && NILP (cp->regexp))
+    return cp;
+
+  if (searchbuf_count == searchbuf_limit
+      && ++searchbuf_evictions >= searchbuf_limit
+      && searchbuf_limit < REGEXP_CACHE_MAX_SIZE)
+    regexp_cache_set_limit (min (2 * searchbuf_limit,
+				 REGEXP_CACHE_MAX_SIZE));
+
+  if (searchbuf_count < searchbuf_limit)
+    {
+      cp = xzalloc (sizeof *cp);
+      cp->buf.allocated = 100;
+      cp->buf.buffer = xmalloc (100);
+      cp->buf.fastmap = cp->fastmap;
+      cp->regexp = Qnil;
+      cp->whitespace_regexp = Qnil;
+      cp->syntax_table = Qnil;
+      cp->buf.translate = Qnil;
+      regexp_cache_link (cp, false);
+      searchbuf_count++;
+      return cp;
+    }
+
+  regexp_cache_forget (cp);
+  return cp;
+}
+
 /* Shrink each compiled regexp buffer in the cache
-   to the size actually used right now.
+   to the size actually used right now, free the DFAs of the regexps
+   not used since the last time, and let the cache shrink, freeing the
+   entries it drops, if few of its entries were used.
    This is called from garbage collection.  */
 
 void
@@ -177,6 +366,39 @@ shrink_regexp_cache (void)
     {
       cp->buf.allocated = cp->buf.used;
       cp->buf.buffer = xrealloc (cp->buf.buffer, cp->buf.used);
+      /* The states of the DFA refer to a syntax table, which this
+	 garbage collection may free.  */
+      if (cp->used)
+	re_flush_dfa (&cp->buf);
+      else
+	re_free_dfa (&cp->buf);
+      cp->used = false;
+    }
+
+  if (searchbuf_used * 4 < searchbuf_limit
+      && searchbuf_limit > REGEXP_CACHE_MIN_SIZE)
+    {
+      regexp_cache_set_limit (max (searchbuf_limit / 2,
+				   REGEXP_CACHE_MIN_SIZE));
+      regexp_cache_trim ();
+    }
+  searchbuf_used = 0;
+}
+
+/* Mark the Lisp objects that the regexp cache refers to.
+   This is called from garbage collection.  */
+
+void
+mark_regexp_cache (void)
+{
+  struct regexp_cache *cp;
+
+  for (cp = searchbuf_head; cp != 0; cp = cp->next)
+    {
+      mark_object (cp->regexp);
+      mark_object (cp->whitespace_regexp);
+      mark_object (cp->syntax_table);
+      mark_object (cp->buf.translate);
     }
 }
 
@@ -188,14 +410,20 @@ shrink_regexp_cache (void)
 void
 clear_regexp_cache (void)
 {
-  int i;
+  struct regexp_cache *cp, *next;
 
-  for (i = 0; i < REGEXP_CACHE_SIZE; ++i)
+  for (cp = searchbuf_head; cp != 0; cp = next)
     /* It's tempting to compare with the syntax-table we've actually changed,
        but it's not sufficient because char-table inheritance means that
        modifying one syntax-table can change others at the same time.  */
-    if (!EQ (searchbufs[i].syntax_table, Qt))
-      searchbufs[i].regexp = Qnil;
+    {
+      next = cp->next;
+      if (!EQ (cp->syntax_table, Qt))
+	regexp_cache_forget (cp);
+      /* Patterns that don't depend on the syntax table to compile
+	 may still look it up to match, and so may their DFA.  */
+      re_flush_dfa (&cp->buf);
+    }
 }
 
 /* Compile a regexp if necessary, but first check to see if there's one in
@@ -213,46 +441,58 @@ struct re_pattern_buffer *
 compile_pattern (Lisp_Object pattern, struct re_registers *regp,
 		 Lisp_Object translate, bool posix, bool multibyte)
 {
-  struct regexp_cache *cp, **cpp;
-
-  for (cpp = &searchbuf_head; ; cpp = &cp->next)
+  struct regexp_cache *cp;
+  EMACS_UINT hash;
+
+  if (NILP (translate))
+    translate = make_number (0);
+  hash = regexp_cache_hash (pattern, translate, posix);
+
+  for (cp = searchbuf_table[hash & (searchbuf_table_size - 1)];
+       cp; cp = cp->hash_next)
+    if (cp->hash == hash
+	&& SCHARS (cp->regexp) == SCHARS (pattern)
+	&& STRING_MULTIBYTE (cp->regexp) == STRING_MULTIBYTE (pattern)
+	&& !NILP (Fstring_equal (cp->regexp, pattern))
+	&& EQ (cp->buf.translate, translate)
+	&& cp->posix == posix
+	&& (EQ (cp->syntax_table, Qt)
+	    || EQ (cp->syntax_table, BVAR (current_buffer, syntax_table)))
+	&& !NILP (Fequal (cp->whitespace_regexp, Vsearch_spaces_regexp))
+	&& cp->buf.charset_unibyte == charset_unibyte)
+      break;
+
+  if (cp)
+    regexp_cache_hits++;
+  else
     {
-      cp = *cpp;
-      /* Entries are initialized to nil, and may be set to nil by
-	 compile_pattern_1 if the pattern isn't valid.  Don't apply
-	 string accessors in those cases.  However, compile_pattern_1
-	 is only applied to the cache entry we pick here to reuse.  So
-	 nil should never appear before a non-nil entry.  */
-      if (NILP (cp->regexp))
-	goto compile_it;
-      if (SCHARS (cp->regexp) == SCHARS (pattern)
-	  && STRING_MULTIBYTE (cp->regexp) == STRING_MULTIBYTE (pattern)
-	  && !NILP (Fstring_equal (cp->regexp, pattern))
-	  && EQ (cp->buf.translate, (! NILP (translate) ? translate : make_number (0)))
-	  && cp->posix == posix
-	  && (EQ (cp->syntax_table, Qt)
-	      || EQ (cp->syntax_table, BVAR (current_buffer, syntax_table)))
-	  && !NILP (Fequal (cp->whitespace_regexp, Vsearch_spaces_regexp))
-	  && cp->buf.charset_unibyte == charset_unibyte)
-	break;
-
-      /* If we're at the end of the cache, compile into the nil cell
-	 we found, or the last (least recently used) cell with a
-	 string value.  */
-      if (cp->next == 0)
-	{
-	compile_it:
-	  compile_pattern_1 (cp, pattern, translate, posix);
-	  break;
-	}
+      struct timespec start = current_timespec ();
+      EMACS_UINT i;
+
+      regexp_cache_misses++;
+      cp = regexp_cache_entry ();
+      compile_pattern_1 (cp, pattern, translate, posix);
+      /* The table may have grown in regexp_cache_entry.  */
+      i = hash & (searchbuf_table_size - 1);
+      cp->hash = hash;
+      cp->hash_next = searchbuf_table[i];
+      searchbuf_table[i] = cp;
+      if (FLOATP (Vregexp_cache_compile_time))
+	Vregexp_cache_compile_time
+	  = make_float (XFLOAT_DATA (Vregexp_cache_compile_time)
+			+ timespectod (timespec_sub (current_timespec (),
+						     start)));
     }
 
-  /* When we get here, cp (aka *cpp) contains the compiled pattern,
-     either because we found it in the cache or because we just compiled it.
-     Move it to the front of the queue to mark it as most recently used.  */
-  *cpp = cp->next;
-  cp->next = searchbuf_head;
-  searchbuf_head = cp;
+  /* Move CP to the front of the list to mark it as most recently
+     used.  */
+  if (!cp->used)
+    {
+      cp->used = true;
+      searchbuf_used++;
+    }
+  regexp_cache_unlink (cp);
+  regexp_cache_link (cp, true);
 
   /* Advise the searching functions about the space we have allocated
      for register data.  */
@@ -621,29 +861,642 @@ newline_cache_on_off (struct buffer *buf)
      immediately turned off by its base buffer.  */
   if (NILP (BVAR (buf, cache_long_scans)))
     {
-      if (!indirect_p
-	  || NILP (BVAR (base_buf, cache_long_scans)))
-	{
-	  /* It should be off.  */
-	  if (base_buf->newline_cache)
-	    {
-	      free_region_cache (base_buf->newline_cache);
-	      base_buf->newline_cache = 0;
-	    }
-	}
-      return NULL;
+      if (!indirect_p
+	  || NILP (BVAR (base_buf, cache_long_scans)))
+	{
+	  /* It should be off.  */
+	  if (base_buf->newline_cache)
+	    {
+	      free_region_cache (base_buf->newline_cache);
+	      base_buf->newline_cache = 0;
+	    }
+	}
+      return NULL;
+    }
+  else
+    {
+      if (!indirect_p
+	  || !NILP (BVAR (base_buf, cache_long_scans)))
+	{
+	  /* It should be on.  */
+	  if (base_buf->newline_cache == 0)
+	    base_buf->newline_cache = new_region_cache ();
+	}
+      return base_buf->newline_cache;
+    }
+}
+
+
+/* The newline index: counting the newlines of large texts.  */
+
+/* The newline index of a buffer text divides the text into blocks of
+   bytes, and records the number of bytes and of newlines in each
+   block.  As in the position index of marker.c, the sums of these
+   numbers over the first blocks are kept in a Fenwick tree.  They give
+   the number of newlines before any position, and the position of the
+   Nth newline of the text, in O(log N) steps and a scan of part of one
+   block.  So find_newline can skip over any number of lines in a large
+   text without looking at them.
+
+   Insertions and deletions update the numbers of bytes of the blocks
+   they touch without looking at the text, and mark those blocks stale;
+   so do the changes that replace text in place, through
+   invalidate_buffer_caches.  The newlines of the stale blocks are
+   counted again the next time the index is used, and those that
+   insertions have made too large are split then.  Blocks that
+   deletions have made too small are merged once there are too many of
+   them.  */
+
+/* The size in bytes of the blocks made by scanning the text, and the
+   size beyond which a block is split.  */
+
+enum { NEWLINE_INDEX_BLOCK = 4096,
+       NEWLINE_INDEX_BLOCK_MAX = 4 * NEWLINE_INDEX_BLOCK };
+
+/* find_newline uses the newline index only when looking for at least
+   this many newlines in at least this many bytes; scanning is faster
+   for short distances.  */
+
+enum { NEWLINE_INDEX_MIN_LINES = 64,
+       NEWLINE_INDEX_MIN_BYTES = 2 * NEWLINE_INDEX_BLOCK_MAX };
+
+struct newline_index_entry
+{
+  ptrdiff_t bytes;
+  ptrdiff_t newlines;
+};
+
+struct newline_index
+{
+  /* The number of blocks, which is at least 1, and the number of
+     elements allocated for BLOCKS and STALE.  */
+  ptrdiff_t nblocks, size;
+
+  /* The bytes and newlines of the whole text.  The newlines are only
+     right when no block is stale.  */
+  struct newline_index_entry total;
+
+  /* The bytes and newlines of each block.  */
+  struct newline_index_entry *blocks;
+
+  /* The Fenwick tree: for I from 1 to NBLOCKS, SUMS[I] is the sum of
+     the blocks from I - (I & -I) to I - 1.  It has SIZE + 1
+     elements.  */
+  struct newline_index_entry *sums;
+
+  /* STALE[I] is true if the newlines of block I must be counted again.
+     STALE_BLOCKS lists the NSTALE such blocks, and has room for
+     STALE_SIZE.  */
+  bool *stale;
+  ptrdiff_t *stale_blocks;
+  ptrdiff_t nstale, stale_size;
+};
+
+/* Free the newline index of the text of B.  */
+
+void
+free_newline_index (struct buffer *b)
+{
+  struct newline_index *index = b->text->newline_index;
+
+  if (index)
+    {
+      xfree (index->blocks);
+      xfree (index->sums);
+      xfree (index->stale);
+      xfree (index->stale_blocks);
+      xfree (index);
+      b->text->newline_index = NULL;
+    }
+}
+
+/* Recompute the Fenwick tree of INDEX from its blocks.  */
+
+static void
+newline_index_rebuild_sums (struct newline_index *index)
+{
+  ptrdiff_t i, j, n = index->nblocks;
+
+  for (i = 1; i <= n; i++)
+    index->sums[i] = index->blocks[i - 1];
+  for (i = 1; i <= n; i++)
+    if ((j = i + (i & -i)) <= n)
+      {
+	index->sums[j].bytes += index->sums[i].bytes;
+	index->sums[j].newlines += index->sums[i].newlines;
+      }
+}
+
+/* Add BYTES bytes and NEWLINES newlines to block BLOCK of INDEX.  */
+
+static void
+newline_index_add (struct newline_index *index, ptrdiff_t block,
+		   ptrdiff_t bytes, ptrdiff_t newlines)
+{
+  ptrdiff_t i;
+
+  index->blocks[block].bytes += bytes;
+  index->blocks[block].newlines += newlines;
+  index->total.bytes += bytes;
+  index->total.newlines += newlines;
+  for (i = block + 1; i <= index->nblocks; i += i & -i)
+    {
+      index->sums[i].bytes += bytes;
+      index->sums[i].newlines += newlines;
+    }
+}
+
+/* Mark block BLOCK of INDEX as stale.  */
+
+static void
+newline_index_mark_stale (struct newline_index *index, ptrdiff_t block)
+{
+  if (!index->stale[block])
+    {
+      if (index->nstale == index->stale_size)
+	index->stale_blocks = xpalloc (index->stale_blocks, &index->stale_size,
+				       1, -1, sizeof *index->stale_blocks);
+      index->stale_blocks[index->nstale++] = block;
+      index->stale[block] = true;
+    }
+}
+
+/* List again the stale blocks of INDEX, after its blocks have moved.  */
+
+static void
+newline_index_list_stale (struct newline_index *index)
+{
+  ptrdiff_t i;
+
+  index->nstale = 0;
+  for (i = 0; i < index->nblocks; i++)
+    if (index->stale[i])
+      {
+	index->stale[i] = false;
+	newline_index_mark_stale (index, i);
+      }
+}
+
+/* Return the block of INDEX that holds the byte at POS, counted from
+   the start of the text if NEWLINE is false.  If NEWLINE is true,
+   return the block that holds newline number POS + 1 of the text
+   instead.  A position at the end of a block belongs to the next one,
+   if any.  Store in *START the bytes and newlines before the block.  */
+
+static ptrdiff_t
+newline_index_find (struct newline_index *index, ptrdiff_t pos, bool newline,
+		    struct newline_index_entry *start)
+{
+  ptrdiff_t block = 0, step = 1;
+  struct newline_index_entry sum = { 0, 0 };
+
+  while (step <= index->nblocks / 2)
+    step *= 2;
+
+  /* Descend the tree to the last block that starts at or before POS.  */
+  for (; step > 0; step /= 2)
+    if (block + step <= index->nblocks)
+      {
+	struct newline_index_entry *s = &index->sums[block + step];
+
+	if ((newline ? sum.newlines + s->newlines : sum.bytes + s->bytes)
+	    <= pos)
+	  {
+	    block += step;
+	    sum.bytes += s->bytes;
+	    sum.newlines += s->newlines;
+	  }
+      }
+
+  /* POS is at the end of the text.  */
+  if (block == index->nblocks)
+    {
+      block--;
+      sum.bytes -= index->blocks[block].bytes;
+      sum.newlines -= index->blocks[block].newlines;
+    }
+
+  *start = sum;
+  return block;
+}
+
+/* Return the number of newlines of B between FROM_BYTE and TO_BYTE.  */
+
+static ptrdiff_t
+count_buffer_newlines (struct buffer *b, ptrdiff_t from_byte,
+		       ptrdiff_t to_byte)
+{
+  ptrdiff_t newlines = 0;
+
+  while (from_byte < to_byte)
+    {
+      /* Count up to the gap, then from its end.  */
+      ptrdiff_t stop = (from_byte < BUF_GPT_BYTE (b)
+			? min (to_byte, BUF_GPT_BYTE (b)) : to_byte);
+      unsigned char *p = BUF_BYTE_ADDRESS (b, from_byte);
+      unsigned char *end = p + (stop - from_byte);
+
+      while ((p = memchr (p, '\n', end - p)))
+	newlines++, p++;
+      from_byte = stop;
+    }
+
+  return newlines;
+}
+
+/* Return the byte position just after newline number N, counting
+   from 1, that comes after FROM_BYTE in B.  There must be such a
+   newline.  */
+
+static ptrdiff_t
+buffer_nth_newline (struct buffer *b, ptrdiff_t from_byte, ptrdiff_t n)
+{
+  while (true)
+    {
+      ptrdiff_t stop = (from_byte < BUF_GPT_BYTE (b)
+			? BUF_GPT_BYTE (b) : BUF_Z_BYTE (b));
+      unsigned char *start = BUF_BYTE_ADDRESS (b, from_byte);
+      unsigned char *p = start, *end = p + (stop - from_byte);
+
+      while ((p = memchr (p, '\n', end - p)))
+	{
+	  p++;
+	  if (--n == 0)
+	    return from_byte + (p - start);
+	}
+      eassert (stop < BUF_Z_BYTE (b));
+      from_byte = stop;
+    }
+}
+
+/* Divide the text of B from FROM_BYTE to TO_BYTE into blocks of
+   NEWLINE_INDEX_BLOCK bytes, the last of which may be shorter.  Store
+   them in BLOCKS, which has room for them all, and return their
+   number.  */
+
+static ptrdiff_t
+divide_buffer_newlines (struct buffer *b, ptrdiff_t from_byte,
+			ptrdiff_t to_byte, struct newline_index_entry *blocks)
+{
+  ptrdiff_t n = 0;
+
+  while (from_byte < to_byte)
+    {
+      ptrdiff_t end = min (from_byte + NEWLINE_INDEX_BLOCK, to_byte);
+
+      blocks[n].bytes = end - from_byte;
+      blocks[n].newlines = count_buffer_newlines (b, from_byte, end);
+      n++;
+      from_byte = end;
+    }
+
+  return n;
+}
+
+/* Make sure INDEX has room for NBLOCKS blocks.  */
+
+static void
+newline_index_reserve (struct newline_index *index, ptrdiff_t nblocks)
+{
+  if (nblocks > index->size)
+    {
+      ptrdiff_t old_size = index->size;
+
+      index->blocks = xpalloc (index->blocks, &index->size,
+			       nblocks - index->size, -1,
+			       sizeof *index->blocks);
+      index->sums = xnrealloc (index->sums, index->size + 1,
+			       sizeof *index->sums);
+      index->stale = xnrealloc (index->stale, index->size,
+				sizeof *index->stale);
+      memset (index->stale + old_size, 0,
+	      (index->size - old_size) * sizeof *index->stale);
+    }
+}
+
+/* Make a newline index for the text of B by scanning it.  */
+
+static struct newline_index *
+build_newline_index (struct buffer *b)
+{
+  struct newline_index *index = xzalloc (sizeof *index);
+  ptrdiff_t i;
+
+  newline_index_reserve (index, ((BUF_Z_BYTE (b) - BUF_BEG_BYTE (b))
+				 / NEWLINE_INDEX_BLOCK + 1));
+  index->nblocks = divide_buffer_newlines (b, BUF_BEG_BYTE (b),
+					   BUF_Z_BYTE (b), index->blocks);
+  if (index->nblocks == 0)
+    {
+      index->blocks[0].bytes = index->blocks[0].newlines = 0;
+      index->nblocks = 1;
+    }
+  for (i = 0; i < index->nblocks; i++)
+    {
+      index->total.bytes += index->blocks[i].bytes;
+      index->total.newlines += index->blocks[i].newlines;
+    }
+  newline_index_rebuild_sums (index);
+  b->text->newline_index = index;
+  return index;
+}
+
+/* Split block BLOCK of the index INDEX of B, which starts at
+   START_BYTE, into blocks of the usual size.  */
+
+static void
+split_newline_index_block (struct buffer *b, struct newline_index *index,
+			   ptrdiff_t block, ptrdiff_t start_byte)
+{
+  ptrdiff_t bytes = index->blocks[block].bytes;
+  struct newline_index_entry *pieces
+    = xnmalloc (bytes / NEWLINE_INDEX_BLOCK + 1, sizeof *pieces);
+  ptrdiff_t n = divide_buffer_newlines (b, start_byte, start_byte + bytes,
+					pieces);
+
+  newline_index_reserve (index, index->nblocks + n - 1);
+  memmove (index->blocks + block + n, index->blocks + block + 1,
+	   (index->nblocks - block - 1) * sizeof *index->blocks);
+  memmove (index->stale + block + n, index->stale + block + 1,
+	   (index->nblocks - block - 1) * sizeof *index->stale);
+  memcpy (index->blocks + block, pieces, n * sizeof *pieces);
+  memset (index->stale + block, 0, n * sizeof *index->stale);
+  index->nblocks += n - 1;
+  xfree (pieces);
+}
+
+/* Return the number of bytes of INDEX before block BLOCK.  */
+
+static ptrdiff_t
+newline_index_bytes_before (struct newline_index *index, ptrdiff_t block)
+{
+  ptrdiff_t bytes = 0;
+
+  for (; block > 0; block -= block & -block)
+    bytes += index->sums[block].bytes;
+  return bytes;
+}
+
+/* Compare the block numbers at A and B, for sorting them.  */
+
+static int
+compare_blocks (const void *a, const void *b)
+{
+  ptrdiff_t x = *(const ptrdiff_t *) a, y = *(const ptrdiff_t *) b;
+  return x < y ? -1 : x > y;
+}
+
+/* Return the newline index of the current buffer, after building it if
+   there is none and bringing it up to date with the changes made
+   since it was last used.  */
+
+static struct newline_index *
+current_newline_index (void)
+{
+  struct buffer *b = current_buffer;
+  struct newline_index *index = b->text->newline_index;
+  bool split = false;
+
+  /* An index that does not account for the whole text has missed
+     some change to it.  */
+  if (index && index->total.bytes != BUF_Z_BYTE (b) - BUF_BEG_BYTE (b))
+    free_newline_index (b);
+  if (!b->text->newline_index)
+    return build_newline_index (b);
+  index = b->text->newline_index;
+
+  /* Count the newlines of the stale blocks again, from the last, so
+     that splitting one does not move those yet to be counted.  */
+  qsort (index->stale_blocks, index->nstale, sizeof *index->stale_blocks,
+	 compare_blocks);
+  while (index->nstale > 0)
+    {
+      ptrdiff_t block = index->stale_blocks[--index->nstale];
+      ptrdiff_t start_byte = (BUF_BEG_BYTE (b)
+			      + newline_index_bytes_before (index, block));
+
+      index->stale[block] = false;
+
+      if (index->blocks[block].bytes > NEWLINE_INDEX_BLOCK_MAX)
+	{
+	  split_newline_index_block (b, index, block, start_byte);
+	  split = true;
+	}
+      else if (split)
+	index->blocks[block].newlines
+	  = count_buffer_newlines (b, start_byte,
+				   start_byte + index->blocks[block].bytes);
+      else
+	newline_index_add (index, block, 0,
+			   (count_buffer_newlines
+			    (b, start_byte,
+			     start_byte + index->blocks[block].bytes)
+			    - index->blocks[block].newlines));
+    }
+
+  if (split)
+    {
+      ptrdiff_t i;
+
+      index->total.newlines = 0;
+      for (i = 0; i < index->nblocks; i++)
+	index->total.newlines += index->blocks[i].newlines;
+      newline_index_rebuild_sums (index);
+    }
+
+  return index;
+}
+
+/* Merge the adjacent blocks of INDEX that are small enough, so that
+   the index has about as many blocks as a scan of the text makes.  */
+
+static void
+compact_newline_index (struct newline_index *index)
+{
+  ptrdiff_t i, n = 1;
+
+  for (i = 1; i < index->nblocks; i++)
+    {
+      struct newline_index_entry *last = &index->blocks[n - 1];
+
+      if (last->bytes + index->blocks[i].bytes <= 2 * NEWLINE_INDEX_BLOCK)
+	{
+	  last->bytes += index->blocks[i].bytes;
+	  last->newlines += index->blocks[i].newlines;
+	  index->stale[n - 1] |= index->stale[i];
+	}
+      else
+	{
+	  index->blocks[n] = index->blocks[i];
+	  index->stale[n++] = index->stale[i];
+	}
+    }
+  for (i = n; i < index->nblocks; i++)
+    index->stale[i] = false;
+  index->nblocks = n;
+  newline_index_list_stale (index);
+  newline_index_rebuild_sums (index);
+}
+
+/* Record in the newline index of the current buffer, if it has one,
+   an insertion of NBYTES bytes at FROM_BYTE.  */
+
+void
+adjust_newline_index_for_insert (ptrdiff_t from_byte, ptrdiff_t nbytes)
+{
+  struct newline_index *index = current_buffer->text->newline_index;
+  struct newline_index_entry start;
+  ptrdiff_t block;
+
+  if (!index)
+    return;
+  from_byte -= BEG_BYTE;
+  if (from_byte > index->total.bytes)
+    free_newline_index (current_buffer);
+  else
+    {
+      block = newline_index_find (index, from_byte, false, &start);
+      newline_index_add (index, block, nbytes, 0);
+      newline_index_mark_stale (index, block);
+    }
+}
+
+/* Record in the newline index of the current buffer, if it has one,
+   the deletion of the text from FROM_BYTE to TO_BYTE.  */
+
+void
+adjust_newline_index_for_delete (ptrdiff_t from_byte, ptrdiff_t to_byte)
+{
+  struct newline_index *index = current_buffer->text->newline_index;
+  struct newline_index_entry start;
+  ptrdiff_t block;
+
+  if (!index)
+    return;
+  from_byte -= BEG_BYTE;
+  to_byte -= BEG_BYTE;
+  if (to_byte > index->total.bytes)
+    {
+      free_newline_index (current_buffer);
+      return;
+    }
+
+  /* Take from each block the part of it that is deleted.  A block
+     deleted whole loses all its newlines.  */
+  for (block = newline_index_find (index, from_byte, false, &start);
+       block < index->nblocks && start.bytes < to_byte;
+       block++)
+    {
+      struct newline_index_entry *b = &index->blocks[block];
+      ptrdiff_t bytes = (min (to_byte, start.bytes + b->bytes)
+			 - max (from_byte, start.bytes));
+
+      start.bytes += b->bytes;
+      if (bytes == b->bytes && !index->stale[block])
+	newline_index_add (index, block, -bytes, -b->newlines);
+      else
+	{
+	  newline_index_add (index, block, -bytes, 0);
+	  newline_index_mark_stale (index, block);
+	}
+    }
+
+  if (index->nblocks > 2 * (index->total.bytes / NEWLINE_INDEX_BLOCK) + 8)
+    compact_newline_index (index);
+}
+
+/* Record in the newline index of B, if it has one, that the text
+   between START and END may be replaced in place.  Insertions and
+   deletions are recorded by the functions above.  */
+
+void
+invalidate_newline_index (struct buffer *b, ptrdiff_t start, ptrdiff_t end)
+{
+  struct newline_index *index = b->text->newline_index;
+  struct newline_index_entry block_start;
+  ptrdiff_t block, start_byte, end_byte;
+
+  if (!index || start >= end)
+    return;
+  start_byte = buf_charpos_to_bytepos (b, start) - BUF_BEG_BYTE (b);
+  end_byte = buf_charpos_to_bytepos (b, end) - BUF_BEG_BYTE (b);
+  if (end_byte > index->total.bytes)
+    {
+      free_newline_index (b);
+      return;
+    }
+
+  for (block = newline_index_find (index, start_byte, false, &block_start);
+       block < index->nblocks && block_start.bytes < end_byte;
+       block++)
+    {
+      block_start.bytes += index->blocks[block].bytes;
+      newline_index_mark_stale (index, block);
+    }
+}
+
+/* Return the number of newlines of the current buffer before POS_BYTE,
+   according to its newline index INDEX.  */
+
+static ptrdiff_t
+newline_index_count (struct newline_index *index, ptrdiff_t pos_byte)
+{
+  struct newline_index_entry start;
+
+  newline_index_find (index, pos_byte - BEG_BYTE, false, &start);
+  return start.newlines + count_buffer_newlines (current_buffer,
+						 BEG_BYTE + start.bytes,
+						 pos_byte);
+}
+
+/* Return the byte position just after newline number N of the current
+   buffer, counting from 1, according to its newline index INDEX.  */
+
+static ptrdiff_t
+newline_index_nth (struct newline_index *index, ptrdiff_t n)
+{
+  struct newline_index_entry start;
+
+  newline_index_find (index, n - 1, true, &start);
+  return buffer_nth_newline (current_buffer, BEG_BYTE + start.bytes,
+			     n - start.newlines);
+}
+
+/* Look for COUNT newlines from START_BYTE to END_BYTE in the current
+   buffer as find_newline does, but with the newline index, if that is
+   faster than scanning the text.  If so, return true, and store in
+   *FOUND_BYTE the byte position that find_newline returns, and in
+   *SHORTAGE the number of newlines that were not found.  Otherwise,
+   return false.  */
+
+bool
+find_newline_by_index (ptrdiff_t start_byte, ptrdiff_t end_byte,
+		       ptrdiff_t count, ptrdiff_t *found_byte,
+		       ptrdiff_t *shortage)
+{
+  struct newline_index *index;
+  ptrdiff_t before_start, found;
+
+  if (eabs (count) < NEWLINE_INDEX_MIN_LINES
+      || eabs (end_byte - start_byte) < NEWLINE_INDEX_MIN_BYTES)
+    return false;
+
+  index = current_newline_index ();
+  before_start = newline_index_count (index, start_byte);
+  found = eabs (newline_index_count (index, end_byte) - before_start);
+  if (eabs (count) <= found)
+    {
+      *found_byte = newline_index_nth (index, (count > 0
+					       ? before_start + count
+					       : before_start + count + 1));
+      *shortage = 0;
     }
   else
     {
-      if (!indirect_p
-	  || !NILP (BVAR (base_buf, cache_long_scans)))
-	{
-	  /* It should be on.  */
-	  if (base_buf->newline_cache == 0)
-	    base_buf->newline_cache = new_region_cache ();
-	}
-      return base_buf->newline_cache;
+      *found_byte = end_byte;
+      *shortage = eabs (count) - found;
     }
+  return true;
 }
 
 
@@ -694,6 +1547,24 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
   if (end_byte == -1)
     end_byte = CHAR_TO_BYTE (end);
 
+  /* Skip over many newlines at once with the newline index.  */
+  if (eabs (count) >= NEWLINE_INDEX_MIN_LINES)
+    {
+      ptrdiff_t found_byte, missing;
+
+      if (start_byte == -1)
+	start_byte = CHAR_TO_BYTE (start);
+      if (find_newline_by_index (start_byte, end_byte, count,
+				 &found_byte, &missing))
+	{
+	  if (shortage)
+	    *shortage = missing;
+	  if (bytepos)
+	    *bytepos = found_byte;
+	  return found_byte == end_byte ? end : BYTE_TO_CHAR (found_byte);
+	}
+    }
+
   newline_cache = newline_cache_on_off (current_buffer);
   if (current_buffer->base_buffer)
     cache_buffer = current_buffer->base_buffer;
@@ -1421,6 +2292,13 @@ search_buffer (Lisp_Object string, ptrdiff_t pos, ptrdiff_t pos_byte,
       len_byte = pat - patbuf;
       pat = base_pat = patbuf;
 
+      if (n > 0)
+	{
+	  unsigned char *alt = alloca (len_byte);
+	  if (case_variants (pat, len_byte, multibyte, trt, inverse_trt, alt))
+	    return memchr_search (n, pat, alt, len_byte, pos_byte, lim_byte);
+	}
+
       if (boyer_moore_ok)
 	return boyer_moore (n, pat, len_byte, trt, inverse_trt,
 			    pos_byte, lim_byte,
@@ -1431,6 +2309,151 @@ search_buffer (Lisp_Object string, ptrdiff_t pos, ptrdiff_t pos_byte,
     }
 }
 
+/* Set ALT to a copy of the LEN_BYTE bytes at PAT, a pattern already
+   translated by TRT, in which each character that matches another one
+   is replaced by that other one, and return true.  Return false if
+   that cannot be done byte by byte: if a character of PAT matches more
+   than one other character, or, when searching a multibyte buffer as
+   MULTIBYTE says, a character that is not ASCII.  INVERSE_TRT is the
+   inverse of TRT.  */
+
+static bool
+case_variants (unsigned char *pat, ptrdiff_t len_byte, bool multibyte,
+	       Lisp_Object trt, Lisp_Object inverse_trt, unsigned char *alt)
+{
+  ptrdiff_t i;
+  int charlen;
+
+  memcpy (alt, pat, len_byte);
+  if (NILP (trt))
+    return 1;
+
+  for (i = 0; i < len_byte; i += charlen)
+    {
+      int c, inverse, other;
+
+      if (multibyte)
+	c = STRING_CHAR_AND_LENGTH (pat + i, charlen);
+      else
+	c = pat[i], charlen = 1;
+      TRANSLATE (inverse, inverse_trt, c);
+      if (inverse != c)
+	{
+	  TRANSLATE (other, inverse_trt, inverse);
+	  if (other != c
+	      || (multibyte
+		  ? ! ASCII_CHAR_P (c) || ! ASCII_CHAR_P (inverse)
+		  : inverse > 0377))
+	    return 0;
+	  alt[i] = inverse;
+	}
+    }
+  return 1;
+}
+
+/* Search forward N times for the string PAT, whose length LEN_BYTE
+   is positive, from buffer position POS_BYTE until LIM_BYTE.  A byte of
+   the buffer matches the byte PAT[I] if it is that byte or ALT[I]; see
+   case_variants.  Return as boyer_moore does.
+
+   This looks for the byte of PAT likely to be the rarest in the text,
+   and for its variant, with memchr, which the C library vectorizes,
+   and compares the rest of PAT where it finds them.  */
+
+static EMACS_INT
+memchr_search (EMACS_INT n, unsigned char *pat, unsigned char *alt,
+	       ptrdiff_t len_byte, ptrdiff_t pos_byte, ptrdiff_t lim_byte)
+{
+  bool exact;
+  ptrdiff_t i, k = 0, pos, last;
+  int cost = INT_MAX;
+
+  eassume (0 < len_byte);
+  exact = memcmp (pat, alt, len_byte) == 0;
+
+  for (i = 0; i < len_byte; i++)
+    {
+      int this_cost = (re_byte_frequency (pat[i])
+		       + (alt[i] == pat[i] ? 0 : re_byte_frequency (alt[i]) + 1));
+      if (this_cost <= cost)
+	{
+	  k = i;
+	  cost = this_cost;
+	}
+    }
+
+  /* POS is where to look for the byte PAT[K], which can be up to LAST.  */
+  pos = pos_byte + k;
+  last = lim_byte - len_byte + k;
+  while (pos <= last)
+    {
+      /* Look in a contiguous part of the text, at most a megabyte so
+	 as to check for quitting.  */
+      ptrdiff_t end, next;
+      unsigned char *base, *limit, *p0, *p1 = NULL, *p;
+
+      QUIT;
+      end = min (min (BUFFER_CEILING_OF (pos), last), pos + 0xFFFFF);
+      next = end + 1;
+      base = BYTE_POS_ADDR (pos);
+      limit = base + end - pos + 1;
+      p0 = memchr (base, pat[k], limit - base);
+      if (alt[k] != pat[k])
+	p1 = memchr (base, alt[k], limit - base);
+      while (p0 || p1)
+	{
+	  ptrdiff_t start;
+	  unsigned char *q;
+
+	  p = (p1 && (!p0 || p1 < p0)) ? p1 : p0;
+	  start = pos + (p - base) - k;
+	  if (start < GPT_BYTE && start + len_byte > GPT_BYTE)
+	    {
+	      /* The match would straddle the gap.  */
+	      for (i = 0; i < len_byte; i++)
+		{
+		  int c = FETCH_BYTE (start + i);
+		  if (c != pat[i] && c != alt[i])
+		    break;
+		}
+	    }
+	  else if (exact)
+	    i = memcmp (BYTE_POS_ADDR (start), pat, len_byte) ? 0 : len_byte;
+	  else
+	    for (i = 0, q = BYTE_POS_ADDR (start); i < len_byte; i++)
+	      if (q[i] != pat[i] && q[i] != alt[i])
+		break;
+
+	  if (i == len_byte)
+	    {
+	      set_search_regs (start, len_byte);
+	      if (--n == 0)
+		return (NILP (Vinhibit_changing_match_data)
+			? search_regs.end[0]
+			: BYTE_TO_CHAR (start + len_byte));
+	      /* Resume the search after the match.  set_search_regs
+		 may have allocated memory and relocated the text, so
+		 start again from its new address.  */
+	      next = start + len_byte + k;
+	      break;
+	    }
+
+	  p++;
+	  if (p >= limit)
+	    {
+	      next = pos + (p - base);
+	      break;
+	    }
+	  if (p0 && p0 < p)
+	    p0 = memchr (p, pat[k], limit - p);
+	  if (p1 && p1 < p)
+	    p1 = memchr (p, alt[k], limit - p);
+	}
+      pos = next;
+    }
+  return -n;
+}
+
 /* Do a simple string search N times for the string PAT,
    whose length is LEN/LEN_BYTE,
    from buffer position POS/POS_BYTE until LIM/LIM_BYTE.
@@ -1954,100 +2977,499 @@ boyer_moore (EMACS_INT n, unsigned char *base_pat,
 	    }
 	  pos_byte += cursor - p2;
 	}
-      else
-	/* Now we'll pick up a clump that has to be done the hard
-	   way because it covers a discontinuity.  */
+      else
+	/* Now we'll pick up a clump that has to be done the hard
+	   way because it covers a discontinuity.  */
+	{
+	  limit = ((direction > 0)
+		   ? BUFFER_CEILING_OF (pos_byte - dirlen + 1)
+		   : BUFFER_FLOOR_OF (pos_byte - dirlen - 1));
+	  limit = ((direction > 0)
+		   ? min (limit + len_byte, lim_byte - 1)
+		   : max (limit - len_byte, lim_byte));
+	  /* LIMIT is now the last value POS_BYTE can have
+	     and still be valid for a possible match.  */
+	  while (1)
+	    {
+	      /* This loop can be coded for space rather than
+		 speed because it will usually run only once.
+		 (the reach is at most len + 21, and typically
+		 does not exceed len).  */
+	      while ((limit - pos_byte) * direction >= 0)
+		{
+		  int ch = FETCH_BYTE (pos_byte);
+		  if (BM_tab[ch] == 0)
+		    goto hit2;
+		  pos_byte += BM_tab[ch];
+		}
+	      break;	/* ran off the end */
+
+	    hit2:
+	      /* Found what might be a match.  */
+	      i = dirlen - direction;
+	      while ((i -= direction) + direction != 0)
+		{
+		  int ch;
+		  unsigned char *ptr;
+		  pos_byte -= direction;
+		  ptr = BYTE_POS_ADDR (pos_byte);
+		  /* Translate only the last byte of a character.  */
+		  if (! multibyte
+		      || ((ptr == tail_end_ptr
+			   || CHAR_HEAD_P (ptr[1]))
+			  && (CHAR_HEAD_P (ptr[0])
+			      /* Check if this is the last byte of a
+				 translatable character.  */
+			      || (translate_prev_byte1 == ptr[-1]
+				  && (CHAR_HEAD_P (translate_prev_byte1)
+				      || (translate_prev_byte2 == ptr[-2]
+					  && (CHAR_HEAD_P (translate_prev_byte2)
+					      || translate_prev_byte3 == ptr[-3])))))))
+		    ch = simple_translate[*ptr];
+		  else
+		    ch = *ptr;
+		  if (pat[i] != ch)
+		    break;
+		}
+	      /* Above loop has moved POS_BYTE part or all the way
+		 back to the first pos (last pos if reverse).
+		 Set it once again at the last (first if reverse) char.  */
+	      pos_byte += dirlen - i - direction;
+	      if (i + direction == 0)
+		{
+		  ptrdiff_t position, start, end;
+		  pos_byte -= direction;
+
+		  position = pos_byte + ((direction > 0) ? 1 - len_byte : 0);
+		  set_search_regs (position, len_byte);
+
+		  if (NILP (Vinhibit_changing_match_data))
+		    {
+		      start = search_regs.start[0];
+		      end = search_regs.end[0];
+		    }
+		  else
+		    /* If Vinhibit_changing_match_data is non-nil,
+		       search_regs will not be changed.  So let's
+		       compute start and end here.  */
+		    {
+		      start = BYTE_TO_CHAR (position);
+		      end = BYTE_TO_CHAR (position + len_byte);
+		    }
+
+		  if ((n -= direction) != 0)
+		    pos_byte += dirlen; /* to resume search */
+		  else
+		    return direction > 0 ? end : start;
+		}
+	      else
+		pos_byte += stride_for_teases;
+	    }
+	  }
+      /* We have done one clump.  Can we continue? */
+      if ((lim_byte - pos_byte) * direction < 0)
+	return ((0 - n) * direction);
+    }
+  return BYTE_TO_CHAR (pos_byte);
+}
+
+/* Searching for any of several strings.
+
+   `search-forward-any' compiles its list of strings into an
+   Aho-Corasick automaton: a deterministic automaton over the bytes of
+   the text whose states are the prefixes of the strings, and which
+   reads the text once, whatever the number of strings.  To keep its
+   transition table small, the bytes that occur in no string all fall
+   into class 0, and each other byte has a class of its own.  The
+   automata compiled last are kept in a cache.
+
+   With `case-fold-search', the strings and the text are both
+   canonicalized with the case table: in a unibyte buffer each byte is
+   canonicalized as a character, as search_buffer does; in a
+   multibyte buffer, the automaton reads the multibyte form of the
+   canonical equivalent of each character.  A match may then have a
+   different length in bytes in the text than in the automaton, so its
+   positions are counted in characters.  */
+
+#define SEARCH_ANY_CACHE_SIZE 8
+
+/* The class of a byte whose character must be decoded and
+   canonicalized before the automaton can read it.  */
+#define SEARCH_ANY_DECODE 0xFFFF
+
+struct search_any
+{
+  struct search_any *next;
+  /* A copy of the list of strings, nil if this entry is unused.  */
+  Lisp_Object strings;
+  /* The case canonicalize table, or nil if case does not matter.  */
+  Lisp_Object trt;
+  /* True if the automaton is for a multibyte buffer.  */
+  bool multibyte;
+  /* True if the positions of matches are counted in characters rather
+     than in bytes.  */
+  bool by_char;
+  /* The class of each byte of the canonicalized strings, and of each
+     byte of the text, after canonicalization.  */
+  unsigned short raw_class[0400];
+  unsigned short byte_class[0400];
+  /* The number of classes.  */
+  int nclasses;
+  /* The transition table: the state after STATE reads a byte of class
+     C is delta[STATE * nclasses + C].  The initial state is 0.  */
+  int *delta;
+  /* For each state, the length of the prefix it stands for, and the
+     index of the longest string that ends there, or -1.  */
+  int *depth;
+  int *out;
+  /* The length of each string.  */
+  int *length;
+};
+
+static struct search_any search_any_cache[SEARCH_ANY_CACHE_SIZE];
+static struct search_any *search_any_head;
+
+/* Compile the list STRINGS into the automaton of CP, for the current
+   buffer, canonicalizing with TRT unless it is nil.  */
+
+static void
+compile_search_any (struct search_any *cp, Lisp_Object strings,
+		    Lisp_Object trt)
+{
+  bool multibyte = !NILP (BVAR (current_buffer, enable_multibyte_characters));
+  bool by_char = multibyte && !NILP (trt);
+  ptrdiff_t nstrings = 0, size = 0, max_size = 0, nstates, i, j;
+  ptrdiff_t *start;
+  unsigned char *text, *conv;
+  int nclasses, *queue;
+  Lisp_Object tail, copy = Qnil;
+  unsigned char fold[0400];
+
+  xfree (cp->delta);
+  xfree (cp->depth);
+  xfree (cp->out);
+  xfree (cp->length);
+  cp->strings = Qnil;
+  cp->delta = cp->depth = cp->out = cp->length = NULL;
+
+  for (i = 0; i < 0400; i++)
+    {
+      int c;
+      TRANSLATE (c, trt, i);
+      fold[i] = c < 0400 ? c : i;
+    }
+
+  /* Convert the strings to the representation of the buffer and
+     canonicalize them, one after the other in TEXT.  */
+  for (tail = strings; CONSP (tail); tail = XCDR (tail))
+    {
+      ptrdiff_t this_size = SCHARS (XCAR (tail)) * MAX_MULTIBYTE_LENGTH;
+      nstrings++;
+      size += this_size;
+      max_size = max (max_size, this_size);
+    }
+  text = xmalloc (size + 1);
+  conv = xmalloc (max_size + 1);
+  start = xnmalloc (nstrings + 1, sizeof *start);
+  cp->length = xnmalloc (nstrings, sizeof *cp->length);
+  size = 0;
+  for (i = 0, tail = strings; i < nstrings; i++, tail = XCDR (tail))
+    {
+      Lisp_Object string = XCAR (tail);
+      ptrdiff_t nchars = SCHARS (string), nbytes;
+      unsigned char *p = text + size;
+
+      start[i] = size;
+      if (multibyte == STRING_MULTIBYTE (string))
+	{
+	  nbytes = SBYTES (string);
+	  memcpy (conv, SDATA (string), nbytes);
+	}
+      else if (multibyte)
+	nbytes = copy_text (SDATA (string), conv, nchars, 0, 1);
+      else
+	nbytes = copy_text (SDATA (string), conv, SBYTES (string), 1, 0);
+
+      if (by_char)
+	{
+	  unsigned char *q = conv;
+	  while (q < conv + nbytes)
+	    {
+	      int len, c = STRING_CHAR_AND_LENGTH (q, len), canon;
+	      q += len;
+	      TRANSLATE (canon, trt, c);
+	      p += CHAR_STRING (canon, p);
+	    }
+	  nbytes = p - (text + size);
+	}
+      else if (!NILP (trt))
+	for (j = 0; j < nbytes; j++)
+	  p[j] = fold[conv[j]];
+      else
+	memcpy (p, conv, nbytes);
+
+      cp->length[i] = by_char ? nchars : nbytes;
+      size += nbytes;
+    }
+  start[nstrings] = size;
+
+  /* Give a class to each byte that occurs in a string.  */
+  memset (cp->raw_class, 0, sizeof cp->raw_class);
+  for (i = 0; i < size; i++)
+    cp->raw_class[text[i]] = 1;
+  for (i = 0, nclasses = 1; i < 0400; i++)
+    if (cp->raw_class[i])
+      cp->raw_class[i] = nclasses++;
+  for (i = 0; i < 0400; i++)
+    {
+      if (NILP (trt))
+	cp->byte_class[i] = cp->raw_class[i];
+      else if (!multibyte)
+	cp->byte_class[i] = cp->raw_class[fold[i]];
+      else
+	{
+	  /* Only ASCII characters whose canonical equivalent is ASCII
+	     can be read byte by byte.  */
+	  int c;
+	  TRANSLATE (c, trt, i);
+	  cp->byte_class[i] = (i < 0200 && c < 0200
+			       ? cp->raw_class[c] : SEARCH_ANY_DECODE);
+	}
+    }
+
+  /* Build the trie of the strings.  */
+  cp->delta = xnmalloc (size + 1, nclasses * sizeof *cp->delta);
+  cp->depth = xnmalloc (size + 1, sizeof *cp->depth);
+  cp->out = xnmalloc (size + 1, sizeof *cp->out);
+  for (j = 0; j < nclasses; j++)
+    cp->delta[j] = -1;
+  cp->depth[0] = 0;
+  cp->out[0] = -1;
+  nstates = 1;
+  for (i = 0; i < nstrings; i++)
+    {
+      int state = 0;
+      for (j = start[i]; j < start[i + 1]; j++)
+	{
+	  int *next = &cp->delta[state * nclasses + cp->raw_class[text[j]]];
+	  if (*next < 0)
+	    {
+	      ptrdiff_t k;
+	      *next = nstates;
+	      for (k = 0; k < nclasses; k++)
+		cp->delta[nstates * nclasses + k] = -1;
+	      cp->depth[nstates] = (cp->depth[state]
+				    + (by_char ? CHAR_HEAD_P (text[j]) : 1));
+	      cp->out[nstates] = -1;
+	      nstates++;
+	    }
+	  state = *next;
+	}
+      if (cp->out[state] < 0)
+	cp->out[state] = i;
+    }
+
+  /* Turn the trie into the automaton, breadth first, so that the
+     state that a state falls back on when its prefix cannot be
+     extended is complete when needed.  FAIL is that state.  */
+  queue = xnmalloc (nstates, 2 * sizeof *queue);
+  {
+    int *fail = queue + nstates;
+    ptrdiff_t qhead = 0, qtail = 0;
+
+    for (j = 0; j < nclasses; j++)
+      {
+	int next = cp->delta[j];
+	if (next < 0)
+	  cp->delta[j] = 0;
+	else
+	  {
+	    fail[next] = 0;
+	    queue[qtail++] = next;
+	  }
+      }
+    while (qhead < qtail)
+      {
+	int state = queue[qhead++];
+	int *row = &cp->delta[state * nclasses];
+	int *fail_row = &cp->delta[fail[state] * nclasses];
+
+	if (cp->out[state] < 0)
+	  cp->out[state] = cp->out[fail[state]];
+	for (j = 0; j < nclasses; j++)
+	  if (row[j] < 0)
+	    row[j] = fail_row[j];
+	  else
+	    {
+	      fail[row[j]] = fail_row[j];
+	      queue[qtail++] = row[j];
+	    }
+      }
+  }
+
+  xfree (queue);
+  xfree (start);
+  xfree (conv);
+  xfree (text);
+  cp->nclasses = nclasses;
+  cp->multibyte = multibyte;
+  cp->by_char = by_char;
+  cp->trt = trt;
+  for (tail = strings; CONSP (tail); tail = XCDR (tail))
+    copy = Fcons (Fcopy_sequence (XCAR (tail)), copy);
+  cp->strings = Fnreverse (copy);
+}
+
+/* Return true if the list of strings STRINGS has the same strings as
+   the list COPY.  */
+
+static bool
+search_any_equal (Lisp_Object copy, Lisp_Object strings)
+{
+  for (; CONSP (copy) && CONSP (strings);
+       copy = XCDR (copy), strings = XCDR (strings))
+    {
+      Lisp_Object a = XCAR (copy), b = XCAR (strings);
+      if (SCHARS (a) != SCHARS (b) || SBYTES (a) != SBYTES (b)
+	  || memcmp (SDATA (a), SDATA (b), SBYTES (a)) != 0)
+	return 0;
+    }
+  return NILP (copy) && NILP (strings);
+}
+
+/* Return the automaton for the list STRINGS in the current buffer,
+   compiling it if it is not in the cache.  TRT is as for
+   compile_search_any.  */
+
+static struct search_any *
+search_any_automaton (Lisp_Object strings, Lisp_Object trt)
+{
+  struct search_any *cp, **cpp;
+  bool multibyte = !NILP (BVAR (current_buffer, enable_multibyte_characters));
+
+  for (cpp = &search_any_head; ; cpp = &cp->next)
+    {
+      cp = *cpp;
+      if (NILP (cp->strings))
+	goto compile_it;
+      if (cp->multibyte == multibyte
+	  && EQ (cp->trt, trt)
+	  && search_any_equal (cp->strings, strings))
+	break;
+      if (cp->next == 0)
+	{
+	compile_it:
+	  compile_search_any (cp, strings, trt);
+	  break;
+	}
+    }
+
+  /* Move the entry to the front of the list.  */
+  *cpp = cp->next;
+  cp->next = search_any_head;
+  search_any_head = cp;
+  return cp;
+}
+
+/* Search forward N times with the automaton CP, from POS_BYTE until
+   LIM_BYTE.  Find the leftmost match, and the longest of those that
+   start there.  Return as boyer_moore does, and set *WHICH to the
+   index of the string found last.  */
+
+static EMACS_INT
+search_any_buffer (struct search_any *cp, EMACS_INT n,
+		   ptrdiff_t pos, ptrdiff_t pos_byte, ptrdiff_t lim_byte,
+		   ptrdiff_t *which)
+{
+  int nclasses = cp->nclasses;
+  int *delta = cp->delta, *depth = cp->depth, *out = cp->out;
+
+  while (n > 0)
+    {
+      int state = 0, best = out[0];
+      /* Positions are counted in characters if CP->by_char, else in
+	 bytes.  UNIT is that of POS_BYTE.  */
+      ptrdiff_t unit = cp->by_char ? pos : pos_byte;
+      ptrdiff_t best_start = unit, best_end = unit, best_end_byte = pos_byte;
+
+      while (pos_byte < lim_byte)
 	{
-	  limit = ((direction > 0)
-		   ? BUFFER_CEILING_OF (pos_byte - dirlen + 1)
-		   : BUFFER_FLOOR_OF (pos_byte - dirlen - 1));
-	  limit = ((direction > 0)
-		   ? min (limit + len_byte, lim_byte - 1)
-		   : max (limit - len_byte, lim_byte));
-	  /* LIMIT is now the last value POS_BYTE can have
-	     and still be valid for a possible match.  */
-	  while (1)
+	  /* Read a contiguous part of the text, at most a megabyte so
+	     as to check for quitting.  */
+	  ptrdiff_t end;
+	  unsigned char *base, *p, *limit;
+	  bool stop = 0;
+
+	  QUIT;
+	  end = min (min (BUFFER_CEILING_OF (pos_byte) + 1, lim_byte),
+		     pos_byte + 0x100000);
+	  base = p = BYTE_POS_ADDR (pos_byte);
+	  limit = base + (end - pos_byte);
+	  while (p < limit)
 	    {
-	      /* This loop can be coded for space rather than
-		 speed because it will usually run only once.
-		 (the reach is at most len + 21, and typically
-		 does not exceed len).  */
-	      while ((limit - pos_byte) * direction >= 0)
-		{
-		  int ch = FETCH_BYTE (pos_byte);
-		  if (BM_tab[ch] == 0)
-		    goto hit2;
-		  pos_byte += BM_tab[ch];
-		}
-	      break;	/* ran off the end */
+	      int c = cp->byte_class[*p];
 
-	    hit2:
-	      /* Found what might be a match.  */
-	      i = dirlen - direction;
-	      while ((i -= direction) + direction != 0)
+	      if (c != SEARCH_ANY_DECODE)
 		{
-		  int ch;
-		  unsigned char *ptr;
-		  pos_byte -= direction;
-		  ptr = BYTE_POS_ADDR (pos_byte);
-		  /* Translate only the last byte of a character.  */
-		  if (! multibyte
-		      || ((ptr == tail_end_ptr
-			   || CHAR_HEAD_P (ptr[1]))
-			  && (CHAR_HEAD_P (ptr[0])
-			      /* Check if this is the last byte of a
-				 translatable character.  */
-			      || (translate_prev_byte1 == ptr[-1]
-				  && (CHAR_HEAD_P (translate_prev_byte1)
-				      || (translate_prev_byte2 == ptr[-2]
-					  && (CHAR_HEAD_P (translate_prev_byte2)
-					      || translate_prev_byte3 == ptr[-3])))))))
-		    ch = simple_translate[*ptr];
-		  else
-		    ch = *ptr;
-		  if (pat[i] != ch)
-		    break;
+		  state = delta[state * nclasses + c];
+		  p++;
 		}
-	      /* Above loop has moved POS_BYTE part or all the way
-		 back to the first pos (last pos if reverse).
-		 Set it once again at the last (first if reverse) char.  */
-	      pos_byte += dirlen - i - direction;
-	      if (i + direction == 0)
+	      else
 		{
-		  ptrdiff_t position, start, end;
-		  pos_byte -= direction;
+		  unsigned char str[MAX_MULTIBYTE_LENGTH];
+		  int len, ch = STRING_CHAR_AND_LENGTH (p, len), i, nbytes;
 
-		  position = pos_byte + ((direction > 0) ? 1 - len_byte : 0);
-		  set_search_regs (position, len_byte);
+		  /* Leave a character cut by the end of this part to
+		     the next part.  */
+		  if (p + len > limit)
+		    break;
+		  p += len;
+		  TRANSLATE (ch, cp->trt, ch);
+		  nbytes = CHAR_STRING (ch, str);
+		  for (i = 0; i < nbytes; i++)
+		    state = delta[state * nclasses + cp->raw_class[str[i]]];
+		}
+	      unit++;
 
-		  if (NILP (Vinhibit_changing_match_data))
-		    {
-		      start = search_regs.start[0];
-		      end = search_regs.end[0];
-		    }
-		  else
-		    /* If Vinhibit_changing_match_data is non-nil,
-		       search_regs will not be changed.  So let's
-		       compute start and end here.  */
+	      if (out[state] >= 0)
+		{
+		  ptrdiff_t match_start = unit - cp->length[out[state]];
+		  if (best < 0 || match_start <= best_start)
 		    {
-		      start = BYTE_TO_CHAR (position);
-		      end = BYTE_TO_CHAR (position + len_byte);
+		      best = out[state];
+		      best_start = match_start;
+		      best_end = unit;
+		      best_end_byte = pos_byte + (p - base);
 		    }
-
-		  if ((n -= direction) != 0)
-		    pos_byte += dirlen; /* to resume search */
-		  else
-		    return direction > 0 ? end : start;
 		}
-	      else
-		pos_byte += stride_for_teases;
+	      /* Stop when no match could start as early as BEST.  */
+	      if (best >= 0 && unit - depth[state] > best_start)
+		{
+		  stop = 1;
+		  break;
+		}
 	    }
-	  }
-      /* We have done one clump.  Can we continue? */
-      if ((lim_byte - pos_byte) * direction < 0)
-	return ((0 - n) * direction);
+	  pos_byte += p - base;
+	  if (stop)
+	    break;
+	}
+
+      if (best < 0)
+	return -n;
+
+      *which = best;
+      pos_byte = best_end_byte;
+      pos = cp->by_char ? best_end : BYTE_TO_CHAR (pos_byte);
+      if (cp->by_char)
+	{
+	  ptrdiff_t start_byte = CHAR_TO_BYTE (best_start);
+	  set_search_regs (start_byte, pos_byte - start_byte);
+	}
+      else
+	set_search_regs (best_start, pos_byte - best_start);
+      n--;
     }
-  return BYTE_TO_CHAR (pos_byte);
+  return pos;
 }
 
 /* Record beginning BEG_BYTE and end BEG_BYTE + NBYTES
@@ -2125,6 +3547,86 @@ See also the functions `match-beginning', `match-end' and `replace-match'.  */)
   return search_command (string, bound, noerror, count, 1, 0, 0);
 }
 
+DEFUN ("search-forward-any", Fsearch_forward_any, Ssearch_forward_any, 1, 4, 0,
+       doc: /* Search forward from point for any of the strings in STRINGS.
+STRINGS is a list of strings.  Set point to the end of the occurrence
+found, and return the element of STRINGS that occurs there.
+The occurrence found is the one that starts first; of several that
+start at the same place, it is the longest.
+An optional second argument bounds the search; it is a buffer position.
+The match found must not extend after that position.  A value of nil is
+  equivalent to (point-max).
+Optional third argument, if t, means if fail just return nil (no error).
+  If not nil and not t, move to limit of search and return nil.
+Optional fourth argument COUNT, if non-nil, means to search for COUNT
+ successive occurrences; it must be positive.
+
+This reads the text once, however many strings there are, so it is
+faster than a regexp search for an alternation of the strings.  The
+automata it builds for the strings are cached, so it is best to use
+the same list in successive searches.
+
+Search case-sensitivity is determined by the value of the variable
+`case-fold-search', which see.
+
+See also the functions `match-beginning', `match-end' and `replace-match'.  */)
+  (Lisp_Object strings, Lisp_Object bound, Lisp_Object noerror, Lisp_Object count)
+{
+  Lisp_Object tail, trt;
+  EMACS_INT n = 1, np;
+  ptrdiff_t lim, lim_byte, which = 0;
+  struct search_any *cp;
+
+  if (!NILP (count))
+    {
+      CHECK_NUMBER (count);
+      n = XINT (count);
+      if (n <= 0)
+	args_out_of_range (count, make_number (1));
+    }
+
+  for (tail = strings; CONSP (tail); tail = XCDR (tail))
+    CHECK_STRING (XCAR (tail));
+  if (!NILP (tail))
+    wrong_type_argument (Qlistp, strings);
+
+  if (NILP (bound))
+    lim = ZV, lim_byte = ZV_BYTE;
+  else
+    {
+      CHECK_NUMBER_COERCE_MARKER (bound);
+      lim = XINT (bound);
+      if (lim < PT)
+	error ("Invalid search bound (wrong side of point)");
+      if (lim > ZV)
+	lim = ZV, lim_byte = ZV_BYTE;
+      else
+	lim_byte = CHAR_TO_BYTE (lim);
+    }
+
+  if (running_asynch_code)
+    save_search_regs ();
+
+  trt = (!NILP (BVAR (current_buffer, case_fold_search))
+	 ? BVAR (current_buffer, case_canon_table) : Qnil);
+  cp = search_any_automaton (strings, trt);
+  np = search_any_buffer (cp, n, PT, PT_BYTE, lim_byte, &which);
+  if (np <= 0)
+    {
+      if (NILP (noerror))
+	xsignal1 (Qsearch_failed, strings);
+
+      if (!EQ (noerror, Qt))
+	SET_PT_BOTH (lim, lim_byte);
+      return Qnil;
+    }
+
+  eassert (BEGV <= np && np <= ZV);
+  SET_PT (np);
+
+  return Fnth (make_number (which), strings);
+}
+
 DEFUN ("re-search-backward", Fre_search_backward, Sre_search_backward, 1, 4,
        "sRE search backward: ",
        doc: /* Search backward from point for match for regular expression REGEXP.
@@ -2210,6 +3712,221 @@ and `replace-match'.  */)
 {
   return search_command (regexp, bound, noerror, count, 1, 1, 1);
 }
+
+/* Find the matches for REGEXP in the current buffer between START and
+   END, which default to the limits of the accessible portion.  Look
+   for each match from the end of the previous one, or one character
+   further if that one was empty.
+
+   If FUNCTION is non-nil, call it at each match, with the match data
+   set, point at the end of the match, and the bounds of the match as
+   arguments, and go on from point when it returns.  Otherwise leave the
+   match data alone, and if POSITIONS is non-null, push on it the
+   bounds of subexpression SUBEXP of each match, if it matched.
+
+   Return the number of matches.  */
+
+static EMACS_INT
+search_all (Lisp_Object regexp, Lisp_Object start, Lisp_Object end,
+	    Lisp_Object function, EMACS_INT subexp, Lisp_Object *positions)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  struct re_registers *regs
+    = NILP (function) ? &search_regs_1 : &search_regs;
+  struct re_pattern_buffer *bufp = NULL;
+  Lisp_Object buffer, limit = Qnil;
+  ptrdiff_t pos, pos_byte, lim, lim_byte;
+  EMACS_INT matches = 0;
+  struct gcpro gcpro1, gcpro2, gcpro3, gcpro4;
+
+  CHECK_STRING (regexp);
+  if (NILP (start))
+    XSETFASTINT (start, BEGV);
+  if (NILP (end))
+    XSETFASTINT (end, ZV);
+  validate_region (&start, &end);
+  pos = XINT (start);
+  pos_byte = CHAR_TO_BYTE (pos);
+  lim = XINT (end);
+  lim_byte = CHAR_TO_BYTE (lim);
+
+  XSETBUFFER (buffer, current_buffer);
+  if (!NILP (function))
+    {
+      /* FUNCTION may edit the buffer, or move point.  */
+      record_unwind_current_buffer ();
+      record_unwind_protect (save_excursion_restore, save_excursion_save ());
+      limit = build_marker (current_buffer, lim, lim_byte);
+    }
+  GCPRO4 (regexp, function, buffer, limit);
+
+  if (running_asynch_code)
+    save_search_regs ();
+
+  while (true)
+    {
+      unsigned char *p1, *p2;
+      ptrdiff_t s1, s2, val, beg_byte, end_byte;
+
+      /* FUNCTION may change the case table or the syntax table, or
+	 compile other regexps in the place of this one.  */
+      if (!bufp || !NILP (function))
+	{
+	  /* This is so set_image_of_range_1 in regex.c can find the EQV
+	     table.  */
+	  set_char_table_extras (BVAR (current_buffer, case_canon_table), 2,
+				 BVAR (current_buffer, case_eqv_table));
+	  bufp = compile_pattern (regexp, regs,
+				  (!NILP (BVAR (current_buffer, case_fold_search))
+				   ? BVAR (current_buffer, case_canon_table)
+				   : Qnil),
+				  0,
+				  !NILP (BVAR (current_buffer,
+					       enable_multibyte_characters)));
+	}
+
+      /* Consing may have compacted the buffer since the last match,
+	 and FUNCTION may have edited it.  */
+      p1 = BEGV_ADDR;
+      s1 = GPT_BYTE - BEGV_BYTE;
+      p2 = GAP_END_ADDR;
+      s2 = ZV_BYTE - GPT_BYTE;
+      if (s1 < 0)
+	{
+	  p2 = p1;
+	  s2 = ZV_BYTE - BEGV_BYTE;
+	  s1 = 0;
+	}
+      if (s2 < 0)
+	{
+	  s1 = ZV_BYTE - BEGV_BYTE;
+	  s2 = 0;
+	}
+      re_match_object = Qnil;
+
+      immediate_quit = 1;
+      QUIT;
+      val = re_search_2 (bufp, (char *) p1, s1, (char *) p2, s2,
+			 pos_byte - BEGV_BYTE, lim_byte - pos_byte,
+			 regs, lim_byte - BEGV_BYTE);
+      immediate_quit = 0;
+      if (val == -2)
+	matcher_overflow ();
+      if (val < 0)
+	break;
+      matches++;
+      beg_byte = regs->start[0] + BEGV_BYTE;
+      end_byte = regs->end[0] + BEGV_BYTE;
+
+      if (!NILP (function))
+	{
+	  ptrdiff_t i, beg, end;
+
+	  for (i = 0; i < search_regs.num_regs; i++)
+	    if (search_regs.start[i] >= 0)
+	      {
+		search_regs.start[i]
+		  = BYTE_TO_CHAR (search_regs.start[i] + BEGV_BYTE);
+		search_regs.end[i]
+		  = BYTE_TO_CHAR (search_regs.end[i] + BEGV_BYTE);
+	      }
+	  XSETBUFFER (last_thing_searched, current_buffer);
+	  beg = search_regs.start[0];
+	  end = search_regs.end[0];
+	  SET_PT_BOTH (end, end_byte);
+
+	  call2 (function, make_number (beg), make_number (end));
+
+	  if (!BUFFER_LIVE_P (XBUFFER (buffer)))
+	    error ("Buffer killed while searching it");
+	  set_buffer_internal (XBUFFER (buffer));
+	  lim = clip_to_bounds (PT, marker_position (limit), ZV);
+	  lim_byte = CHAR_TO_BYTE (lim);
+	  pos = PT;
+	  pos_byte = PT_BYTE;
+	  if (beg == end && pos == end)
+	    {
+	      if (pos >= lim)
+		break;
+	      pos++;
+	      INC_POS (pos_byte);
+	    }
+	}
+      else
+	{
+	  if (positions && subexp < regs->num_regs
+	      && regs->start[subexp] >= 0)
+	    *positions
+	      = Fcons (Fcons (make_number (BYTE_TO_CHAR (regs->start[subexp]
+							  + BEGV_BYTE)),
+			      make_number (BYTE_TO_CHAR (regs->end[subexp]
+							  + BEGV_BYTE))),
+		       *positions);
+	  pos_byte = end_byte;
+	  if (beg_byte == end_byte)
+	    {
+	      if (pos_byte >= lim_byte)
+		break;
+	      INC_POS (pos_byte);
+	    }
+	}
+    }
+
+  UNGCPRO;
+  unbind_to (count, Qnil);
+  return matches;
+}
+
+DEFUN ("re-search-map", Fre_search_map, Sre_search_map, 2, 4, 0,
+       doc: /* Call FUNCTION for each match for REGEXP from START to END.
+FUNCTION is called with two arguments, the beginning and end of the
+match, with point at the end of the match and the match data set, as
+after `re-search-forward'.  The search goes on from point when it
+returns, so FUNCTION may move point, or replace the match.  Point is
+restored afterwards.  START and END default to the limits of the
+accessible portion of the buffer.  Without FUNCTION, each match is
+looked for from the end of the previous one, or one character further
+if that one was empty.
+
+If FUNCTION is nil, just count the matches, without changing the
+match data.  This does not allocate any storage for each match.
+
+Return the number of matches.
+
+Search case-sensitivity is determined by the value of the variable
+`case-fold-search', which see.  */)
+  (Lisp_Object function, Lisp_Object regexp, Lisp_Object start,
+   Lisp_Object end)
+{
+  return make_number (search_all (regexp, start, end, function, 0, NULL));
+}
+
+DEFUN ("re-search-positions", Fre_search_positions, Sre_search_positions,
+       1, 4, 0,
+       doc: /* Return the positions of the matches for REGEXP from START to END.
+The value is a list of elements (BEG . END), the bounds of the
+matches in the order they occur.  START and END default to the limits
+of the accessible portion of the buffer.  Matches are found as by
+`re-search-map'.  The match data is not changed.
+
+If SUBEXP is non-nil, return the bounds of that subexpression of each
+match instead, omitting the matches where it did not match.
+
+Search case-sensitivity is determined by the value of the variable
+`case-fold-search', which see.  */)
+  (Lisp_Object regexp, Lisp_Object start, Lisp_Object end, Lisp_Object subexp)
+{
+  Lisp_Object positions = Qnil;
+  EMACS_INT n = 0;
+
+  if (!NILP (subexp))
+    {
+      CHECK_NATNUM (subexp);
+      n = XFASTINT (subexp);
+    }
+  search_all (regexp, start, end, Qnil, n, &positions);
+  return Fnreverse (positions);
+}
 
 DEFUN ("replace-match", Freplace_match, Sreplace_match, 1, 5, 0,
        doc: /* Replace text matched by last search with NEWTEXT.
@@ -3032,26 +4749,53 @@ DEFUN ("regexp-quote", Fregexp_quote, Sregexp_quote, 1, 1, 0,
 				out - temp,
 				STRING_MULTIBYTE (string));
 }
+
+DEFUN ("regexp-disassemble", Fregexp_disassemble, Sregexp_disassemble, 1, 1, 0,
+       doc: /* Return a description of the compiled form of REGEXP.
+The description shows, one per line, the operations that the regexp
+matcher runs to match REGEXP in the current buffer, after the
+compiler optimized them.  It is meant for debugging the regexp
+compiler, and its format may change.  */)
+  (Lisp_Object regexp)
+{
+  struct re_pattern_buffer *bufp;
+  char *text;
+  Lisp_Object val;
+
+  CHECK_STRING (regexp);
+
+  /* This is so set_image_of_range_1 in regex.c can find the EQV table.  */
+  set_char_table_extras (BVAR (current_buffer, case_canon_table), 2,
+			 BVAR (current_buffer, case_eqv_table));
+
+  bufp = compile_pattern (regexp, NULL,
+			  (!NILP (BVAR (current_buffer, case_fold_search))
+			   ? BVAR (current_buffer, case_canon_table) : Qnil),
+			  0,
+			  !NILP (BVAR (current_buffer, enable_multibyte_characters)));
+  text = re_describe_pattern (bufp);
+  val = build_string (text);
+  xfree (text);
+  return val;
+}
 
 void
 syms_of_search (void)
 {
-  register int i;
+  int i;
 
-  for (i = 0; i < REGEXP_CACHE_SIZE; ++i)
+  regexp_cache_set_limit (REGEXP_CACHE_MIN_SIZE);
+
+  for (i = 0; i < SEARCH_ANY_CACHE_SIZE; ++i)
     {
-      searchbufs[i].buf.allocated = 100;
-      searchbufs[i].buf.buffer = xmalloc (100);
-      searchbufs[i].buf.fastmap = searchbufs[i].fastmap;
-      searchbufs[i].regexp = Qnil;
-      searchbufs[i].whitespace_regexp = Qnil;
-      searchbufs[i].syntax_table = Qnil;
-      staticpro (&searchbufs[i].regexp);
-      staticpro (&searchbufs[i].whitespace_regexp);
-      staticpro (&searchbufs[i].syntax_table);
-      searchbufs[i].next = (i == REGEXP_CACHE_SIZE-1 ? 0 : &searchbufs[i+1]);
+      search_any_cache[i].strings = Qnil;
+      search_any_cache[i].trt = Qnil;
+      staticpro (&search_any_cache[i].strings);
+      staticpro (&search_any_cache[i].trt);
+      search_any_cache[i].next = (i == SEARCH_ANY_CACHE_SIZE - 1
+				  ? 0 : &search_any_cache[i + 1]);
     }
-  searchbuf_head = &searchbufs[0];
+  search_any_head = &search_any_cache[0];
 
   DEFSYM (Qsearch_failed, "search-failed");
   DEFSYM (Qinvalid_regexp, "invalid-regexp");
@@ -3088,20 +4832,50 @@ do not set the match data.  The proper way to use this variable
 is to bind it with `let' around a small expression.  */);
   Vinhibit_changing_match_data = Qnil;
 
+  DEFVAR_BOOL ("search-use-dfa", search_use_dfa,
+      doc: /* Non-nil means regexp searches skip hopeless positions with a DFA.
+The regexp matcher backtracks, which takes exponential time for some
+regexps at positions where they don't match.  When this is non-nil,
+the searching and matching functions first run a deterministic
+automaton built on demand from the regexp, and only backtrack where it
+finds that a match starts.  The results are the same either way; this
+variable exists for debugging and for measuring the difference.  */);
+  search_use_dfa = 1;
+
+  DEFVAR_INT ("regexp-cache-hits", regexp_cache_hits,
+	      doc: /* Number of times a regexp was found in the regexp cache.
+The searching and matching functions keep the regexps they compile in
+a cache, which grows when more regexps are in use.  See also
+`regexp-cache-misses' and `regexp-cache-compile-time'.  */);
+
+  DEFVAR_INT ("regexp-cache-misses", regexp_cache_misses,
+	      doc: /* Number of times a regexp was compiled for the regexp cache.
+This counts the regexps that were not found in the cache, including
+those that failed to compile.  See `regexp-cache-hits'.  */);
+
+  DEFVAR_LISP ("regexp-cache-compile-time", Vregexp_cache_compile_time,
+	       doc: /* Accumulated time spent compiling regexps for the regexp cache.
+The time is in seconds as a floating point value.  */);
+  Vregexp_cache_compile_time = make_float (0.0);
+
   defsubr (&Slooking_at);
   defsubr (&Sposix_looking_at);
   defsubr (&Sstring_match);
   defsubr (&Sposix_string_match);
   defsubr (&Ssearch_forward);
   defsubr (&Ssearch_backward);
+  defsubr (&Ssearch_forward_any);
   defsubr (&Sre_search_forward);
   defsubr (&Sre_search_backward);
   defsubr (&Sposix_search_forward);
   defsubr (&Sposix_search_backward);
+  defsubr (&Sre_search_map);
+  defsubr (&Sre_search_positions);
   defsubr (&Sreplace_match);
   defsubr (&Smatch_beginning);
   defsubr (&Smatch_end);
   defsubr (&Smatch_data);
   defsubr (&Sset_match_data);
   defsubr (&Sregexp_quote);
+  defsubr (&Sregexp_disassemble);
 }
@@ -176,6 +176,85 @@ static struct buffer *find_start_buffer;
 static ptrdiff_t find_start_begv;
 static EMACS_INT find_start_modiff;
 
+/* The checkpoints of `syntax-ppss'.
+
+   `syntax-ppss' returns the state that `parse-partial-sexp' reaches
+   at some position when it starts at the beginning of the accessible
+   portion of the buffer.  So as not to scan all that text each time,
+   the (base) buffer keeps the states at positions about
+   PPSS_CHECKPOINT_INTERVAL characters apart, in increasing order,
+   and a query scans only from the last checkpoint before it.  The
+   states are kept in C rather than in Lisp lists, so that they cost
+   nothing to the garbage collector; the positions of the open parens
+   that enclose each checkpoint are stored one after the other in
+   LEVELS.
+
+   A change to the text makes the checkpoints after it stale, since
+   the state at them may now be different; see invalidate_buffer_caches.
+   The text after a stale checkpoint is still the same, though, so
+   when scanning from the change finds the same state at one of them
+   as before, it and the stale checkpoints computed from it are right
+   again, and an edit that leaves the parse state alone costs no more
+   than the scan up to the next checkpoint.
+
+   The checkpoints also depend on the syntax table, on
+   `parse-sexp-lookup-properties' and on where the accessible portion
+   starts, and are all dropped when one of those is not what it was
+   when they were computed.  */
+
+#define PPSS_CHECKPOINT_INTERVAL 2000
+
+struct ppss_checkpoint
+{
+  ptrdiff_t charpos, bytepos;
+  EMACS_INT depth;
+  EMACS_INT incomment;
+  int instring;
+  int comstyle;
+  bool quoted;
+  /* Start of the comment or string, or -1 if not in one.  */
+  ptrdiff_t comstr_start;
+  /* Where the open parens enclosing this checkpoint start in LEVELS,
+     and how many there are.  */
+  ptrdiff_t levels, nlevels;
+  /* Whether this checkpoint was computed from the previous one, and
+     the text between them has not changed since.  */
+  bool chain;
+};
+
+struct ppss_points
+{
+  struct ppss_checkpoint *points;
+  ptrdiff_t npoints, points_size;
+  ptrdiff_t *levels;
+  ptrdiff_t nlevels, levels_size;
+};
+
+struct ppss_cache
+{
+  /* The checkpoints known to be right.  */
+  struct ppss_points valid;
+
+  /* The stale checkpoints, from FIRST_STALE on, all after the valid
+     ones.  Their positions are as of when the buffer's Z and Z_BYTE
+     were STALE_Z and STALE_Z_BYTE, and STALE_END was the end of the
+     text that was about to change; those at or after STALE_END move
+     as much as the buffer has grown since.  */
+  struct ppss_points stale;
+  ptrdiff_t first_stale;
+  ptrdiff_t stale_z, stale_z_byte, stale_end;
+
+  /* What the checkpoints were computed with.  */
+  Lisp_Object syntax_table;
+  EMACS_INT syntax_modiff;
+  bool lookup_properties;
+  ptrdiff_t begv;
+};
+
+/* Incremented whenever a syntax table is modified, which may change
+   others that inherit from it.  */
+static EMACS_INT syntax_modiff;
+
 
 static Lisp_Object skip_chars (bool, Lisp_Object, Lisp_Object, bool);
 static Lisp_Object skip_syntaxes (bool, Lisp_Object, Lisp_Object);
@@ -592,6 +671,173 @@ find_defun_start (ptrdiff_t pos, ptrdiff_t pos_byte)
   return find_start_value;
 }
 
+/* Long lines, such as those of minified JavaScript or JSON, make the
+   scanning loops below spend most of their time on characters that
+   cannot change their state: whitespace, words, the insides of strings
+   and comments.  The functions that follow let them skip runs of such
+   characters a byte at a time, with the syntax of the ASCII characters
+   kept in a small table, instead of decoding each character, looking
+   it up in the syntax table and updating the syntax-table property
+   state.  They do nothing when a `syntax-table' property gives the
+   syntax directly, and stop where the property changes.  */
+
+/* Masks for the flags in a SYNTAX_WITH_FLAGS value, and for a set of
+   syntax codes.  */
+enum
+  {
+    SYNTAX_FLAG_COMSTART_FIRST = 1 << 16,
+    SYNTAX_FLAG_COMSTART_SECOND = 1 << 17,
+    SYNTAX_FLAG_COMEND_FIRST = 1 << 18,
+    SYNTAX_FLAG_COMEND_SECOND = 1 << 19,
+    SYNTAX_FLAG_COMMENT_ANY = (SYNTAX_FLAG_COMSTART_FIRST
+			       | SYNTAX_FLAG_COMSTART_SECOND
+			       | SYNTAX_FLAG_COMEND_FIRST
+			       | SYNTAX_FLAG_COMEND_SECOND)
+  };
+
+#define SYNTAX_CODE_BIT(code) (1 << (code))
+
+struct syntax_run
+{
+  /* The syntax table that SYNTAX was read from.  */
+  Lisp_Object table;
+
+  /* The SYNTAX_WITH_FLAGS of each ASCII character, or -1 if it has not
+     been looked up yet.  */
+  int syntax[128];
+};
+
+static void
+syntax_run_init (struct syntax_run *run)
+{
+  run->table = Qnil;
+}
+
+/* Return true if RUN can be used at the current position of gl_state,
+   making it ready for the syntax table in use there.  */
+
+static bool
+syntax_run_usable (struct syntax_run *run)
+{
+  if (gl_state.use_global)
+    return false;
+  if (!EQ (run->table, gl_state.current_syntax_table))
+    {
+      run->table = gl_state.current_syntax_table;
+      memset (run->syntax, -1, sizeof run->syntax);
+    }
+  return true;
+}
+
+/* Return true if the ASCII character C has one of the syntax codes in
+   CODES, a set of SYNTAX_CODE_BIT, and none of the flags in FLAGS.  */
+
+static bool
+syntax_run_member (struct syntax_run *run, int c, int codes, int flags)
+{
+  int syntax = run->syntax[c];
+
+  if (syntax < 0)
+    syntax = run->syntax[c] = SYNTAX_WITH_FLAGS (c);
+  return (codes & SYNTAX_CODE_BIT (syntax & 0xff)) && ! (syntax & flags);
+}
+
+/* Return how many characters after FROM, FROM_BYTE, and before STOP,
+   are ASCII characters that have a syntax code in CODES and none of
+   the flags in FLAGS.  Global syntax data must be valid for FROM, and
+   stays valid for the characters counted.  */
+
+static ptrdiff_t
+skip_syntax_run_forward (struct syntax_run *run, ptrdiff_t from,
+			 ptrdiff_t from_byte, ptrdiff_t stop,
+			 int codes, int flags)
+{
+  ptrdiff_t n = 0;
+
+  if (!syntax_run_usable (run))
+    return 0;
+  if (parse_sexp_lookup_properties)
+    {
+      if (from < gl_state.b_property)
+	return 0;
+      stop = min (stop, gl_state.e_property);
+    }
+
+  /* All the characters counted are one byte long, so the text to look
+     at is at most STOP - FROM bytes, in two pieces around the gap.  */
+  while (from + n < stop)
+    {
+      ptrdiff_t pos_byte = from_byte + n;
+      ptrdiff_t len = stop - from - n;
+      unsigned char *p = BYTE_POS_ADDR (pos_byte);
+      ptrdiff_t i;
+
+      if (pos_byte < GPT_BYTE)
+	len = min (len, GPT_BYTE - pos_byte);
+      for (i = 0; i < len; i++)
+	if (! (p[i] < 0x80 && syntax_run_member (run, p[i], codes, flags)))
+	  return n + i;
+      n += len;
+    }
+  return n;
+}
+
+/* Like skip_syntax_run_forward, but count characters before FROM,
+   FROM_BYTE, and after STOP.  If UNQUOTED, also stop at a character
+   that a character with the syntax of an escape or a character quote
+   may quote.  Global syntax data must be valid for FROM - 1.  */
+
+static ptrdiff_t
+skip_syntax_run_backward (struct syntax_run *run, ptrdiff_t from,
+			  ptrdiff_t from_byte, ptrdiff_t stop,
+			  int codes, int flags, bool unquoted)
+{
+  int quote_codes = SYNTAX_CODE_BIT (Sescape) | SYNTAX_CODE_BIT (Scharquote);
+  ptrdiff_t n = 0;
+
+  if (!syntax_run_usable (run))
+    return 0;
+  if (parse_sexp_lookup_properties)
+    {
+      if (from > gl_state.e_property)
+	return 0;
+      stop = max (stop, gl_state.b_property);
+    }
+
+  while (from - n > stop)
+    {
+      ptrdiff_t pos_byte = from_byte - n;
+      ptrdiff_t len = from - n - stop;
+      unsigned char *p = BYTE_POS_ADDR (pos_byte - 1);
+      ptrdiff_t i;
+
+      if (pos_byte > GPT_BYTE)
+	len = min (len, pos_byte - GPT_BYTE);
+      for (i = 0; i < len; i++)
+	{
+	  ptrdiff_t pos = from - n - i - 1;
+
+	  if (! (p[-i] < 0x80 && syntax_run_member (run, p[-i], codes, flags)))
+	    return n + i;
+	  /* The character before POS must be looked at with the same
+	     syntax table, and must not be able to quote it.  */
+	  if (unquoted && pos > BEGV)
+	    {
+	      int c;
+
+	      if (pos == stop)
+		return n + i;
+	      c = FETCH_BYTE (pos_byte - i - 2);
+	      if (! (c < 0x80
+		     && ! syntax_run_member (run, c, quote_codes, 0)))
+		return n + i;
+	    }
+	}
+      n += len;
+    }
+  return n;
+}
+
 /* Return the SYNTAX_COMEND_FIRST of the character before POS, POS_BYTE.  */
 
 static bool
@@ -654,6 +900,15 @@ back_comment (ptrdiff_t from, ptrdiff_t from_byte, ptrdiff_t stop,
   ptrdiff_t nesting = 1;		/* current comment nesting */
   int c;
   int syntax = 0;
+  struct syntax_run run;
+  /* The characters that cannot matter here, quoted or not.  */
+  int inert = ~ (SYNTAX_CODE_BIT (Sstring) | SYNTAX_CODE_BIT (Sstring_fence)
+		 | SYNTAX_CODE_BIT (Scomment_fence) | SYNTAX_CODE_BIT (Scomment)
+		 | SYNTAX_CODE_BIT (Sendcomment)
+		 | (open_paren_in_column_0_is_defun_start
+		    ? SYNTAX_CODE_BIT (Sopen) : 0));
+
+  syntax_run_init (&run);
 
   /* FIXME: A }} comment-ender style leads to incorrect behavior
      in the case of {{ c }}} because we ignore the last two chars which are
@@ -666,6 +921,18 @@ back_comment (ptrdiff_t from, ptrdiff_t from_byte, ptrdiff_t stop,
       ptrdiff_t temp_byte;
       int prev_syntax;
       bool com2start, com2end, comstart;
+      ptrdiff_t n = skip_syntax_run_backward (&run, from, from_byte, stop,
+					      inert, SYNTAX_FLAG_COMMENT_ANY,
+					      false);
+
+      if (n > 0)
+	{
+	  from -= n;
+	  from_byte -= n;
+	  syntax = run.syntax[FETCH_BYTE (from_byte)];
+	  if (from == stop)
+	    break;
+	}
 
       /* Move back and examine a character.  */
       DEC_BOTH (from, from_byte);
@@ -1177,6 +1444,8 @@ usage: (modify-syntax-entry CHAR NEWENTRY &optional SYNTAX-TABLE)  */)
   /* We clear the regexp cache, since character classes can now have
      different values from those in the compiled regexps.*/
   clear_regexp_cache ();
+  /* Likewise for the checkpoints of `syntax-ppss'.  */
+  syntax_modiff++;
 
   return Qnil;
 }
@@ -2253,8 +2522,14 @@ forw_comment (ptrdiff_t from, ptrdiff_t from_byte, ptrdiff_t stop,
   register int c, c1;
   register enum syntaxcode code;
   register int syntax, other_syntax;
+  struct syntax_run run;
+  /* The characters that cannot start or end a comment.  */
+  int inert = ~ (SYNTAX_CODE_BIT (Sendcomment)
+		 | SYNTAX_CODE_BIT (Scomment_fence)
+		 | SYNTAX_CODE_BIT (Scomment));
 
   if (nesting <= 0) nesting = -1;
+  syntax_run_init (&run);
 
   /* Enter the loop in the middle so that we find
      a 2-char comment ender if we start in the middle of it.  */
@@ -2263,6 +2538,17 @@ forw_comment (ptrdiff_t from, ptrdiff_t from_byte, ptrdiff_t stop,
 
   while (1)
     {
+      ptrdiff_t n
+	= skip_syntax_run_forward (&run, from, from_byte, stop, inert,
+				   (SYNTAX_FLAG_COMSTART_FIRST
+				    | SYNTAX_FLAG_COMEND_FIRST));
+
+      if (n > 0)
+	{
+	  from += n;
+	  from_byte += n;
+	  UPDATE_SYNTAX_TABLE_FORWARD (from);
+	}
       if (from == stop)
 	{
 	  *incomment_ptr = nesting;
@@ -2359,9 +2645,11 @@ between them, return t; otherwise return nil.  */)
   EMACS_INT count1;
   ptrdiff_t out_charpos, out_bytepos;
   EMACS_INT dummy;
+  struct syntax_run run;
 
   CHECK_NUMBER (count);
   count1 = XINT (count);
+  syntax_run_init (&run);
   stop = count1 > 0 ? ZV : BEGV;
 
   immediate_quit = 1;
@@ -2377,7 +2665,16 @@ between them, return t; otherwise return nil.  */)
 	{
 	  bool comstart_first;
 	  int syntax, other_syntax;
+	  ptrdiff_t n = skip_syntax_run_forward (&run, from, from_byte, stop,
+						 SYNTAX_CODE_BIT (Swhitespace),
+						 SYNTAX_FLAG_COMSTART_FIRST);
 
+	  if (n > 0)
+	    {
+	      from += n;
+	      from_byte += n;
+	      UPDATE_SYNTAX_TABLE_FORWARD (from);
+	    }
 	  if (from == stop)
 	    {
 	      SET_PT_BOTH (from, from_byte);
@@ -2442,7 +2739,13 @@ between them, return t; otherwise return nil.  */)
 	{
 	  bool quoted;
 	  int syntax;
+	  ptrdiff_t n = skip_syntax_run_backward (&run, from, from_byte, stop,
+						  SYNTAX_CODE_BIT (Swhitespace),
+						  SYNTAX_FLAG_COMEND_SECOND,
+						  true);
 
+	  from -= n;
+	  from_byte -= n;
 	  if (from <= stop)
 	    {
 	      SET_PT_BOTH (BEGV, BEGV_BYTE);
@@ -2583,8 +2886,22 @@ scan_lists (EMACS_INT from, EMACS_INT count, EMACS_INT depth, bool sexpflag)
   ptrdiff_t out_bytepos, out_charpos;
   EMACS_INT dummy;
   bool multibyte_symbol_p = sexpflag && multibyte_syntax_as_symbol;
+  struct syntax_run run;
+  /* The characters that the loops below ignore in any case, those
+     that they ignore unless they end a sexp, and those that may be
+     inside strings and symbols.  */
+  int inert = (SYNTAX_CODE_BIT (Swhitespace) | SYNTAX_CODE_BIT (Spunct)
+	       | SYNTAX_CODE_BIT (Squote)
+	       | (sexpflag ? 0 : SYNTAX_CODE_BIT (Smath)));
+  int inert_within = (SYNTAX_CODE_BIT (Sword) | SYNTAX_CODE_BIT (Ssymbol));
+  int in_string = ~ (SYNTAX_CODE_BIT (Sstring) | SYNTAX_CODE_BIT (Sstring_fence)
+		     | SYNTAX_CODE_BIT (Sescape)
+		     | SYNTAX_CODE_BIT (Scharquote));
+  int in_symbol = (SYNTAX_CODE_BIT (Sword) | SYNTAX_CODE_BIT (Ssymbol)
+		   | SYNTAX_CODE_BIT (Squote));
 
   if (depth > 0) min_depth = 0;
+  syntax_run_init (&run);
 
   if (from > ZV) from = ZV;
   if (from < BEGV) from = BEGV;
@@ -2601,7 +2918,21 @@ scan_lists (EMACS_INT from, EMACS_INT count, EMACS_INT depth, bool sexpflag)
 	{
 	  bool comstart_first, prefix;
 	  int syntax, other_syntax;
+	  ptrdiff_t n;
 	  UPDATE_SYNTAX_TABLE_FORWARD (from);
+	  n = skip_syntax_run_forward (&run, from, from_byte, stop,
+				       (inert | SYNTAX_CODE_BIT (Sendcomment)
+					| (depth || !sexpflag
+					   ? inert_within : 0)),
+				       SYNTAX_FLAG_COMSTART_FIRST);
+	  if (n > 0)
+	    {
+	      from += n;
+	      from_byte += n;
+	      if (depth == min_depth)
+		last_good = from - 1;
+	      continue;
+	    }
 	  c = FETCH_CHAR_AS_MULTIBYTE (from_byte);
 	  syntax = SYNTAX_WITH_FLAGS (c);
 	  code = syntax_multibyte (c, multibyte_symbol_p);
@@ -2648,7 +2979,16 @@ scan_lists (EMACS_INT from, EMACS_INT count, EMACS_INT depth, bool sexpflag)
 	      /* This word counts as a sexp; return at end of it.  */
 	      while (from < stop)
 		{
+		  ptrdiff_t n;
 		  UPDATE_SYNTAX_TABLE_FORWARD (from);
+		  n = skip_syntax_run_forward (&run, from, from_byte, stop,
+					       in_symbol, 0);
+		  if (n > 0)
+		    {
+		      from += n;
+		      from_byte += n;
+		      continue;
+		    }
 
 		  c = FETCH_CHAR_AS_MULTIBYTE (from_byte);
 		  switch (syntax_multibyte (c, multibyte_symbol_p))
@@ -2724,9 +3064,18 @@ scan_lists (EMACS_INT from, EMACS_INT count, EMACS_INT depth, bool sexpflag)
 	      while (1)
 		{
 		  enum syntaxcode c_code;
+		  ptrdiff_t n;
 		  if (from >= stop)
 		    goto lose;
 		  UPDATE_SYNTAX_TABLE_FORWARD (from);
+		  n = skip_syntax_run_forward (&run, from, from_byte, stop,
+					       in_string, 0);
+		  if (n > 0)
+		    {
+		      from += n;
+		      from_byte += n;
+		      continue;
+		    }
 		  c = FETCH_CHAR_AS_MULTIBYTE (from_byte);
 		  c_code = syntax_multibyte (c, multibyte_symbol_p);
 		  if (code == Sstring
@@ -2768,6 +3117,23 @@ scan_lists (EMACS_INT from, EMACS_INT count, EMACS_INT depth, bool sexpflag)
       while (from > stop)
 	{
 	  int syntax;
+	  ptrdiff_t n
+	    = skip_syntax_run_backward (&run, from, from_byte, stop,
+					(inert
+					 | (depth || !sexpflag
+					    ? (inert_within
+					       | SYNTAX_CODE_BIT (Sescape)
+					       | SYNTAX_CODE_BIT (Scharquote))
+					    : 0)),
+					SYNTAX_FLAG_COMEND_SECOND, true);
+	  if (n > 0)
+	    {
+	      from -= n;
+	      from_byte -= n;
+	      if (depth == min_depth)
+		last_good = from;
+	      continue;
+	    }
 	  DEC_BOTH (from, from_byte);
 	  UPDATE_SYNTAX_TABLE_BACKWARD (from);
 	  c = FETCH_CHAR_AS_MULTIBYTE (from_byte);
@@ -2892,6 +3258,12 @@ scan_lists (EMACS_INT from, EMACS_INT count, EMACS_INT depth, bool sexpflag)
 	    case Sstring_fence:
 	      while (1)
 		{
+		  ptrdiff_t n
+		    = skip_syntax_run_backward (&run, from, from_byte, stop,
+						~SYNTAX_CODE_BIT (code),
+						0, false);
+		  from -= n;
+		  from_byte -= n;
 		  if (from == stop)
 		    goto lose;
 		  DEC_BOTH (from, from_byte);
@@ -2910,6 +3282,12 @@ scan_lists (EMACS_INT from, EMACS_INT count, EMACS_INT depth, bool sexpflag)
 	      stringterm = FETCH_CHAR_AS_MULTIBYTE (from_byte);
 	      while (1)
 		{
+		  ptrdiff_t n
+		    = skip_syntax_run_backward (&run, from, from_byte, stop,
+						~SYNTAX_CODE_BIT (Sstring),
+						0, false);
+		  from -= n;
+		  from_byte -= n;
 		  if (from == stop)
 		    goto lose;
 		  DEC_BOTH (from, from_byte);
@@ -3400,6 +3778,36 @@ do { prev_from = from;				\
   *stateptr = state;
 }
 
+/* Return the list that `parse-partial-sexp' returns for STATE.  */
+
+static Lisp_Object
+parse_state_list (struct lisp_parse_state *state)
+{
+  return Fcons (make_number (state->depth),
+	   Fcons (state->prevlevelstart < 0
+		  ? Qnil : make_number (state->prevlevelstart),
+	     Fcons (state->thislevelstart < 0
+		    ? Qnil : make_number (state->thislevelstart),
+	       Fcons (state->instring >= 0
+		      ? (state->instring == ST_STRING_STYLE
+			 ? Qt : make_number (state->instring)) : Qnil,
+		 Fcons (state->incomment < 0 ? Qt :
+			(state->incomment == 0 ? Qnil :
+			 make_number (state->incomment)),
+		   Fcons (state->quoted ? Qt : Qnil,
+		     Fcons (make_number (state->mindepth),
+		       Fcons ((state->comstyle
+			       ? (state->comstyle == ST_COMMENT_STYLE
+				  ? Qsyntax_table
+				  : make_number (state->comstyle))
+			       : Qnil),
+			      Fcons (((state->incomment
+				       || (state->instring >= 0))
+				      ? make_number (state->comstr_start)
+				      : Qnil),
+				     Fcons (state->levelstarts, Qnil))))))))));
+}
+
 DEFUN ("parse-partial-sexp", Fparse_partial_sexp, Sparse_partial_sexp, 2, 6, 0,
        doc: /* Parse Lisp syntax starting at FROM until TO; return status of parse at TO.
 Parsing stops at TO or when certain criteria are met;
@@ -3453,31 +3861,494 @@ Sixth arg COMMENTSTOP non-nil means stop at the start of a comment.
 
   SET_PT_BOTH (state.location, state.location_byte);
 
-  return Fcons (make_number (state.depth),
-	   Fcons (state.prevlevelstart < 0
-		  ? Qnil : make_number (state.prevlevelstart),
-	     Fcons (state.thislevelstart < 0
-		    ? Qnil : make_number (state.thislevelstart),
-	       Fcons (state.instring >= 0
-		      ? (state.instring == ST_STRING_STYLE
-			 ? Qt : make_number (state.instring)) : Qnil,
-		 Fcons (state.incomment < 0 ? Qt :
-			(state.incomment == 0 ? Qnil :
-			 make_number (state.incomment)),
-		   Fcons (state.quoted ? Qt : Qnil,
-		     Fcons (make_number (state.mindepth),
-		       Fcons ((state.comstyle
-			       ? (state.comstyle == ST_COMMENT_STYLE
-				  ? Qsyntax_table
-				  : make_number (state.comstyle))
-			       : Qnil),
-			      Fcons (((state.incomment
-				       || (state.instring >= 0))
-				      ? make_number (state.comstr_start)
-				      : Qnil),
-				     Fcons (state.levelstarts, Qnil))))))))));
+  return parse_state_list (&state);
 }
 
+/* Make room at the end of PTS for a checkpoint and NLEVELS enclosing
+   parens, and return the checkpoint.  */
+
+static struct ppss_checkpoint *
+ppss_push (struct ppss_points *pts, ptrdiff_t nlevels)
+{
+  struct ppss_checkpoint *p;
+
+  if (pts->npoints == pts->points_size)
+    pts->points = xpalloc (pts->points, &pts->points_size, 1, -1,
+			   sizeof *pts->points);
+  if (pts->levels_size - pts->nlevels < nlevels)
+    pts->levels = xpalloc (pts->levels, &pts->levels_size,
+			   nlevels - (pts->levels_size - pts->nlevels), -1,
+			   sizeof *pts->levels);
+  p = &pts->points[pts->npoints++];
+  p->levels = pts->nlevels;
+  p->nlevels = nlevels;
+  pts->nlevels += nlevels;
+  return p;
+}
+
+/* Append to DST the checkpoints of SRC from the index FROM to TO.  */
+
+static void
+ppss_copy (struct ppss_points *dst, struct ppss_points *src,
+	   ptrdiff_t from, ptrdiff_t to)
+{
+  for (; from < to; from++)
+    {
+      struct ppss_checkpoint *q = &src->points[from];
+      struct ppss_checkpoint *p = ppss_push (dst, q->nlevels);
+      ptrdiff_t levels = p->levels;
+
+      *p = *q;
+      p->levels = levels;
+      memcpy (dst->levels + levels, src->levels + q->levels,
+	      q->nlevels * sizeof *dst->levels);
+    }
+}
+
+/* Keep only the first N checkpoints of PTS.  */
+
+static void
+ppss_truncate (struct ppss_points *pts, ptrdiff_t n)
+{
+  if (n < pts->npoints)
+    {
+      pts->nlevels = pts->points[n].levels;
+      pts->npoints = n;
+    }
+}
+
+static void
+ppss_free_points (struct ppss_points *pts)
+{
+  xfree (pts->points);
+  xfree (pts->levels);
+  memset (pts, 0, sizeof *pts);
+}
+
+/* Return the index in PTS of the last checkpoint at or before POS,
+   looking from the index FROM on, or FROM - 1 if there is none.  */
+
+static ptrdiff_t
+ppss_checkpoint_before (struct ppss_points *pts, ptrdiff_t from,
+			ptrdiff_t pos)
+{
+  ptrdiff_t lo = from, hi = pts->npoints;
+
+  while (lo < hi)
+    {
+      ptrdiff_t mid = lo + (hi - lo) / 2;
+      if (pts->points[mid].charpos <= pos)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  return lo - 1;
+}
+
+/* Move the stale checkpoints of CACHE, which belongs to buffer B, to
+   where the text after them now is.  */
+
+static void
+ppss_update_stale (struct ppss_cache *cache, struct buffer *b)
+{
+  ptrdiff_t delta = BUF_Z (b) - cache->stale_z;
+  ptrdiff_t delta_byte = BUF_Z_BYTE (b) - cache->stale_z_byte;
+  ptrdiff_t k;
+
+  if (cache->first_stale == cache->stale.npoints)
+    {
+      ppss_truncate (&cache->stale, 0);
+      cache->first_stale = 0;
+    }
+  else if (delta || delta_byte)
+    {
+      for (k = cache->first_stale; k < cache->stale.npoints; k++)
+	{
+	  struct ppss_checkpoint *p = &cache->stale.points[k];
+	  p->charpos += delta;
+	  p->bytepos += delta_byte;
+	  if (p->comstr_start >= cache->stale_end)
+	    p->comstr_start += delta;
+	}
+      for (k = cache->stale.points[cache->first_stale].levels;
+	   k < cache->stale.nlevels; k++)
+	if (cache->stale.levels[k] >= cache->stale_end)
+	  cache->stale.levels[k] += delta;
+      cache->stale_end += delta;
+    }
+  cache->stale_z = BUF_Z (b);
+  cache->stale_z_byte = BUF_Z_BYTE (b);
+}
+
+/* Return the checkpoints of `syntax-ppss' for the current buffer,
+   after dropping them if they are out of date.  If there are none
+   yet, create them if CREATE, else return NULL.  */
+
+static struct ppss_cache *
+current_ppss_cache (bool create)
+{
+  struct buffer *b = (current_buffer->base_buffer
+		      ? current_buffer->base_buffer : current_buffer);
+  struct ppss_cache *cache = b->ppss_cache;
+  Lisp_Object table = BVAR (current_buffer, syntax_table);
+
+  if (!cache)
+    {
+      if (!create)
+	return NULL;
+      cache = b->ppss_cache = xzalloc (sizeof *cache);
+      cache->syntax_table = Qnil;
+    }
+  if (! EQ (cache->syntax_table, table)
+      || cache->syntax_modiff != syntax_modiff
+      || cache->lookup_properties != parse_sexp_lookup_properties
+      || cache->begv != BEGV)
+    {
+      ppss_truncate (&cache->valid, 0);
+      ppss_truncate (&cache->stale, 0);
+      cache->first_stale = 0;
+      cache->syntax_table = table;
+      cache->syntax_modiff = syntax_modiff;
+      cache->lookup_properties = parse_sexp_lookup_properties;
+      cache->begv = BEGV;
+    }
+  ppss_update_stale (cache, b);
+  return cache;
+}
+
+/* Return the parse state at the valid checkpoint I of CACHE, as a
+   list like the one `parse-partial-sexp' returns.  */
+
+static Lisp_Object
+ppss_checkpoint_state (struct ppss_cache *cache, ptrdiff_t i)
+{
+  struct ppss_checkpoint *p = &cache->valid.points[i];
+  ptrdiff_t *levels = cache->valid.levels + p->levels;
+  struct lisp_parse_state state;
+  ptrdiff_t j;
+
+  state.depth = state.mindepth = p->depth;
+  state.instring = p->instring;
+  state.incomment = p->incomment;
+  state.comstyle = p->comstyle;
+  state.quoted = p->quoted;
+  state.comstr_start = p->comstr_start;
+  state.thislevelstart = -1;
+  state.prevlevelstart = p->nlevels ? levels[p->nlevels - 1] : -1;
+  state.location = p->charpos;
+  state.location_byte = p->bytepos;
+  state.levelstarts = Qnil;
+  for (j = p->nlevels; j > 0; j--)
+    state.levelstarts = Fcons (make_number (levels[j - 1]),
+			       state.levelstarts);
+  return parse_state_list (&state);
+}
+
+/* Return true if the checkpoint P, with its enclosing parens at
+   LEVELS, has the parse state STATE.  */
+
+static bool
+ppss_same_state (struct ppss_checkpoint *p, ptrdiff_t *levels,
+		 struct lisp_parse_state *state)
+{
+  Lisp_Object tail;
+  ptrdiff_t j;
+
+  if (! (p->depth == state->depth
+	 && p->instring == state->instring
+	 && p->incomment == state->incomment
+	 && p->comstyle == state->comstyle
+	 && p->quoted == state->quoted
+	 && p->comstr_start == ((state->incomment || state->instring >= 0)
+				? state->comstr_start : -1)))
+    return false;
+  for (j = 0, tail = state->levelstarts; CONSP (tail);
+       j++, tail = XCDR (tail))
+    if (j == p->nlevels || levels[j] != XINT (XCAR (tail)))
+      return false;
+  return j == p->nlevels;
+}
+
+/* Append a valid checkpoint for STATE to CACHE.  */
+
+static void
+ppss_add_checkpoint (struct ppss_cache *cache, struct lisp_parse_state *state)
+{
+  struct ppss_checkpoint *p;
+  ptrdiff_t *levels;
+  Lisp_Object tail;
+
+  p = ppss_push (&cache->valid, XFASTINT (Flength (state->levelstarts)));
+  p->charpos = state->location;
+  p->bytepos = state->location_byte;
+  p->depth = state->depth;
+  p->incomment = state->incomment;
+  p->instring = state->instring;
+  p->comstyle = state->comstyle;
+  p->quoted = state->quoted;
+  p->comstr_start = ((state->incomment || state->instring >= 0)
+		     ? state->comstr_start : -1);
+  p->chain = true;
+  levels = cache->valid.levels + p->levels;
+  for (tail = state->levelstarts; CONSP (tail); tail = XCDR (tail))
+    *levels++ = XINT (XCAR (tail));
+}
+
+/* Return the first position from POS on where a scan can resume and
+   get the same results as one that went through it, or LIMIT if
+   there is none before LIMIT.  The scanner resumes in the middle of a
+   two-character comment delimiter or after an escape only as far as
+   the parse state says, so stay clear of those.  */
+
+static ptrdiff_t
+ppss_resumable_pos (ptrdiff_t pos, ptrdiff_t limit)
+{
+  ptrdiff_t prev_byte;
+
+  if (pos >= limit)
+    return limit;
+  prev_byte = CHAR_TO_BYTE (pos - 1);
+  SETUP_SYNTAX_TABLE (pos - 1, 1);
+  for (; pos < limit; pos++)
+    {
+      int c = FETCH_CHAR_AS_MULTIBYTE (prev_byte);
+      int syntax = SYNTAX_WITH_FLAGS (c);
+
+      if (! (SYNTAX_FLAGS_COMSTART_FIRST (syntax)
+	     || SYNTAX_FLAGS_COMEND_FIRST (syntax)
+	     || (syntax & 0xff) == Sescape
+	     || (syntax & 0xff) == Scharquote))
+	break;
+      INC_POS (prev_byte);
+      UPDATE_SYNTAX_TABLE_FORWARD (pos);
+    }
+  return pos;
+}
+
+/* Note that the text of buffer B between START and END is about to
+   change: make the checkpoints after START stale, and drop those that
+   are not after END, since the text after them changes too.  B must
+   not be an indirect buffer.  */
+
+void
+invalidate_ppss_cache (struct buffer *b, ptrdiff_t start, ptrdiff_t end)
+{
+  struct ppss_cache *cache = b->ppss_cache;
+  ptrdiff_t i, j, k;
+
+  if (!cache)
+    return;
+  ppss_update_stale (cache, b);
+  i = ppss_checkpoint_before (&cache->valid, 0, start) + 1;
+  j = ppss_checkpoint_before (&cache->valid, i, end) + 1;
+  k = ppss_checkpoint_before (&cache->stale, cache->first_stale, end) + 1;
+  if (j < cache->valid.npoints)
+    {
+      struct ppss_points stale;
+
+      memset (&stale, 0, sizeof stale);
+      ppss_copy (&stale, &cache->valid, j, cache->valid.npoints);
+      if (k < cache->stale.npoints)
+	{
+	  /* Those were computed before the text before them changed.  */
+	  cache->stale.points[k].chain = false;
+	  ppss_copy (&stale, &cache->stale, k, cache->stale.npoints);
+	}
+      ppss_free_points (&cache->stale);
+      cache->stale = stale;
+      cache->first_stale = 0;
+    }
+  else
+    cache->first_stale = k;
+  ppss_truncate (&cache->valid, i);
+  cache->stale_end = end;
+}
+
+/* Drop the checkpoints of `syntax-ppss' in buffer B that are after
+   START, and the stale ones.  B must not be an indirect buffer.  */
+
+void
+flush_ppss_cache (struct buffer *b, ptrdiff_t start)
+{
+  struct ppss_cache *cache = b->ppss_cache;
+
+  if (cache)
+    {
+      ppss_truncate (&cache->valid,
+		     ppss_checkpoint_before (&cache->valid, 0, start) + 1);
+      ppss_truncate (&cache->stale, 0);
+      cache->first_stale = 0;
+    }
+}
+
+/* Free the checkpoints of `syntax-ppss' in buffer B.  */
+
+void
+free_ppss_cache (struct buffer *b)
+{
+  struct ppss_cache *cache = b->ppss_cache;
+
+  if (cache)
+    {
+      ppss_free_points (&cache->valid);
+      ppss_free_points (&cache->stale);
+      xfree (cache);
+      b->ppss_cache = NULL;
+    }
+}
+
+/* Mark the Lisp objects that the checkpoints of buffer B refer to.
+   This is called from garbage collection.  */
+
+void
+mark_ppss_cache (struct buffer *b)
+{
+  if (b->ppss_cache)
+    mark_object (b->ppss_cache->syntax_table);
+}
+
+DEFUN ("syntax-ppss-checkpoint", Fsyntax_ppss_checkpoint,
+       Ssyntax_ppss_checkpoint, 1, 1, 0,
+       doc: /* Return the last checkpoint of `syntax-ppss' at or before POS.
+The value is a cons (CPOS . STATE), where STATE is the state that
+`parse-partial-sexp' reaches at CPOS when it starts at `point-min',
+or nil if there is no such checkpoint.  Elements 2 and 6 of STATE are
+not meaningful.  */)
+  (Lisp_Object pos)
+{
+  struct ppss_cache *cache;
+  ptrdiff_t i;
+
+  CHECK_NUMBER_COERCE_MARKER (pos);
+  cache = current_ppss_cache (false);
+  if (!cache)
+    return Qnil;
+  i = ppss_checkpoint_before (&cache->valid, 0, XINT (pos));
+  if (i < 0)
+    return Qnil;
+  return Fcons (make_number (cache->valid.points[i].charpos),
+		ppss_checkpoint_state (cache, i));
+}
+
+DEFUN ("syntax-ppss-scan", Fsyntax_ppss_scan, Ssyntax_ppss_scan, 1, 1, 0,
+       doc: /* Return the state of `parse-partial-sexp' from `point-min' to POS.
+Scan only from the last checkpoint of `syntax-ppss' before POS, and
+when POS is after the last checkpoint, add checkpoints along the way
+so that later calls need not scan that text again.  Point is set to
+POS.  Elements 2 and 6 of the value are not meaningful.  */)
+  (Lisp_Object pos)
+{
+  struct lisp_parse_state state;
+  struct ppss_cache *cache;
+  ptrdiff_t i, from, from_byte, to;
+  Lisp_Object oldstate;
+
+  CHECK_NUMBER_COERCE_MARKER (pos);
+  if (! (BEGV <= XINT (pos) && XINT (pos) <= ZV))
+    args_out_of_range (pos, Fcurrent_buffer ());
+  to = XINT (pos);
+  cache = current_ppss_cache (true);
+
+ retry:
+  i = ppss_checkpoint_before (&cache->valid, 0, to);
+  if (i < 0)
+    {
+      from = BEGV;
+      from_byte = BEGV_BYTE;
+      oldstate = Qnil;
+    }
+  else
+    {
+      from = cache->valid.points[i].charpos;
+      from_byte = cache->valid.points[i].bytepos;
+      oldstate = ppss_checkpoint_state (cache, i);
+    }
+
+  /* Past the last checkpoint, scan in steps and record where each one
+     ends.  Stop at each stale checkpoint on the way, to see whether it
+     and those computed from it are right after all.  */
+  if (i == cache->valid.npoints - 1)
+    while (from < to)
+      {
+	ptrdiff_t next = ppss_resumable_pos (from + PPSS_CHECKPOINT_INTERVAL,
+					     to);
+	struct ppss_checkpoint *stale = NULL;
+
+	while (cache->first_stale < cache->stale.npoints
+	       && cache->stale.points[cache->first_stale].charpos <= from)
+	  cache->first_stale++;
+	if (cache->first_stale < cache->stale.npoints
+	    && cache->stale.points[cache->first_stale].charpos <= next)
+	  {
+	    stale = &cache->stale.points[cache->first_stale];
+	    next = stale->charpos;
+	  }
+	else if (next == to)
+	  break;
+
+	scan_sexps_forward (&state, from, from_byte, next,
+			    TYPE_MINIMUM (EMACS_INT), 0, oldstate, 0);
+	from = state.location;
+	from_byte = state.location_byte;
+	oldstate = parse_state_list (&state);
+	if (stale)
+	  {
+	    if (ppss_same_state (stale, cache->stale.levels + stale->levels,
+				 &state))
+	      {
+		ptrdiff_t k = cache->first_stale + 1;
+		while (k < cache->stale.npoints && cache->stale.points[k].chain)
+		  k++;
+		ppss_copy (&cache->valid, &cache->stale, cache->first_stale, k);
+		cache->first_stale = k;
+		goto retry;
+	      }
+	    cache->first_stale++;
+	  }
+	ppss_add_checkpoint (cache, &state);
+      }
+
+  scan_sexps_forward (&state, from, from_byte, to,
+		      TYPE_MINIMUM (EMACS_INT), 0, oldstate, 0);
+  SET_PT_BOTH (state.location, state.location_byte);
+  return parse_state_list (&state);
+}
+
+DEFUN ("syntax-ppss-flush-checkpoints", Fsyntax_ppss_flush_checkpoints,
+       Ssyntax_ppss_flush_checkpoints, 0, 2, 0,
+       doc: /* Forget the checkpoints of `syntax-ppss' after BEG.
+If BEG is nil, forget all of them.  If END is non-nil, only the text
+between BEG and END has changed, so the checkpoints after END may
+still be right, and are checked again when a scan reaches them.
+
+Changes to the buffer text take care of the checkpoints by themselves;
+this is needed only when something else that the parse depends on
+changes, such as `syntax-table' properties set while modification
+hooks are inhibited.  */)
+  (Lisp_Object beg, Lisp_Object end)
+{
+  struct buffer *b = (current_buffer->base_buffer
+		      ? current_buffer->base_buffer : current_buffer);
+
+  if (NILP (beg))
+    free_ppss_cache (b);
+  else if (NILP (end))
+    {
+      CHECK_NUMBER_COERCE_MARKER (beg);
+      flush_ppss_cache (b, XINT (beg));
+    }
+  else
+    {
+      CHECK_NUMBER_COERCE_MARKER (beg);
+      CHECK_NUMBER_COERCE_MARKER (end);
+      if (XINT (end) < XINT (beg))
+	invalidate_ppss_cache (b, XINT (end), XINT (beg));
+      else
+	invalidate_ppss_cache (b, XINT (beg), XINT (end));
+    }
+  return Qnil;
+}
+
 void
 init_syntax_once (void)
 {
@@ -3651,4 +4522,7 @@ In both cases, LIMIT bounds the search. */);
   defsubr (&Sscan_sexps);
   defsubr (&Sbackward_prefix_chars);
   defsubr (&Sparse_partial_sexp);
+  defsubr (&Ssyntax_ppss_checkpoint);
+  defsubr (&Ssyntax_ppss_scan);
+  defsubr (&Ssyntax_ppss_flush_checkpoints);
 }
@@ -1364,6 +1364,179 @@ into it.  */)
   return Qnil;
 }
 
+/* Return the interval of OBJECT that contains position POS.  I, if
+   not null, is an interval of OBJECT that was found earlier; POS is
+   most often in it or in the next one, which saves a search from the
+   root of the tree.  */
+
+static INTERVAL
+find_run_interval (Lisp_Object object, INTERVAL i, ptrdiff_t pos)
+{
+  if (i && i->position <= pos)
+    {
+      if (pos < i->position + LENGTH (i))
+	return i;
+      i = next_interval (i);
+      if (i && pos < i->position + LENGTH (i))
+	return i;
+    }
+  return find_interval (STRINGP (object)
+			? string_intervals (object)
+			: buffer_intervals (XBUFFER (object)),
+			pos);
+}
+
+/* Add the properties of PLIST to the LEN characters of OBJECT from
+   position S, which is in interval I, splitting the intervals at
+   either end if need be.  Return the interval that contains the last
+   of the characters.  */
+
+static INTERVAL
+add_properties_to_run (INTERVAL i, ptrdiff_t s, ptrdiff_t len,
+		       Lisp_Object plist, Lisp_Object object)
+{
+  while (1)
+    {
+      ptrdiff_t here = LENGTH (i) - (s - i->position);
+
+      if (! interval_has_all_properties (plist, i))
+	{
+	  INTERVAL unchanged;
+
+	  if (i->position != s)
+	    {
+	      unchanged = i;
+	      i = split_interval_right (unchanged, s - unchanged->position);
+	      copy_properties (unchanged, i);
+	    }
+	  if (here > len)
+	    {
+	      unchanged = i;
+	      i = split_interval_left (unchanged, len);
+	      copy_properties (unchanged, i);
+	      here = len;
+	    }
+	  add_properties (plist, i, object, TEXT_PROPERTY_REPLACE);
+	}
+
+      if (here >= len)
+	return i;
+      s += here;
+      len -= here;
+      i = next_interval (i);
+    }
+}
+
+/* Store in *START and *END the bounds of RUN, an element of the list
+   given to add-text-property-runs, and return its property list.  */
+
+static Lisp_Object
+decode_property_run (Lisp_Object run, Lisp_Object *start, Lisp_Object *end)
+{
+  *start = Fcar (run);
+  *end = Fcar (Fcdr (run));
+  CHECK_NUMBER_COERCE_MARKER (*start);
+  CHECK_NUMBER_COERCE_MARKER (*end);
+  return validate_plist (Fcar (Fcdr (Fcdr (run))));
+}
+
+/* Callers note, this can GC when OBJECT is a buffer (or nil).  */
+
+DEFUN ("add-text-property-runs", Fadd_text_property_runs,
+       Sadd_text_property_runs, 1, 2, 0,
+       doc: /* Add properties to each of the runs of text in RUNS.
+RUNS is a list of elements (START END PROPERTIES), each of which says
+to add the properties of the property list PROPERTIES to the text from
+START to END, as `add-text-properties' would.  The runs must be sorted
+by position and must not overlap.
+
+This is faster than calling `add-text-properties' for each run, since
+it goes through the text properties once for all the runs, and it runs
+the modification hooks only once, for the text from the start of the
+first run to the end of the last.
+
+If the optional second argument OBJECT is a buffer (or nil, which
+means the current buffer), START and END are buffer positions
+\(integers or markers).  If OBJECT is a string, START and END are
+0-based indices into it.
+Return t if any property value actually changed, nil otherwise.  */)
+  (Lisp_Object runs, Lisp_Object object)
+{
+  Lisp_Object tail, start, end, plist, first = Qnil, last = Qnil;
+  INTERVAL i;
+  struct gcpro gcpro1, gcpro2;
+
+  if (NILP (object))
+    XSETBUFFER (object, current_buffer);
+
+  /* Check the runs, and find the text they cover.  */
+  for (tail = runs; CONSP (tail); tail = XCDR (tail))
+    {
+      decode_property_run (XCAR (tail), &start, &end);
+      if (XINT (start) > XINT (end)
+	  || (!NILP (last) && XINT (start) < XINT (last)))
+	error ("Text property runs are not sorted or overlap");
+      if (NILP (first))
+	first = start;
+      last = end;
+    }
+  if (!NILP (tail))
+    wrong_type_argument (Qlistp, runs);
+
+  if (NILP (first))
+    return Qnil;
+  i = validate_interval_range (object, &first, &last, hard);
+  if (!i)
+    return Qnil;
+
+  /* Return now if the text already has all the properties.  */
+  for (tail = runs; CONSP (tail); tail = XCDR (tail))
+    {
+      plist = decode_property_run (XCAR (tail), &start, &end);
+      if (XINT (start) == XINT (end) || NILP (plist))
+	continue;
+      for (i = find_run_interval (object, i, XINT (start));
+	   interval_has_all_properties (plist, i);
+	   i = next_interval (i))
+	if (i->position + LENGTH (i) >= XINT (end))
+	  break;
+      if (! interval_has_all_properties (plist, i))
+	break;
+    }
+  if (NILP (tail))
+    return Qnil;
+
+  GCPRO2 (runs, object);
+
+  if (BUFFERP (object))
+    {
+      modify_text_properties (object, first, last);
+      /* The modification hooks may have changed the intervals, or
+	 even the text.  */
+      validate_interval_range (object, &first, &last, hard);
+    }
+
+  i = NULL;
+  for (tail = runs; CONSP (tail); tail = XCDR (tail))
+    {
+      plist = decode_property_run (XCAR (tail), &start, &end);
+      if (XINT (start) < XINT (end) && !NILP (plist))
+	{
+	  i = find_run_interval (object, i, XINT (start));
+	  i = add_properties_to_run (i, XINT (start),
+				     XINT (end) - XINT (start),
+				     plist, object);
+	}
+    }
+
+  if (BUFFERP (object))
+    signal_after_change (XINT (first), XINT (last) - XINT (first),
+			 XINT (last) - XINT (first));
+
+  UNGCPRO;
+  return Qt;
+}
+
 /* Replace properties of text from START to END with new list of
    properties PROPERTIES.  OBJECT is the buffer or string containing
    the text.  OBJECT nil means use the current buffer.
@@ -2411,6 +2584,7 @@ inherits it if NONSTICKINESS is nil.  The `front-sticky' and
   defsubr (&Sprevious_property_change);
   defsubr (&Sprevious_single_property_change);
   defsubr (&Sadd_text_properties);
+  defsubr (&Sadd_text_property_runs);
   defsubr (&Sput_text_property);
   defsubr (&Sset_text_properties);
   defsubr (&Sadd_face_text_property);
@@ -25,6 +25,248 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "buffer.h"
 #include "commands.h"
 #include "window.h"
+#include "intervals.h"
+
+/* Changes are recorded for undo in the undo journal of the buffer,
+   in a compact form that takes no Lisp objects for an insertion or
+   for the deletion of text without properties, and they are turned
+   into elements of `buffer-undo-list' only when something looks at
+   that list; see buffer_undo_list.  Each record of the journal stands
+   for one element of the list, the oldest first, and the records
+   that need Lisp objects, or the text of a deletion, take them in
+   turn from the arrays of objects and of text.  */
+
+static Lisp_Object Qmove_overlay;
+
+enum undo_record_type
+{
+  /* nil: an undo boundary.  */
+  UNDO_BOUNDARY,
+  /* POSITION: the position of point, in BEG.  */
+  UNDO_POINT,
+  /* (BEG . END): an insertion.  */
+  UNDO_INSERT,
+  /* (TEXT . POSITION): the deletion of text without properties, with
+     POSITION in BEG and the number of bytes of TEXT in END.  */
+  UNDO_TEXT,
+  /* (TEXT . POSITION): the deletion of the string TEXT, an object,
+     with POSITION in BEG.  */
+  UNDO_STRING,
+  /* (MARKER . ADJUSTMENT): MARKER is an object, ADJUSTMENT is in BEG.  */
+  UNDO_MARKER,
+  /* (t . TIME-FLAG): TIME-FLAG is an object.  */
+  UNDO_FIRST_CHANGE,
+  /* (nil PROPERTY VALUE BEG . END): PROPERTY and VALUE are objects.  */
+  UNDO_PROPERTY,
+  /* (apply move-overlay OVERLAY BEG END): OVERLAY is an object.  */
+  UNDO_OVERLAY
+};
+
+struct undo_record
+{
+  ENUM_BF (undo_record_type) type : 4;
+
+  /* For UNDO_TEXT, whether the text is multibyte.  */
+  bool_bf multibyte : 1;
+
+  ptrdiff_t beg, end;
+};
+
+struct undo_journal
+{
+  struct undo_record *records;
+  ptrdiff_t nrecords, records_size;
+
+  Lisp_Object *objects;
+  ptrdiff_t nobjects, objects_size;
+
+  unsigned char *text;
+  ptrdiff_t text_bytes, text_size;
+};
+
+/* Return the number of Lisp objects that a record of type TYPE takes.  */
+
+static int
+undo_record_objects (enum undo_record_type type)
+{
+  switch (type)
+    {
+    case UNDO_STRING:
+    case UNDO_MARKER:
+    case UNDO_FIRST_CHANGE:
+    case UNDO_OVERLAY:
+      return 1;
+    case UNDO_PROPERTY:
+      return 2;
+    default:
+      return 0;
+    }
+}
+
+/* Return the last record in the undo journal of the current buffer,
+   or NULL if the journal is empty.  */
+
+static struct undo_record *
+last_undo_record (void)
+{
+  struct undo_journal *j = current_buffer->undo_journal;
+  return j ? &j->records[j->nrecords - 1] : NULL;
+}
+
+/* Add a record of type TYPE with BEG and END to the undo journal of
+   the current buffer, followed by the Lisp objects OBJ1 and OBJ2 it
+   takes, and NBYTES bytes of text, which the caller must store at the
+   returned address.  */
+
+static unsigned char *
+add_undo_record (enum undo_record_type type, ptrdiff_t beg, ptrdiff_t end,
+		 Lisp_Object obj1, Lisp_Object obj2, ptrdiff_t nbytes)
+{
+  struct undo_journal *j = current_buffer->undo_journal;
+  struct undo_record *r;
+  int nobjects = undo_record_objects (type);
+  unsigned char *text;
+
+  if (!j)
+    j = current_buffer->undo_journal = xzalloc (sizeof *j);
+
+  if (j->nrecords == j->records_size)
+    j->records = xpalloc (j->records, &j->records_size, 1, -1,
+			  sizeof *j->records);
+  if (j->objects_size - j->nobjects < nobjects)
+    j->objects = xpalloc (j->objects, &j->objects_size,
+			  nobjects - (j->objects_size - j->nobjects), -1,
+			  sizeof *j->objects);
+  if (j->text_size - j->text_bytes < nbytes)
+    j->text = xpalloc (j->text, &j->text_size,
+		       nbytes - (j->text_size - j->text_bytes), -1, 1);
+
+  r = &j->records[j->nrecords++];
+  r->type = type;
+  r->multibyte = 0;
+  r->beg = beg;
+  r->end = end;
+  if (nobjects > 0)
+    j->objects[j->nobjects++] = obj1;
+  if (nobjects > 1)
+    j->objects[j->nobjects++] = obj2;
+  text = j->text + j->text_bytes;
+  j->text_bytes += nbytes;
+  return text;
+}
+
+/* Free the undo journal of buffer B, discarding its changes.  */
+
+void
+free_undo_journal (struct buffer *b)
+{
+  struct undo_journal *j = b->undo_journal;
+
+  b->undo_journal = NULL;
+  xfree (j->records);
+  xfree (j->objects);
+  xfree (j->text);
+  xfree (j);
+}
+
+/* Put the changes in the undo journal of buffer B in front of its
+   undo list, empty the journal, and return the list.  */
+
+Lisp_Object
+flush_undo_journal (struct buffer *b)
+{
+  struct undo_journal *j = b->undo_journal;
+  Lisp_Object list = BVAR (b, undo_list), elt, *obj = j->objects;
+  unsigned char *text = j->text;
+  ptrdiff_t i, nchars;
+
+  for (i = 0; i < j->nrecords; i++)
+    {
+      struct undo_record *r = &j->records[i];
+
+      switch (r->type)
+	{
+	case UNDO_BOUNDARY:
+	  elt = Qnil;
+	  break;
+	case UNDO_POINT:
+	  elt = make_number (r->beg);
+	  break;
+	case UNDO_INSERT:
+	  elt = Fcons (make_number (r->beg), make_number (r->end));
+	  break;
+	case UNDO_TEXT:
+	  nchars = (r->multibyte ? multibyte_chars_in_text (text, r->end)
+		    : r->end);
+	  elt = Fcons (make_specified_string ((char *) text, nchars, r->end,
+					      r->multibyte),
+		       make_number (r->beg));
+	  text += r->end;
+	  break;
+	case UNDO_STRING:
+	case UNDO_MARKER:
+	  elt = Fcons (*obj++, make_number (r->beg));
+	  break;
+	case UNDO_FIRST_CHANGE:
+	  elt = Fcons (Qt, *obj++);
+	  break;
+	case UNDO_PROPERTY:
+	  elt = Fcons (Qnil, Fcons (obj[0], Fcons (obj[1],
+						   Fcons (make_number (r->beg),
+							  make_number (r->end)))));
+	  obj += 2;
+	  break;
+	case UNDO_OVERLAY:
+	  elt = list5 (Qapply, Qmove_overlay, *obj++,
+		       make_number (r->beg), make_number (r->end));
+	  break;
+	default:
+	  emacs_abort ();
+	}
+      list = Fcons (elt, list);
+    }
+
+  free_undo_journal (b);
+  bset_undo_list (b, list);
+  return list;
+}
+
+/* Remove the records of unmarked markers from the undo journal of
+   buffer B, like compact_undo_list in alloc.c does for the list, and
+   mark the Lisp objects of the other records.  */
+
+void
+mark_undo_journal (struct buffer *b)
+{
+  struct undo_journal *j = b->undo_journal;
+  ptrdiff_t i, n = 0, from = 0, to = 0;
+
+  if (!j)
+    return;
+
+  for (i = 0; i < j->nrecords; i++)
+    {
+      struct undo_record *r = &j->records[i];
+      int k = undo_record_objects (r->type);
+
+      if (r->type == UNDO_MARKER && !XMARKER (j->objects[from])->gcmarkbit)
+	from += k;
+      else
+	{
+	  j->records[n++] = *r;
+	  while (k-- > 0)
+	    j->objects[to++] = j->objects[from++];
+	}
+    }
+  j->nrecords = n;
+  j->nobjects = to;
+
+  if (n == 0)
+    free_undo_journal (b);
+  else
+    for (i = 0; i < to; i++)
+      mark_object (j->objects[i]);
+}
 
 /* Last buffer for which undo information was recorded.  */
 /* BEWARE: This is not traced by the GC, so never dereference it!  */
@@ -47,6 +289,19 @@ Lisp_Object Qapply;
    an undo-boundary.  */
 static Lisp_Object pending_boundary;
 
+/* Return true if ELT is an element of an undo list that records the
+   adjustment of a marker or of an overlay.  */
+
+static bool
+adjustment_element_p (Lisp_Object elt)
+{
+  return (CONSP (elt)
+	  && (MARKERP (XCAR (elt))
+	      || (EQ (XCAR (elt), Qapply)
+		  && CONSP (XCDR (elt))
+		  && EQ (XCAR (XCDR (elt)), Qmove_overlay))));
+}
+
 /* Record point as it was at beginning of this command (if necessary)
    and prepare the undo info for recording a change.
    PT is the position of point that will naturally occur as a result of the
@@ -56,6 +311,8 @@ static void
 record_point (ptrdiff_t pt)
 {
   bool at_boundary;
+  struct undo_journal *j;
+  ptrdiff_t i;
 
   /* Don't record position of pt when undo_inhibit_record_point holds.  */
   if (undo_inhibit_record_point)
@@ -75,11 +332,18 @@ record_point (ptrdiff_t pt)
     Fundo_boundary ();
   last_undo_buffer = current_buffer;
 
-  if (CONSP (BVAR (current_buffer, undo_list)))
+  /* Set AT_BOUNDARY only when we have nothing other than
+     marker and overlay adjustments before undo boundary.  */
+  j = current_buffer->undo_journal;
+  for (i = j ? j->nrecords : 0; i > 0; i--)
+    if (j->records[i - 1].type != UNDO_MARKER
+	&& j->records[i - 1].type != UNDO_OVERLAY)
+      break;
+
+  if (i > 0)
+    at_boundary = j->records[i - 1].type == UNDO_BOUNDARY;
+  else if (CONSP (BVAR (current_buffer, undo_list)))
     {
-      /* Set AT_BOUNDARY only when we have nothing other than
-         marker adjustment before undo boundary.  */
-
       Lisp_Object tail = BVAR (current_buffer, undo_list), elt;
 
       while (1)
@@ -88,7 +352,7 @@ record_point (ptrdiff_t pt)
 	    elt = Qnil;
 	  else
 	    elt = XCAR (tail);
-	  if (NILP (elt) || ! (CONSP (elt) && MARKERP (XCAR (elt))))
+	  if (NILP (elt) || ! adjustment_element_p (elt))
 	    break;
 	  tail = XCDR (tail);
 	}
@@ -105,9 +369,7 @@ record_point (ptrdiff_t pt)
   if (at_boundary
       && current_buffer == last_boundary_buffer
       && last_boundary_position != pt)
-    bset_undo_list (current_buffer,
-		    Fcons (make_number (last_boundary_position),
-			   BVAR (current_buffer, undo_list)));
+    add_undo_record (UNDO_POINT, last_boundary_position, 0, Qnil, Qnil, 0);
 }
 
 /* Record an insertion that just happened or is about to happen,
@@ -118,7 +380,7 @@ record_point (ptrdiff_t pt)
 void
 record_insert (ptrdiff_t beg, ptrdiff_t length)
 {
-  Lisp_Object lbeg, lend;
+  struct undo_record *last;
 
   if (EQ (BVAR (current_buffer, undo_list), Qt))
     return;
@@ -127,7 +389,16 @@ record_insert (ptrdiff_t beg, ptrdiff_t length)
 
   /* If this is following another insertion and consecutive with it
      in the buffer, combine the two.  */
-  if (CONSP (BVAR (current_buffer, undo_list)))
+  last = last_undo_record ();
+  if (last)
+    {
+      if (last->type == UNDO_INSERT && last->end == beg)
+	{
+	  last->end = beg + length;
+	  return;
+	}
+    }
+  else if (CONSP (BVAR (current_buffer, undo_list)))
     {
       Lisp_Object elt;
       elt = XCAR (BVAR (current_buffer, undo_list));
@@ -141,10 +412,26 @@ record_insert (ptrdiff_t beg, ptrdiff_t length)
 	}
     }
 
-  XSETFASTINT (lbeg, beg);
-  XSETINT (lend, beg + length);
-  bset_undo_list (current_buffer,
-		  Fcons (Fcons (lbeg, lend), BVAR (current_buffer, undo_list)));
+  add_undo_record (UNDO_INSERT, beg, beg + length, Qnil, Qnil, 0);
+}
+
+/* Record point for the deletion of LENGTH characters at BEG that is
+   about to take place, and return the position to record with the
+   deleted text: -BEG if point is at the end of the text, else BEG.  */
+
+static ptrdiff_t
+record_point_for_delete (ptrdiff_t beg, ptrdiff_t length)
+{
+  if (PT == beg + length)
+    {
+      record_point (PT);
+      return -beg;
+    }
+  else
+    {
+      record_point (beg);
+      return beg;
+    }
 }
 
 /* Record that a deletion is about to take place,
@@ -153,25 +440,53 @@ record_insert (ptrdiff_t beg, ptrdiff_t length)
 void
 record_delete (ptrdiff_t beg, Lisp_Object string)
 {
-  Lisp_Object sbeg;
+  ptrdiff_t pos;
 
   if (EQ (BVAR (current_buffer, undo_list), Qt))
     return;
 
-  if (PT == beg + SCHARS (string))
-    {
-      XSETINT (sbeg, -beg);
-      record_point (PT);
-    }
-  else
-    {
-      XSETFASTINT (sbeg, beg);
-      record_point (beg);
-    }
+  pos = record_point_for_delete (beg, SCHARS (string));
+  add_undo_record (UNDO_STRING, pos, 0, string, Qnil, 0);
+}
+
+/* Record that the text from BEG to END of the current buffer, which
+   is from BEG_BYTE to END_BYTE in bytes, is about to be deleted.
+   This is the same as calling record_delete with that text, but
+   unless the text has properties, it is saved without making a
+   string.  */
+
+void
+record_delete_text (ptrdiff_t beg, ptrdiff_t beg_byte,
+		    ptrdiff_t end, ptrdiff_t end_byte)
+{
+  INTERVAL i;
+  ptrdiff_t pos, before_gap;
+  unsigned char *text;
+
+  if (EQ (BVAR (current_buffer, undo_list), Qt))
+    return;
 
-  bset_undo_list
-    (current_buffer,
-     Fcons (Fcons (string, sbeg), BVAR (current_buffer, undo_list)));
+  i = buffer_intervals (current_buffer);
+  for (i = i ? find_interval (i, beg) : NULL;
+       i && i->position < end; i = next_interval (i))
+    if (!NILP (i->plist))
+      {
+	record_delete (beg, make_buffer_string_both (beg, beg_byte,
+						     end, end_byte, 1));
+	return;
+      }
+
+  pos = record_point_for_delete (beg, end - beg);
+  text = add_undo_record (UNDO_TEXT, pos, end_byte - beg_byte,
+			  Qnil, Qnil, end_byte - beg_byte);
+  last_undo_record ()->multibyte
+    = !NILP (BVAR (current_buffer, enable_multibyte_characters));
+
+  /* The text may be on both sides of the gap.  */
+  before_gap = (beg < GPT && GPT < end ? GPT_BYTE : end_byte) - beg_byte;
+  memcpy (text, BYTE_POS_ADDR (beg_byte), before_gap);
+  if (before_gap < end_byte - beg_byte)
+    memcpy (text + before_gap, GAP_END_ADDR, end_byte - beg_byte - before_gap);
 }
 
 /* Record the fact that MARKER is about to be adjusted by ADJUSTMENT.
@@ -193,10 +508,29 @@ record_marker_adjustment (Lisp_Object marker, ptrdiff_t adjustment)
     Fundo_boundary ();
   last_undo_buffer = current_buffer;
 
-  bset_undo_list
-    (current_buffer,
-     Fcons (Fcons (marker, make_number (adjustment)),
-	    BVAR (current_buffer, undo_list)));
+  add_undo_record (UNDO_MARKER, adjustment, 0, marker, Qnil, 0);
+}
+
+/* Record the fact that OVERLAY, which is from BEG to END, is about to
+   be moved by a deletion in a way that undoing the deletion would not
+   revert, as record_marker_adjustment does for a marker.  Undoing
+   this moves OVERLAY back from BEG to END.  */
+
+void
+record_overlay_adjustment (Lisp_Object overlay, ptrdiff_t beg, ptrdiff_t end)
+{
+  if (EQ (BVAR (current_buffer, undo_list), Qt))
+    return;
+
+  /* Allocate a cons cell to be the undo boundary after this command.  */
+  if (NILP (pending_boundary))
+    pending_boundary = Fcons (Qnil, Qnil);
+
+  if (current_buffer != last_undo_buffer)
+    Fundo_boundary ();
+  last_undo_buffer = current_buffer;
+
+  add_undo_record (UNDO_OVERLAY, beg, end, overlay, Qnil, 0);
 }
 
 /* Record that a replacement is about to take place,
@@ -206,10 +540,11 @@ record_marker_adjustment (Lisp_Object marker, ptrdiff_t adjustment)
 void
 record_change (ptrdiff_t beg, ptrdiff_t length)
 {
-  record_delete (beg, make_buffer_string (beg, beg + length, 1));
+  record_delete_text (beg, CHAR_TO_BYTE (beg),
+		      beg + length, CHAR_TO_BYTE (beg + length));
   record_insert (beg, length);
 }
-
+
 /* Record that an unmodified buffer is about to be changed.
    Record the file modification date so that when undoing this entry
    we can tell whether it is obsolete because the file was saved again.  */
@@ -229,9 +564,7 @@ record_first_change (void)
   if (base_buffer->base_buffer)
     base_buffer = base_buffer->base_buffer;
 
-  bset_undo_list (current_buffer,
-		  Fcons (Fcons (Qt, Fvisited_file_modtime ()),
-			 BVAR (current_buffer, undo_list)));
+  add_undo_record (UNDO_FIRST_CHANGE, 0, 0, Fvisited_file_modtime (), Qnil, 0);
 }
 
 /* Record a change in property PROP (whose old value was VAL)
@@ -242,7 +575,6 @@ record_property_change (ptrdiff_t beg, ptrdiff_t length,
 			Lisp_Object prop, Lisp_Object value,
 			Lisp_Object buffer)
 {
-  Lisp_Object lbeg, lend, entry;
   struct buffer *obuf = current_buffer, *buf = XBUFFER (buffer);
   bool boundary = 0;
 
@@ -266,11 +598,7 @@ record_property_change (ptrdiff_t beg, ptrdiff_t length,
   if (MODIFF <= SAVE_MODIFF)
     record_first_change ();
 
-  XSETINT (lbeg, beg);
-  XSETINT (lend, beg + length);
-  entry = Fcons (Qnil, Fcons (prop, Fcons (value, Fcons (lbeg, lend))));
-  bset_undo_list (current_buffer,
-		  Fcons (entry, BVAR (current_buffer, undo_list)));
+  add_undo_record (UNDO_PROPERTY, beg, beg + length, prop, value, 0);
 
   current_buffer = obuf;
 }
@@ -282,29 +610,158 @@ but another undo command will undo to the previous boundary.  */)
   (void)
 {
   Lisp_Object tem;
+  struct undo_record *last;
+
   if (EQ (BVAR (current_buffer, undo_list), Qt))
     return Qnil;
-  tem = Fcar (BVAR (current_buffer, undo_list));
-  if (!NILP (tem))
+  last = last_undo_record ();
+  if (last)
     {
-      /* One way or another, cons nil onto the front of the undo list.  */
-      if (!NILP (pending_boundary))
+      if (last->type != UNDO_BOUNDARY)
+	add_undo_record (UNDO_BOUNDARY, 0, 0, Qnil, Qnil, 0);
+    }
+  else
+    {
+      tem = Fcar (BVAR (current_buffer, undo_list));
+      if (!NILP (tem))
 	{
-	  /* If we have preallocated the cons cell to use here,
-	     use that one.  */
-	  XSETCDR (pending_boundary, BVAR (current_buffer, undo_list));
-	  bset_undo_list (current_buffer, pending_boundary);
-	  pending_boundary = Qnil;
+	  /* One way or another, cons nil onto the front of the undo list.  */
+	  if (!NILP (pending_boundary))
+	    {
+	      /* If we have preallocated the cons cell to use here,
+		 use that one.  */
+	      XSETCDR (pending_boundary, BVAR (current_buffer, undo_list));
+	      bset_undo_list (current_buffer, pending_boundary);
+	      pending_boundary = Qnil;
+	    }
+	  else
+	    bset_undo_list (current_buffer,
+			    Fcons (Qnil, BVAR (current_buffer, undo_list)));
 	}
-      else
-	bset_undo_list (current_buffer,
-			Fcons (Qnil, BVAR (current_buffer, undo_list)));
     }
   last_boundary_position = PT;
   last_boundary_buffer = current_buffer;
   return Qnil;
 }
 
+/* A place in the undo information of a buffer, going from the most
+   recent change to the oldest one: first through the records of its
+   undo journal, then through the elements of its undo list.  */
+
+struct undo_position
+{
+  /* The journal, and the number of its records not yet passed, and of
+     the Lisp objects they take.  */
+  struct undo_journal *journal;
+  ptrdiff_t record, object;
+
+  /* When all the records are passed, the rest of the undo list.  */
+  Lisp_Object tail;
+
+  /* The number of records and elements passed.  */
+  ptrdiff_t passed;
+};
+
+static bool
+undo_position_end_p (struct undo_position *p)
+{
+  return p->record == 0 && !CONSP (p->tail);
+}
+
+static bool
+undo_position_boundary_p (struct undo_position *p)
+{
+  return (p->record > 0
+	  ? p->journal->records[p->record - 1].type == UNDO_BOUNDARY
+	  : NILP (XCAR (p->tail)));
+}
+
+/* Pass the record or element at P, and return the space it takes.  */
+
+static EMACS_INT
+undo_position_advance (struct undo_position *p)
+{
+  EMACS_INT size;
+
+  p->passed++;
+  if (p->record > 0)
+    {
+      struct undo_record *r = &p->journal->records[--p->record];
+      int nobjects = undo_record_objects (r->type);
+
+      p->object -= nobjects;
+      size = sizeof *r + nobjects * word_size;
+      if (r->type == UNDO_TEXT)
+	size += r->end;
+      else if (r->type == UNDO_STRING)
+	size += (sizeof (struct Lisp_String) - 1
+		 + SCHARS (p->journal->objects[p->object]));
+    }
+  else
+    {
+      Lisp_Object elt = XCAR (p->tail);
+
+      /* Add in the space occupied by this element and its chain link.  */
+      size = sizeof (struct Lisp_Cons);
+      if (CONSP (elt))
+	{
+	  size += sizeof (struct Lisp_Cons);
+	  if (STRINGP (XCAR (elt)))
+	    size += (sizeof (struct Lisp_String) - 1
+		     + SCHARS (XCAR (elt)));
+	}
+      p->tail = XCDR (p->tail);
+    }
+  return size;
+}
+
+/* Discard the undo information of buffer B past the most recent KEEP
+   records and elements.  */
+
+static void
+keep_recent_undo (struct buffer *b, ptrdiff_t keep)
+{
+  struct undo_journal *j = b->undo_journal;
+  ptrdiff_t nrecords = j ? j->nrecords : 0;
+
+  if (keep > nrecords)
+    {
+      XSETCDR (Fnthcdr (make_number (keep - nrecords - 1),
+			BVAR (b, undo_list)),
+	       Qnil);
+      return;
+    }
+
+  if (keep == 0)
+    {
+      bset_undo_list (b, Qnil);
+      return;
+    }
+
+  if (keep < nrecords)
+    {
+      /* Remove the oldest records, with their objects and text.  */
+      ptrdiff_t i, drop = nrecords - keep, nobjects = 0, nbytes = 0;
+
+      for (i = 0; i < drop; i++)
+	{
+	  nobjects += undo_record_objects (j->records[i].type);
+	  if (j->records[i].type == UNDO_TEXT)
+	    nbytes += j->records[i].end;
+	}
+      memmove (j->records, j->records + drop, keep * sizeof *j->records);
+      memmove (j->objects, j->objects + nobjects,
+	       (j->nobjects - nobjects) * sizeof *j->objects);
+      memmove (j->text, j->text + nbytes, j->text_bytes - nbytes);
+      j->nrecords = keep;
+      j->nobjects -= nobjects;
+      j->text_bytes -= nbytes;
+    }
+
+  /* Everything older than the journal goes.  */
+  b->INTERNAL_FIELD (undo_list) = Qnil;
+}
+
 /* At garbage collection time, make an undo list shorter at the end,
    returning the truncated list.  How this is done depends on the
    variables undo-limit, undo-strong-limit and undo-outer-limit.
@@ -313,8 +770,8 @@ but another undo command will undo to the previous boundary.  */)
 void
 truncate_undo_list (struct buffer *b)
 {
-  Lisp_Object list;
-  Lisp_Object prev, next, last_boundary;
+  struct undo_position p;
+  ptrdiff_t last_boundary = -1;
   EMACS_INT size_so_far = 0;
 
   /* Make sure that calling undo-outer-limit-function
@@ -327,22 +784,15 @@ truncate_undo_list (struct buffer *b)
   record_unwind_current_buffer ();
   set_buffer_internal (b);
 
-  list = BVAR (b, undo_list);
-
-  prev = Qnil;
-  next = list;
-  last_boundary = Qnil;
+  p.journal = b->undo_journal;
+  p.record = p.journal ? p.journal->nrecords : 0;
+  p.object = p.journal ? p.journal->nobjects : 0;
+  p.tail = BVAR (b, undo_list);
+  p.passed = 0;
 
   /* If the first element is an undo boundary, skip past it.  */
-  if (CONSP (next) && NILP (XCAR (next)))
-    {
-      /* Add in the space occupied by this element and its chain link.  */
-      size_so_far += sizeof (struct Lisp_Cons);
-
-      /* Advance to next element.  */
-      prev = next;
-      next = XCDR (next);
-    }
+  if (!undo_position_end_p (&p) && undo_position_boundary_p (&p))
+    size_so_far += undo_position_advance (&p);
 
   /* Always preserve at least the most recent undo record
      unless it is really horribly big.
@@ -350,25 +800,8 @@ truncate_undo_list (struct buffer *b)
      Skip, skip, skip the undo, skip, skip, skip the undo,
      Skip, skip, skip the undo, skip to the undo bound'ry.  */
 
-  while (CONSP (next) && ! NILP (XCAR (next)))
-    {
-      Lisp_Object elt;
-      elt = XCAR (next);
-
-      /* Add in the space occupied by this element and its chain link.  */
-      size_so_far += sizeof (struct Lisp_Cons);
-      if (CONSP (elt))
-	{
-	  size_so_far += sizeof (struct Lisp_Cons);
-	  if (STRINGP (XCAR (elt)))
-	    size_so_far += (sizeof (struct Lisp_String) - 1
-			    + SCHARS (XCAR (elt)));
-	}
-
-      /* Advance to next element.  */
-      prev = next;
-      next = XCDR (next);
-    }
+  while (!undo_position_end_p (&p) && !undo_position_boundary_p (&p))
+    size_so_far += undo_position_advance (&p);
 
   /* If by the first boundary we have already passed undo_outer_limit,
      we're heading for memory full, so offer to clear out the list.  */
@@ -379,6 +812,12 @@ truncate_undo_list (struct buffer *b)
       Lisp_Object tem;
       struct buffer *temp = last_undo_buffer;
 
+      /* The function sees the whole list, so go on from the same
+	 place in it.  */
+      p.journal = NULL;
+      p.record = p.object = 0;
+      p.tail = Fnthcdr (make_number (p.passed), buffer_undo_list (b));
+
       /* Normally the function this calls is undo-outer-limit-truncate.  */
       tem = call1 (Vundo_outer_limit_function, make_number (size_so_far));
       if (! NILP (tem))
@@ -394,49 +833,34 @@ truncate_undo_list (struct buffer *b)
       last_undo_buffer = temp;
     }
 
-  if (CONSP (next))
-    last_boundary = prev;
+  if (!undo_position_end_p (&p))
+    last_boundary = p.passed;
 
   /* Keep additional undo data, if it fits in the limits.  */
-  while (CONSP (next))
+  while (!undo_position_end_p (&p))
     {
-      Lisp_Object elt;
-      elt = XCAR (next);
-
       /* When we get to a boundary, decide whether to truncate
 	 either before or after it.  The lower threshold, undo_limit,
 	 tells us to truncate after it.  If its size pushes past
 	 the higher threshold undo_strong_limit, we truncate before it.  */
-      if (NILP (elt))
+      if (undo_position_boundary_p (&p))
 	{
 	  if (size_so_far > undo_strong_limit)
 	    break;
-	  last_boundary = prev;
+	  last_boundary = p.passed;
 	  if (size_so_far > undo_limit)
 	    break;
 	}
 
-      /* Add in the space occupied by this element and its chain link.  */
-      size_so_far += sizeof (struct Lisp_Cons);
-      if (CONSP (elt))
-	{
-	  size_so_far += sizeof (struct Lisp_Cons);
-	  if (STRINGP (XCAR (elt)))
-	    size_so_far += (sizeof (struct Lisp_String) - 1
-			    + SCHARS (XCAR (elt)));
-	}
-
-      /* Advance to next element.  */
-      prev = next;
-      next = XCDR (next);
+      size_so_far += undo_position_advance (&p);
     }
 
   /* If we scanned the whole list, it is short enough; don't change it.  */
-  if (NILP (next))
+  if (undo_position_end_p (&p))
     ;
   /* Truncate at the boundary where we decided to truncate.  */
-  else if (!NILP (last_boundary))
-    XSETCDR (last_boundary, Qnil);
+  else if (last_boundary > 0)
+    keep_recent_undo (b, last_boundary);
   /* There's nothing we decided to keep, so clear it out.  */
   else
     bset_undo_list (b, Qnil);
@@ -444,12 +868,13 @@ truncate_undo_list (struct buffer *b)
   unbind_to (count, Qnil);
 }
 
-
+
 void
 syms_of_undo (void)
 {
   DEFSYM (Qinhibit_read_only, "inhibit-read-only");
   DEFSYM (Qapply, "apply");
+  DEFSYM (Qmove_overlay, "move-overlay");
 
   pending_boundary = Qnil;
   staticpro (&pending_boundary);
@@ -3565,11 +3565,8 @@ next_overlay_change (ptrdiff_t pos)
      use its ending point instead.  */
   for (i = 0; i < noverlays; ++i)
     {
-      Lisp_Object oend;
-      ptrdiff_t oendpos;
+      ptrdiff_t oendpos = OVERLAY_END (overlays[i]);
 
-      oend = OVERLAY_END (overlays[i]);
-      oendpos = OVERLAY_POSITION (oend);
       endpos = min (endpos, oendpos);
     }
 
@@ -5614,7 +5611,8 @@ static void
 load_overlay_strings (struct it *it, ptrdiff_t charpos)
 {
   Lisp_Object overlay, window, str, invisible;
-  struct Lisp_Overlay *ov;
+  struct itree_iterator iter;
+  struct itree_node *node;
   ptrdiff_t start, end;
   ptrdiff_t size = 20;
   ptrdiff_t n = 0, i, j;
@@ -5651,16 +5649,15 @@ load_overlay_strings (struct it *it, ptrdiff_t charpos)
     }									\
   while (0)
 
-  /* Process overlay before the overlay center.  */
-  for (ov = current_buffer->overlays_before; ov; ov = ov->next)
+  /* Process the overlays that contain CHARPOS.  */
+  for (node = itree_iterator_start (&iter, &current_buffer->overlays,
+				    charpos, charpos);
+       node; node = itree_iterator_next (&iter))
     {
-      XSETMISC (overlay, ov);
+      overlay = node->data;
       eassert (OVERLAYP (overlay));
-      start = OVERLAY_POSITION (OVERLAY_START (overlay));
-      end = OVERLAY_POSITION (OVERLAY_END (overlay));
-
-      if (end < charpos)
-	break;
+      start = node->begin;
+      end = node->end;
 
       /* Skip this overlay if it doesn't start or end at IT's current
 	 position.  */
@@ -5691,45 +5688,6 @@ load_overlay_strings (struct it *it, ptrdiff_t charpos)
 	RECORD_OVERLAY_STRING (overlay, str, 1);
     }
 
-  /* Process overlays after the overlay center.  */
-  for (ov = current_buffer->overlays_after; ov; ov = ov->next)
-    {
-      XSETMISC (overlay, ov);
-      eassert (OVERLAYP (overlay));
-      start = OVERLAY_POSITION (OVERLAY_START (overlay));
-      end = OVERLAY_POSITION (OVERLAY_END (overlay));
-
-      if (start > charpos)
-	break;
-
-      /* Skip this overlay if it doesn't start or end at IT's current
-	 position.  */
-      if (end != charpos && start != charpos)
-	continue;
-
-      /* Skip this overlay if it doesn't apply to IT->w.  */
-      window = Foverlay_get (overlay, Qwindow);
-      if (WINDOWP (window) && XWINDOW (window) != it->w)
-	continue;
-
-      /* If the text ``under'' the overlay is invisible, it has a zero
-	 dimension, and both before- and after-strings apply.  */
-      invisible = Foverlay_get (overlay, Qinvisible);
-      invis_p = TEXT_PROP_MEANS_INVISIBLE (invisible);
-
-      /* If overlay has a non-empty before-string, record it.  */
-      if ((start == charpos || (end == charpos && invis_p))
-	  && (str = Foverlay_get (overlay, Qbefore_string), STRINGP (str))
-	  && SCHARS (str))
-	RECORD_OVERLAY_STRING (overlay, str, 0);
-
-      /* If overlay has a non-empty after-string, record it.  */
-      if ((end == charpos || (start == charpos && invis_p))
-	  && (str = Foverlay_get (overlay, Qafter_string), STRINGP (str))
-	  && SCHARS (str))
-	RECORD_OVERLAY_STRING (overlay, str, 1);
-    }
-
 #undef RECORD_OVERLAY_STRING
 
   /* Sort entries.  */
@@ -6264,7 +6222,7 @@ back_to_previous_visible_line_start (struct it *it)
 	    && !NILP (val = get_char_property_and_overlay
 		      (make_number (pos), Qdisplay, Qnil, &overlay))
 	    && (OVERLAYP (overlay)
-		? (beg = OVERLAY_POSITION (OVERLAY_START (overlay)))
+		? (beg = OVERLAY_START (overlay))
 		: get_property_and_range (pos, Qdisplay, &val, &beg, &end, Qnil)))
 	  {
 	    RESTORE_IT (it, it, it2data);
@@ -9199,7 +9157,6 @@ move_it_to (struct it *it, ptrdiff_t to_charpos, int to_x, int to_y, int to_vpos
 	}
 
       /* Reset/increment for the next run.  */
-      recenter_overlay_lists (current_buffer, IT_CHARPOS (*it));
       it->current_x = line_start_x;
       line_start_x = 0;
       it->hpos = 0;
@@ -19737,13 +19694,6 @@ display_line (struct it *it)
   row->starts_in_middle_of_char_p = it->starts_in_middle_of_char_p;
   it->starts_in_middle_of_char_p = 0;
 
-  /* Arrange the overlays nicely for our purposes.  Usually, we call
-     display_line on only one line at a time, in which case this
-     can't really hurt too much, or we call it on lines which appear
-     one after another in the buffer, in which case all calls to
-     recenter_overlay_lists but the first will be pretty cheap.  */
-  recenter_overlay_lists (current_buffer, IT_CHARPOS (*it));
-
   /* Move over display elements that are not visible because we are
      hscrolled.  This may stop at an x-position < IT->first_visible_x
      if the first glyph is partially visible or if we hit a line end.  */
@@ -22784,6 +22734,18 @@ display_count_lines (ptrdiff_t start_byte,
   int selective_display = (!NILP (BVAR (current_buffer, selective_display))
 			   && !INTEGERP (BVAR (current_buffer, selective_display)));
 
+  /* Newlines are all that count, so skip over many lines at once with
+     the newline index.  */
+  if (!selective_display)
+    {
+      ptrdiff_t shortage;
+
+      if (find_newline_by_index (start_byte, limit_byte, count,
+				 byte_pos_ptr, &shortage))
+	return (shortage ? eabs (count) - shortage
+		: count > 0 ? count : - count - 1);
+    }
+
   if (count > 0)
     {
       while (start_byte < limit_byte)
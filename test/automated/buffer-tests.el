@@ -0,0 +1,491 @@
+;;; buffer-tests.el --- tests for src/buffer.c
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defun buffer-tests--region (ov)
+  "Return the region of overlay OV, as a list of its start and end."
+  (list (overlay-start ov) (overlay-end ov)))
+
+(ert-deftest buffer-tests-overlay-insert ()
+  "Overlay boundaries move with insertions as markers do."
+  (with-temp-buffer
+    (insert "0123456789")
+    (let ((plain (make-overlay 3 6))
+          (front (make-overlay 3 6 nil t))
+          (rear (make-overlay 3 6 nil nil t))
+          (empty (make-overlay 5 5))
+          (empty-front (make-overlay 5 5 nil t)))
+      (goto-char 3)
+      (insert "ab")
+      (should (equal (buffer-tests--region plain) '(3 8)))
+      (should (equal (buffer-tests--region front) '(5 8)))
+      (goto-char 8)
+      (insert "cd")
+      (should (equal (buffer-tests--region plain) '(3 8)))
+      (should (equal (buffer-tests--region rear) '(3 10)))
+      ;; The empty overlays were at 7 after the first insertion, and
+      ;; one that only advances its start stays empty.
+      (should (equal (buffer-tests--region empty) '(7 7)))
+      (goto-char 7)
+      (insert "x")
+      (should (equal (buffer-tests--region empty) '(7 7)))
+      (should (equal (buffer-tests--region empty-front) '(7 7)))
+      (goto-char 3)
+      (insert-before-markers "yy")
+      (should (equal (buffer-tests--region plain) '(5 11)))
+      (should (equal (buffer-tests--region empty) '(9 9))))))
+
+(ert-deftest buffer-tests-overlay-delete ()
+  "Deleting text collapses the overlays in it."
+  (with-temp-buffer
+    (insert "0123456789")
+    (let ((inside (make-overlay 4 6 nil nil nil))
+          (across (make-overlay 2 8))
+          (after (make-overlay 9 11))
+          (evaporating (make-overlay 4 7)))
+      (overlay-put evaporating 'evaporate t)
+      (delete-region 3 8)
+      (should (equal (buffer-tests--region inside) '(3 3)))
+      (should (equal (buffer-tests--region across) '(2 3)))
+      (should (equal (buffer-tests--region after) '(4 6)))
+      (should-not (overlay-buffer evaporating))
+      (should-not (overlay-start evaporating))
+      (should (equal (overlays-at 2) (list across))))))
+
+(ert-deftest buffer-tests-overlay-undo ()
+  "Undoing a deletion puts the overlay boundaries in it back."
+  (with-temp-buffer
+    (buffer-enable-undo)
+    (insert "0123456789")
+    (undo-boundary)
+    (let ((inside (make-overlay 4 6))
+          (advancing (make-overlay 5 7 nil t t))
+          (edge (make-overlay 3 9 nil t nil))
+          (across (make-overlay 2 9)))
+      (delete-region 3 8)
+      (primitive-undo 1 buffer-undo-list)
+      (should (equal (buffer-string) "0123456789"))
+      (should (equal (mapcar #'buffer-tests--region
+                             (list inside advancing edge across))
+                     '((4 6) (5 7) (3 9) (2 9)))))))
+
+(ert-deftest buffer-tests-overlay-lookup ()
+  "Find overlays and their boundaries among many overlays."
+  (with-temp-buffer
+    (insert (make-string 2000 ?x))
+    (dotimes (i 1000)
+      (make-overlay (+ 1 (* 2 i)) (+ 4 (* 2 i))))
+    (should (= (length (overlays-at 101)) 2))
+    (should (= (length (overlays-in 101 111)) 6))
+    (should (= (next-overlay-change 100) 101))
+    (should (= (previous-overlay-change 100) 99))
+    (should (= (length (car (overlay-lists))) 1000))
+    (should-not (cdr (overlay-lists)))
+    (goto-char 1000)
+    (insert (make-string 1000 ?y))
+    (should (equal (mapcar #'overlay-start (overlays-in 998 2001))
+                   (sort (mapcar #'overlay-start (overlays-in 998 2001)) #'<)))
+    (should (= (length (overlays-at 1500)) 1))
+    (should (equal (buffer-tests--region (car (overlays-at 1500)))
+                   '(999 2002)))))
+
+(ert-deftest buffer-tests-overlay-many ()
+  "Look up and edit around many overlays, one per word and one per line."
+  (with-temp-buffer
+    (dotimes (_ 50)
+      (let ((bol (point)))
+        (dotimes (_ 9)
+          (insert "word")
+          (make-overlay (- (point) 4) (point))
+          (insert " "))
+        (insert "\n")
+        (make-overlay bol (point))))
+    (let ((size (buffer-size))
+          (n 0)
+          (pos (point-min)))
+      ;; Each line is 46 characters long, and a position in a word is
+      ;; in the overlay of the word and in that of the line.
+      (dotimes (i 20)
+        (setq n (+ n (length (overlays-at (+ 1 (* 2 i 46) (* 5 (% i 9))))))))
+      (should (= n 40))
+      ;; Each line has the 18 boundaries of its words, the first of
+      ;; which is where the previous line ends.
+      (setq n 0)
+      (while (< (setq pos (next-overlay-change pos)) (point-max))
+        (setq n (1+ n)))
+      (should (= n (1- (* 18 50))))
+      (dotimes (_ 100)
+        (goto-char (point-min))
+        (insert "ab")
+        (goto-char (point-max))
+        (insert "cd"))
+      (should (= (buffer-size) (+ size 400)))
+      (dotimes (_ 100)
+        (delete-region (point-min) (+ (point-min) 2))
+        (delete-region (- (point-max) 2) (point-max)))
+      (should (= (buffer-size) size))
+      ;; The deletions undid the insertions, so the words are back to
+      ;; their own length.
+      (setq n 0)
+      (dolist (ov (car (overlay-lists)))
+        (when (= (- (overlay-end ov) (overlay-start ov)) 4)
+          (setq n (1+ n))))
+      (should (= n (* 9 50))))))
+
+(ert-deftest buffer-tests-overlay-indirect ()
+  "Edits in an indirect buffer move the overlays of its base buffer."
+  (let ((base (generate-new-buffer " *base*")))
+    (unwind-protect
+        (let* ((ov (with-current-buffer base
+                     (insert "0123456789")
+                     (make-overlay 4 6)))
+               (indirect (make-indirect-buffer base " *indirect*" t))
+               (copy (car (overlays-at 4))))
+          (with-current-buffer indirect
+            (setq copy (car (overlays-at 4)))
+            (goto-char 2)
+            (insert "abc")
+            (should (equal (buffer-tests--region copy) '(7 9))))
+          (should (equal (buffer-tests--region ov) '(7 9)))
+          (with-current-buffer base
+            (delete-region 1 8))
+          (should (equal (buffer-tests--region copy) '(1 2)))
+          (kill-buffer indirect)
+          (should-not (overlay-buffer copy)))
+      (kill-buffer base))))
+
+(ert-deftest buffer-tests-overlay-buffer-changes ()
+  "Overlays follow their buffer through multibyteness and text swaps."
+  (with-temp-buffer
+    (insert "aéb")
+    (let ((ov (make-overlay 2 3))
+          (other (current-buffer)))
+      (set-buffer-multibyte nil)
+      (should (equal (buffer-tests--region ov) '(2 4)))
+      (set-buffer-multibyte t)
+      (should (equal (buffer-tests--region ov) '(2 3)))
+      (with-temp-buffer
+        (insert "xyz")
+        (let ((mine (make-overlay 1 2)))
+          (buffer-swap-text other)
+          (should (eq (overlay-buffer ov) (current-buffer)))
+          (should (eq (overlay-buffer mine) other))
+          (move-overlay mine 2 3 (current-buffer))
+          (should (eq (overlay-buffer mine) (current-buffer)))
+          (should (equal (mapcar #'overlay-start (overlays-in 1 4))
+                         '(2 2))))))))
+
+(defun buffer-tests--check-model (model)
+  "Check the overlays of MODEL against the markers that model them.
+MODEL is a list of elements (OVERLAY START-MARKER END-MARKER)."
+  (dolist (entry model)
+    (let ((start (marker-position (nth 1 entry)))
+          (end (marker-position (nth 2 entry))))
+      (when (> start end)
+        ;; An overlay that the edits turned around becomes empty.
+        (set-marker (nth 1 entry) end)
+        (setq start end))
+      (should (equal (list (car entry) start end)
+                     (list (car entry)
+                           (overlay-start (car entry))
+                           (overlay-end (car entry)))))))
+  (let ((pos (1+ (random (point-max)))))
+    (should (equal (sort (mapcar #'overlay-start (overlays-at pos)) #'<)
+                   (sort (delq nil
+                               (mapcar (lambda (entry)
+                                         (and (<= (nth 1 entry) pos)
+                                              (< pos (nth 2 entry))
+                                              (marker-position (nth 1 entry))))
+                                       model))
+                         #'<)))
+    (should (= (next-overlay-change pos)
+               (apply #'min (point-max)
+                      (delq nil
+                            (mapcar (lambda (entry)
+                                      (let ((s (nth 1 entry)) (e (nth 2 entry)))
+                                        (cond ((> s pos) (marker-position s))
+                                              ((and (<= s pos) (> e pos))
+                                               (marker-position e)))))
+                                    model)))))))
+
+(ert-deftest buffer-tests-overlay-random ()
+  "Random edits move overlays as they move markers."
+  (with-temp-buffer
+    (let ((model nil))
+      (random "buffer-tests")
+      (insert (make-string 200 ?a))
+      (dotimes (_ 100)
+        (let* ((start (1+ (random (point-max))))
+               (end (min (point-max) (+ start (random 20))))
+               (front (zerop (random 2)))
+               (rear (zerop (random 2)))
+               (ov (make-overlay start end nil front rear))
+               (m1 (copy-marker start front))
+               (m2 (copy-marker end rear)))
+          (push (list ov m1 m2) model)))
+      (dotimes (_ 500)
+        (let ((pos (1+ (random (point-max))))
+              (len (random 10)))
+          (pcase (random 5)
+            (0 (goto-char pos) (insert (make-string len ?b)))
+            (1 (goto-char pos) (insert-before-markers (make-string len ?c)))
+            (2 (delete-region pos (min (point-max) (+ pos len))))
+            (3 (goto-char pos)
+               (when (looking-at "..?.?")
+                 (replace-match (make-string len ?d) t t)))
+            (4 (let* ((a (random (point-max)))
+                      (b (+ a (random (- (point-max) a))))
+                      (c (+ b (random (- (point-max) b))))
+                      (d (+ c (random (- (point-max) c)))))
+                 (when (and (< (1+ a) b) (< c d))
+                   (transpose-regions (1+ a) b c d))))))
+        (buffer-tests--check-model model)))))
+
+;; Character and byte positions.
+
+(defun buffer-tests--check-positions (text)
+  "Check conversions between character and byte positions.
+TEXT is a string with the same contents as the current buffer."
+  (dotimes (_ 10)
+    (let* ((pos (1+ (random (1+ (length text)))))
+           (byte (1+ (string-bytes (substring text 0 (1- pos))))))
+      (should (equal (list pos (position-bytes pos))
+                     (list pos byte)))
+      (should (equal (list byte (byte-to-position byte))
+                     (list byte pos))))))
+
+(ert-deftest buffer-tests-positions-random ()
+  "Random edits keep character and byte positions in step."
+  (with-temp-buffer
+    (random "buffer-tests-positions")
+    (let* ((pieces ["a" "bc" "\u00e9" "\u65e5\u672c" "\U0001F600" "\n"])
+           (text (apply #'concat
+                        (mapcar (lambda (_)
+                                  (aref pieces (random (length pieces))))
+                                (make-list 5000 nil)))))
+      (insert text)
+      (dotimes (_ 300)
+        (let* ((from (random (1+ (length text))))
+               (to (min (length text) (+ from (random 3000)))))
+          (pcase (random 4)
+            (0 (let ((new (apply #'concat
+                                 (mapcar (lambda (_)
+                                           (aref pieces
+                                                 (random (length pieces))))
+                                         (make-list (random 500) nil)))))
+                 (goto-char (1+ from))
+                 (insert new)
+                 (setq text (concat (substring text 0 from) new
+                                    (substring text from)))))
+            (1 (delete-region (1+ from) (1+ to))
+               (setq text (concat (substring text 0 from)
+                                  (substring text to))))
+            (2 (let ((mid (+ from (random (1+ (- to from))))))
+                 (when (and (< from mid) (< mid to))
+                   (transpose-regions (1+ from) (1+ mid) (1+ mid) (1+ to))
+                   (setq text (concat (substring text 0 from)
+                                      (substring text mid to)
+                                      (substring text from mid)
+                                      (substring text to))))))
+            (3 (goto-char (1+ from))
+               (when (re-search-forward "\u00e9+" (1+ to) t)
+                 (let ((start (- (match-beginning 0) 1))
+                       (end (- (match-end 0) 1)))
+                   (replace-match "e" t t)
+                   (setq text (concat (substring text 0 start) "e"
+                                      (substring text end)))))))
+          (buffer-tests--check-positions text)))
+      (should (equal (buffer-string) text))
+      (set-buffer-multibyte nil)
+      (should (= (position-bytes (point-max)) (1+ (string-bytes text))))
+      (set-buffer-multibyte t)
+      (buffer-tests--check-positions text))))
+
+(defun buffer-tests--periodic-bytes (pos)
+  "Return the byte position of POS in a buffer that repeats \"a\u00e9\u65e5\".
+Its characters take 1, 2 and 3 bytes in turn."
+  (let ((q (/ (1- pos) 3)) (r (% (1- pos) 3)))
+    (+ 1 (* 6 q) (aref [0 1 3] r))))
+
+(defun buffer-tests--periodic-errors (n)
+  "Convert N positions spread over the current buffer both ways.
+Return the number of wrong results."
+  (let ((errors 0) (size (buffer-size)))
+    (dotimes (i n)
+      (let* ((pos (1+ (% (* i 7919) size)))
+             (byte (buffer-tests--periodic-bytes pos)))
+        (unless (and (= (position-bytes pos) byte)
+                     (= (byte-to-position byte) pos))
+          (setq errors (1+ errors)))))
+    errors))
+
+(ert-deftest buffer-tests-positions-periodic ()
+  "Convert positions all over a large buffer, between edits and markers."
+  (with-temp-buffer
+    (insert (apply #'concat (make-list 10000 "a\u00e9\u65e5")))
+    (should (= (buffer-tests--periodic-errors 2000) 0))
+    ;; Typing a whole period keeps the buffer periodic.
+    (dotimes (i 200)
+      (goto-char (1+ (* 3 (% (* i 104729) (/ (buffer-size) 3)))))
+      (insert "a\u00e9\u65e5")
+      (should (= (buffer-tests--periodic-errors 5) 0)))
+    (let ((markers nil))
+      (dotimes (i 2000)
+        (push (copy-marker (1+ (* 3 i))) markers))
+      (should (= (buffer-tests--periodic-errors 2000) 0))
+      (dolist (m markers)
+        (set-marker m nil)))))
+
+;; Markers.
+
+(defun buffer-tests--move (pos from inserted deleted advance)
+  "Return where an edit at FROM moves a marker at POS.
+The edit deletes DELETED characters and then inserts INSERTED ones.
+ADVANCE non-nil means a marker at FROM moves past the inserted text."
+  (cond ((< pos from) pos)
+        ((<= pos (+ from deleted))
+         (if (and (= pos from) advance (= deleted 0))
+             (+ pos inserted)
+           (if (> pos from) from pos)))
+        (t (+ pos (- inserted deleted)))))
+
+(ert-deftest buffer-tests-markers-random ()
+  "Random edits move markers as documented."
+  (with-temp-buffer
+    (random "buffer-tests-markers")
+    (insert (make-string 300 ?a))
+    (let ((model (mapcar (lambda (_)
+                           (let ((type (zerop (random 2))))
+                             (cons (copy-marker (1+ (random 301)) type)
+                                   nil)))
+                         (make-list 300 nil))))
+      (dolist (entry model)
+        (setcdr entry (marker-position (car entry))))
+      (dotimes (_ 500)
+        (let* ((pos (1+ (random (point-max))))
+               (len (random 10))
+               (end (min (point-max) (+ pos len))))
+          (pcase (random 4)
+            (0 (goto-char pos)
+               (insert (make-string len ?b))
+               (dolist (entry model)
+                 (setcdr entry (buffer-tests--move
+                                (cdr entry) pos len 0
+                                (marker-insertion-type (car entry))))))
+            (1 (goto-char pos)
+               (insert-before-markers (make-string len ?c))
+               (dolist (entry model)
+                 (setcdr entry (buffer-tests--move (cdr entry) pos len 0 t))))
+            (2 (delete-region pos end)
+               (dolist (entry model)
+                 (setcdr entry (buffer-tests--move
+                                (cdr entry) pos 0 (- end pos) nil))))
+            (3 (let ((entry (nth (random (length model)) model)))
+                 ;; Markers can change their insertion type at any time.
+                 (set-marker-insertion-type
+                  (car entry) (not (marker-insertion-type (car entry)))))))
+          (dolist (entry model)
+            (should (equal (list (car entry) (marker-position (car entry)))
+                           (list (car entry) (cdr entry)))))
+          (let ((pos (1+ (random (point-max)))))
+            (should (eq (buffer-has-markers-at pos)
+                        (and (rassq pos model) t)))))))))
+
+(ert-deftest buffer-tests-markers-many ()
+  "Edit at both ends of a buffer with many markers, and collect them."
+  (with-temp-buffer
+    (insert (make-string 10000 ?x))
+    (let* ((n 1000)
+           ;; The markers are at 1, 11, 21...
+           (sum (+ n (* 5 n (1- n))))
+           (markers nil))
+      (dotimes (i n)
+        (push (copy-marker (1+ (* 10 i))) markers))
+      (dotimes (_ 100)
+        (goto-char (point-min))
+        (insert "ab")
+        (goto-char (point-max))
+        (insert "cd"))
+      ;; The marker at the start stayed before the insertions.
+      (should (= (apply #'+ (mapcar #'marker-position markers))
+                 (+ sum (* 200 (1- n)))))
+      (dotimes (_ 100)
+        (delete-region (point-min) (+ (point-min) 2))
+        (delete-region (- (point-max) 2) (point-max)))
+      (should (= (buffer-size) 10000))
+      (should (= (apply #'+ (mapcar #'marker-position markers)) sum))
+      (setq markers nil)
+      (garbage-collect)
+      (let ((m (copy-marker 5001)))
+        (goto-char 1)
+        (insert "ab")
+        (should (= m 5003))))))
+
+(ert-deftest buffer-tests-markers-undo ()
+  "Undoing a deletion puts the markers in it back."
+  (with-temp-buffer
+    (buffer-enable-undo)
+    (insert "0123456789")
+    (undo-boundary)
+    (let ((before (copy-marker 4))
+          (after (copy-marker 6 t))
+          (edge (copy-marker 3 t)))
+      (delete-region 3 8)
+      (should (equal (mapcar #'marker-position (list before after edge))
+                     '(3 3 3)))
+      (primitive-undo 1 buffer-undo-list)
+      (should (equal (buffer-string) "0123456789"))
+      (should (equal (mapcar #'marker-position (list before after edge))
+                     '(4 6 3))))))
+
+(ert-deftest buffer-tests-markers-buffer-changes ()
+  "Markers follow their buffer through kills, conversions and swaps."
+  (let ((base (generate-new-buffer " *base*")))
+    (unwind-protect
+        (let* ((mine (with-current-buffer base
+                       (insert "a\u00e9b\u00e9c")
+                       (copy-marker 4)))
+               (indirect (make-indirect-buffer base " *indirect*"))
+               (theirs (with-current-buffer indirect (copy-marker 3))))
+          (kill-buffer indirect)
+          (should-not (marker-buffer theirs))
+          (should (eq (marker-buffer mine) base))
+          (with-current-buffer base
+            (set-buffer-multibyte nil)
+            (should (= mine 5))
+            (set-buffer-multibyte t)
+            (should (= mine 4))
+            (should (= (position-bytes mine) 5))))
+      (kill-buffer base)))
+  (with-temp-buffer
+    (insert "a\u00e9b\u00e9c")
+    (let ((mine (copy-marker 4))
+          (base (current-buffer)))
+      (with-temp-buffer
+        (insert "xyz")
+        (let ((other (copy-marker 2)))
+          (buffer-swap-text base)
+          (should (eq (marker-buffer mine) (current-buffer)))
+          (should (eq (marker-buffer other) base))
+          (should (equal (buffer-substring mine (1+ mine)) "\u00e9")))))))
+
+;;; buffer-tests.el ends here
@@ -255,3 +255,104 @@ comparing the subr with a much slower lisp implementation."
          (v2 (test-bool-vector-bv-from-hex-string "0000C"))
          (v3 (bool-vector-not v1)))
     (should (equal v2 v3))))
+
+(ert-deftest data-tests-buffer-local ()
+  "Each buffer sees its own buffer-local bindings."
+  (let ((vars (mapcar (lambda (i) (make-symbol (format "v%d" i)))
+                      (number-sequence 0 99)))
+        (a (generate-new-buffer "a"))
+        (b (generate-new-buffer "b")))
+    (unwind-protect
+        (progn
+          (dolist (var vars)
+            (set-default var 'default))
+          (put (nth 2 vars) 'permanent-local t)
+          (make-variable-buffer-local (nth 3 vars))
+          (with-current-buffer a
+            (dolist (var vars)
+              (set (make-local-variable var) (list 'a var)))
+            (kill-local-variable (nth 1 vars))
+            (setq indent-tabs-mode nil))
+          (with-current-buffer b
+            (set (make-local-variable (nth 0 vars)) 'b)
+            (set (nth 3 vars) 'b))
+          (dolist (var vars)
+            (should (eq (local-variable-p var b)
+                        (and (memq var (list (nth 0 vars) (nth 3 vars))) t)))
+            (should (eq (local-variable-p var a) (not (eq var (nth 1 vars))))))
+          (should (equal (buffer-local-value (nth 0 vars) a)
+                         (list 'a (nth 0 vars))))
+          (should (eq (buffer-local-value (nth 1 vars) a) 'default))
+          (should (eq (buffer-local-value (nth 3 vars) b) 'b))
+          (should (eq (buffer-local-value (nth 4 vars) b) 'default))
+          (with-current-buffer b
+            (should (eq (symbol-value (nth 0 vars)) 'b))
+            (should (eq (symbol-value (nth 4 vars)) 'default))
+            (should (eq indent-tabs-mode t)))
+          (with-current-buffer a
+            (should (equal (symbol-value (nth 4 vars)) (list 'a (nth 4 vars))))
+            (should (eq indent-tabs-mode nil))
+            (let ((c (clone-buffer)))
+              (unwind-protect
+                  (with-current-buffer c
+                    (should (equal (symbol-value (nth 4 vars))
+                                   (list 'a (nth 4 vars))))
+                    (should-not (local-variable-p (nth 1 vars))))
+                (kill-buffer c)))
+            (kill-all-local-variables)
+            (dolist (var vars)
+              (should (eq (local-variable-p var) (eq var (nth 2 vars))))))
+          ;; The variables that are garbage collected make room for new
+          ;; ones, which must not see the bindings of the old ones.
+          (setq vars nil)
+          (garbage-collect)
+          (dotimes (i 100)
+            (let ((var (make-symbol (format "w%d" i))))
+              (set-default var 'default)
+              (with-current-buffer b
+                (set (make-local-variable var) 'b))
+              (should-not (local-variable-p var a))
+              (should (eq (buffer-local-value var a) 'default))
+              (should (eq (buffer-local-value var b) 'b)))))
+      (kill-buffer a)
+      (kill-buffer b))))
+
+(ert-deftest data-tests-buffer-local-switching ()
+  "Switching buffers all the time reads and sets their own bindings."
+  (let* ((count 500)
+         (vars (make-vector count nil))
+         (a (generate-new-buffer "a"))
+         (b (generate-new-buffer "b"))
+         (expected (list (make-vector count 1) (make-vector count 2))))
+    (unwind-protect
+        (progn
+          ;; Each variable is local in both buffers, with the value 1
+          ;; in A and 2 in B.
+          (dotimes (i count)
+            (let ((var (make-symbol (format "v%d" i))))
+              (aset vars i var)
+              (set-default var 0)
+              (with-current-buffer a
+                (set (make-local-variable var) 1))
+              (with-current-buffer b
+                (set (make-local-variable var) 2))))
+          (with-temp-buffer
+            (let ((n 0))
+              (dotimes (i 10000)
+                (set-buffer (if (zerop (% i 2)) a b))
+                (setq n (+ n (symbol-value (aref vars (% (* i 7919) count))))))
+              (should (= n 15000)))
+            (dotimes (i 10000)
+              (let ((j (% (* i 7919) count)))
+                (set-buffer (if (zerop (% i 2)) a b))
+                (set (aref vars j) i)
+                (aset (nth (% i 2) expected) j i))))
+          (dotimes (i count)
+            (let ((var (aref vars i)))
+              (should (local-variable-p var a))
+              (should (local-variable-p var b))
+              (should (= (buffer-local-value var a) (aref (nth 0 expected) i)))
+              (should (= (buffer-local-value var b) (aref (nth 1 expected) i)))
+              (should (= (default-value var) 0)))))
+      (kill-buffer a)
+      (kill-buffer b))))
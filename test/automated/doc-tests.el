@@ -0,0 +1,55 @@
+;;; doc-tests.el --- tests for src/doc.c
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+(ert-deftest doc-tests--cached ()
+  "Docstrings from the DOC file survive being evicted from the cache."
+  (let ((subrs nil))
+    (mapatoms (lambda (s)
+                (when (and (fboundp s) (subrp (symbol-function s)))
+                  (push s subrs))))
+    (let ((docs (mapcar (lambda (s) (documentation s t)) subrs)))
+      (should (string-match "\\`Return the car of LIST" (documentation 'car t)))
+      (should (equal (mapcar (lambda (s) (documentation s t)) subrs) docs))
+      (should (equal (mapcar (lambda (s) (documentation s t))
+                             (reverse subrs))
+                     (reverse docs))))))
+
+(ert-deftest doc-tests--variable ()
+  "Variable docstrings come from the DOC file and from the cache."
+  (let ((doc (documentation-property 'fill-column 'variable-documentation t)))
+    (should (string-match "column beyond which" doc))
+    (should (equal (documentation-property 'fill-column
+                                           'variable-documentation t)
+                   doc))))
+
+(ert-deftest doc-tests--fresh ()
+  "Modifying a docstring does not change the docstrings fetched later."
+  (dolist (raw '(t nil))
+    (aset (documentation 'car raw) 0 ?X)
+    (should (string-match "\\`Return the car" (documentation 'car raw))))
+  (aset (documentation-property 'fill-column 'variable-documentation t) 0 ?X)
+  (should (string-match "\\`Column beyond which"
+                        (documentation-property 'fill-column
+                                                'variable-documentation t))))
+
+(provide 'doc-tests)
+;;; doc-tests.el ends here
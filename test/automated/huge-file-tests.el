@@ -0,0 +1,130 @@
+;;; huge-file-tests.el --- tests for huge-file.el  -*- lexical-binding: t -*-
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+(require 'huge-file)
+
+(defmacro huge-file-tests--with-file (contents &rest body)
+  "Evaluate BODY in a `huge-file-mode' buffer showing CONTENTS.
+CONTENTS is written to a temporary file in UTF-8, and the chunks
+are about 1000 bytes long."
+  (declare (indent 1) (debug t))
+  (let ((file (make-symbol "file")))
+    `(let ((,file (make-temp-file "huge-file-tests"))
+           (huge-file-chunk-size 1000))
+       (unwind-protect
+           (progn
+             (let ((coding-system-for-write 'utf-8-unix))
+               (write-region ,contents nil ,file nil 'silent))
+             (with-current-buffer (huge-file-find ,file)
+               (unwind-protect
+                   (progn ,@body)
+                 (kill-buffer))))
+         (delete-file ,file)))))
+
+(defun huge-file-tests--lines (n)
+  "Return a string of N numbered lines with multibyte characters."
+  (mapconcat (lambda (i) (format "line %d é日\n" i))
+             (number-sequence 1 n) ""))
+
+(ert-deftest huge-file-tests-forward ()
+  "The chunks shown going forward make up the file."
+  (let ((text (huge-file-tests--lines 2000)))
+    (huge-file-tests--with-file text
+      (let ((chunks (list (buffer-string))))
+        (should (= huge-file-start 0))
+        (should (= huge-file-size (string-bytes text)))
+        (while (< huge-file-end huge-file-size)
+          (let ((end huge-file-end))
+            (huge-file-next-chunk)
+            (should (= huge-file-start end))
+            (should (<= (- huge-file-end huge-file-start) 1000))
+            (should (equal (char-before (point-max)) ?\n))
+            (push (buffer-string) chunks)))
+        (should (equal (apply #'concat (nreverse chunks)) text))
+        (should-error (huge-file-next-chunk) :type 'user-error)))))
+
+(ert-deftest huge-file-tests-backward ()
+  "The chunks shown going backward make up the file."
+  (let ((text (huge-file-tests--lines 2000)))
+    (huge-file-tests--with-file text
+      (huge-file-last-chunk)
+      (should (= huge-file-end huge-file-size))
+      (should (eobp))
+      (let ((chunks (list (buffer-string))))
+        (while (> huge-file-start 0)
+          (let ((start huge-file-start))
+            (huge-file-previous-chunk)
+            (should (= huge-file-end start))
+            (push (buffer-string) chunks)))
+        (should (equal (apply #'concat chunks) text))
+        (should-error (huge-file-previous-chunk) :type 'user-error)))))
+
+(ert-deftest huge-file-tests-long-lines ()
+  "Lines longer than a chunk are split between chunks."
+  (let ((text (concat "short\n" (make-string 2500 ?x) "\nend\n")))
+    (huge-file-tests--with-file text
+      (let ((chunks (list (buffer-string))))
+        (while (< huge-file-end huge-file-size)
+          (huge-file-next-chunk)
+          (push (buffer-string) chunks))
+        (should (> (length chunks) 2))
+        (should (equal (apply #'concat (nreverse chunks)) text))))))
+
+(ert-deftest huge-file-tests-goto ()
+  "Going to a byte offset shows the chunk that starts with its line."
+  (let* ((text (huge-file-tests--lines 2000))
+         (offset (string-bytes (substring text 0 (string-match "line 1234 "
+                                                                text)))))
+    (huge-file-tests--with-file text
+      (huge-file-goto-byte (+ offset 7))
+      (should (= huge-file-start offset))
+      (should (looking-at "line 1234 "))
+      (huge-file-goto-percent 50)
+      (should (<= huge-file-start (/ huge-file-size 2)))
+      (should (looking-at "line [0-9]+ é日$")))))
+
+(ert-deftest huge-file-tests-search ()
+  "Searches go through the chunks of the file."
+  (huge-file-tests--with-file (huge-file-tests--lines 2000)
+    (should (huge-file-search-forward "^line 1500 "))
+    (should (> huge-file-start 0))
+    (should (looking-back "^line 1500 " nil))
+    (should (huge-file-search-backward "^line 7 "))
+    (should (= huge-file-start 0))
+    (should (looking-at "line 7 "))
+    (let ((start huge-file-start) (pos (point)))
+      (should-error (huge-file-search-forward "^line 2001 ")
+                    :type 'search-failed)
+      (should (= huge-file-start start))
+      (should (= (point) pos)))))
+
+(ert-deftest huge-file-tests-revert ()
+  "Reverting shows text appended to the file."
+  (let ((text (huge-file-tests--lines 10)))
+    (huge-file-tests--with-file text
+      (let ((coding-system-for-write 'utf-8-unix))
+        (write-region "more\n" nil huge-file-name 'append 'silent))
+      (revert-buffer)
+      (should (equal (buffer-string) (concat text "more\n")))
+      (should (= huge-file-end huge-file-size)))))
+
+;;; huge-file-tests.el ends here
@@ -0,0 +1,136 @@
+;;; insdel-tests.el --- tests for src/insdel.c
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defun insdel-tests--random-edits (size)
+  "Return a random sorted list of edits of a buffer of SIZE characters."
+  (let ((edits nil)
+        (pos 1))
+    (while (< pos size)
+      (let ((end (min size (+ pos (random 4)))))
+        (push (list pos end (substring "xyzé日" 0 (random 6))) edits)
+        (setq pos (+ end (random 20)))))
+    (nreverse edits)))
+
+(ert-deftest insdel-tests-replace-regions ()
+  "Replacing regions at once is the same as replacing them one by one."
+  (random "insdel-tests")
+  (dotimes (_ 20)
+    (let* ((text (mapconcat (lambda (i) (format "%d " i))
+                            (number-sequence 1 500) ""))
+           (edits (insdel-tests--random-edits (length text)))
+           (markers nil)
+           (expected
+            (with-temp-buffer
+              (insert text)
+              (goto-char 1000)
+              (dotimes (i 50)
+                (push (copy-marker (* 20 (1+ i)) (= (% i 2) 0)) markers))
+              (dolist (edit (reverse edits))
+                (replace-regions (list edit)))
+              (list (buffer-string) (point)
+                    (mapcar #'marker-position markers)))))
+      (setq markers nil)
+      (with-temp-buffer
+        (insert text)
+        (goto-char 1000)
+        (dotimes (i 50)
+          (push (copy-marker (* 20 (1+ i)) (= (% i 2) 0)) markers))
+        (replace-regions edits)
+        (should (equal (list (buffer-string) (point)
+                             (mapcar #'marker-position markers))
+                       expected))))))
+
+(ert-deftest insdel-tests-replace-regions-markers ()
+  "Marker positions in the edits are those before any replacement."
+  (with-temp-buffer
+    (insert "aaaa bbbb cccc dddd")
+    (let ((m1 (copy-marker 6)) (m2 (copy-marker 10))
+          (m3 (copy-marker 11)) (m4 (copy-marker 15)))
+      (replace-regions (list (list 1 5 "XXXXXXXX") (list m1 m2 "Y")
+                             (list m3 m4 "ZZZ")))
+      (should (equal (buffer-string) "XXXXXXXX Y ZZZ dddd")))))
+
+(ert-deftest insdel-tests-replace-regions-changes ()
+  "Replacing regions runs the change hooks once, and can be undone."
+  (with-temp-buffer
+    (buffer-enable-undo)
+    (insert "0123456789")
+    (undo-boundary)
+    (let* ((changes nil)
+           (before-change-functions
+            (list (lambda (beg end) (push (list 'before beg end) changes))))
+           (after-change-functions
+            (list (lambda (beg end len)
+                    (push (list 'after beg end len) changes)))))
+      (replace-regions '((2 4 "ab") (5 5 "XYZ") (7 10 "")))
+      (should (equal (buffer-string) "0ab3XYZ459"))
+      (should (equal (nreverse changes) '((before 2 10) (after 2 10 8)))))
+    (primitive-undo 1 buffer-undo-list)
+    (should (equal (buffer-string) "0123456789"))
+    (should-error (replace-regions '((5 6 "a") (2 3 "b"))))
+    (should-error (replace-regions '((2 5 "a") (4 6 "b"))))
+    (should-error (replace-regions '((2 50 "a"))))
+    (should-error (replace-regions '((2 3 b))))
+    (should (equal (buffer-string) "0123456789"))
+    (let ((string (propertize "new" 'p 1)))
+      (put-text-property 1 11 'q 2)
+      (replace-regions (list (list 3 4 string)) t)
+      (should (equal (text-properties-at 3) '(p 1 q 2))))))
+
+(ert-deftest insdel-tests-replace-regions-combine ()
+  "Replacing regions combines with other changes in one call."
+  (with-temp-buffer
+    (insert "0123456789")
+    (let* ((changes nil)
+           (after-change-functions
+            (list (lambda (beg end len)
+                    (push (list beg end len) changes)))))
+      (combine-after-change-calls
+        (replace-regions '((2 3 "a") (8 9 "b")))
+        (goto-char 1)
+        (insert "x"))
+      (should (equal changes '((1 10 8)))))))
+
+(ert-deftest insdel-tests-gap-growth ()
+  "Text inserted into a large buffer, with GCs in between, is all there."
+  (with-temp-buffer
+    (insert (make-string 1000000 ?x))
+    (let ((chunk (make-string 1000 ?y)))
+      (dotimes (_ 400)
+        (goto-char (point-min))
+        (insert chunk))
+      (should (= (buffer-size) 1400000))
+      (goto-char 700001)
+      (dotimes (i 400)
+        (when (zerop (% i 40))
+          (garbage-collect))
+        (insert chunk))
+      (should (= (buffer-size) 1800000))
+      (goto-char (point-min))
+      (should (= (skip-chars-forward "y") 400000))
+      (should (= (skip-chars-forward "x") 300000))
+      (should (= (skip-chars-forward "y") 400000))
+      (should (= (skip-chars-forward "x") 700000))
+      (should (eobp)))))
+
+;;; insdel-tests.el ends here
@@ -0,0 +1,71 @@
+;;; lread-tests.el --- tests for src/lread.c
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defconst lread-tests--data
+  '("(a b . c)" "(1 -2 +3 1.5 -0.0 1e3 .5 1. 100000000000000000000)"
+    "[a [b (c)] \"s\\\"q\\\\\\n\\t\"]" "(a 'b '(c d) ''e)"
+    "#s(hash-table data (a 1))" "(?a ?\\C-x `(a ,b))" "(#1=(x) #1#)"
+    "\"\\x41\\u00e9\"" "(\"é ü\" é foo\\ bar)" "; comment\n (a ; c\n b)"
+    "(a . (b))" "\"a\\\nb\\ c\"" "(a b) rest" "#(\"abc\" 0 1 (face bold))"
+    "(a .b)" "(. a)" "[]" "(())")
+  "Printed representations for comparing `read-data' with `read'.")
+
+(defconst lread-tests--invalid
+  '("(a" "" "(a ])" "[a . b]" "(a . b c)" ")" "'")
+  "Printed representations that `read' rejects.")
+
+(defun lread-tests--equal (a b)
+  "Return non-nil if A and B print the same way.
+Unlike `equal', this also compares hash tables and shared structure."
+  (let ((print-circle t))
+    (equal (prin1-to-string a) (prin1-to-string b))))
+
+(ert-deftest lread-tests-read-data-string ()
+  "`read-data' on strings agrees with `read-from-string'."
+  (dolist (s lread-tests--data)
+    (should (lread-tests--equal (read-data s) (read-from-string s))))
+  (should (equal (read-data "xx (a b) yy" 2 8) '((a b) . 8)))
+  (dolist (s lread-tests--invalid)
+    (should (equal (car (should-error (read-data s)))
+                   (car (should-error (read-from-string s)))))))
+
+(ert-deftest lread-tests-read-data-buffer ()
+  "`read-data' on buffers agrees with `read'."
+  (with-temp-buffer
+    (dolist (s lread-tests--data)
+      (erase-buffer)
+      (insert "xx" s)
+      (goto-char 3)
+      (let ((val (read (current-buffer)))
+            (end (point)))
+        (goto-char 3)
+        (should (lread-tests--equal (read-data (current-buffer))
+                                    (cons val end)))
+        (should (= (point) 3))))
+    (erase-buffer)
+    (insert "(a b) (c d)")
+    (should (equal (read-data (current-buffer) 7) '((c d) . 12)))
+    (should-error (read-data (current-buffer) 1 4))))
+
+(provide 'lread-tests)
+;;; lread-tests.el ends here
@@ -0,0 +1,111 @@
+;;; package-cache-tests.el --- Tests for package-cache.el  -*- lexical-binding: t -*-
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+(require 'package-cache)
+
+(defconst package-cache-tests--library "\
+;;; pct-lib.el --- test library  -*- lexical-binding: t -*-
+(defvar pct-lib-loads 0)
+(setq pct-lib-loads (1+ pct-lib-loads))
+(defun pct-lib-add (a b)
+  \"Add A and B, in \\\"pct-lib\\\".\"
+  (+ a b))
+(defun pct-lib-greet (name)
+  \"Greet NAME.\"
+  (interactive \"sName: \")
+  (format \"Hé, %s\\0\\037\\001!\" name))
+(defmacro pct-lib-twice (form)
+  \"Evaluate FORM twice.\"
+  (list 'progn form form))
+(defvar pct-lib-file (or load-file-name \"none\"))
+(provide 'pct-lib)
+")
+
+(defmacro package-cache-tests--with-library (&rest body)
+  "Run BODY with a compiled test library and an active package cache."
+  (declare (indent 0) (debug t))
+  `(let* ((dir (make-temp-file "package-cache-tests" t))
+          (source (expand-file-name "pct-lib.el" dir))
+          (package-cache-directory (expand-file-name "cache/" dir))
+          (package-cache-libraries '("pct-lib"))
+          (load-path (cons dir load-path))
+          (load-history load-history)
+          (features features))
+     (unwind-protect
+         (progn
+           (let ((coding-system-for-write 'utf-8-unix))
+             (write-region package-cache-tests--library nil source nil 'silent))
+           (let ((byte-compile-verbose nil))
+             (byte-compile-file source))
+           (package-cache-activate)
+           ,@body)
+       (dolist (sym '(pct-lib-add pct-lib-greet pct-lib-twice))
+         (fmakunbound sym))
+       (makunbound 'pct-lib-loads)
+       (makunbound 'pct-lib-file)
+       (delete-directory dir t))))
+
+(ert-deftest package-cache-tests--lazy ()
+  (package-cache-tests--with-library
+    (should (file-exists-p (expand-file-name "pct-lib.elc"
+                                             package-cache-directory)))
+    (require 'pct-lib)
+    (should (equal pct-lib-loads 1))
+    (should (equal pct-lib-file (concat source "c")))
+    (should (autoloadp (symbol-function 'pct-lib-add)))
+    (should (commandp 'pct-lib-greet))
+    (should (equal (documentation 'pct-lib-add)
+                   "Add A and B, in \"pct-lib\".\n\n(fn A B)"))
+    (should (equal (pct-lib-add 1 2) 3))
+    (should (byte-code-function-p (symbol-function 'pct-lib-add)))
+    (should (equal (pct-lib-greet "x") "Hé, x\0\037\001!"))
+    (should (equal (macroexpand '(pct-lib-twice (foo)))
+                   '(progn (foo) (foo))))
+    ;; Materializing a function does not load the library again.
+    (should (equal pct-lib-loads 1))
+    (should (equal (symbol-file 'pct-lib-add) (concat source "c")))
+    (should (member '(defun . pct-lib-add)
+                    (cdr (assoc (concat source "c") load-history))))
+    (should-not (assoc (expand-file-name "pct-lib.elc" package-cache-directory)
+                       load-history))))
+
+(ert-deftest package-cache-tests--autoload ()
+  (package-cache-tests--with-library
+    (autoload 'pct-lib-add "pct-lib")
+    (should (equal (pct-lib-add 2 3) 5))
+    (should (byte-code-function-p (symbol-function 'pct-lib-add)))
+    (should (autoloadp (symbol-function 'pct-lib-greet)))
+    (should (equal pct-lib-loads 1))))
+
+(ert-deftest package-cache-tests--stale ()
+  (package-cache-tests--with-library
+    (let ((cache (expand-file-name "pct-lib.elc" package-cache-directory))
+          (stale (expand-file-name "stale.elc" package-cache-directory)))
+      (write-region "" nil stale nil 'silent)
+      (set-file-times cache '(0 0))
+      (package-cache-activate)
+      (should-not (file-exists-p stale))
+      (should (file-newer-than-file-p cache source))
+      (should (equal (car load-path)
+                     (file-name-as-directory package-cache-directory))))))
+
+;;; package-cache-tests.el ends here
@@ -0,0 +1,88 @@
+;;; print-tests.el --- tests for src/print.c
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(ert-deftest print-tests--nested ()
+  "Lists, vectors and hash tables print as before."
+  (should (equal (prin1-to-string '(a "b\"c" [1 (2 . 3)] . d))
+                 "(a \"b\\\"c\" [1 (2 . 3)] . d)"))
+  (let ((print-quoted t))
+    (should (equal (prin1-to-string '('a #'b `(c ,d ,@e)))
+                   "('a #'b `(c ,d ,@e))")))
+  (let ((print-length 2))
+    (should (equal (prin1-to-string '(1 2 3 [4 5 6])) "(1 2 ...)"))
+    (should (equal (prin1-to-string [1 (2 3 4) 5]) "[1 (2 3 ...) ...]")))
+  (let ((print-level 2))
+    (should (equal (prin1-to-string '(1 (2 (3)))) "(1 (2 ...))")))
+  (let ((h (make-hash-table :size 1)))
+    (puthash 'k '(v) h)
+    (should (equal (prin1-to-string h)
+                   "#s(hash-table size 1 test eql rehash-size 1.5 rehash-threshold 0.8 data (k (v)))"))))
+
+(ert-deftest print-tests--circular ()
+  "Circular and shared structure."
+  (let ((x (list 1 2)))
+    (setcdr (cdr x) x)
+    (should (equal (prin1-to-string x) "(1 2 1 . #1)"))
+    (let ((print-circle t))
+      (should (equal (prin1-to-string (list x x))
+                     "(#1=(1 2 . #1#) #1#)"))))
+  (let ((print-gensym t)
+        (print-circle t)
+        (g (make-symbol "g")))
+    (should (equal (prin1-to-string (list g (vector g))) "(#1=#:g [#1#])"))))
+
+(ert-deftest print-tests--deep ()
+  "Deeply nested data prints without overflowing the C stack."
+  (let ((print-circle t)
+        (l nil))
+    (dotimes (_ 50000)
+      (setq l (list l)))
+    (should (= (length (prin1-to-string l)) 100003))
+    (setq l nil)
+    (dotimes (_ 50000)
+      (setq l (vector l)))
+    (should (= (length (prin1-to-string l)) 100003)))
+  (let ((print-circle nil)
+        (l nil))
+    (dotimes (_ 300)
+      (setq l (list l)))
+    (should (= (length (prin1-to-string l)) 603))
+    (let ((inner (list nil)))
+      (setq l inner)
+      (dotimes (_ 299)
+        (setq l (list l)))
+      (setcar inner l)
+      (should (equal (prin1-to-string l)
+                     (concat (make-string 300 ?\() "#0"
+                             (make-string 300 ?\))))))))
+
+(ert-deftest print-tests--nonlocal-exit ()
+  "An error from PRINTCHARFUN leaves the printer usable."
+  (should (eq (condition-case nil
+                  (prin1 '(1 (2 [3])) (lambda (c) (if (eq c ?3) (error "x"))))
+                (error 'caught))
+              'caught))
+  (should (equal (prin1-to-string '(1 (2 [3]))) "(1 (2 [3]))")))
+
+(provide 'print-tests)
+;;; print-tests.el ends here
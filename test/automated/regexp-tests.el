@@ -28,4 +28,323 @@
 The test data is in `compile-tests--test-regexps-data'."
   (should (string-match (regexp-opt-charset '(?^)) "a^b")))
 
+;; The DFA must only skip positions where the backtracking matcher
+;; finds no match, so compare the match data with and without it.
+(defun regexp-tests--search-data (dfa function &rest args)
+  "Return the value of FUNCTION applied to ARGS, and the match data.
+Bind `search-use-dfa' to DFA while calling FUNCTION."
+  (let ((search-use-dfa dfa))
+    (list (apply function args) (match-data t))))
+
+(defun regexp-tests--check-dfa (regexp string)
+  "Check that searches for REGEXP in STRING don't depend on the DFA."
+  (dolist (case-fold-search '(nil t))
+    (dotimes (start (1+ (length string)))
+      (should (equal (regexp-tests--search-data t #'string-match
+                                                regexp string start)
+                     (regexp-tests--search-data nil #'string-match
+                                                regexp string start))))
+    (with-temp-buffer
+      (insert string)
+      (dotimes (i (1+ (length string)))
+        (let ((forward (lambda (bound)
+                         (goto-char (1+ i))
+                         (list (re-search-forward regexp bound t) (point))))
+              (backward (lambda ()
+                          (goto-char (1+ i))
+                          (list (re-search-backward regexp nil t)
+                                (looking-at regexp)))))
+          (should (equal (regexp-tests--search-data t forward nil)
+                         (regexp-tests--search-data nil forward nil)))
+          (should (equal (regexp-tests--search-data t forward (1+ i))
+                         (regexp-tests--search-data nil forward (1+ i))))
+          (should (equal (regexp-tests--search-data t backward)
+                         (regexp-tests--search-data nil backward))))))))
+
+(ert-deftest regexp-test-dfa ()
+  "Test that searches find the same matches with and without the DFA."
+  (dolist (regexp '("a+b" "\\(a\\|ab\\)\\(c\\|bcd\\)\\(d*\\)" "[^a-c]+"
+                    "^foo$" "\\`x\\|y\\'" "\\<\\w+\\>" "\\bé\\B"
+                    "\\_<[-a]+\\_>" "\\s-*\\S-" "[[:space:]]+[[:word:]]"
+                    "\\(?:\\(a*\\)*\\)+?b" "x.*y" "[é-ü]\\|\n" ".\\{2,3\\}"
+                    "\\(a\\)\\1" ""))
+    (dolist (string '("" "ab aab\n foo-a abc\nfoo" "xAyyé übé\n--a y"))
+      (regexp-tests--check-dfa regexp string)
+      (regexp-tests--check-dfa regexp (string-to-unibyte
+                                       (encode-coding-string string
+                                                             'latin-1))))))
+
+(ert-deftest regexp-test-dfa-backtracking ()
+  "Test that the DFA avoids exponential backtracking."
+  (let ((search-use-dfa t)
+        (string (make-string 40 ?a)))
+    (should-not (string-match "\\(a*\\)*b" string))
+    (should (= (string-match "\\(a*\\)*b" (concat string "b")) 0))
+    (with-temp-buffer
+      (insert string)
+      (goto-char (point-min))
+      (should-not (re-search-forward "\\(?:a\\|aa\\)*c" nil t)))))
+
+;; A match must contain the strings that the regexp matches literally,
+;; which `re-search-forward' looks for before trying to match.
+(defun regexp-tests--check-literal (regexp string)
+  "Check forward searches for REGEXP in STRING against `looking-at'.
+Each search is repeated with the gap of the buffer at each position."
+  (with-temp-buffer
+    (insert string)
+    (dolist (case-fold-search '(nil t))
+      (dotimes (gap (1+ (length string)))
+        (goto-char (1+ gap))
+        (insert "x")
+        (delete-char -1)
+        (dotimes (i (1+ (length string)))
+          (let ((expected
+                 (catch 'found
+                   (dotimes (j (- (length string) i -1))
+                     (goto-char (+ 1 i j))
+                     (when (looking-at regexp)
+                       (throw 'found (list (match-beginning 0)
+                                           (match-end 0)))))
+                   nil)))
+            (goto-char (1+ i))
+            (should (equal (and (re-search-forward regexp nil t)
+                                (list (match-beginning 0) (match-end 0)))
+                           expected))))))))
+
+(ert-deftest regexp-test-literal ()
+  "Test searches for regexps that match strings literally."
+  (dolist (regexp '("error:" "^\\*+ TODO" "[e]rror:" "\\(?:ab\\|cd\\)e:"
+                    "a*b:" "\\(ab\\)+c" "ab\\(?:x\\)??:" "x.*?b:" "é+r"
+                    "\\<rr" "o\\{2\\}r" "ERROR"))
+    (dolist (string '("" "error: ab:\n** TODO eRRor:cde:" "ababc ERROR:\n* TODO"
+                      "ééré, rror: abx:"))
+      (regexp-tests--check-literal regexp string)))
+  (should-not (string-match "error:" "Error: " 1))
+  (should (= (string-match "r:" (string-to-unibyte "\351r:")) 1))
+  (should-not (string-match "ér" (string-to-unibyte "\351r:"))))
+
+(ert-deftest regexp-test-cache ()
+  "Test that the regexp cache grows to hold the regexps in use."
+  (let ((regexps (mapcar (lambda (i) (format "a%d\\(b\\)?" i))
+                         (number-sequence 1 200))))
+    (dotimes (_ 3)
+      (dolist (regexp regexps)
+        (should-not (string-match regexp "a0b"))))
+    (let ((hits regexp-cache-hits)
+          (misses regexp-cache-misses)
+          (time regexp-cache-compile-time))
+      (dolist (regexp regexps)
+        (string-match regexp "a0b"))
+      (should (= regexp-cache-hits (+ hits 200)))
+      (should (= regexp-cache-misses misses))
+      (should (= regexp-cache-compile-time time))
+      (should (string-match "a201\\(b\\)?" "a201b"))
+      (should (= regexp-cache-misses (1+ misses)))
+      (should (> regexp-cache-compile-time time))))
+  ;; Regexps compiled for one syntax table are not used for another.
+  (with-temp-buffer
+    (should (string-match "\\sw" "a"))
+    (modify-syntax-entry ?a ".")
+    (should-not (string-match "\\sw" "a"))))
+
+(ert-deftest regexp-test-cache-shrink ()
+  "Test the regexps of the cache after garbage collections free
+their DFAs and let the cache shrink."
+  (let ((regexps (mapcar (lambda (i) (format "x%d[a-z]*y" i))
+                         (number-sequence 1 100))))
+    (with-temp-buffer
+      (insert "x50abcy x100y")
+      (dolist (regexp regexps)
+        (goto-char (point-min))
+        (re-search-forward regexp nil t)
+        (re-search-backward regexp nil t))
+      (dotimes (_ 4)
+        (garbage-collect))
+      (goto-char (point-min))
+      (should (re-search-forward (nth 49 regexps) nil t))
+      (should (equal (match-string 0) "x50abcy"))
+      (goto-char (point-max))
+      (should (re-search-backward (nth 99 regexps) nil t))
+      (should (= (point) 9)))))
+
+;; Most forward searches for literal strings use `memchr' rather than
+;; the Boyer-Moore algorithm.
+(ert-deftest regexp-test-search-forward ()
+  "Test that `search-forward' finds the same matches as the regexp search."
+  (dolist (multibyte '(t nil))
+    (with-temp-buffer
+      (set-buffer-multibyte multibyte)
+      (insert "The cat; the CAT, tHe caT.\nthethe" (if multibyte "é→É" ""))
+      (dolist (case-fold-search '(nil t))
+        (dotimes (gap (buffer-size))
+          (goto-char (1+ gap))
+          (insert "x")
+          (delete-char -1)
+          (dolist (string (append '("the" "cat" "CAT" "e" "." "hethe" "\n")
+                                  (and multibyte '("é" "→" "é→"))))
+            (dolist (count '(1 2))
+              (dolist (bound (list nil (- (point-max) 3)))
+                (let ((regexp (concat "\\(?:" (regexp-quote string) "\\)"))
+                      expected)
+                  (goto-char (point-min))
+                  (setq expected
+                        (and (re-search-forward regexp bound t count)
+                             (list (point) (match-beginning 0))))
+                  (goto-char (point-min))
+                  (should (equal (and (search-forward string bound t count)
+                                      (list (point) (match-beginning 0)))
+                                 expected)))))))))))
+
+;; `search-forward-any' finds the leftmost match, and the longest of
+;; those that start there.
+(ert-deftest regexp-test-search-forward-any ()
+  "Test `search-forward-any'."
+  (with-temp-buffer
+    (insert "the display of displaying: Display, DISPLAY.")
+    (goto-char (point-min))
+    (let ((case-fold-search nil)
+          (strings '("play" "display" "displaying" "ing:")))
+      (should (eq (search-forward-any strings) (nth 1 strings)))
+      (should (equal (list (match-beginning 0) (point)) '(5 12)))
+      (should (eq (search-forward-any strings) (nth 2 strings)))
+      (should (equal (list (match-beginning 0) (point)) '(16 26)))
+      (should (equal (search-forward-any strings nil t) "play"))
+      (should-not (search-forward-any strings nil t))
+      (goto-char (point-min))
+      (should-not (search-forward-any strings 34 t 3))
+      (goto-char (point-min))
+      (should (equal (search-forward-any strings 35 t 3) "play"))
+      (should (= (point) 35))
+      (goto-char (point-min))
+      (should-not (search-forward-any strings 10 'move))
+      (should (= (point) 10))
+      (goto-char (point-max))
+      (should-error (search-forward-any strings))
+      (should-error (search-forward-any '("a" b)))
+      (should-error (search-forward-any strings nil nil 0)))
+    (let ((case-fold-search t))
+      (goto-char 30)
+      (should (equal (search-forward-any '("display" "y.")) "display"))
+      (should (equal (match-string 0) "DISPLAY"))
+      (should-not (search-forward-any '("display") nil t))
+      (goto-char (point-min))
+      (should (equal (search-forward-any '("" "the")) "the"))))
+  (dolist (multibyte '(t nil))
+    (with-temp-buffer
+      (set-buffer-multibyte multibyte)
+      (insert "Straße STRASSE stra\342\202\254 ÉTÉ été")
+      (let ((case-fold-search t))
+        (goto-char (point-min))
+        (should (equal (search-forward-any '("strasse" "été")) "strasse"))
+        (should (= (match-beginning 0) 8))
+        (when multibyte
+          (should (equal (search-forward-any '("été")) "été"))
+          (should (= (match-beginning 0) 24))
+          (should (equal (search-forward-any '("\342\202\254" "été")) "été")))))))
+
+(ert-deftest regexp-test-optimize ()
+  "Test the optimizations that the regexp compiler makes."
+  (with-temp-buffer
+    (let ((case-fold-search nil))
+      ;; Adjacent strings are merged.
+      (should (string-match "\\`0:\t/exactn/3/a/b/c\n"
+                            (regexp-disassemble "a\\(?:b\\)c")))
+      ;; Loops over a set of characters that cannot match what follows
+      ;; them are run as one scan.
+      (should (string-match "on_failure_keep_string_span"
+                            (regexp-disassemble "[a-z]*;")))
+      (should (string-match "on_failure_keep_string_span"
+                            (regexp-disassemble "[^\n]*\n")))
+      (should-not (string-match "on_failure_keep_string_span"
+                                (regexp-disassemble "[a-z]*b")))
+      ;; Anchors are moved to the front.
+      (should (string-match "\\`0:\t/begline\n"
+                            (regexp-disassemble "\\(^foo\\)")))
+      (insert "foo bar;\nxyz;\n")
+      (goto-char (point-min))
+      (should (re-search-forward "[a-z ]*;" nil t))
+      (should (equal (match-string 0) "foo bar;"))
+      (should (re-search-forward "[a-z ]*;" nil t))
+      (should (equal (match-string 0) "xyz;"))
+      (goto-char (point-min))
+      (should (re-search-forward "\\(^xyz\\)" nil t))
+      (should (equal (match-beginning 1) 10))
+      (should (equal (string-match "\\(?:a\\)\\(?:b\\)*c" "xabbbc") 1))
+      (should (equal (match-end 0) 6))
+      (should (equal (string-match ".*;" "ab;cd;\nx;") 0))
+      (should (equal (match-end 0) 6)))))
+
+(ert-deftest regexp-test-search-map ()
+  "Test `re-search-map' and `re-search-positions'."
+  (with-temp-buffer
+    (insert "foo=1 bar=22\nbaz=333 x= qux=4444\n")
+    (goto-char 3)
+    (set-match-data '(1 2))
+    (should (equal (re-search-positions "\\([a-z]+\\)=\\([0-9]+\\)?")
+                   '((1 . 6) (7 . 13) (14 . 21) (22 . 24) (25 . 33))))
+    (should (equal (re-search-positions "\\([a-z]+\\)=\\([0-9]+\\)?" 7 24 2)
+                   '((11 . 13) (18 . 21))))
+    (should (= (re-search-map nil "[0-9]+") 4))
+    (should (equal (re-search-positions "^") '((1 . 1) (14 . 14) (34 . 34))))
+    (should (equal (re-search-positions "a*" 6 9)
+                   '((6 . 6) (7 . 7) (8 . 9) (9 . 9))))
+    (should (equal (match-data) '(1 2)))
+    (should (= (point) 3))
+    (let ((names nil))
+      (should (= (re-search-map (lambda (beg end)
+                                  (should (= (point) end))
+                                  (push (match-string 1) names))
+                                "\\([a-z]+\\)=" 5 30)
+                 4))
+      (should (equal names '("qux" "x" "baz" "bar"))))
+    (should (= (point) 3))
+    (should (= (re-search-map (lambda (_beg _end) (replace-match ""))
+                              "=[0-9]*")
+               5))
+    (should (equal (buffer-string) "foo bar\nbaz x qux\n"))
+    (let ((case-fold-search t))
+      (should (equal (re-search-positions "FOO\\|BAZ") '((1 . 4) (9 . 12)))))
+    (should-error (re-search-map nil "a" 1 1000))))
+
+;; An oracle for backward searches: the last position at or before
+;; START, and not before BOUND, where REGEXP matches without going
+;; past START.
+(defun regexp-tests--last-match (regexp start bound)
+  (save-restriction
+    (narrow-to-region (point-min) start)
+    (let ((pos start) found)
+      (while (and (not found) (>= pos bound))
+        (goto-char pos)
+        (if (looking-at regexp)
+            (setq found pos)
+          (setq pos (1- pos))))
+      found)))
+
+(ert-deftest regexp-test-search-backward ()
+  "Test `re-search-backward' against a `looking-at' loop."
+  (dolist (multibyte '(t nil))
+    (with-temp-buffer
+      (set-buffer-multibyte multibyte)
+      (insert "int foo_p (void);\n  /* a comment */ bar = 12.5;\n"
+              "static int baz;\nif (x) foo_p (x); aaaa  ab aab\n")
+      (when multibyte
+        (insert "façade Ünïcode → strasse\n"))
+      (goto-char 20)
+      (insert "Foo ")
+      (dolist (case-fold-search '(nil t))
+        (dolist (regexp '("foo" "foo_p" "a[^\n]*b" "\\_<[a-z]+_p\\_>"
+                          "[0-9]+\\.[0-9]+" "^static" "/\\*[^*]*\\*/"
+                          "if (\\([a-z_]+\\))" "\\bab\\b" "a*b" "x$"
+                          "[^[:ascii:]]+" "Ü" "cade\\|code" "\\`int"
+                          "e\\'" "zzz"))
+          (dolist (start (list (point-max) 40 12))
+            (dolist (bound (list nil 10))
+              (let ((expected (regexp-tests--last-match
+                               regexp start (or bound (point-min)))))
+                (goto-char start)
+                (should (equal (list regexp start bound
+                                     (and (re-search-backward regexp bound t)
+                                          (point)))
+                               (list regexp start bound expected)))))))))))
+
 ;;; regexp-tests.el ends here.
@@ -0,0 +1,144 @@
+;;; search-tests.el --- tests for the newline index of src/search.c
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defun search-tests--newlines (start end)
+  "Return the number of newlines between START and END, without scanning."
+  (1- (length (split-string (buffer-substring-no-properties start end)
+                            "\n"))))
+
+(defun search-tests--line-start (line)
+  "Return the start of LINE in the accessible portion, the slow way."
+  (let ((string (buffer-substring-no-properties (point-min) (point-max)))
+        (i 0))
+    (while (and (> line 1) i)
+      (setq i (string-match "\n" string i))
+      (when i
+        (setq i (1+ i)
+              line (1- line))))
+    (+ (point-min) (or i (length string)))))
+
+(defun search-tests--check (positions)
+  "Check that line numbers and positions agree at POSITIONS."
+  (dolist (pos positions)
+    (let ((line (1+ (search-tests--newlines (point-min) pos))))
+      (should (equal (list pos (line-number-at-pos pos))
+                     (list pos line)))
+      (should (equal (list pos (line-number-at-pos pos t))
+                     (list pos (1+ (save-restriction
+                                     (widen)
+                                     (search-tests--newlines 1 pos))))))
+      (should (equal (list line (position-of-line line))
+                     (list line (search-tests--line-start line))))
+      (save-excursion
+        (goto-char (point-min))
+        (should (equal (list line (forward-line (1- line)) (point))
+                       (list line 0 (search-tests--line-start line))))
+        (goto-char (point-max))
+        (let ((back (- (search-tests--newlines pos (point-max)))))
+          (when (< back 0)
+            (forward-line back)
+            (should (equal (list pos (point))
+                           (list pos (save-excursion
+                                       (goto-char pos)
+                                       (line-beginning-position)))))))))))
+
+(ert-deftest search-tests-newline-index ()
+  "Line numbers stay right through random edits of a large buffer."
+  (with-temp-buffer
+    (random "search-tests")
+    (dotimes (i 8000)
+      (insert (make-string (random 30) (if (zerop (% i 7)) ?é ?a)) "\n"))
+    (dotimes (_ 60)
+      (let ((pos (1+ (random (buffer-size)))))
+        (pcase (random 5)
+          (0 (goto-char pos)
+             (insert (mapconcat (lambda (_) "line\n")
+                                (make-list (random 200) nil) "")))
+          (1 (delete-region pos (min (point-max) (+ pos (random 20000)))))
+          (2 (goto-char pos)
+             (insert (make-string (random 20000) ?b)))
+          (3 (subst-char-in-region pos (min (point-max) (+ pos 500)) ?a ?\n))
+          (4 (subst-char-in-region pos (min (point-max) (+ pos 500)) ?\n ?c))))
+      (search-tests--check (list (point-min) (point-max)
+                                 (1+ (random (buffer-size)))
+                                 (1+ (random (buffer-size))))))
+    (let ((end (point-max)))
+      (save-restriction
+        (narrow-to-region (/ end 3) (/ (* 2 end) 3))
+        (search-tests--check
+         (list (point-min) (point-max)
+               (+ (point-min) (random (- (point-max) (point-min))))))))))
+
+(ert-deftest search-tests-line-numbers-many ()
+  "Line numbers and line motion are right all over a buffer of many lines."
+  (with-temp-buffer
+    (let ((lines 20000))
+      ;; Lines of 40 characters, the newline included, so line L starts
+      ;; at 1 + 40 (L - 1).
+      (dotimes (_ lines)
+        (insert (make-string 39 ?x) "\n"))
+      (dotimes (i 500)
+        (let ((l (1+ (% (* i 7919) lines))))
+          (should (= (line-number-at-pos (+ 1 (* 40 (1- l)) 17)) l))
+          (goto-char (point-min))
+          (forward-line (1- l))
+          (should (= (point) (+ 1 (* 40 (1- l)))))))
+      ;; The narrowing starts at the start of line L / 4 + 1.
+      (save-restriction
+        (narrow-to-region (1+ (* 40 (/ lines 4))) (point-max))
+        (should (= (line-number-at-pos (point-max))
+                   (- lines (/ lines 4) -1)))
+        (should (= (line-number-at-pos (point-max) t) (1+ lines))))
+      ;; Each edit adds a line near the end of the buffer.
+      (dotimes (i 100)
+        (goto-char (- (point-max) (* 40 (% (* i 7919) 100))))
+        (insert "line\n")
+        (should (= (line-number-at-pos (point-max)) (+ lines i 2))))
+      (dotimes (i 100)
+        (goto-char (1+ (* 40 (% (* i 7919) lines))))
+        (delete-char 1)
+        (insert "y")
+        (should (= (count-lines (point-min) (point-max)) (+ lines 100)))))))
+
+(ert-deftest search-tests-line-number-at-pos ()
+  "`line-number-at-pos' and `position-of-line' handle their arguments."
+  (with-temp-buffer
+    (insert "a\nb\nc\nd\n")
+    (should (= (line-number-at-pos) 5))
+    (should (= (line-number-at-pos 1) 1))
+    (should (= (line-number-at-pos (copy-marker 4)) 2))
+    (should (= (position-of-line 3) 5))
+    (should (= (position-of-line 0) 1))
+    (should (= (position-of-line 100) 9))
+    (narrow-to-region 3 7)
+    (should (= (line-number-at-pos 5) 2))
+    (should (= (line-number-at-pos 5 t) 3))
+    (should (= (line-number-at-pos 1) 1))
+    (should (= (line-number-at-pos 100) 3))
+    (should (= (position-of-line 2) 5))
+    (should (= (position-of-line 2 t) 3))
+    (should (= (position-of-line 100) 7))
+    (should-error (line-number-at-pos 'a))
+    (should-error (position-of-line nil))))
+
+;;; search-tests.el ends here
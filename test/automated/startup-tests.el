@@ -0,0 +1,71 @@
+;;; startup-tests.el --- tests for startup tracing
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defun startup-tests--trace (&rest args)
+  "Run Emacs in batch mode with ARGS, recording the startup trace.
+Return the trace, as read back from the child Emacs."
+  (let ((process-environment (cons "EMACS_STARTUP_TRACE=1"
+                                   process-environment)))
+    (with-temp-buffer
+      (apply #'call-process
+             (expand-file-name invocation-name invocation-directory)
+             nil t nil "-Q" "--batch"
+             (append args '("--eval" "(prin1 (startup-trace))")))
+      (goto-char (point-min))
+      (read (current-buffer)))))
+
+(ert-deftest startup-tests--trace ()
+  "Phases of `main', `load' and `startup-trace-call' are recorded."
+  (let* ((trace (startup-tests--trace
+                 "--eval" "(startup-trace-call \"outer\" (lambda () (load \"ert\" nil t)))"))
+         (names (mapcar #'car trace))
+         (command-line (assoc "command-line" trace))
+         (outer nil))
+    (should (member "init: early" names))
+    (should (member "init: windows" names))
+    (should command-line)
+    (dolist (node trace)
+      (should (stringp (nth 0 node)))
+      (should (floatp (nth 1 node)))
+      (should (floatp (nth 2 node)))
+      (should (<= 0 (nth 3 node)))
+      (should (<= 0 (nth 4 node))))
+    ;; "outer" is run by `command-line-1', within `command-line'.
+    (let ((stack (nthcdr 5 command-line)))
+      (while (and stack (not outer))
+        (let ((node (pop stack)))
+          (if (equal (car node) "outer")
+              (setq outer node)
+            (setq stack (append (nthcdr 5 node) stack))))))
+    (should outer)
+    (should (string-match "/ert\\.elc?\\'" (car (nth 5 outer))))
+    (should (<= (nth 1 (nth 5 outer)) (nth 1 outer)))))
+
+(ert-deftest startup-tests--disabled ()
+  "Without EMACS_STARTUP_TRACE, nothing is recorded."
+  (should (equal (startup-trace-call "test" (lambda () 42)) 42))
+  (unless (getenv "EMACS_STARTUP_TRACE")
+    (should-not (startup-trace))))
+
+(provide 'startup-tests)
+;;; startup-tests.el ends here
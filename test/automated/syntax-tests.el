@@ -0,0 +1,174 @@
+;;; syntax-tests.el --- tests for src/syntax.c
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defun syntax-tests--state (state)
+  "Return STATE without the elements that `syntax-ppss' leaves out."
+  (let ((state (copy-sequence state)))
+    (setcar (nthcdr 2 state) nil)
+    (setcar (nthcdr 6 state) nil)
+    state))
+
+(defun syntax-tests--check-ppss (&optional positions)
+  "Check `syntax-ppss-scan' at POSITIONS against `parse-partial-sexp'.
+POSITIONS defaults to a few positions spread over the buffer."
+  (dolist (pos (or positions
+                   (list (point-max) 5000 (/ (point-max) 2) 100 (point-min))))
+    (should (equal (list pos (syntax-tests--state (syntax-ppss-scan pos)))
+                   (list pos (syntax-tests--state
+                              (parse-partial-sexp (point-min) pos)))))
+    (should (= (point) pos))
+    (let ((checkpoint (syntax-ppss-checkpoint pos)))
+      (when checkpoint
+        (should (<= (point-min) (car checkpoint) pos))
+        (should (equal (syntax-tests--state (cdr checkpoint))
+                       (syntax-tests--state
+                        (parse-partial-sexp (point-min)
+                                            (car checkpoint)))))))))
+
+(ert-deftest syntax-tests-ppss-checkpoints ()
+  "Test the checkpoints of `syntax-ppss' as the buffer changes."
+  (with-temp-buffer
+    (emacs-lisp-mode)
+    (dotimes (i 400)
+      (insert (format "(defun f%d (x) \"doc (%d\" ; comment (\n  '(a . [b ?\\( %d]))\n"
+                      i i i)
+              (if (= (% i 50) 0) "(let ((y 1))\n" "")
+              (if (= (% i 70) 0) "#| block\n (comment |#\n" "")
+              "(ü → \"ŝ\")\n"))
+    (syntax-tests--check-ppss)
+    (should (syntax-ppss-checkpoint (point-max)))
+    ;; Changes to the text drop the checkpoints after them.
+    (goto-char 10000)
+    (insert "(\"")
+    (syntax-tests--check-ppss)
+    (goto-char 3000)
+    (delete-char 40)
+    (syntax-tests--check-ppss)
+    (goto-char 20000)
+    (insert "#|")
+    (syntax-tests--check-ppss)
+    ;; An edit that leaves the state after it alone keeps the
+    ;; checkpoints after it, once a scan has checked the first one.
+    (let ((last (car (syntax-ppss-checkpoint (point-max)))))
+      (goto-char 4000)
+      (insert "x")
+      (syntax-ppss 6000)
+      (should (= (car (syntax-ppss-checkpoint (point-max))) (1+ last)))
+      (syntax-tests--check-ppss))
+    ;; So do changes to the syntax table and narrowing.
+    (modify-syntax-entry ?\" "." (syntax-table))
+    (syntax-tests--check-ppss)
+    (save-restriction
+      (narrow-to-region 1234 (- (point-max) 1234))
+      (syntax-tests--check-ppss (list 1234 6000 (point-max))))
+    (with-syntax-table (standard-syntax-table)
+      (syntax-tests--check-ppss))
+    (syntax-tests--check-ppss)
+    (syntax-ppss-flush-checkpoints 4000)
+    (should (< (car (syntax-ppss-checkpoint (point-max))) 4000))
+    (syntax-ppss-flush-checkpoints nil)
+    (should-not (syntax-ppss-checkpoint (point-max)))
+    (syntax-tests--check-ppss)
+    (let ((pos (/ (point-max) 3)))
+      (should (equal (syntax-tests--state (syntax-ppss pos))
+                     (syntax-tests--state
+                      (parse-partial-sexp (point-min) pos)))))))
+
+(defun syntax-tests--scans (positions)
+  "Return what `scan-lists' and `forward-comment' find from POSITIONS."
+  (let (results)
+    (dolist (pos positions)
+      (dolist (scan '((scan-lists 1 0) (scan-lists -1 0) (scan-lists 2 1)
+                      (scan-lists -2 1) (scan-sexps 1) (scan-sexps -1)
+                      (forward-comment 1) (forward-comment -1)
+                      (forward-comment 3) (forward-comment -3)))
+        (push (condition-case err
+                  (if (eq (car scan) 'forward-comment)
+                      (progn
+                        (goto-char pos)
+                        (list (forward-comment (nth 1 scan)) (point)))
+                    (apply (car scan) pos (cdr scan)))
+                (error (cons 'error (cdr err))))
+              results)))
+    (nreverse results)))
+
+(ert-deftest syntax-tests-scan-runs ()
+  "Test that scans skipping runs of characters find what others find."
+  (let ((table (make-syntax-table))
+        (other (make-syntax-table))
+        (tokens '("foo" "x_1" " " "   " "\n" "(" ")" "[" "]" "{" "}"
+                  "\"" "\\" "'" "#" "/*" "*/" "//" "/" "*" "@" "`" "$"
+                  "é" "→" "\"str\\\"ing\"" "/* c */" ";" "," "\\ "))
+        (positions nil))
+    (modify-syntax-entry ?/ ". 124b" table)
+    (modify-syntax-entry ?* ". 23" table)
+    (modify-syntax-entry ?\n "> b" table)
+    (modify-syntax-entry ?' "\"" table)
+    (modify-syntax-entry ?# "' " table)
+    (modify-syntax-entry ?@ "!" table)
+    (modify-syntax-entry ?` "|" table)
+    (modify-syntax-entry ?$ "$" table)
+    (modify-syntax-entry ?_ "_" table)
+    (modify-syntax-entry ?\' "." other)
+    (modify-syntax-entry ?$ "w" other)
+    (modify-syntax-entry ?/ "." other)
+    (with-temp-buffer
+      (random "syntax-tests")
+      ;; Backward scans signal an error at a `$' at the beginning of
+      ;; the buffer when `syntax-table' properties are in use.
+      (insert "\n")
+      (dotimes (_ 3000)
+        (insert (nth (random (length tokens)) tokens)))
+      (dotimes (_ 300)
+        (push (1+ (random (buffer-size))) positions))
+      (set-syntax-table table)
+      (let ((text (buffer-string))
+            (copies (list (cons table (copy-syntax-table table))
+                          (cons other (copy-syntax-table other))))
+            (fast (syntax-tests--scans positions))
+            (parse-sexp-lookup-properties t))
+        ;; Give each character a syntax table of its own, alternating
+        ;; between two copies, so that no run goes past one character.
+        (dotimes (i (buffer-size))
+          (put-text-property (1+ i) (+ i 2) 'syntax-table
+                             (if (= (% i 2) 0) table (cdr (assq table copies)))))
+        (should (equal (syntax-tests--scans positions) fast))
+        ;; Likewise with another syntax table in some parts.
+        (erase-buffer)
+        (insert text)
+        (dotimes (_ 50)
+          (let ((beg (1+ (random (buffer-size)))))
+            (put-text-property beg (min (point-max) (+ beg (random 200)))
+                               'syntax-table other)))
+        (setq fast (syntax-tests--scans positions))
+        (let ((changes nil))
+          (dotimes (i (buffer-size))
+            (let ((this (or (get-text-property (1+ i) 'syntax-table) table)))
+              (push (list (1+ i) (+ i 2) 'syntax-table
+                          (if (= (% i 2) 0) this (cdr (assq this copies))))
+                    changes)))
+          (dolist (change changes)
+            (apply #'put-text-property change)))
+        (should (equal (syntax-tests--scans positions) fast))))))
+
+;;; syntax-tests.el ends here.
@@ -0,0 +1,191 @@
+;;; textprop-tests.el --- tests for src/textprop.c and src/intervals.c
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defun textprop-tests--properties (object)
+  "Return the property changes of OBJECT, a buffer or a string.
+The value is a list of elements (POS PLIST), for each position POS
+where the properties change, with the properties PLIST from there."
+  (let* ((pos (if (stringp object) 0 (with-current-buffer object
+                                       (point-min))))
+         (end (if (stringp object) (length object) (with-current-buffer object
+                                                     (point-max))))
+         (changes nil))
+    (while (< pos end)
+      (push (list pos (text-properties-at pos object)) changes)
+      (setq pos (next-property-change pos object end)))
+    (nreverse changes)))
+
+(ert-deftest textprop-tests-random ()
+  "Random edits of text and properties keep the properties consistent."
+  (with-temp-buffer
+    (let ((model (make-vector 1000 nil)))
+      (random "textprop-tests")
+      (insert (make-string 1000 ?a))
+      (dotimes (_ 3000)
+        (let* ((start (1+ (random (1- (point-max)))))
+               (end (min (point-max) (+ start (random 20))))
+               (value (random 4)))
+          (pcase (random 5)
+            ((or 0 1)
+             (put-text-property start end 'p value)
+             (dotimes (i (- end start))
+               (aset model (+ start i -1) value)))
+            (2
+             (remove-text-properties start end '(p nil))
+             (dotimes (i (- end start))
+               (aset model (+ start i -1) nil)))
+            (3
+             (goto-char start)
+             (insert (propertize "xy" 'p value))
+             (setq model (vconcat (substring model 0 (1- start))
+                                  (list value value)
+                                  (substring model (1- start)))))
+            (4
+             (when (> (buffer-size) 500)
+               (delete-region start end)
+               (setq model (vconcat (substring model 0 (1- start))
+                                    (substring model (1- end)))))))))
+      (should (= (length model) (buffer-size)))
+      (dotimes (i (length model))
+        (should (equal (list i (get-text-property (1+ i) 'p))
+                       (list i (aref model i))))))))
+
+(ert-deftest textprop-tests-copy ()
+  "Copying text with many intervals copies its properties."
+  (with-temp-buffer
+    (dotimes (i 2000)
+      (insert (propertize (format "w%d " i) 'p (% i 7))))
+    (let ((string (buffer-substring 100 9000)))
+      (should (equal (textprop-tests--properties string)
+                     (mapcar (lambda (change)
+                               (cons (- (car change) 100) (cdr change)))
+                             (save-restriction
+                               (narrow-to-region 100 9000)
+                               (textprop-tests--properties
+                                (current-buffer))))))
+      (erase-buffer)
+      (insert string)
+      (set-buffer-multibyte nil)
+      (set-buffer-multibyte t)
+      (should (equal-including-properties (buffer-string) string)))))
+
+(ert-deftest textprop-tests-runs ()
+  "Adding runs of properties is the same as adding each run."
+  (let ((runs nil)
+        (pos 1))
+    (random "textprop-tests")
+    (while (< pos 2000)
+      (let ((end (min 2000 (+ pos (random 10)))))
+        (push (list pos end (list 'face (random 3) 'p (random 2))) runs)
+        (setq pos (+ end (random 3)))))
+    (setq runs (nreverse runs))
+    (with-temp-buffer
+      (insert (make-string 2000 ?a))
+      (put-text-property 500 1500 'p 0)
+      (let ((expected (with-temp-buffer
+                        (insert (make-string 2000 ?a))
+                        (put-text-property 500 1500 'p 0)
+                        (dolist (run runs)
+                          (add-text-properties (nth 0 run) (nth 1 run)
+                                               (nth 2 run)))
+                        (buffer-string))))
+        (should (eq (add-text-property-runs runs) t))
+        (should (equal-including-properties (buffer-string) expected))
+        (should (eq (add-text-property-runs runs) nil))))))
+
+(ert-deftest textprop-tests-runs-changes ()
+  "Adding runs of properties runs the change hooks once."
+  (with-temp-buffer
+    (insert "abcdefghij")
+    (set-buffer-modified-p nil)
+    (let* ((changes nil)
+           (after-change-functions
+            (list (lambda (beg end len) (push (list beg end len) changes)))))
+      (add-text-property-runs '((2 4 (p 1)) (6 8 (p 2))))
+      (should (equal changes '((2 8 6))))
+      (should (buffer-modified-p))
+      (should (equal (textprop-tests--properties (current-buffer))
+                     '((1 nil) (2 (p 1)) (4 nil) (6 (p 2)) (8 nil))))))
+  (let ((string (copy-sequence "abcdef")))
+    (add-text-property-runs '((0 2 (p 1)) (2 3 (q 2))) string)
+    (should (equal-including-properties
+             string #("abcdef" 0 2 (p 1) 2 3 (q 2)))))
+  (with-temp-buffer
+    (insert "abcdef")
+    (should-error (add-text-property-runs '((3 5 (p 1)) (1 2 (p 2)))))
+    (should-error (add-text-property-runs '((1 3 (p 1)) (2 4 (p 2)))))
+    (should-error (add-text-property-runs '((1 30 (p 1)))))
+    (should (equal (textprop-tests--properties (current-buffer))
+                   '((1 nil))))))
+
+(ert-deftest textprop-tests-many ()
+  "Properties on every word of a buffer survive runs, GCs and deletions."
+  (with-temp-buffer
+    (let ((lines 500))
+      ;; Lines of 9 words of 4 characters: each line is 46 characters
+      ;; long, and word K of line L starts at 1 + 46 L + 5 K.
+      (dotimes (_ lines)
+        (dotimes (_ 9)
+          (insert "word "))
+        (insert "\n"))
+      ;; Words are bold or italic in turn, so the first word is bold on
+      ;; even lines.
+      (dotimes (l lines)
+        (dotimes (k 9)
+          (let ((start (+ 1 (* 46 l) (* 5 k))))
+            (put-text-property start (+ start 4) 'face
+                               (if (zerop (% (+ (* 9 l) k) 2))
+                                   'bold 'italic)))))
+      (let ((n 0))
+        (dotimes (i lines)
+          (let ((l (% (* i 7919) lines)))
+            (when (eq (get-text-property (+ 1 (* 46 l)) 'face) 'bold)
+              (setq n (1+ n)))))
+        (should (= n (/ lines 2))))
+      (dotimes (l lines)
+        (let ((runs nil))
+          (dotimes (k 9)
+            (let ((start (+ 1 (* 46 l) (* 5 k))))
+              (push (list start (+ start 4) '(mouse-face highlight)) runs)))
+          (add-text-property-runs (nreverse runs))))
+      (dotimes (_ 3)
+        (garbage-collect))
+      (should (equal (text-properties-at 47)
+                     '(mouse-face highlight face italic)))
+      ;; Deleting the space after the first word of a line joins that
+      ;; word with the second, and leaves one change of the `face'
+      ;; property instead of two.  Delete from the end so that the
+      ;; positions of the lines do not change.
+      (let ((size (buffer-size))
+            (ls nil))
+        (dotimes (i 100)
+          (push (% (* i 7919) lines) ls))
+        (dolist (l (sort ls #'>))
+          (delete-region (+ 5 (* 46 l)) (+ 6 (* 46 l))))
+        (should (= (buffer-size) (- size 100))))
+      (let ((n 0) (pos (point-min)))
+        (while (setq pos (next-single-property-change pos 'face))
+          (setq n (1+ n)))
+        (should (= n (- (* 2 9 lines) 1 100)))))))
+
+;;; textprop-tests.el ends here
@@ -268,6 +268,63 @@
     (should (string= (buffer-string)
                      "This sentence corrupted?aaa"))))
 
+(ert-deftest undo-test-list-elements ()
+  "Test the elements of `buffer-undo-list' for various changes."
+  (with-temp-buffer
+    (buffer-enable-undo)
+    (insert "abcdef")
+    (undo-boundary)
+    (goto-char 3)
+    (insert "xy")
+    (insert "z")
+    (undo-boundary)
+    (delete-region 2 6)
+    (undo-boundary)
+    (put-text-property 1 3 'face 'bold)
+    (undo-boundary)
+    (delete-region 1 3)
+    (undo-boundary)
+    (goto-char (point-max))
+    (delete-char -1)
+    (should (equal buffer-undo-list
+                   '(("f" . -3) 1 nil ("ac" . 1) 2 nil (nil face nil 1 . 3)
+                     nil ("bxyz" . -2) nil (3 . 6) 7 nil (1 . 7) (t . 0))))
+    (should (equal-including-properties (car (nth 3 buffer-undo-list))
+                                        #("ac" 0 2 (face bold))))
+    (should-not (text-properties-at 0 (car (nth 0 buffer-undo-list))))))
+
+(ert-deftest undo-test-bulk-replacement ()
+  "Test undoing many replacements made in one command."
+  (with-temp-buffer
+    (buffer-enable-undo)
+    (dotimes (i 1000)
+      (insert (propertize "é日" 'p i) " word\n"))
+    (let ((text (buffer-string)))
+      (undo-boundary)
+      (goto-char (point-min))
+      (while (re-search-forward "é\\|word" nil t)
+        (replace-match (if (equal (match-string 0) "é") "e" "words") t t))
+      (should (= (buffer-size) (+ (length text) 1000)))
+      (garbage-collect)
+      (primitive-undo 1 buffer-undo-list)
+      (should (equal-including-properties (buffer-string) text)))))
+
+(ert-deftest undo-test-truncate ()
+  "Test that garbage collection truncates undo information."
+  (with-temp-buffer
+    (buffer-enable-undo)
+    (let ((undo-limit 2000)
+          (undo-strong-limit 3000))
+      (dotimes (_ 1000)
+        (insert "word ")
+        (undo-boundary))
+      (insert (make-string 500 ?x))
+      (garbage-collect)
+      (should (< (length buffer-undo-list) 200))
+      (should (equal (car buffer-undo-list) '(5001 . 5501)))
+      (primitive-undo 1 buffer-undo-list)
+      (should (= (buffer-size) 5000)))))
+
 (defun undo-test-all (&optional interactive)
   "Run all tests for \\[undo]."
   (interactive "p")
@@ -0,0 +1,58 @@
+;;; benchmark-util.el --- Helpers for the benchmarks  -*- lexical-binding: t -*-
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; Keywords:       internal
+;; Human-Keywords: internal
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; The benchmarks in this directory time their steps with the
+;; functions here, which use `benchmark-run'.  Run a benchmark from
+;; the top of the source tree with, for instance,
+;;
+;;   emacs -Q --batch -L test -l syntax-benchmark -f syntax-benchmark
+;;
+;; A benchmark signals an error if one of its steps gives a wrong
+;; result, so that Emacs then exits with a nonzero status.
+
+;;; Code:
+
+(require 'benchmark)
+
+(defun benchmark-util-time (function)
+  "Call FUNCTION with no arguments, and time the call with `benchmark-run'.
+Return a list of the value of FUNCTION, the elapsed time in seconds,
+the number of garbage collections and the time they took."
+  (let* ((value nil)
+         (times (benchmark-run (setq value (funcall function)))))
+    (cons value times)))
+
+(defun benchmark-util-check (name expected function)
+  "Time calling FUNCTION, and check that it returns EXPECTED.
+Report the time under NAME, with the value of FUNCTION if it is
+not `equal' to EXPECTED.  Return t if it is."
+  (let* ((result (benchmark-util-time function))
+         (ok (equal (car result) expected)))
+    (message "%-38s %8.3fs %3d GCs  %s" name (nth 1 result) (nth 2 result)
+             (if ok "" (format "GOT %S, EXPECTED %S" (car result) expected)))
+    ok))
+
+(provide 'benchmark-util)
+
+;;; benchmark-util.el ends here
@@ -0,0 +1,134 @@
+;;; regexp-benchmark.el --- Benchmark for regexp searches
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; Keywords:       internal
+;; Human-Keywords: internal
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Times regexp searches with and without `search-use-dfa', using the
+;; regexps in the font-lock keywords of some major modes over files of
+;; the Emacs sources, and a few regexps on which a backtracking matcher
+;; takes exponential time.  Run it from the top of the source tree with
+;;
+;;   emacs -Q --batch -L test -l regexp-benchmark -f regexp-benchmark
+;;
+;; or load it and type M-x regexp-benchmark RET.  The matches found
+;; with and without the DFA are compared, and any difference is
+;; reported.
+
+;;; Code:
+
+(require 'benchmark-util)
+(require 'font-lock)
+
+(defvar regexp-benchmark-corpora
+  '((emacs-lisp-mode . "lisp/simple.el")
+    (c-mode . "src/xdisp.c")
+    (sh-mode . "make-dist")
+    (texinfo-mode . "doc/lispref/searching.texi")
+    (makefile-gmake-mode . "src/Makefile.in"))
+  "Alist of major modes and files, relative to the source tree, to search.")
+
+(defvar regexp-benchmark-pathological
+  '(("\\(a*\\)*b" . 20)
+    ("\\(?:a\\|aa\\)*c" . 28)
+    ("\\(x+x+\\)+y" . 22))
+  "Alist of regexps and the lengths of strings of `a' or `x' to search.
+A backtracking matcher takes exponential time to find that these
+regexps don't match such strings.")
+
+(defvar regexp-benchmark-repeat 3
+  "How many times to search each file for each regexp.")
+
+(defun regexp-benchmark--regexps ()
+  "Return the regexps in the font-lock keywords of the current buffer."
+  (font-lock-set-defaults)
+  (let ((regexps nil))
+    (dolist (keyword (font-lock-eval-keywords font-lock-keywords))
+      (let ((matcher (if (consp keyword) (car keyword) keyword)))
+        (when (stringp matcher)
+          (push matcher regexps))))
+    (delete-dups (nreverse regexps))))
+
+(defun regexp-benchmark--search (regexps)
+  "Search the current buffer for each of REGEXPS.
+Return a list of the number of matches of each and the sum of their
+positions."
+  (let ((found nil))
+    (dotimes (i regexp-benchmark-repeat)
+      (dolist (regexp regexps)
+        (goto-char (point-min))
+        (let ((count 0) (sum 0))
+          (while (and (re-search-forward regexp nil t)
+                      (or (< (match-beginning 0) (point))
+                          (not (eobp))))
+            (setq count (1+ count) sum (+ sum (match-beginning 0)))
+            (when (= (match-beginning 0) (point))
+              (forward-char 1)))
+          (when (= i 0)
+            (push (cons count sum) found)))))
+    (nreverse found)))
+
+(defun regexp-benchmark--compare (name regexps)
+  "Time searching the current buffer for REGEXPS with and without the DFA.
+NAME describes the search.  Return t if the matches were the same."
+  (let* ((search (lambda () (regexp-benchmark--search regexps)))
+         (with (let ((search-use-dfa t)) (benchmark-util-time search)))
+         (without (let ((search-use-dfa nil)) (benchmark-util-time search)))
+         (same (equal (car with) (car without))))
+    (message "%-34s %4d regexps  DFA %8.3fs  no DFA %8.3fs  %s"
+             name (length regexps) (nth 1 with) (nth 1 without)
+             (if same "" "MATCHES DIFFER"))
+    same))
+
+;;;###autoload
+(defun regexp-benchmark ()
+  "Time regexp searches with and without `search-use-dfa'.
+Signal an error if they did not find the same matches."
+  (interactive)
+  (let ((root (expand-file-name "../" (file-name-directory
+                                       (or load-file-name
+                                           (locate-library
+                                            "regexp-benchmark")))))
+        (ok t))
+    (dolist (corpus regexp-benchmark-corpora)
+      (let ((file (expand-file-name (cdr corpus) root)))
+        (if (not (file-readable-p file))
+            (message "%s: not found" file)
+          (with-temp-buffer
+            (insert-file-contents file)
+            (let ((delay-mode-hooks t))
+              (funcall (car corpus)))
+            (unless (regexp-benchmark--compare
+                     (format "%s %s" (car corpus) (cdr corpus))
+                     (regexp-benchmark--regexps))
+              (setq ok nil))))))
+    (dolist (case regexp-benchmark-pathological)
+      (with-temp-buffer
+        (insert (make-string (cdr case) (if (string-match "x" (car case)) ?x ?a))
+                "\n")
+        (unless (regexp-benchmark--compare (car case) (list (car case)))
+          (setq ok nil))))
+    (unless ok
+      (error "Searches with and without the DFA found different matches"))))
+
+(provide 'regexp-benchmark)
+
+;;; regexp-benchmark.el ends here
@@ -0,0 +1,129 @@
+;;; search-benchmark.el --- Benchmark for literal string searches
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; Keywords:       internal
+;; Human-Keywords: internal
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Times loops of `search-forward' over a large buffer made of copies
+;; of some files of the Emacs sources, with and without
+;; `case-fold-search', in a multibyte and a unibyte buffer.  Forward
+;; searches look for the string with `memchr' where they can, so the
+;; same loop with `search-backward', which always uses the Boyer-Moore
+;; algorithm, is timed for comparison.  Run it from the top of the
+;; source tree with
+;;
+;;   emacs -Q --batch -L test -l search-benchmark -f search-benchmark
+;;
+;; or load it and type M-x search-benchmark RET.  The matches found by
+;; `search-forward' are compared with those that `re-search-forward'
+;; finds for the equivalent regexp, and any difference is reported.
+
+;;; Code:
+
+(require 'benchmark-util)
+
+(defvar search-benchmark-files
+  '("src/xdisp.c" "lisp/simple.el" "doc/lispref/searching.texi"
+    "etc/HELLO")
+  "Files, relative to the source tree, that make up the buffer to search.")
+
+(defvar search-benchmark-copies 10
+  "How many times to insert each file in the buffer to search.")
+
+(defvar search-benchmark-strings
+  '("e" "the" "glyph_row" "it->" "defun " "@node" "xyzzy_absent"
+    "THE" "Struct" "→" "Здравствуйте")
+  "Strings to search for.")
+
+(defun search-benchmark--loop (string forward)
+  "Find all the occurrences of STRING in the current buffer.
+Search forward if FORWARD is non-nil, else backward.  Return the
+sum of the match positions."
+  (let ((sum 0))
+    (goto-char (if forward (point-min) (point-max)))
+    (while (if forward
+               (search-forward string nil t)
+             (search-backward string nil t))
+      (setq sum (+ sum (match-beginning 0))))
+    sum))
+
+(defun search-benchmark--regexp-sum (string)
+  "Return the sum of the positions where a regexp search finds STRING."
+  (let ((regexp (concat "\\(?:" (regexp-quote string) "\\)"))
+        (sum 0))
+    (goto-char (point-min))
+    (while (re-search-forward regexp nil t)
+      (setq sum (+ sum (match-beginning 0))))
+    sum))
+
+(defun search-benchmark--run (name)
+  "Time searches for `search-benchmark-strings' in the current buffer.
+NAME describes the buffer.  Return t if the forward searches found
+the same matches as the regexp searches."
+  (let ((ok t))
+    (dolist (case-fold-search '(nil t))
+      (dolist (string search-benchmark-strings)
+        (when (or enable-multibyte-characters
+                  (string-match "\\`[[:ascii:]]*\\'" string))
+          (let* ((forward (benchmark-util-time
+                           (lambda () (search-benchmark--loop string t))))
+                 (backward (benchmark-util-time
+                            (lambda () (search-benchmark--loop string nil))))
+                 (same (= (car forward)
+                          (search-benchmark--regexp-sum string))))
+            (message "%-9s %-5s %-14s forward %7.3fs  backward %7.3fs  %s"
+                     name (if case-fold-search "fold" "exact")
+                     string (nth 1 forward) (nth 1 backward)
+                     (if same "" "MATCHES DIFFER"))
+            (unless same
+              (setq ok nil))))))
+    ok))
+
+;;;###autoload
+(defun search-benchmark ()
+  "Time loops of `search-forward' and `search-backward' over a large buffer.
+Signal an error if the forward searches found wrong matches."
+  (interactive)
+  (let ((root (expand-file-name "../" (file-name-directory
+                                       (or load-file-name
+                                           (locate-library
+                                            "search-benchmark")))))
+        (ok t))
+    (with-temp-buffer
+      (dolist (file search-benchmark-files)
+        (dotimes (_ search-benchmark-copies)
+          (insert-file-contents (expand-file-name file root))))
+      (message "Searching %d characters" (buffer-size))
+      ;; Leave the gap in the middle, as editing would.
+      (goto-char (/ (point-max) 2))
+      (insert " ")
+      (delete-char -1)
+      (unless (search-benchmark--run "multibyte")
+        (setq ok nil))
+      (set-buffer-multibyte nil)
+      (unless (search-benchmark--run "unibyte")
+        (setq ok nil)))
+    (unless ok
+      (error "Forward searches and regexp searches found different matches"))))
+
+(provide 'search-benchmark)
+
+;;; search-benchmark.el ends here
@@ -0,0 +1,149 @@
+;;; syntax-benchmark.el --- Benchmark for scans over long lines
+
+;; Copyright (C) 2014 Free Software Foundation, Inc.
+
+;; Keywords:       internal
+;; Human-Keywords: internal
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Times `scan-lists', `scan-sexps' and `forward-comment' over
+;; minified sources: a JSON document and a JavaScript program, each
+;; on a single line of a few megabytes, as editing such files makes
+;; them scan.  Run it from the top of the source tree with
+;;
+;;   emacs -Q --batch -L test -l syntax-benchmark -f syntax-benchmark
+;;
+;; or load it and type M-x syntax-benchmark RET.  Each scan should
+;; stop at a known place, and any other result is reported.
+
+;;; Code:
+
+(require 'benchmark-util)
+(require 'json)
+(require 'js)
+
+(defvar syntax-benchmark-size 2000000
+  "Rough size of each minified source, in characters.")
+
+(defun syntax-benchmark--json ()
+  "Insert a minified JSON document of `syntax-benchmark-size' characters."
+  (let ((i 0))
+    (insert "[")
+    (while (< (buffer-size) syntax-benchmark-size)
+      (insert (json-encode
+               `((id . ,i)
+                 (name . ,(format "item number %d, with \"quotes\"" i))
+                 (tags . ["alpha" "beta" "gamma" "été"])
+                 (point . ((x . ,(* i 0.5)) (y . ,(- i))))
+                 (text . "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua.")))
+              ",")
+      (setq i (1+ i)))
+    (delete-char -1)
+    (insert "]")))
+
+(defun syntax-benchmark--js ()
+  "Insert a minified JavaScript program of `syntax-benchmark-size' characters.
+End it with a line comment.  Return the number of functions inserted."
+  (let ((i 0))
+    (while (< (buffer-size) syntax-benchmark-size)
+      (insert (format "function f%d(a,b){var s=\"str\\\"ing %d\",t='q';/* comment %d */return a+b*[1,2,{k:s,v:t}].length}"
+                      i i i))
+      (setq i (1+ i)))
+    (insert "//# sourceMappingURL=app.min.js.map\n")
+    i))
+
+(defun syntax-benchmark--count (pos count limit)
+  "Return how many times `scan-sexps' moves by COUNT from POS before LIMIT."
+  (let ((n 0))
+    (while (and (setq pos (scan-sexps pos count))
+                (if (> count 0) (<= pos limit) (>= pos limit)))
+      (setq n (1+ n)))
+    n))
+
+;;;###autoload
+(defun syntax-benchmark ()
+  "Time scans over minified JSON and JavaScript sources.
+Signal an error if some did not stop where they should."
+  (interactive)
+  (let ((ok t))
+    (with-temp-buffer
+      (set-syntax-table js-mode-syntax-table)
+      (syntax-benchmark--json)
+      (message "Scanning %d characters of JSON" (buffer-size))
+      (let* ((middle (save-excursion
+                       ;; Between two elements of the top-level array.
+                       (goto-char (/ (point-max) 2))
+                       (search-forward "},{")
+                       (1- (point))))
+             (results
+              (list
+               (benchmark-util-check
+                "forward-sexp over the document" (point-max)
+                (lambda () (scan-sexps (point-min) 1)))
+               (benchmark-util-check
+                "backward-sexp over the document" (point-min)
+                (lambda () (scan-sexps (point-max) -1)))
+               (benchmark-util-check
+                "up-list from the middle" (point-max)
+                (lambda () (scan-lists middle 1 1)))
+               (benchmark-util-check
+                "backward-up-list from the middle" (point-min)
+                (lambda () (scan-lists middle -1 1))))))
+        (setq ok (and ok (not (memq nil results)))))
+      (erase-buffer)
+      (let* ((functions (prog1 (syntax-benchmark--js)
+                          (message "Scanning %d characters of JavaScript"
+                                   (buffer-size))))
+             (comment (save-excursion
+                        (goto-char (point-max))
+                        (search-backward "//")))
+             (results
+              (list
+               ;; Each function is four sexps: the keyword, the name,
+               ;; the arguments and the body.
+               (benchmark-util-check
+                "forward-sexp over the functions" (* 4 functions)
+                (lambda () (syntax-benchmark--count (point-min) 1 comment)))
+               (benchmark-util-check
+                "backward-sexp over the functions" (* 4 functions)
+                (lambda ()
+                  (syntax-benchmark--count comment -1 (point-min))))
+               (benchmark-util-check
+                "forward-comment over the comments" functions
+                (lambda ()
+                  (let ((count 0))
+                    (goto-char (point-min))
+                    (while (search-forward "/*" comment t)
+                      (goto-char (- (point) 2))
+                      (when (forward-comment 1)
+                        (setq count (1+ count))))
+                    count)))
+               (benchmark-util-check
+                "backward over the final line comment" comment
+                (lambda ()
+                  (goto-char (point-max))
+                  (forward-comment -1)
+                  (point))))))
+        (setq ok (and ok (not (memq nil results))))))
+    (unless ok
+      (error "Some scans stopped at the wrong place"))))
+
+(provide 'syntax-benchmark)
+
+;;; syntax-benchmark.el ends here